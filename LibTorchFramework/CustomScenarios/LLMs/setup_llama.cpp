@@ -37,8 +37,12 @@
 #include "../../InputProcessing/InputLoadersWrapper.h"
 #include "../../InputProcessing/InputLoader.h"
 #include "../../InputProcessing/DataLoaderData.h"
+#include "../../InputProcessing/TokenShardDataset.h"
 
 #include "../../InputProcessing/InputLoaders/TextFilesInputLoader.h"
+#include "../../InputProcessing/InputLoaders/TokenStreamInputLoader.h"
+#include "../../InputProcessing/StreamingDataset.h"
+#include "../../InputProcessing/SampleDataset.h"
 
 //=========================================================
 // ModelZoo
@@ -46,6 +50,7 @@
 
 #include "../../ModelZoo/LLMs/llama.h"
 #include "../../ModelZoo/LLMs/LLamaSafeTensorLoader.h"
+#include "../../ModelZoo/LLMs/LlamaPerplexity.h"
 
 //=========================================================
 // Utils
@@ -59,11 +64,14 @@
 #include <FileUtils/Reading/TextFileReader.h>
 #include <Utils/cJSON.h>
 
+#include <filesystem>
+
 //=========================================================
 
 #include "../_tests_/llm_smoke_tests.h"
 #include "../_tests_/tokenizer_tests.h"
 #include "../_tests_/optimizers_tests.h"
+#include "../_tests_/training_state_tests.h"
 
 using namespace ModelZoo::llama;
 
@@ -164,6 +172,9 @@ namespace CustomScenarios::LLMs::Llama
         //CustomScenarios::_tests_::test_matches_adamw_when_quant_off();
         CustomScenarios::_tests_::test_loss_decreases_toy_regression_adamw8();
         CustomScenarios::_tests_::test_loss_decreases_toy_regression_fused_adamw8();
+        CustomScenarios::_tests_::test_named_state_roundtrip_adamw8();
+        CustomScenarios::_tests_::test_named_state_roundtrip_fused_adamw8();
+        CustomScenarios::_tests_::test_training_state_resume_bucketed();
         
         
         //auto bpeGemma = TokenizerBPE("d://tokenizer_gemma.json");
@@ -178,6 +189,9 @@ namespace CustomScenarios::LLMs::Llama
         std::shared_ptr<TokenizerBPE> bpe = std::make_shared<TokenizerBPE>("d://tokenizer.json");
         bpe->Load();
         //RunBpeJsonTests("D://res_tokenizer_llama3.2.json", *bpe.get());
+        //RunBpeCompiledTests("D://res_tokenizer_llama3.2.json", *bpe.get(), "D://tokenizer_llama3.2.bin");
+        //RunTokenShardTests("D://token_shards_test");
+        CustomScenarios::_tests_::RunBpeTrainerTests((std::filesystem::temp_directory_path() / "tokenizer_trainer_test.json").string().c_str());
 
         StringUtf8 prompt = LlamaConfig::InstructPrompt(u8"Hello! Briefly explain what weather warnings are.\n");
 
@@ -263,7 +277,8 @@ namespace CustomScenarios::LLMs::Llama
             auto vocab_size = output[0].size(-1);
             auto x = output[0].view({ -1, vocab_size });
             auto gt = targets.view({ -1 });
-            auto loss = torch::nn::functional::cross_entropy(x, gt);
+            auto loss = torch::nn::functional::cross_entropy(x, gt,
+                torch::nn::functional::CrossEntropyFuncOptions().ignore_index(TextFilesInputLoader::IGNORE_TARGET));
             auto lossVal = loss.cpu();
 
             return loss;
@@ -284,6 +299,7 @@ namespace CustomScenarios::LLMs::Llama
         
         //CustomScenarios::_tests_::Llama::GreedySmokeTestInference(llama, bpe, 256, 40);
         //CustomScenarios::_tests_::Llama::SmokeTestInference(llama, bpe, 256, 40);
+        //ModelZoo::llama::PerplexityEvaluator(llama, { 2048, 512, 4 }).Evaluate(TokenShardDataset("D:\\Datasets\\llama_tokens_eval"));
         //return;
 
         int lora_r = 8;
@@ -305,7 +321,7 @@ namespace CustomScenarios::LLMs::Llama
 
         uint16_t ctxLen = 128;
         auto ilw = std::make_shared<InputLoadersWrapper>(std::vector<uint16_t>{ ctxLen });
-        ilw->InitLoaders<TextFilesInputLoader, std::shared_ptr<Tokenizer>, int32_t, std::string>({ RunMode::TRAIN }, bpe, ctxLen,  "");
+        ilw->InitLoaders<TextFilesInputLoader, std::shared_ptr<Tokenizer>, int32_t, std::string, TextFilesInputLoader::SampleMode>({ RunMode::TRAIN }, bpe, ctxLen, "D:\\Datasets\\llama_tokens", TextFilesInputLoader::SampleMode::PACKED_WINDOWS);
 
                 
         //llama->CreateOptimizer<torch::optim::AdamW>(torch::optim::AdamWOptions(5e-5).weight_decay(0.01).betas(std::make_tuple(0.9, 0.95)));
@@ -318,8 +334,15 @@ namespace CustomScenarios::LLMs::Llama
         //sets.pretrainedManager->EnableSaving(false);
         //sets.pretrainedManager->EnableLoading(false);
 
+        //streaming - no indexing pass, epoch is given by steps
+        //ilw->InitLoaders<TokenStreamInputLoader, int32_t, std::string>({ RunMode::TRAIN }, ctxLen, "D:\\Datasets\\llama_tokens");
+        //sets.epochSteps = 1000;
+
         TrainingHelper th(sets, llama);
-        th.Run(ilw);
+        //typed samples (no additionalData map per sample)
+        th.Run<SampleDataset<TextSample>>(ilw);
+        //th.Run(ilw);
+        //th.Run<StreamingDataset>(ilw);
         
         printf("=====");
 	}
@@ -5,8 +5,10 @@
 #include <torch/torch.h>
 
 #include "../../core/Tokenizers/TokenizerBPE.h"
+#include "../../core/Tokenizers/StreamingDecoder.h"
 
 #include "../../ModelZoo/LLMs/llama.h"
+#include "../../ModelZoo/LLMs/LlamaSession.h"
 
 using namespace ModelZoo::llama;
 
@@ -177,6 +179,10 @@ namespace CustomScenarios::_tests_::Llama
 
 		torch::Tensor gen = x.clone();
 		std::tie(logits, kvCache) = model->forward_with_cache(x, {}, true);
+
+		//print generated text as it comes
+		StreamingDecoder stream(*bpe);
+		std::cout << "\n=== SMOKE STREAM ===\n";
 		
 		for (int64_t step = 0; step < steps; ++step)
 		{
@@ -256,6 +262,8 @@ namespace CustomScenarios::_tests_::Llama
 				break;
 			}
 
+			std::cout << ((const char*)stream.Push(static_cast<TokenId>(next_token)).c_str()) << std::flush;
+
 			if (!kvCache.empty() && kvCache[0].k.size(2) >= seq_len)
 			{
 				break;
@@ -264,6 +272,7 @@ namespace CustomScenarios::_tests_::Llama
 			std::tie(logits, kvCache) = model->forward_with_cache(next_id_dev, kvCache, true);
 			
 		}
+		std::cout << ((const char*)stream.Flush().c_str()) << "\n======================\n" << std::endl;
 		//================================================
 		
 		std::vector<TokenId> outIds(gen.size(1));
@@ -281,4 +290,60 @@ namespace CustomScenarios::_tests_::Llama
 		//std::cout << "\n=== SMOKE GENERATED ===\n" << out << "\n======================\n\n";
 		
 	}
+
+	void SessionSaveLoadSmokeTest(
+		std::shared_ptr<ModelZoo::llama::LlamaForCausalLM> model,
+		std::shared_ptr<TokenizerBPE> bpe,
+		const std::string& sessionPath)
+	{
+		auto device = torch::kCUDA;
+
+		StringUtf8 prompt = LlamaConfig::InstructPrompt(u8"Hello! Briefly explain what weather warnings are.\n");
+
+		torch::NoGradGuard noGrad;
+		model->eval();
+
+		std::vector<TokenId> ids = bpe->Encode(prompt, false, false);
+		torch::Tensor x = torch::tensor(ids, torch::TensorOptions().dtype(torch::kLong).device(device)).unsqueeze(0);
+
+		//prefill and continue with one token - reference
+		auto [logits, kvCache] = model->forward_with_cache(x, {}, true);
+		torch::Tensor nextId = logits.index({ 0, -1 }).argmax().view({ 1, 1 });
+		torch::Tensor refLogits = model->forward_with_cache(nextId, kvCache, true).first.to(torch::kFloat32);
+
+		LlamaSession session;
+		session.kvCache = kvCache;
+		session.tokens = TensorToInt64Vector(x.index({ 0 }));
+		session.lastLogits = logits.index({ 0, -1 });
+
+		for (auto storage : { LlamaSession::StorageType::NATIVE, LlamaSession::StorageType::INT8 })
+		{
+			if (session.Save(sessionPath, model->GetConfig(), storage) == false)
+			{
+				throw std::runtime_error("Session save failed");
+			}
+
+			LlamaSession restored;
+			if (restored.Load(sessionPath, model->GetConfig(), device, kvCache[0].k.scalar_type()) == false)
+			{
+				throw std::runtime_error("Session load failed");
+			}
+
+			if ((restored.tokens != session.tokens) || (restored.GetCachedLength() != session.GetCachedLength()))
+			{
+				throw std::runtime_error("Restored session differs");
+			}
+
+			torch::Tensor outLogits = model->forward_with_cache(nextId, restored.kvCache, true).first.to(torch::kFloat32);
+			double maxDiff = (outLogits - refLogits).abs().max().item<double>();
+
+			std::cout << "SESSION " << ((storage == LlamaSession::StorageType::INT8) ? "int8" : "native")
+				<< " max logits diff: " << maxDiff << std::endl;
+
+			if ((storage == LlamaSession::StorageType::NATIVE) && (maxDiff != 0.0))
+			{
+				throw std::runtime_error("Restored native session gives different logits");
+			}
+		}
+	}
 }
\ No newline at end of file
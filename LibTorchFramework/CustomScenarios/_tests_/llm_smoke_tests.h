@@ -11,6 +11,7 @@ namespace ModelZoo
 
 #include <cstdint>
 #include <memory>
+#include <string>
 
 namespace CustomScenarios
 {
@@ -35,6 +36,12 @@ namespace CustomScenarios
 				double top_p = 0.9,
 				double repetition_penalty = 1.15
 			);
+
+			void SessionSaveLoadSmokeTest(
+				std::shared_ptr<ModelZoo::llama::LlamaForCausalLM> model,
+				std::shared_ptr<TokenizerBPE> bpe,
+				const std::string& sessionPath
+			);
 		}
 	}
 }
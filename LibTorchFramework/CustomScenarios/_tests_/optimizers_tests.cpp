@@ -18,6 +18,7 @@
 
 #include "../../core/Optimizers/AdamW8bit.h"
 #include "../../core/Optimizers/FusedAdamW8bit.h"
+#include "../../core/Optimizers/NamedStateOptimizer.h"
 
 namespace CustomScenarios::_tests_
 {
@@ -221,6 +222,91 @@ namespace CustomScenarios::_tests_
         test_loss_decreases_toy_regression<FusedAdamW8bit>(myopt);
     }
 
+    //========================================================================================
+
+    // State exported from one optimizer and imported to fresh one (as after restart,
+    // different TensorImpl addresses) must continue with identical updates
+    template <typename Opt, typename OptSets>
+    void test_named_state_roundtrip(const OptSets& sets)
+    {
+        std::cout << "[TEST] named state save/load roundtrip...\n";
+
+        auto dev = pick_device();
+
+        seed_all(7);
+
+        auto opts = torch::TensorOptions().device(dev).dtype(torch::kFloat32);
+
+        torch::OrderedDict<std::string, torch::Tensor> paramsA;
+        paramsA.insert("big", torch::randn({ 64, 128 }, opts).set_requires_grad(true));
+        paramsA.insert("small", torch::randn({ 19 }, opts).set_requires_grad(true));
+
+        Opt a(paramsA.values(), sets);
+
+        for (int step = 0; step < 5; ++step)
+        {
+            for (auto& p : paramsA)
+            {
+                p.value().mutable_grad() = torch::randn_like(p.value());
+            }
+            a.step();
+        }
+
+        NamedStateOptimizer::TensorMap state;
+        a.save_named_state(paramsA, state);
+
+        torch::OrderedDict<std::string, torch::Tensor> paramsB;
+        for (const auto& p : paramsA)
+        {
+            paramsB.insert(p.key(), p.value().detach().clone().set_requires_grad(true));
+        }
+
+        Opt b(paramsB.values(), sets);
+        auto loaded = b.load_named_state(paramsB, state);
+        if (loaded != paramsB.size())
+        {
+            std::cerr << "\n[FAIL] state restored for " << loaded << " / " << paramsB.size() << " params\n";
+            std::exit(1);
+        }
+
+        for (int step = 0; step < 5; ++step)
+        {
+            for (size_t i = 0; i < paramsA.size(); i++)
+            {
+                auto g = torch::randn_like(paramsA[i]);
+                paramsA[i].mutable_grad() = g.clone();
+                paramsB[i].mutable_grad() = g.clone();
+            }
+            a.step();
+            b.step();
+
+            for (size_t i = 0; i < paramsA.size(); i++)
+            {
+                assert_allclose(paramsB[i], paramsA[i], /*rtol=*/0.0, /*atol=*/0.0, paramsA.keys()[i].c_str());
+            }
+        }
+
+        std::cout << "  OK\n";
+    }
+
+    void test_named_state_roundtrip_adamw8()
+    {
+        AdamW8bitOptions myopt(1e-3);
+        myopt.block_size(256);
+        myopt.min_quantized_numel(4096);
+        myopt.amsgrad(true);
+
+        test_named_state_roundtrip<AdamW8bit>(myopt);
+    }
+
+    void test_named_state_roundtrip_fused_adamw8()
+    {
+        FusedAdamW8bitOptions myopt(1e-3);
+        myopt.block_size(256);
+        myopt.min_quantized_numel(4096);
+
+        test_named_state_roundtrip<FusedAdamW8bit>(myopt);
+    }
 
     /*
     static void test_quant_roundtrip_sanity(torch::Device dev)
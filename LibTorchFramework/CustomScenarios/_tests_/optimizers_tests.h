@@ -12,6 +12,9 @@ namespace CustomScenarios
 
 		void test_loss_decreases_toy_regression_adamw8();
 		void test_loss_decreases_toy_regression_fused_adamw8();
+
+		void test_named_state_roundtrip_adamw8();
+		void test_named_state_roundtrip_fused_adamw8();
 		
 	}
 }
\ No newline at end of file
@@ -1,11 +1,19 @@
 #include "./tokenizer_tests.h"
 
 #include <vector>
+#include <algorithm>
+#include <string>
+#include <filesystem>
+#include <iterator>
 
 #include <Utils/cJSON.h>
 #include <FileUtils/Reading/TextFileReader.h>
 
 #include "../../core/Tokenizers/TokenizerBPE.h"
+#include "../../core/Tokenizers/TokenizerBPETrainer.h"
+#include "../../core/Tokenizers/TokenShardFile.h"
+
+#include "../../InputProcessing/TokenShardDataset.h"
 
 namespace CustomScenarios::_tests_
 {
@@ -55,6 +63,9 @@ namespace CustomScenarios::_tests_
 
         const int count = cJSON_GetArraySize(root);
 
+        std::vector<StringUtf8> prompts;
+        std::vector<std::vector<int32_t>> expectedAll;
+
         for (int i = 0; i < count; ++i)
         {
             cJSON* item = cJSON_GetArrayItem(root, i);
@@ -68,6 +79,9 @@ namespace CustomScenarios::_tests_
 
             auto got = tok.Encode(prompt, false, false);
 
+            prompts.push_back(prompt);
+            expectedAll.push_back(expected);
+
             if (got == expected)
             {
                 continue;
@@ -95,6 +109,168 @@ namespace CustomScenarios::_tests_
         }
 
         cJSON_Delete(root);
+
+        //parallel batch encoding must give the same ids
+        auto flat = tok.EncodeBatchFlat(prompts);
+        for (size_t i = 0; i < prompts.size(); ++i)
+        {
+            auto got = flat.Get(i);
+            if (std::equal(got.begin(), got.end(), expectedAll[i].begin(), expectedAll[i].end()) == false)
+            {
+                std::printf("---- FAIL batch #%zu ----\n", i);
+                PrintIds("Expected ", expectedAll[i]);
+                PrintIds("Got      ", std::vector<int32_t>(got.begin(), got.end()));
+                break;
+            }
+        }
+    }
+
+    void RunBpeCompiledTests(const char* jsonPath, TokenizerBPE& tok, const char* compiledPath)
+    {
+        //compiled file loaded via mmap must encode the same as tokenizer.json
+        tok.SaveCompiled(compiledPath);
+
+        TokenizerBPE compiled(compiledPath);
+        compiled.Load();
+
+        RunBpeJsonTests(jsonPath, compiled);
+    }
+
+    void RunBpeTrainerTests(const char* outJsonPath)
+    {
+        //train small tokenizer, load it back and check encode / decode round trip
+        std::vector<StringUtf8> texts = {
+            u8"Severe thunderstorm warning in effect for the northern region until 18:00.",
+            u8"Heavy rain warning: 40-60 mm of rain expected overnight, local flooding possible.",
+            u8"for (size_t i = 0; i < count; i++) { sum += values[i]; }",
+            u8"Předpověď počasí: zítra slunečno, teploty 20 až 25 °C. 天气预报 ☀️🌧️"
+        };
+
+        TokenizerBPETrainer::Settings settings;
+        settings.vocabSize = 400;
+        settings.minFrequency = 1;
+        settings.specialTokens = { u8"<|begin_of_text|>", u8"<|end_of_text|>" };
+
+        TokenizerBPETrainer trainer(settings);
+        for (int i = 0; i < 10; i++)
+        {
+            trainer.AddTexts(texts);
+        }
+        trainer.Train();
+        trainer.Save(outJsonPath);
+
+        TokenizerBPE tok(outJsonPath);
+        tok.Load();
+
+        for (const auto& t : texts)
+        {
+            auto ids = tok.Encode(t, false, false);
+            if (tok.Decode(ids) != t)
+            {
+                std::printf("---- FAIL trainer round trip ----\n");
+                std::printf("Text: %s\n", (const char*)t.c_str());
+                PrintIds("Got      ", ids);
+            }
+        }
+
+        auto special = tok.Encode(u8"<|begin_of_text|>Hello", false, false);
+        if (special.empty() || (special[0] != static_cast<TokenId>(trainer.GetVocab().size())))
+        {
+            std::printf("---- FAIL trainer special token ----\n");
+        }
+    }
+
+    void RunTokenShardTests(const char* outDir)
+    {
+        //write shards of different sizes and read token stream back across shard borders
+        std::filesystem::create_directories(outDir);
+
+        std::vector<TokenId> expected;
+        std::vector<uint64_t> expectedStarts;
+        const size_t shardSizes[] = { 1000, 37, 5000, 1, 2048 };
+
+        for (size_t s = 0; s < std::size(shardSizes); s++)
+        {
+            char name[64];
+            std::snprintf(name, sizeof(name), "shard_%05zu.bin", s);
+
+            TokenShardFile::Writer w((std::filesystem::path(outDir) / name).string(), 2);
+            for (size_t i = 0; i < shardSizes[s]; i++)
+            {
+                if (i % 100 == 0)
+                {
+                    expectedStarts.push_back(expected.size());
+                }
+
+                TokenId id = static_cast<TokenId>((expected.size() * 7919) % 65536);
+                w.AppendTokens(std::span<const TokenId>(&id, 1));
+                expected.push_back(id);
+                if (i % 100 == 99)
+                {
+                    w.EndDocument();
+                }
+            }
+            if (shardSizes[s] % 100 != 0)
+            {
+                w.EndDocument();
+            }
+            w.Finish();
+        }
+
+        TokenShardDataset ds(outDir);
+        if (ds.GetTokensCount() != expected.size())
+        {
+            std::printf("---- FAIL token shards count ----\n");
+            return;
+        }
+
+        std::vector<int64_t> buf;
+        std::vector<uint64_t> starts;
+        for (size_t start = 0; start < expected.size(); start += 13)
+        {
+            size_t count = std::min<size_t>(129, expected.size() - start);
+            buf.resize(count);
+            ds.CopyTokens(start, count, buf.data());
+
+            ds.GetDocumentStarts(start, count, starts);
+            std::vector<uint64_t> expectedRange;
+            std::copy_if(expectedStarts.begin(), expectedStarts.end(), std::back_inserter(expectedRange),
+                [&](uint64_t v) { return (v >= start) && (v < start + count); });
+            if (starts != expectedRange)
+            {
+                std::printf("---- FAIL token shards document starts at %zu ----\n", start);
+                return;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (buf[i] != expected[start + i])
+                {
+                    std::printf("---- FAIL token shards at %zu ----\n", start + i);
+                    return;
+                }
+            }
+        }
+
+        //every document is whole, so documents are exactly expectedStarts
+        if (ds.GetDocumentsCount() != expectedStarts.size())
+        {
+            std::printf("---- FAIL token shards documents count ----\n");
+            return;
+        }
+        for (size_t d = 0; d < expectedStarts.size(); d++)
+        {
+            uint64_t docStart = 0;
+            uint64_t docLength = 0;
+            ds.GetDocument(d, docStart, docLength);
+
+            uint64_t docEnd = (d + 1 < expectedStarts.size()) ? expectedStarts[d + 1] : expected.size();
+            if ((docStart != expectedStarts[d]) || (docLength != docEnd - expectedStarts[d]))
+            {
+                std::printf("---- FAIL token shards document %zu ----\n", d);
+                return;
+            }
+        }
     }
 
 }
\ No newline at end of file
@@ -10,5 +10,8 @@ namespace CustomScenarios
 	namespace _tests_
 	{
 		void RunBpeJsonTests(const char* jsonPath, TokenizerBPE& tok);
+		void RunBpeCompiledTests(const char* jsonPath, TokenizerBPE& tok, const char* compiledPath);
+		void RunBpeTrainerTests(const char* outJsonPath);
+		void RunTokenShardTests(const char* outDir);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "./training_state_tests.h"
+
+#include <iostream>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "../../InputProcessing/BucketBatchSampler.h"
+#include "../../core/Snapshot/TrainingState.h"
+
+namespace CustomScenarios::_tests_
+{
+    static void fail(const std::string& what)
+    {
+        std::cerr << "\n[FAIL] " << what << "\n";
+        std::exit(1);
+    }
+
+    /// <summary>
+    /// Bucketed batches (Settings::maxBatchTokens) use first data index
+    /// as batch id (see Trainer::GetBatchId), ids are larger than batches count.
+    /// State saved in the middle of epoch must be resumed (Trainer::OnEpochStart
+    /// compares batches count) and only the processed batches are skipped
+    /// </summary>
+    void test_training_state_resume_bucketed()
+    {
+        std::cout << "[TEST] training state resume with bucketed batches...\n";
+
+        const size_t SAMPLES = 500;
+        const size_t MAX_BATCH_TOKENS = 256;
+        const size_t MAX_BATCH_SIZE = 16;
+        const int SEED = 42;
+
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int64_t> len(4, 128);
+
+        std::vector<std::vector<int64_t>> shapes;
+        for (size_t i = 0; i < SAMPLES; i++)
+        {
+            shapes.push_back({ len(rng) });
+        }
+
+        auto getPlan = [&]() {
+            BucketBatchSampler sampler(shapes, MAX_BATCH_TOKENS, MAX_BATCH_SIZE, SEED);
+            sampler.reset();
+
+            std::vector<std::vector<size_t>> plan;
+            while (auto b = sampler.next(MAX_BATCH_SIZE))
+            {
+                plan.push_back(*b);
+            }
+
+            if (plan.size() != sampler.GetBatchesCount(MAX_BATCH_SIZE))
+            {
+                fail("sampler returned different number of batches than GetBatchesCount");
+            }
+            return plan;
+        };
+
+        //interrupted run - first part of epoch is processed
+        auto plan = getPlan();
+        const size_t batchesCount = plan.size();
+        const size_t processed = batchesCount / 2;
+
+        TrainingState state;
+        state.SetEpoch(3, batchesCount);
+        for (size_t i = 0; i < processed; i++)
+        {
+            state.MarkBatchProcessed(plan[i][0]);
+        }
+
+        auto path = (std::filesystem::temp_directory_path() / "training_state_bucketed_test.safetensors").string();
+        if (state.Save(path) == false)
+        {
+            fail("training state was not saved");
+        }
+
+        //restarted run - loaders are rebuilt with the same seed
+        TrainingState resumed;
+        if (resumed.Load(path) == false)
+        {
+            fail("training state was not loaded");
+        }
+        std::filesystem::remove(path);
+
+        if ((resumed.GetEpochId() != 3) || (resumed.GetBatchesCount() != batchesCount))
+        {
+            fail("loaded state does not match epoch (resume would start epoch from the beginning)");
+        }
+        if (resumed.GetProcessedBatchesCount() != processed)
+        {
+            fail("processed batches count differs after load");
+        }
+
+        auto planResumed = getPlan();
+        if (planResumed != plan)
+        {
+            fail("bucketed plan differs between runs");
+        }
+
+        size_t skipped = 0;
+        for (size_t i = 0; i < planResumed.size(); i++)
+        {
+            bool isProcessed = resumed.IsBatchProcessed(planResumed[i][0]);
+            if (isProcessed != (i < processed))
+            {
+                fail("batch " + std::to_string(i) + " has wrong processed flag");
+            }
+            skipped += isProcessed ? 1 : 0;
+        }
+
+        std::cout << "  OK (batches: " << batchesCount << ", skipped on resume: " << skipped << ")\n";
+    }
+}
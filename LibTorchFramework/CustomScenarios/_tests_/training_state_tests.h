@@ -0,0 +1,9 @@
+#pragma once
+
+namespace CustomScenarios
+{
+	namespace _tests_
+	{
+		void test_training_state_resume_bucketed();
+	}
+}
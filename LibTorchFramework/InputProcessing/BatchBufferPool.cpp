@@ -0,0 +1,184 @@
+#include "./BatchBufferPool.h"
+
+#include <optional>
+
+#ifdef USE_CUDA
+#   include <ATen/cuda/CUDAEvent.h>
+#endif
+
+//============================================
+
+struct BatchBufferPool::Buffer
+{
+    at::Tensor tensor;
+    bool inUse = false;
+
+#ifdef USE_CUDA
+    //recorded when batch was released, async copy from buffer
+    //issued before must be finished before buffer is overwritten
+    at::cuda::CUDAEvent released;
+    bool hasReleased = false;
+#endif
+};
+
+//============================================
+
+BatchBufferPool::Lease::Lease(std::shared_ptr<BatchBufferPool> pool) :
+    pool(pool)
+{
+}
+
+BatchBufferPool::Lease::~Lease()
+{
+    if (this->buffers.empty() == false)
+    {
+        this->pool->Release(this->buffers);
+    }
+}
+
+//============================================
+
+BatchBufferPool::BatchBufferPool(bool pinned, size_t maxBuffers) :
+    pinned(pinned),
+    maxBuffers(maxBuffers),
+    allocationsCount(0)
+{
+}
+
+BatchBufferPool::~BatchBufferPool()
+{
+}
+
+std::shared_ptr<BatchBufferPool::Lease> BatchBufferPool::CreateLease()
+{
+    return std::make_shared<Lease>(shared_from_this());
+}
+
+bool BatchBufferPool::IsPinned() const
+{
+    return this->pinned;
+}
+
+/// <summary>
+/// Number of tensors allocated by pool (does not grow in steady state)
+/// </summary>
+/// <returns></returns>
+size_t BatchBufferPool::GetAllocationsCount() const
+{
+    std::lock_guard<std::mutex> lk(m);
+    return this->allocationsCount;
+}
+
+/// <summary>
+/// Get free buffer with given shape and type. Content is undefined.
+/// If there is no matching free buffer, unused buffer of other shape
+/// is replaced. If the pool is full, tensor outside pool is returned
+/// </summary>
+/// <param name="shape"></param>
+/// <param name="dtype"></param>
+/// <param name="lease"></param>
+/// <returns></returns>
+at::Tensor BatchBufferPool::Acquire(at::IntArrayRef shape, at::ScalarType dtype, Lease& lease)
+{
+    std::unique_lock<std::mutex> lk(m);
+
+    std::optional<size_t> replaceId = std::nullopt;
+
+    for (size_t i = 0; i < this->buffers.size(); i++)
+    {
+        auto& b = *this->buffers[i];
+
+        //storage still referenced outside of pool (views kept by someone)
+        if ((b.inUse) || (b.tensor.storage().use_count() > 1))
+        {
+            continue;
+        }
+
+        if ((b.tensor.sizes() != shape) || (b.tensor.scalar_type() != dtype))
+        {
+            if (replaceId.has_value() == false)
+            {
+                replaceId = i;
+            }
+            continue;
+        }
+
+        b.inUse = true;
+        lease.buffers.push_back(i);
+
+#ifdef USE_CUDA
+        if (b.hasReleased)
+        {
+            b.hasReleased = false;
+            lk.unlock();
+            b.released.synchronize();
+        }
+#endif
+
+        return b.tensor;
+    }
+
+    size_t id = 0;
+    if (this->buffers.size() < this->maxBuffers)
+    {
+        id = this->buffers.size();
+        this->buffers.push_back(std::make_unique<Buffer>());
+    }
+    else if (replaceId.has_value())
+    {
+        //old tensor is freed, pinned memory allocator
+        //itself waits for copies that use it
+        id = replaceId.value();
+    }
+    else
+    {
+        this->allocationsCount++;
+        lk.unlock();
+        return this->Allocate(shape, dtype);
+    }
+
+    auto& b = *this->buffers[id];
+    b.inUse = true;
+    b.tensor = at::Tensor();
+#ifdef USE_CUDA
+    b.hasReleased = false;
+#endif
+    lease.buffers.push_back(id);
+    this->allocationsCount++;
+
+    lk.unlock();
+    auto t = this->Allocate(shape, dtype);
+
+    lk.lock();
+    b.tensor = t;
+
+    return t;
+}
+
+at::Tensor BatchBufferPool::Allocate(at::IntArrayRef shape, at::ScalarType dtype) const
+{
+    return torch::empty(shape, torch::TensorOptions()
+        .dtype(dtype)
+        .device(torch::kCPU)
+        .pinned_memory(this->pinned));
+}
+
+void BatchBufferPool::Release(const std::vector<size_t>& ids)
+{
+    std::lock_guard<std::mutex> lk(m);
+
+    for (size_t id : ids)
+    {
+        auto& b = *this->buffers[id];
+        b.inUse = false;
+
+#ifdef USE_CUDA
+        if (this->pinned)
+        {
+            //on current stream, after copy of batch to device
+            b.released.record();
+            b.hasReleased = true;
+        }
+#endif
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef BATCH_BUFFER_POOL_H
+#define BATCH_BUFFER_POOL_H
+
+#include <memory>
+#include <vector>
+#include <mutex>
+
+#include <torch/torch.h>
+
+/// <summary>
+/// Pool of reusable batch tensors for collation (Stack<DataLoaderData>).
+/// Samples are copied to slots of preallocated batch tensor,
+/// so in steady state no new batch memory is allocated.
+///
+/// Buffers of one batch are held by Lease stored in DataLoaderData,
+/// they return to pool when batch is destroyed (step is done).
+/// Buffer is reused only if nobody else holds its storage
+/// (e.g. target kept by metrics).
+///
+/// If pinned, buffers are in page-locked memory and async copy
+/// to device must finish before buffer is reused (CUDA event)
+/// </summary>
+class BatchBufferPool : public std::enable_shared_from_this<BatchBufferPool>
+{
+public:
+    class Lease
+    {
+    public:
+        explicit Lease(std::shared_ptr<BatchBufferPool> pool);
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+    protected:
+        friend class BatchBufferPool;
+
+        std::shared_ptr<BatchBufferPool> pool;
+        std::vector<size_t> buffers;
+    };
+
+    BatchBufferPool(bool pinned, size_t maxBuffers);
+    ~BatchBufferPool();
+
+    std::shared_ptr<Lease> CreateLease();
+
+    at::Tensor Acquire(at::IntArrayRef shape, at::ScalarType dtype, Lease& lease);
+
+    bool IsPinned() const;
+    size_t GetAllocationsCount() const;
+
+protected:
+    struct Buffer;
+
+    bool pinned;
+    size_t maxBuffers;
+
+    mutable std::mutex m;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    size_t allocationsCount;
+
+    at::Tensor Allocate(at::IntArrayRef shape, at::ScalarType dtype) const;
+    void Release(const std::vector<size_t>& ids);
+};
+
+#endif
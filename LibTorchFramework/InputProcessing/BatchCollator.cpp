@@ -0,0 +1,144 @@
+#include "./BatchCollator.h"
+
+#include <algorithm>
+
+BatchCollator::BatchCollator(std::shared_ptr<BatchBufferPool> pool) :
+    pool(pool)
+{
+}
+
+std::shared_ptr<BatchBufferPool::Lease> BatchCollator::CreateLease(const torch::Tensor& sample) const
+{
+    if ((this->pool == nullptr) || (sample.device().is_cpu() == false))
+    {
+        return nullptr;
+    }
+    return this->pool->CreateLease();
+}
+
+torch::Tensor BatchCollator::Collate(std::vector<torch::Tensor>& ts, int64_t value, BatchBufferPool::Lease* lease) const
+{
+    if (lease == nullptr)
+    {
+        return PadStack(ts, value);
+    }
+
+    auto batch = this->pool->Acquire(BatchShape(ts), ts[0].scalar_type(), *lease);
+    if (HaveSameShape(ts) == false)
+    {
+        batch.fill_(value);
+    }
+
+    for (size_t i = 0; i < ts.size(); i++)
+    {
+        Slot(batch, i, ts[i]).copy_(ts[i]);
+    }
+
+    return batch;
+}
+
+torch::Tensor BatchCollator::CollateMask(const std::vector<torch::Tensor>& ts, BatchBufferPool::Lease* lease) const
+{
+    if (lease == nullptr)
+    {
+        std::vector<torch::Tensor> masks;
+        masks.reserve(ts.size());
+        for (const auto& t : ts)
+        {
+            masks.push_back(torch::ones_like(t, torch::kBool));
+        }
+        return PadStack(masks, 0);
+    }
+
+    auto batch = this->pool->Acquire(BatchShape(ts), torch::kBool, *lease);
+    batch.fill_(false);
+
+    for (size_t i = 0; i < ts.size(); i++)
+    {
+        Slot(batch, i, ts[i]).fill_(true);
+    }
+
+    return batch;
+}
+
+bool BatchCollator::HaveSameShape(const std::vector<torch::Tensor>& ts)
+{
+    for (size_t i = 1; i < ts.size(); i++)
+    {
+        if (ts[i].sizes() != ts[0].sizes())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<int64_t> BatchCollator::MaxShape(const std::vector<torch::Tensor>& ts)
+{
+    std::vector<int64_t> maxShape = ts[0].sizes().vec();
+    for (const auto& t : ts)
+    {
+        TORCH_CHECK(t.dim() == static_cast<int64_t>(maxShape.size()),
+            "Stack - samples have different number of dimensions");
+        for (size_t j = 0; j < maxShape.size(); j++)
+        {
+            maxShape[j] = std::max(maxShape[j], t.size(j));
+        }
+    }
+    return maxShape;
+}
+
+/// <summary>
+/// (B, max shape of samples)
+/// </summary>
+/// <param name="ts"></param>
+/// <returns></returns>
+std::vector<int64_t> BatchCollator::BatchShape(const std::vector<torch::Tensor>& ts)
+{
+    std::vector<int64_t> shape = MaxShape(ts);
+    shape.insert(shape.begin(), static_cast<int64_t>(ts.size()));
+    return shape;
+}
+
+/// <summary>
+/// Part of batch item i covered by sample (rest is padding)
+/// </summary>
+/// <param name="batch"></param>
+/// <param name="i"></param>
+/// <param name="sample"></param>
+/// <returns></returns>
+torch::Tensor BatchCollator::Slot(const torch::Tensor& batch, size_t i, const torch::Tensor& sample)
+{
+    auto slot = batch.select(0, static_cast<int64_t>(i));
+    for (int64_t j = 0; j < sample.dim(); j++)
+    {
+        if (slot.size(j) != sample.size(j))
+        {
+            slot = slot.narrow(j, 0, sample.size(j));
+        }
+    }
+    return slot;
+}
+
+torch::Tensor BatchCollator::PadStack(std::vector<torch::Tensor>& ts, int64_t value)
+{
+    if (HaveSameShape(ts))
+    {
+        return torch::stack(ts);
+    }
+
+    std::vector<int64_t> maxShape = MaxShape(ts);
+
+    for (auto& t : ts)
+    {
+        //constant_pad_nd pads from the last dimension: [last_begin, last_end, ...]
+        std::vector<int64_t> pad(maxShape.size() * 2, 0);
+        for (size_t j = 0; j < maxShape.size(); j++)
+        {
+            pad[(maxShape.size() - 1 - j) * 2 + 1] = maxShape[j] - t.size(j);
+        }
+        t = torch::constant_pad_nd(t, pad, value);
+    }
+
+    return torch::stack(ts);
+}
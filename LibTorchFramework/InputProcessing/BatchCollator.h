@@ -0,0 +1,44 @@
+#ifndef BATCH_COLLATOR_H
+#define BATCH_COLLATOR_H
+
+#include <memory>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include "./BatchBufferPool.h"
+
+/// <summary>
+/// Collation of sample tensors to batch tensor (B, ...),
+/// shared by Stack transforms of all sample types.
+/// Samples with different shapes are padded to the largest one.
+///
+/// Without pool (or without lease), samples are stacked to new tensor,
+/// otherwise they are copied to slots of pooled buffer
+/// </summary>
+class BatchCollator
+{
+public:
+    BatchCollator() = default;
+    explicit BatchCollator(std::shared_ptr<BatchBufferPool> pool);
+
+    //nullptr if there is no pool or samples are not in host memory
+    std::shared_ptr<BatchBufferPool::Lease> CreateLease(const torch::Tensor& sample) const;
+
+    torch::Tensor Collate(std::vector<torch::Tensor>& ts, int64_t value, BatchBufferPool::Lease* lease) const;
+
+    //true for sample data, false for padding
+    torch::Tensor CollateMask(const std::vector<torch::Tensor>& ts, BatchBufferPool::Lease* lease) const;
+
+    static bool HaveSameShape(const std::vector<torch::Tensor>& ts);
+
+protected:
+    std::shared_ptr<BatchBufferPool> pool = nullptr;
+
+    static std::vector<int64_t> MaxShape(const std::vector<torch::Tensor>& ts);
+    static std::vector<int64_t> BatchShape(const std::vector<torch::Tensor>& ts);
+    static torch::Tensor Slot(const torch::Tensor& batch, size_t i, const torch::Tensor& sample);
+    static torch::Tensor PadStack(std::vector<torch::Tensor>& ts, int64_t value);
+};
+
+#endif
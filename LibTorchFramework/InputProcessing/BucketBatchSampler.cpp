@@ -0,0 +1,196 @@
+#include "./BucketBatchSampler.h"
+
+#include <numeric>
+#include <random>
+#include <algorithm>
+
+#include <Utils/Logger.h>
+
+BucketBatchSampler::BucketBatchSampler(size_t samplesCount) :
+    samplesCount(samplesCount),
+    index(0)
+{
+}
+
+BucketBatchSampler::BucketBatchSampler(const std::vector<std::vector<int64_t>>& shapes,
+    size_t maxBatchElements,
+    size_t maxBatchSize,
+    std::optional<int> seed) :
+    samplesCount(shapes.size()),
+    index(0)
+{
+    auto elementsCount = [](const std::vector<int64_t>& shape) -> uint64_t {
+        uint64_t count = 1;
+        for (auto v : shape)
+        {
+            count *= static_cast<uint64_t>(std::max<int64_t>(v, 0));
+        }
+        return count;
+    };
+
+    std::vector<size_t> order(shapes.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    std::mt19937 rng(seed.has_value() ? seed.value() : 0);
+
+    //random order of samples with the same shape
+    if (seed.has_value())
+    {
+        std::shuffle(order.begin(), order.end(), rng);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return shapes[a] < shapes[b];
+    });
+
+    std::vector<std::vector<size_t>> batches;
+    std::vector<size_t> current;
+    std::vector<int64_t> currentMax;
+
+    auto closeBatch = [&]() {
+        if (current.empty())
+        {
+            return;
+        }
+        this->stats.batchElements += current.size() * elementsCount(currentMax);
+        batches.push_back(std::move(current));
+        current.clear();
+        currentMax.clear();
+    };
+
+    for (size_t i : order)
+    {
+        const auto& shape = shapes[i];
+
+        if ((current.empty() == false) && (shape.size() != currentMax.size()))
+        {
+            closeBatch();
+        }
+
+        std::vector<int64_t> newMax = shape;
+        if (current.empty() == false)
+        {
+            for (size_t d = 0; d < newMax.size(); d++)
+            {
+                newMax[d] = std::max(newMax[d], currentMax[d]);
+            }
+        }
+
+        const uint64_t cost = (current.size() + 1) * elementsCount(newMax);
+        if ((current.empty() == false) && ((cost > maxBatchElements) || (current.size() >= maxBatchSize)))
+        {
+            closeBatch();
+            newMax = shape;
+        }
+
+        current.push_back(i);
+        currentMax = std::move(newMax);
+        this->stats.dataElements += elementsCount(shape);
+    }
+    closeBatch();
+
+    //do not feed batches sorted by length
+    if (seed.has_value())
+    {
+        std::shuffle(batches.begin(), batches.end(), rng);
+    }
+
+    this->indices.reserve(shapes.size());
+    this->batchOffsets.reserve(batches.size() + 1);
+    this->batchOffsets.push_back(0);
+    for (const auto& b : batches)
+    {
+        this->indices.insert(this->indices.end(), b.begin(), b.end());
+        this->batchOffsets.push_back(this->indices.size());
+    }
+}
+
+bool BucketBatchSampler::IsBucketing() const
+{
+    return (this->batchOffsets.empty() == false);
+}
+
+size_t BucketBatchSampler::GetBatchesCount(size_t batchSize) const
+{
+    if (this->IsBucketing())
+    {
+        return this->batchOffsets.size() - 1;
+    }
+
+    batchSize = std::max<size_t>(batchSize, 1);
+    return (this->samplesCount + batchSize - 1) / batchSize;
+}
+
+const BucketBatchSampler::Stats& BucketBatchSampler::GetStats() const
+{
+    return this->stats;
+}
+
+/// <summary>
+/// Called by DataLoader at the start of each epoch
+/// </summary>
+/// <param name="new_size"></param>
+void BucketBatchSampler::reset(torch::optional<size_t> new_size)
+{
+    if ((new_size.has_value()) && (this->IsBucketing() == false))
+    {
+        this->samplesCount = *new_size;
+    }
+    this->index = 0;
+
+    if ((this->IsBucketing()) && (this->stats.batchElements > 0))
+    {
+        const double padding = 100.0 * (this->stats.batchElements - this->stats.dataElements) /
+            static_cast<double>(this->stats.batchElements);
+
+        MY_LOG_INFO("Bucketed batches: %zu, data elements: %llu, padding: %.2f %%",
+            this->batchOffsets.size() - 1,
+            static_cast<unsigned long long>(this->stats.dataElements), padding);
+    }
+}
+
+/// <summary>
+/// In bucketing mode batch_size is ignored, size of batch is given by plan
+/// </summary>
+/// <param name="batch_size"></param>
+/// <returns></returns>
+torch::optional<std::vector<size_t>> BucketBatchSampler::next(size_t batch_size)
+{
+    if (this->IsBucketing())
+    {
+        if (this->index + 1 >= this->batchOffsets.size())
+        {
+            return torch::nullopt;
+        }
+
+        auto begin = this->indices.begin() + this->batchOffsets[this->index];
+        auto end = this->indices.begin() + this->batchOffsets[this->index + 1];
+        this->index++;
+
+        return std::vector<size_t>(begin, end);
+    }
+
+    const size_t remaining = this->samplesCount - this->index;
+    if (remaining == 0)
+    {
+        return torch::nullopt;
+    }
+
+    std::vector<size_t> batch(std::min(batch_size, remaining));
+    std::iota(batch.begin(), batch.end(), this->index);
+    this->index += batch.size();
+
+    return batch;
+}
+
+void BucketBatchSampler::save(torch::serialize::OutputArchive& archive) const
+{
+    archive.write("index", torch::tensor(static_cast<int64_t>(this->index), torch::kInt64), true);
+}
+
+void BucketBatchSampler::load(torch::serialize::InputArchive& archive)
+{
+    auto tensor = torch::empty(1, torch::kInt64);
+    archive.read("index", tensor, true);
+    this->index = static_cast<size_t>(tensor.item<int64_t>());
+}
@@ -0,0 +1,57 @@
+#ifndef BUCKET_BATCH_SAMPLER_H
+#define BUCKET_BATCH_SAMPLER_H
+
+#include <cstdint>
+#include <vector>
+#include <optional>
+
+#include <torch/torch.h>
+
+/// <summary>
+/// Batch sampler used by InputLoader::BuildDataLoader.
+///
+/// Without sample shapes it returns sequential batches of requested size
+/// (same as torch SequentialSampler).
+/// With shapes, samples are sorted by shape (length for text), so similar
+/// samples are next to each other, and batches are cut so that
+/// count * max shape (including padding) fits into maxBatchElements.
+/// Batches are fixed for all epochs (resumed training sees the same batches),
+/// their order is shuffled once if seed is set
+/// </summary>
+class BucketBatchSampler : public torch::data::samplers::Sampler<>
+{
+public:
+    struct Stats
+    {
+        uint64_t dataElements = 0; //elements of samples
+        uint64_t batchElements = 0; //elements of padded batches
+    };
+
+    explicit BucketBatchSampler(size_t samplesCount);
+    BucketBatchSampler(const std::vector<std::vector<int64_t>>& shapes,
+        size_t maxBatchElements,
+        size_t maxBatchSize,
+        std::optional<int> seed = std::nullopt);
+
+    void reset(torch::optional<size_t> new_size = torch::nullopt) override;
+    torch::optional<std::vector<size_t>> next(size_t batch_size) override;
+
+    void save(torch::serialize::OutputArchive& archive) const override;
+    void load(torch::serialize::InputArchive& archive) override;
+
+    bool IsBucketing() const;
+    size_t GetBatchesCount(size_t batchSize) const;
+    const Stats& GetStats() const;
+
+protected:
+    size_t samplesCount;
+    size_t index; //next sample (sequential) or next batch (bucketing)
+
+    //batch i is indices[batchOffsets[i], batchOffsets[i + 1])
+    std::vector<size_t> indices;
+    std::vector<size_t> batchOffsets;
+
+    Stats stats;
+};
+
+#endif
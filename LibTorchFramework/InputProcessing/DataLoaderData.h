@@ -6,6 +6,9 @@
 
 #include <torch/torch.h>
 
+#include "./BatchBufferPool.h"
+#include "./BatchCollator.h"
+
 #include "../Settings.h"
 #include "../PerformanceSettings.h"
 
@@ -13,11 +16,20 @@
 
 struct DataLoaderData
 {    
+    //target value skipped by loss (cross entropy ignore_index), used for padding
+    static constexpr int64_t IGNORE_TARGET = -100;
+
+    //index of sample read from stream (StreamInputLoader), that has no random access
+    static constexpr int64_t STREAM_INDEX = -1;
+
     at::Tensor input;
     at::Tensor target;
 
     std::unordered_map<std::string, at::Tensor> additionalData;
 
+    //pooled buffers of collated batch, returned to pool when batch is destroyed
+    std::shared_ptr<BatchBufferPool::Lease> batchBuffers;
+
     DataLoaderData(int64_t index) :
         index({index})
     {
@@ -84,8 +96,22 @@ namespace torch::data::transforms
     template <>
     struct Stack<DataLoaderData> : public Collation<DataLoaderData>
     {
+        Stack() = default;
+
+        //samples are copied to reusable batch buffers of pool
+        explicit Stack(std::shared_ptr<BatchBufferPool> pool) :
+            collator(pool)
+        {
+        }
+
         DataLoaderData apply_batch(std::vector<DataLoaderData> ds) override
         {
+            if (ds.empty())
+            {
+                //end of stream (StreamingDataset)
+                return DataLoaderData(std::vector<int64_t>{});
+            }
+
             std::vector<int64_t> idx;
             idx.reserve(ds.size());
 
@@ -108,17 +134,32 @@ namespace torch::data::transforms
                 }
             }
 
+            auto lease = this->collator.CreateLease(inputs[0]);
+
+            //samples with different shapes (length bucketing) are padded
+            //to the largest one, "padding_mask" marks real input data
             DataLoaderData d(idx);
-            d.input = torch::stack(inputs);
-            d.target = torch::stack(targets);
+            if (BatchCollator::HaveSameShape(inputs) == false)
+            {
+                d.additionalData.try_emplace("padding_mask", this->collator.CollateMask(inputs, lease.get()));
+            }
+            d.input = this->collator.Collate(inputs, 0, lease.get());
+            d.target = this->collator.Collate(targets,
+                (targets[0].scalar_type() == torch::kLong) ? DataLoaderData::IGNORE_TARGET : 0,
+                lease.get());
             
-            for (const auto& [k, v] : additionals)
+            for (auto& [k, v] : additionals)
             {
-                d.additionalData.try_emplace(k, torch::stack(v));
+                d.additionalData.try_emplace(k, this->collator.Collate(v, 0, lease.get()));
             }
+
+            d.batchBuffers = lease;
                         
             return d;
         }
+
+    protected:
+        BatchCollator collator;
     };
 }
 
@@ -0,0 +1,268 @@
+#ifndef DATA_LOADER_SAMPLE_H
+#define DATA_LOADER_SAMPLE_H
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+#include <torch/torch.h>
+
+#include "./DataLoaderData.h"
+#include "./BatchBufferPool.h"
+#include "./BatchCollator.h"
+
+#include "../Settings.h"
+
+//=================================================================================
+// Named tensor slots of typed samples. Name is used only
+// when batch is converted to DataLoaderData (additionalData key)
+//=================================================================================
+
+namespace SampleSlots
+{
+    struct PositionIds
+    {
+        static constexpr const char* NAME = "position_ids";
+    };
+
+    struct DocumentIds
+    {
+        static constexpr const char* NAME = "document_ids";
+    };
+}
+
+//=================================================================================
+
+/// <summary>
+/// Sample with additional tensors declared at compile time
+/// (typed alternative of DataLoaderData::additionalData).
+/// Slot is found by type, no strings are hashed or allocated
+/// per sample, Stack collates fixed array of slots.
+///
+/// Models work with DataLoaderData, batch is converted once
+/// by ToDataLoaderData (slots are moved to additionalData).
+///
+/// Used with SampleInputLoader and SampleDataset
+/// </summary>
+template <typename... Slots>
+struct DataLoaderSample
+{
+    static constexpr size_t SLOTS_COUNT = sizeof...(Slots);
+
+    at::Tensor input;
+    at::Tensor target;
+
+    //set by Stack if samples were padded (true for data)
+    at::Tensor paddingMask;
+
+    //undefined slot is not used by sample
+    std::array<at::Tensor, SLOTS_COUNT> slots;
+
+    //pooled buffers of collated batch, returned to pool when batch is destroyed
+    std::shared_ptr<BatchBufferPool::Lease> batchBuffers;
+
+    DataLoaderSample(int64_t index) :
+        index({ index })
+    {
+    }
+
+    DataLoaderSample(std::vector<int64_t> index) :
+        index(std::move(index))
+    {
+    }
+
+    template <typename Slot>
+    static constexpr size_t SlotIndex()
+    {
+        static_assert((std::is_same_v<Slot, Slots> || ...), "Slot is not part of sample");
+
+        size_t i = 0;
+        (void)((std::is_same_v<Slot, Slots> ? false : (++i, true)) && ...);
+        return i;
+    }
+
+    template <typename Slot>
+    at::Tensor& Get()
+    {
+        return slots[SlotIndex<Slot>()];
+    }
+
+    template <typename Slot>
+    const at::Tensor& Get() const
+    {
+        return slots[SlotIndex<Slot>()];
+    }
+
+    void setupDevice(const Settings& sets)
+    {
+        input = input.to(sets.device, input.dtype(), sets.perf.useNonBlockingTransfers);
+        target = target.to(sets.device, target.dtype(), sets.perf.useNonBlockingTransfers);
+
+        if (paddingMask.defined())
+        {
+            paddingMask = paddingMask.to(sets.device, paddingMask.dtype(), sets.perf.useNonBlockingTransfers);
+        }
+
+        for (auto& v : slots)
+        {
+            if (v.defined())
+            {
+                v = v.to(sets.device, v.dtype(), sets.perf.useNonBlockingTransfers);
+            }
+        }
+    }
+
+    int64_t GetDataIndex(size_t batchIndex = 0) const
+    {
+        return index[batchIndex];
+    }
+
+    const std::vector<int64_t>& GetDataIndices() const
+    {
+        return index;
+    }
+
+    size_t GetBatchSize() const
+    {
+        return index.size();
+    }
+
+    /// <summary>
+    /// Move content to DataLoaderData, defined slots
+    /// are stored in additionalData under slot names
+    /// </summary>
+    /// <returns></returns>
+    DataLoaderData ToDataLoaderData() &&
+    {
+        static constexpr std::array<const char*, SLOTS_COUNT> NAMES = { Slots::NAME... };
+
+        DataLoaderData d(std::move(index));
+        d.input = std::move(input);
+        d.target = std::move(target);
+
+        if (paddingMask.defined())
+        {
+            d.additionalData.try_emplace("padding_mask", std::move(paddingMask));
+        }
+
+        for (size_t i = 0; i < SLOTS_COUNT; i++)
+        {
+            if (slots[i].defined())
+            {
+                d.additionalData.try_emplace(NAMES[i], std::move(slots[i]));
+            }
+        }
+
+        d.batchBuffers = std::move(batchBuffers);
+
+        return d;
+    }
+
+    friend struct torch::data::transforms::Stack<DataLoaderSample<Slots...>>;
+
+protected:
+    std::vector<int64_t> index;
+};
+
+//=================================================================================
+// Batch of any sample type as DataLoaderData (batch is moved from)
+//=================================================================================
+
+inline DataLoaderData ToDataLoaderData(DataLoaderData&& d)
+{
+    return std::move(d);
+}
+
+template <typename... Slots>
+DataLoaderData ToDataLoaderData(DataLoaderSample<Slots...>&& d)
+{
+    return std::move(d).ToDataLoaderData();
+}
+
+//=================================================================================
+
+namespace torch::data::transforms
+{
+    template <typename... Slots>
+    struct Stack<DataLoaderSample<Slots...>> : public Collation<DataLoaderSample<Slots...>>
+    {
+        using SampleType = DataLoaderSample<Slots...>;
+
+        Stack() = default;
+
+        //samples are copied to reusable batch buffers of pool
+        explicit Stack(std::shared_ptr<BatchBufferPool> pool) :
+            collator(pool)
+        {
+        }
+
+        SampleType apply_batch(std::vector<SampleType> ds) override
+        {
+            if (ds.empty())
+            {
+                return SampleType(std::vector<int64_t>{});
+            }
+
+            std::vector<int64_t> idx;
+            idx.reserve(ds.size());
+
+            std::vector<torch::Tensor> inputs, targets;
+            inputs.reserve(ds.size());
+            targets.reserve(ds.size());
+
+            std::array<std::vector<torch::Tensor>, SampleType::SLOTS_COUNT> slots;
+            for (auto& s : slots)
+            {
+                s.reserve(ds.size());
+            }
+
+            for (auto& d : ds)
+            {
+                inputs.push_back(std::move(d.input));
+                targets.push_back(std::move(d.target));
+                idx.push_back(d.index[0]);
+
+                for (size_t i = 0; i < SampleType::SLOTS_COUNT; i++)
+                {
+                    if (d.slots[i].defined())
+                    {
+                        slots[i].push_back(std::move(d.slots[i]));
+                    }
+                }
+            }
+
+            auto lease = this->collator.CreateLease(inputs[0]);
+
+            SampleType b(std::move(idx));
+            if (BatchCollator::HaveSameShape(inputs) == false)
+            {
+                b.paddingMask = this->collator.CollateMask(inputs, lease.get());
+            }
+            b.input = this->collator.Collate(inputs, 0, lease.get());
+            b.target = this->collator.Collate(targets,
+                (targets[0].scalar_type() == torch::kLong) ? DataLoaderData::IGNORE_TARGET : 0,
+                lease.get());
+
+            for (size_t i = 0; i < SampleType::SLOTS_COUNT; i++)
+            {
+                if (slots[i].empty())
+                {
+                    continue;
+                }
+
+                TORCH_CHECK(slots[i].size() == ds.size(), "Stack - slot is not set in all samples");
+                b.slots[i] = this->collator.Collate(slots[i], 0, lease.get());
+            }
+
+            b.batchBuffers = lease;
+
+            return b;
+        }
+
+    protected:
+        BatchCollator collator;
+    };
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "./InputLoader.h"
 
+//max pooled buffers per batch (input, target, padding mask and additional data)
+static constexpr size_t BUFFERS_PER_BATCH = 8;
 
 
 InputLoader::InputLoader(RunMode type, std::weak_ptr<InputLoadersWrapper> parent) :
@@ -13,6 +15,133 @@ void InputLoader::SetLoaderSettings(const InputLoaderSettings& loaderSets)
     this->loaderSets = loaderSets;
 }
 
+/// <summary>
+/// Range [offset, offset + count) of (optionally shuffled) items
+/// that belong to this loader's RunMode, based on parent split ratios
+/// and subset size
+/// </summary>
+/// <param name="totalCount"></param>
+/// <param name="offset"></param>
+/// <param name="count"></param>
+void InputLoader::GetSplitRange(size_t totalCount, size_t& offset, size_t& count) const
+{
+    auto parentPtr = this->parent.lock();
+
+    offset = 0;
+    count = 0;
+
+    if (this->type == RunMode::TRAIN)
+    {
+        count = static_cast<size_t>(parentPtr->GetTrainRatio() * totalCount);
+    }
+    else if (this->type == RunMode::VALID)
+    {
+        count = static_cast<size_t>(parentPtr->GetValRatio() * totalCount);
+        offset = static_cast<size_t>(parentPtr->GetTrainRatio() * totalCount);
+    }
+    else
+    {
+        if (parentPtr->GetTestRatio().has_value() == false)
+        {
+            count = totalCount - static_cast<size_t>((parentPtr->GetTrainRatio() + parentPtr->GetValRatio()) * totalCount);
+        }
+        else
+        {
+            count = static_cast<size_t>(parentPtr->GetTestRatio().value() * totalCount);
+        }
+    }
+
+    if ((loaderSets.subsetSize.has_value()) && (count > loaderSets.subsetSize.value()))
+    {
+        count = loaderSets.subsetSize.value();
+    }
+
+    if ((this->type != RunMode::TRAIN) && (this->type != RunMode::VALID))
+    {
+        //test items are taken from the end
+        offset = totalCount - count;
+    }
+}
+
+/// <summary>
+/// Default - shape unknown, length bucketing is not possible
+/// </summary>
+/// <param name="index"></param>
+/// <returns></returns>
+std::vector<int64_t> InputLoader::GetSampleShape(size_t index) const
+{
+    return {};
+}
+
+/// <summary>
+/// Sequential batches of sets.batchSize, or length-bucketed batches
+/// if sets.maxBatchTokens is set and loader knows shapes of all samples
+/// </summary>
+/// <param name="sets"></param>
+/// <param name="datasetSize"></param>
+/// <returns></returns>
+BucketBatchSampler InputLoader::CreateBatchSampler(const Settings& sets, size_t datasetSize) const
+{
+    if (sets.maxBatchTokens.has_value() == false)
+    {
+        return BucketBatchSampler(datasetSize);
+    }
+
+    std::vector<std::vector<int64_t>> shapes;
+    shapes.reserve(datasetSize);
+
+    for (size_t i = 0; i < datasetSize; i++)
+    {
+        shapes.push_back(this->GetSampleShape(i));
+        if (shapes.back().empty())
+        {
+            MY_LOG_WARNING("Sample shape is unknown, length bucketing disabled");
+            return BucketBatchSampler(datasetSize);
+        }
+    }
+
+    auto parentPtr = this->parent.lock();
+
+    return BucketBatchSampler(shapes,
+        sets.maxBatchTokens.value(),
+        std::max<size_t>(sets.batchSize, 1),
+        parentPtr->GetShuffleSeed());
+}
+
+ParallelDataLoaderOptions InputLoader::CreateLoaderOptions(const Settings& sets) const
+{
+    ParallelDataLoaderOptions opts;
+    opts.batchSize = std::max<size_t>(sets.batchSize, 1);
+    opts.workers = sets.numWorkers;
+    opts.prefetchDepth = sets.perf.loaderPrefetchDepth;
+    opts.enforceOrdering = sets.perf.loaderEnforceOrdering;
+
+    return opts;
+}
+
+/// <summary>
+/// Pool of collated batch buffers, sized for all batches that can
+/// exist at once (in loader, in prefetcher and processed one).
+/// Buffers are pinned if batches are copied to CUDA device
+/// </summary>
+/// <param name="sets"></param>
+/// <returns></returns>
+std::shared_ptr<BatchBufferPool> InputLoader::CreateBufferPool(const Settings& sets) const
+{
+    if (sets.perf.useBatchBufferPool == false)
+    {
+        return nullptr;
+    }
+
+    const size_t batchesInFlight = std::max<size_t>(sets.numWorkers, 1) * std::max<size_t>(sets.perf.loaderPrefetchDepth, 1) +
+        sets.perf.batchPrefetchDepth + 2;
+
+    const bool pinned = (sets.perf.usePinMemory) &&
+        (sets.device == torch::kCUDA) && (torch::cuda::is_available());
+
+    return std::make_shared<BatchBufferPool>(pinned, batchesInFlight * BUFFERS_PER_BATCH);
+}
+
 void InputLoader::ApplyTransform()
 {
     
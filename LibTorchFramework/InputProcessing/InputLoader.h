@@ -8,10 +8,15 @@ struct DataLoaderData;
 #include <vector>
 #include <random>
 #include <optional>
+#include <type_traits>
 
 #include <torch/torch.h>
 
 #include "./DataLoaderData.h"
+#include "./BatchBufferPool.h"
+#include "./BucketBatchSampler.h"
+#include "./StreamBatchSampler.h"
+#include "./ParallelDataLoader.h"
 #include "./InputLoadersWrapper.h"
 #include "./InputLoaderSettings.h"
 
@@ -31,18 +36,19 @@ public:
     ));
 
     template <typename Dataset>
-    using StackedDataLoaderType = decltype(
-        torch::data::make_data_loader<
-        torch::data::samplers::SequentialSampler>(
-            std::declval<
-            decltype(
-                std::declval<Dataset>().map(
-                    torch::data::transforms::Stack<typename Dataset::ExampleType>()
-                )
-                )>(),
-            size_t{}
-        )
-    );
+    static constexpr bool IsStreamDataset = std::is_same_v<typename Dataset::BatchRequestType, StreamBatchRequest>;
+
+    template <typename Dataset>
+    using BatchSamplerType = std::conditional_t<IsStreamDataset<Dataset>, StreamBatchSampler, BucketBatchSampler>;
+
+    template <typename Dataset>
+    using StackedDatasetType = torch::data::datasets::MapDataset<Dataset, torch::data::transforms::Stack<typename Dataset::ExampleType>>;
+
+    template <typename Dataset>
+    using DataLoaderType = ParallelDataLoader<StackedDatasetType<Dataset>, BatchSamplerType<Dataset>>;
+
+    template <typename Dataset>
+    using StackedDataLoaderType = std::unique_ptr<DataLoaderType<Dataset>>;
 
     //========================================================================
     
@@ -60,6 +66,14 @@ public:
     virtual void Load() = 0;
     virtual void FillData(size_t index, DataLoaderData& ld) = 0;
 
+    //==============
+    // optional - shape of sample input used for
+    // length-bucketed batching (Settings::maxBatchTokens)
+    // empty = unknown
+    //==============
+
+    virtual std::vector<int64_t> GetSampleShape(size_t index) const;
+
     //==============
 
     DataLoaderData GetData(size_t index);
@@ -79,7 +93,16 @@ protected:
     template <typename T>
     std::vector<T> BuildSplits(const std::vector<T>& input);
 
+    void GetSplitRange(size_t totalCount, size_t& offset, size_t& count) const;
+
+    template <typename DatasetType>
+    auto BuildIndexedDataLoader(const Settings& sets, int& bacthesCount);
+
     void ApplyTransform();
+
+    BucketBatchSampler CreateBatchSampler(const Settings& sets, size_t datasetSize) const;
+    ParallelDataLoaderOptions CreateLoaderOptions(const Settings& sets) const;
+    std::shared_ptr<BatchBufferPool> CreateBufferPool(const Settings& sets) const;
 };
 
 //======================================================================
@@ -92,40 +115,13 @@ std::vector<T> InputLoader::BuildSplits(const std::vector<T>& input)
     size_t totalFilesCount = input.size();
     size_t offsetIndex = 0;
     size_t filesCount = 0;
-
-    if (this->type == RunMode::TRAIN)
-    {
-        filesCount = static_cast<size_t>(parentPtr->GetTrainRatio() * totalFilesCount);
-    }
-    else if (this->type == RunMode::VALID)
-    {
-        filesCount = static_cast<size_t>(parentPtr->GetValRatio() * totalFilesCount);
-        offsetIndex = static_cast<size_t>(parentPtr->GetTrainRatio() * totalFilesCount);
-    }
-    else
-    {
-        if (parentPtr->GetTestRatio().has_value() == false)
-        {
-            filesCount = totalFilesCount - static_cast<size_t>((parentPtr->GetTrainRatio() + parentPtr->GetValRatio()) * totalFilesCount);
-            offsetIndex = totalFilesCount - filesCount;
-        }
-        else
-        {
-            filesCount = static_cast<size_t>(parentPtr->GetTestRatio().value() * totalFilesCount);
-            offsetIndex = static_cast<size_t>(parentPtr->GetTestRatio().value() * totalFilesCount);
-        }
-    }
+    this->GetSplitRange(totalFilesCount, offsetIndex, filesCount);
 
     if (filesCount == 0)
     {
         return {};
     }
 
-    if ((loaderSets.subsetSize.has_value()) && (filesCount > loaderSets.subsetSize.value()))
-    {
-        filesCount = loaderSets.subsetSize.value();
-    }
-
     // prepare indices
     std::vector<size_t> indices(totalFilesCount);
     std::iota(indices.begin(), indices.end(), 0);
@@ -139,26 +135,9 @@ std::vector<T> InputLoader::BuildSplits(const std::vector<T>& input)
     std::vector<T> output;
     output.reserve(filesCount);
 
-    if (this->type == RunMode::TRAIN)
-    {
-        for (size_t j = 0; j < filesCount; ++j)
-        {
-            output.push_back(input[indices[j]]);
-        }
-    }
-    else if (this->type == RunMode::VALID)
-    {
-        for (size_t j = offsetIndex; j < offsetIndex + filesCount; ++j)
-        {
-            output.push_back(input[indices[j]]);
-        }
-    }
-    else
+    for (size_t j = offsetIndex; j < offsetIndex + filesCount; ++j)
     {
-        for (size_t j = totalFilesCount - filesCount; j < totalFilesCount; ++j)
-        {
-            output.push_back(input[indices[j]]);
-        }
+        output.push_back(input[indices[j]]);
     }
 
     return output;
@@ -173,22 +152,45 @@ auto InputLoader::BuildDataLoader(const Settings& sets)
 
 template <typename DatasetType>
 auto InputLoader::BuildDataLoader(const Settings& sets, int& bacthesCount)
+{        
+    if constexpr (IsStreamDataset<DatasetType>)
+    {
+        //size is not known, no indexing pass
+        //bacthesCount is 0 if epoch is not limited by steps
+        auto ds = DatasetType(shared_from_this(), sets.epochSteps.has_value());
+        auto dsMapped = ds.map(torch::data::transforms::Stack<DataLoaderData>(this->CreateBufferPool(sets)));
+
+        auto sampler = StreamBatchSampler(sets.epochSteps);
+        bacthesCount = static_cast<int>(sampler.GetBatchesCount(sets.batchSize));
+
+        return std::make_unique<DataLoaderType<DatasetType>>(
+            std::move(dsMapped),
+            std::move(sampler),
+            this->CreateLoaderOptions(sets)
+        );
+    }
+    else
+    {
+        return this->BuildIndexedDataLoader<DatasetType>(sets, bacthesCount);
+    }
+}
+
+template <typename DatasetType>
+auto InputLoader::BuildIndexedDataLoader(const Settings& sets, int& bacthesCount)
 {        
     auto ds = DatasetType(shared_from_this());
-    auto dsMapped = ds.map(torch::data::transforms::Stack<typename DatasetType::ExampleType>());
+    auto dsMapped = ds.map(torch::data::transforms::Stack<typename DatasetType::ExampleType>(this->CreateBufferPool(sets)));
     
     auto datasetSize = dsMapped.size().value();
-    bacthesCount = (datasetSize + sets.batchSize - 1) / sets.batchSize;
 
-    auto loader = torch::data::make_data_loader<torch::data::samplers::SequentialSampler>(
-        std::move(dsMapped),        
-        torch::data::DataLoaderOptions()
-            .batch_size(sets.batchSize)            
-            .workers(sets.numWorkers)
-            .enforce_ordering(false)            
-    );    
+    auto sampler = this->CreateBatchSampler(sets, datasetSize);
+    bacthesCount = static_cast<int>(sampler.GetBatchesCount(sets.batchSize));
 
-    return loader;
+    return std::make_unique<DataLoaderType<DatasetType>>(
+        std::move(dsMapped),
+        std::move(sampler),
+        this->CreateLoaderOptions(sets)
+    );
 }
 
 #endif
\ No newline at end of file
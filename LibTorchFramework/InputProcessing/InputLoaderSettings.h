@@ -7,6 +7,9 @@
 struct InputLoaderSettings
 {
     std::optional<size_t> subsetSize = std::nullopt;
+
+    //streaming loaders - samples kept in shuffle buffer of each reader (0 = no shuffling)
+    size_t shuffleBufferSize = 0;
 };
 
 #endif
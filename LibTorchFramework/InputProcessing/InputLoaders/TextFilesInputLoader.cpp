@@ -1,70 +1,256 @@
 #include "./TextFilesInputLoader.h"
 
 #include <filesystem>
+#include <numeric>
+#include <random>
 
 #include <Utils/Logger.h>
 
 
 #include "../InputLoadersWrapper.h"
+#include "../TokenShardDataset.h"
 
 #include "../../Utils/TorchUtils.h"
-#include "../../Utils/TorchImageUtils.h"
-
 
+//============================================
+// Dataset path is directory created by TokenizeCorpus tool
+// (manifest.json + shard_XXXXX.bin) or single shard file.
+// Shards are memory-mapped, samples are read directly
+// from the mapping, no tokenization during training
+//============================================
 
 TextFilesInputLoader::TextFilesInputLoader(
 	RunMode type,
 	std::weak_ptr<InputLoadersWrapper> parent,
 	std::shared_ptr<Tokenizer> tokenizer,
 	int32_t seqLen,
-	const std::string& datasetPath) :
-	InputLoader(type, parent),
+	const std::string& datasetPath,
+	SampleMode mode) :
+	SampleInputLoader<TextSample>(type, parent),
 	tokenizer(tokenizer),
-	seqLen(seqLen)
+	seqLen(seqLen),
+	datasetPath(datasetPath),
+	mode(mode),
+	dataset(nullptr),
+	itemsTotal(0),
+	itemsOffset(0),
+	itemsCount(0),
+	permA(1),
+	permB(0)
 {
-	auto ptr = parent.lock();
-
-
+	if (std::filesystem::exists(this->datasetPath) == false)
+	{
+		MY_LOG_WARNING("Dataset path %s does not exist", datasetPath.c_str());
+	}
 }
 
 size_t TextFilesInputLoader::GetSize() const
 {
-	return 10;
+	return static_cast<size_t>(this->itemsCount);
 }
 
 void TextFilesInputLoader::Load()
 {
+	if (this->dataset != nullptr)
+	{
+		//already loaded
+		return;
+	}
+
+	if (std::filesystem::exists(this->datasetPath) == false)
+	{
+		return;
+	}
+
+	this->dataset = std::make_shared<TokenShardDataset>(this->datasetPath);
+
+	if (this->mode == SampleMode::DOCUMENTS)
+	{
+		this->itemsTotal = this->dataset->GetDocumentsCount();
+	}
+	else
+	{
+		//each window needs seqLen + 1 tokens, windows overlap by one token
+		const uint64_t tokensCount = this->dataset->GetTokensCount();
+		this->itemsTotal = (tokensCount > 0) ? (tokensCount - 1) / this->seqLen : 0;
+	}
+
+	size_t offset = 0;
+	size_t count = 0;
+	this->GetSplitRange(static_cast<size_t>(this->itemsTotal), offset, count);
+
+	this->itemsOffset = offset;
+	this->itemsCount = count;
+
+	//shuffle items with affine permutation (same splits as BuildSplits,
+	//but without index array - there may be billions of windows)
+	auto parentPtr = this->parent.lock();
+	if ((parentPtr->GetShuffleSeed().has_value()) && (this->itemsTotal > 1))
+	{
+		std::mt19937_64 rng(parentPtr->GetShuffleSeed().value());
+		std::uniform_int_distribution<uint64_t> dist(1, this->itemsTotal - 1);
+
+		do
+		{
+			this->permA = dist(rng);
+		} while (std::gcd(this->permA, this->itemsTotal) != 1);
+
+		this->permB = dist(rng);
+	}
+
+	MY_LOG_INFO("Text %s: %llu of %llu (seq len %d)",
+		(this->mode == SampleMode::DOCUMENTS) ? "documents" : "windows",
+		static_cast<unsigned long long>(this->itemsCount),
+		static_cast<unsigned long long>(this->itemsTotal), this->seqLen);
+}
+
+uint64_t TextFilesInputLoader::GetItemIndex(size_t index) const
+{
+	const uint64_t i = this->itemsOffset + index;
+	const uint64_t n = this->itemsTotal;
+
+	//(permA * i + permB) % n without 128-bit overflow
+	uint64_t res = 0;
+	uint64_t a = this->permA % n;
+	uint64_t b = i % n;
+	while (b > 0)
+	{
+		if (b & 1)
+		{
+			res = (res >= n - a) ? (res - (n - a)) : (res + a);
+		}
+		a = (a >= n - a) ? (a - (n - a)) : (a + a);
+		b >>= 1;
+	}
+
+	res = (res >= n - this->permB) ? (res - (n - this->permB)) : (res + this->permB);
+	return res;
+}
+
+/// <summary>
+/// Input length of sample, used for length bucketing
+/// </summary>
+/// <param name="index"></param>
+/// <returns></returns>
+std::vector<int64_t> TextFilesInputLoader::GetSampleShape(size_t index) const
+{
+	if (this->mode != SampleMode::DOCUMENTS)
+	{
+		return { this->seqLen };
+	}
+
+	uint64_t start = 0;
+	uint64_t length = 0;
+	this->dataset->GetDocument(this->GetItemIndex(index), start, length);
 
+	length = std::min<uint64_t>(length, static_cast<uint64_t>(this->seqLen) + 1);
+	return { std::max<int64_t>(static_cast<int64_t>(length) - 1, 1) };
 }
 
-void TextFilesInputLoader::FillData(size_t index, DataLoaderData& ld)
+void TextFilesInputLoader::FillSample(size_t index, TextSample& s)
 {
-	std::vector<TokenId> ids;
+	if (this->mode == SampleMode::DOCUMENTS)
+	{
+		this->FillDocument(this->GetItemIndex(index), s);
+		return;
+	}
+
+	const uint64_t window = this->GetItemIndex(index);
+
+	//read seqLen + 1 tokens directly from mapped shards,
+	//input and target are views of the same buffer
+	torch::Tensor buf = torch::empty({ this->seqLen + 1 }, torch::dtype(torch::kLong));
+	this->dataset->CopyTokens(window * this->seqLen, static_cast<size_t>(this->seqLen) + 1, buf.data_ptr<int64_t>());
+
+	s.input = buf.slice(0, 0, this->seqLen);
+	s.target = buf.slice(0, 1, this->seqLen + 1);
 
-	while (ids.size() <= static_cast<size_t>(seqLen + 1))
+	if (this->mode == SampleMode::PACKED_WINDOWS)
 	{
-		//load next line, strip it
-		StringUtf8 prompt = (u8"Hello! Briefly explain what weather warnings are.");
+		//target is modified, do not share storage with input
+		s.target = s.target.clone();
+		this->FillDocumentIds(window * this->seqLen, s);
+	}
+}
+
+/// <summary>
+/// Document truncated to seqLen + 1 tokens.
+/// Document with single token (or empty) has one input token
+/// and ignored target
+/// </summary>
+/// <param name="document"></param>
+/// <param name="s"></param>
+void TextFilesInputLoader::FillDocument(uint64_t document, TextSample& s) const
+{
+	uint64_t start = 0;
+	uint64_t length = 0;
+	this->dataset->GetDocument(document, start, length);
 
-		auto tmp = tokenizer->Encode(prompt);
+	const int64_t count = static_cast<int64_t>(std::min<uint64_t>(length, static_cast<uint64_t>(this->seqLen) + 1));
 
-		ids.insert(ids.end(), tmp.begin(), tmp.end());
+	if (count < 2)
+	{
+		s.input = torch::zeros({ 1 }, torch::dtype(torch::kLong));
+		if (count == 1)
+		{
+			this->dataset->CopyTokens(start, 1, s.input.data_ptr<int64_t>());
+		}
+		s.target = torch::full({ 1 }, IGNORE_TARGET, torch::dtype(torch::kLong));
+		return;
 	}
 
-	//pad to seq_len if ids is shorter
-	//if len(buf) < self.seq_len + 1:
-	//	buf = buf + [pad] * ((self.seq_len + 1) - len(buf))
+	torch::Tensor buf = torch::empty({ count }, torch::dtype(torch::kLong));
+	this->dataset->CopyTokens(start, static_cast<size_t>(count), buf.data_ptr<int64_t>());
+
+	s.input = buf.slice(0, 0, count - 1);
+	s.target = buf.slice(0, 1, count);
+}
+
+/// <summary>
+/// Documents are packed one after another in token stream, so window
+/// contains end of one document, several whole documents and start of another.
+/// Document continuing from previous window starts again at position 0.
+/// Input token predicting first token of the next document has target ignored
+/// </summary>
+/// <param name="windowStart"></param>
+/// <param name="s"></param>
+void TextFilesInputLoader::FillDocumentIds(uint64_t windowStart, TextSample& s) const
+{
+	//document starts at window tokens [1, seqLen] - they split input tokens
+	//and also mark targets, that belong to the next document
+	std::vector<uint64_t> starts;
+	this->dataset->GetDocumentStarts(windowStart + 1, static_cast<size_t>(this->seqLen), starts);
+
+	torch::Tensor positions = torch::empty({ this->seqLen }, torch::dtype(torch::kLong));
+	torch::Tensor documents = torch::empty({ this->seqLen }, torch::dtype(torch::kLong));
 
-	std::vector<int64_t> chunk(ids.begin(), ids.begin() + (seqLen + 1));
-	ids.erase(ids.begin(), ids.begin() + (seqLen + 1));
+	int64_t* pos = positions.data_ptr<int64_t>();
+	int64_t* doc = documents.data_ptr<int64_t>();
+	int64_t* tgt = s.target.data_ptr<int64_t>();
 
-	std::vector<int64_t> x_vec(chunk.begin(), chunk.end() - 1);
+	size_t next = 0;
+	int64_t docIndex = 0;
+	int64_t docStart = 0;
 
-	std::vector<int64_t> y_vec(chunk.begin() + 1, chunk.end());
+	for (int64_t i = 0; i < this->seqLen; i++)
+	{
+		if ((next < starts.size()) && (starts[next] == windowStart + i))
+		{
+			docIndex++;
+			docStart = i;
+			next++;
+		}
 
-	torch::Tensor x = torch::tensor(x_vec, torch::dtype(torch::kLong));
-	torch::Tensor y = torch::tensor(y_vec, torch::dtype(torch::kLong));
+		pos[i] = i - docStart;
+		doc[i] = docIndex;
 
-	ld.input = x;
-	ld.target = y;
-}
\ No newline at end of file
+		//target i is window token i + 1
+		if ((next < starts.size()) && (starts[next] == windowStart + i + 1))
+		{
+			tgt[i] = IGNORE_TARGET;
+		}
+	}
+
+	s.Get<SampleSlots::PositionIds>() = positions;
+	s.Get<SampleSlots::DocumentIds>() = documents;
+}
@@ -1,36 +1,84 @@
 #ifndef TEXT_FILES_INPUT_LOADER_H
 #define TEXT_FILES_INPUT_LOADER_H
 
+class TokenShardDataset;
 
 #include <vector>
 #include <string>
 #include <memory>
 
-#include "../InputLoader.h"
+#include "../SampleInputLoader.h"
 
 #include "../../core/Structures.h"
 #include "../../core/Tokenizers/Tokenizers.h"
 
-class TextFilesInputLoader : public InputLoader
+/// <summary>
+/// Language model samples from pre-tokenized shards
+/// (see TokenizeCorpus tool). Token stream is cut into
+/// windows of seqLen + 1 tokens with stride seqLen,
+/// input is window[0, seqLen), target is window[1, seqLen + 1)
+///
+/// With PACKED_WINDOWS, every window is treated as pack of documents:
+/// sample has "position_ids" (reset at each document start)
+/// and "document_ids" (index of document within row) for block-diagonal
+/// attention, targets that cross document boundary are IGNORE_TARGET
+///
+/// With DOCUMENTS, every sample is one document truncated to seqLen + 1
+/// tokens. Samples have different lengths, use with Settings::maxBatchTokens
+/// (length bucketing), shorter samples are padded in batch
+///
+/// Samples are typed (TextSample), use SampleDataset<TextSample>
+/// to keep them typed until batch is collated
+/// </summary>
+using TextSample = DataLoaderSample<SampleSlots::PositionIds, SampleSlots::DocumentIds>;
+
+class TextFilesInputLoader : public SampleInputLoader<TextSample>
 {
 public:
+    static constexpr int64_t IGNORE_TARGET = DataLoaderData::IGNORE_TARGET;
+
+    enum class SampleMode
+    {
+        WINDOWS,
+        PACKED_WINDOWS,
+        DOCUMENTS
+    };
+
     TextFilesInputLoader(RunMode type,
         std::weak_ptr<InputLoadersWrapper> parent,
         std::shared_ptr<Tokenizer> tokenizer,
         int32_t seqLen,
-        const std::string& datasetPath);
+        const std::string& datasetPath,
+        SampleMode mode = SampleMode::WINDOWS);
     virtual ~TextFilesInputLoader() = default;
 
 
     size_t GetSize() const override;
     void Load()  override;
-    void FillData(size_t index, DataLoaderData& ld)  override;
+    void FillSample(size_t index, TextSample& s)  override;
+
+    std::vector<int64_t> GetSampleShape(size_t index) const override;
 
 
 protected:
     std::shared_ptr<Tokenizer> tokenizer;
     int32_t seqLen;
-    
+    std::string datasetPath;
+    SampleMode mode;
+
+    std::shared_ptr<TokenShardDataset> dataset;
+
+    //items (windows or documents) of this split are [itemsOffset, itemsOffset + itemsCount)
+    //of all items permuted by (permA * i + permB) % itemsTotal
+    uint64_t itemsTotal;
+    uint64_t itemsOffset;
+    uint64_t itemsCount;
+    uint64_t permA;
+    uint64_t permB;
+
+    uint64_t GetItemIndex(size_t index) const;
+    void FillDocument(uint64_t document, TextSample& s) const;
+    void FillDocumentIds(uint64_t windowStart, TextSample& s) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,91 @@
+#include "./TokenStreamInputLoader.h"
+
+#include <filesystem>
+
+#include <Utils/Logger.h>
+
+#include "../DataLoaderData.h"
+#include "../TokenShardDataset.h"
+
+#include "../../core/Tokenizers/TokenShardFile.h"
+
+//============================================
+
+class TokenStreamInputLoader::WindowsReader : public StreamInputLoader::ShardReader
+{
+public:
+	WindowsReader(const std::string& path, int32_t seqLen) :
+		shard(path),
+		seqLen(seqLen),
+		window(0)
+	{
+		const uint64_t tokensCount = shard.GetTokensCount();
+		this->windowsCount = (tokensCount > 0) ? (tokensCount - 1) / seqLen : 0;
+	}
+
+	bool Next(DataLoaderData& ld) override
+	{
+		if (this->window >= this->windowsCount)
+		{
+			return false;
+		}
+
+		torch::Tensor buf = torch::empty({ this->seqLen + 1 }, torch::dtype(torch::kLong));
+		this->shard.CopyTokens(this->window * this->seqLen, static_cast<size_t>(this->seqLen) + 1, buf.data_ptr<int64_t>());
+		this->window++;
+
+		ld.input = buf.slice(0, 0, this->seqLen);
+		ld.target = buf.slice(0, 1, this->seqLen + 1);
+
+		return true;
+	}
+
+protected:
+	TokenShardFile shard;
+	int32_t seqLen;
+	uint64_t window;
+	uint64_t windowsCount;
+};
+
+//============================================
+
+TokenStreamInputLoader::TokenStreamInputLoader(
+	RunMode type,
+	std::weak_ptr<InputLoadersWrapper> parent,
+	int32_t seqLen,
+	const std::string& datasetPath) :
+	StreamInputLoader(type, parent),
+	seqLen(seqLen),
+	datasetPath(datasetPath)
+{
+	if (std::filesystem::exists(this->datasetPath) == false)
+	{
+		MY_LOG_WARNING("Dataset path %s does not exist", datasetPath.c_str());
+	}
+}
+
+void TokenStreamInputLoader::Load()
+{
+	if (this->files.empty() == false)
+	{
+		//already loaded
+		return;
+	}
+
+	if (std::filesystem::exists(this->datasetPath) == false)
+	{
+		return;
+	}
+
+	this->files = TokenShardDataset::ListShardFiles(this->datasetPath);
+}
+
+size_t TokenStreamInputLoader::GetShardsCount() const
+{
+	return this->files.size();
+}
+
+std::unique_ptr<StreamInputLoader::ShardReader> TokenStreamInputLoader::OpenShard(size_t shard) const
+{
+	return std::make_unique<WindowsReader>(this->files[shard], this->seqLen);
+}
@@ -0,0 +1,42 @@
+#ifndef TOKEN_STREAM_INPUT_LOADER_H
+#define TOKEN_STREAM_INPUT_LOADER_H
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "../StreamInputLoader.h"
+
+#include "../../core/Structures.h"
+
+/// <summary>
+/// Streaming variant of TextFilesInputLoader (WINDOWS mode).
+/// Every token shard file is one stream shard, shard is mapped only
+/// when it is read and cut into windows of seqLen + 1 tokens with
+/// stride seqLen (windows do not cross shard border).
+/// Load only lists shard files, nothing is opened or indexed
+/// </summary>
+class TokenStreamInputLoader : public StreamInputLoader
+{
+public:
+    TokenStreamInputLoader(RunMode type,
+        std::weak_ptr<InputLoadersWrapper> parent,
+        int32_t seqLen,
+        const std::string& datasetPath);
+    virtual ~TokenStreamInputLoader() = default;
+
+    void Load() override;
+
+    size_t GetShardsCount() const override;
+    std::unique_ptr<ShardReader> OpenShard(size_t shard) const override;
+
+protected:
+    class WindowsReader;
+
+    int32_t seqLen;
+    std::string datasetPath;
+
+    std::vector<std::string> files;
+};
+
+#endif
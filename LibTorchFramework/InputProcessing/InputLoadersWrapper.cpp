@@ -32,6 +32,17 @@ std::optional<int> InputLoadersWrapper::GetShuffleSeed() const
 	return this->shuffleSeed;
 }
 
+/// <summary>
+/// Set seed used to split dataset
+/// Must be called before loaders are loaded
+/// (e.g. to get the same split when training is resumed)
+/// </summary>
+/// <param name="seed"></param>
+void InputLoadersWrapper::SetShuffleSeed(std::optional<int> seed)
+{
+	this->shuffleSeed = seed;
+}
+
 float InputLoadersWrapper::GetTrainRatio() const
 {
 	return this->trainRatio;
@@ -25,6 +25,7 @@ public:
 	std::shared_ptr<InputLoader> GetLoader(RunMode type) const;
 	
 	std::optional<int> GetShuffleSeed() const;
+	void SetShuffleSeed(std::optional<int> seed);
 
 	float GetTrainRatio() const;
 	float GetValRatio() const;
@@ -0,0 +1,447 @@
+#ifndef PARALLEL_DATA_LOADER_H
+#define PARALLEL_DATA_LOADER_H
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <exception>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+
+#include "../Utils/MpmcQueue.h"
+
+struct ParallelDataLoaderOptions
+{
+    size_t batchSize = 1;
+
+    //0 = batches are loaded on calling thread
+    size_t workers = 0;
+
+    //batches requested ahead per worker
+    size_t prefetchDepth = 2;
+
+    //return batches in sampler order (worker that finished first may wait)
+    bool enforceOrdering = false;
+};
+
+/// <summary>
+/// Data loader with persistent worker threads (replacement of torch
+/// make_data_loader). Threads are started once and live across epochs,
+/// each worker has its own copy of dataset.
+///
+/// Job is the whole batch request - worker loads all samples of batch
+/// and collates them (dataset get_batch), so there is one queue operation
+/// per batch, not per sample. Jobs and results are passed through
+/// lock-free MPMC ring queues, idle threads spin briefly and then
+/// sleep on atomic wait.
+///
+/// At most workers * prefetchDepth batches are in flight
+/// </summary>
+template <typename Dataset, typename Sampler>
+class ParallelDataLoader
+{
+public:
+    using BatchType = typename Dataset::BatchType;
+    using BatchRequestType = typename Sampler::BatchRequestType;
+
+    class Iterator
+    {
+    public:
+        Iterator() = default;
+
+        explicit Iterator(ParallelDataLoader* loader) :
+            loader(loader)
+        {
+            this->Advance();
+        }
+
+        BatchType& operator*()
+        {
+            return *this->current;
+        }
+
+        BatchType* operator->()
+        {
+            return &(*this->current);
+        }
+
+        Iterator& operator++()
+        {
+            this->Advance();
+            return *this;
+        }
+
+        //only end iterators are equal
+        bool operator==(const Iterator& other) const
+        {
+            return (this->loader == nullptr) && (other.loader == nullptr);
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    protected:
+        ParallelDataLoader* loader = nullptr;
+        std::optional<BatchType> current;
+
+        void Advance()
+        {
+            this->current = this->loader->Next();
+            if (this->current.has_value() == false)
+            {
+                this->loader = nullptr;
+            }
+        }
+    };
+
+    ParallelDataLoader(Dataset dataset, Sampler sampler, const ParallelDataLoaderOptions& opts);
+    ~ParallelDataLoader();
+
+    ParallelDataLoader(const ParallelDataLoader&) = delete;
+    ParallelDataLoader& operator=(const ParallelDataLoader&) = delete;
+
+    //starts new epoch, batches of unfinished epoch are discarded
+    Iterator begin();
+    Iterator end();
+
+    //next batch of current epoch, nullopt at the end of epoch
+    std::optional<BatchType> Next();
+
+protected:
+    struct Job
+    {
+        uint64_t seq = 0;
+        BatchRequestType request;
+    };
+
+    struct Result
+    {
+        uint64_t seq = 0;
+        std::optional<BatchType> batch;
+        std::exception_ptr error;
+    };
+
+    static constexpr int SPIN_COUNT = 64;
+
+    Dataset dataset; //used by calling thread if there are no workers
+    Sampler sampler;
+    ParallelDataLoaderOptions opts;
+
+    size_t maxInFlight;
+
+    MpmcQueue<Job> jobs;
+    MpmcQueue<Result> results;
+
+    //incremented after every push, threads sleep on them
+    std::atomic<uint32_t> jobsSignal;
+    std::atomic<uint32_t> resultsSignal;
+    std::atomic<bool> running;
+
+    std::vector<std::thread> threads;
+
+    //state of calling thread
+    uint64_t nextSeq;
+    uint64_t expectedSeq;
+    size_t inFlight; //requested batches not yet returned from Next
+    bool samplerFinished;
+    std::unordered_map<uint64_t, Result> reorder;
+
+    void WorkerLoop(Dataset workerDataset);
+
+    void StartEpoch();
+    void Drain();
+    void Refill();
+
+    Result PopResult();
+    std::optional<BatchType> TakeResult(Result& res);
+};
+
+//======================================================================
+
+template <typename Dataset, typename Sampler>
+ParallelDataLoader<Dataset, Sampler>::ParallelDataLoader(Dataset dataset, Sampler sampler,
+    const ParallelDataLoaderOptions& opts) :
+    dataset(std::move(dataset)),
+    sampler(std::move(sampler)),
+    opts(opts),
+    maxInFlight(std::max<size_t>(opts.workers * std::max<size_t>(opts.prefetchDepth, 1), 1)),
+    jobs(maxInFlight),
+    results(maxInFlight),
+    jobsSignal(0),
+    resultsSignal(0),
+    running(true),
+    nextSeq(0),
+    expectedSeq(0),
+    inFlight(0),
+    samplerFinished(true)
+{
+    this->threads.reserve(this->opts.workers);
+    for (size_t i = 0; i < this->opts.workers; i++)
+    {
+        this->threads.emplace_back(&ParallelDataLoader::WorkerLoop, this, this->dataset);
+    }
+}
+
+template <typename Dataset, typename Sampler>
+ParallelDataLoader<Dataset, Sampler>::~ParallelDataLoader()
+{
+    if (this->threads.empty())
+    {
+        return;
+    }
+
+    //queued jobs are dropped, workers finish only running batch
+    Job job;
+    while (this->jobs.TryPop(job))
+    {
+    }
+
+    this->running.store(false, std::memory_order_release);
+    this->jobsSignal.fetch_add(1, std::memory_order_release);
+    this->jobsSignal.notify_all();
+
+    for (auto& t : this->threads)
+    {
+        t.join();
+    }
+}
+
+template <typename Dataset, typename Sampler>
+typename ParallelDataLoader<Dataset, Sampler>::Iterator ParallelDataLoader<Dataset, Sampler>::begin()
+{
+    this->StartEpoch();
+    return Iterator(this);
+}
+
+template <typename Dataset, typename Sampler>
+typename ParallelDataLoader<Dataset, Sampler>::Iterator ParallelDataLoader<Dataset, Sampler>::end()
+{
+    return Iterator();
+}
+
+template <typename Dataset, typename Sampler>
+void ParallelDataLoader<Dataset, Sampler>::StartEpoch()
+{
+    this->Drain();
+
+    this->sampler.reset();
+    this->samplerFinished = false;
+    this->expectedSeq = this->nextSeq;
+
+    this->Refill();
+}
+
+/// <summary>
+/// Remove batches of previous (not fully iterated) epoch.
+/// Jobs not yet taken by workers are cancelled,
+/// running jobs are waited for and their results dropped
+/// </summary>
+template <typename Dataset, typename Sampler>
+void ParallelDataLoader<Dataset, Sampler>::Drain()
+{
+    this->inFlight -= this->reorder.size();
+    this->reorder.clear();
+
+    Job job;
+    while (this->jobs.TryPop(job))
+    {
+        this->inFlight--;
+    }
+
+    while (this->inFlight > 0)
+    {
+        this->PopResult();
+        this->inFlight--;
+    }
+}
+
+/// <summary>
+/// Request batches from sampler until maxInFlight batches are in flight
+/// </summary>
+template <typename Dataset, typename Sampler>
+void ParallelDataLoader<Dataset, Sampler>::Refill()
+{
+    if (this->threads.empty())
+    {
+        return;
+    }
+
+    while ((this->inFlight < this->maxInFlight) && (this->samplerFinished == false))
+    {
+        auto request = this->sampler.next(this->opts.batchSize);
+        if (request.has_value() == false)
+        {
+            this->samplerFinished = true;
+            break;
+        }
+
+        Job job;
+        job.seq = this->nextSeq++;
+        job.request = std::move(*request);
+
+        //queue capacity >= maxInFlight, push cannot fail
+        while (this->jobs.TryPush(job) == false)
+        {
+            std::this_thread::yield();
+        }
+        this->inFlight++;
+
+        this->jobsSignal.fetch_add(1, std::memory_order_release);
+        this->jobsSignal.notify_one();
+    }
+}
+
+template <typename Dataset, typename Sampler>
+std::optional<typename ParallelDataLoader<Dataset, Sampler>::BatchType> ParallelDataLoader<Dataset, Sampler>::Next()
+{
+    if (this->threads.empty())
+    {
+        if (this->samplerFinished)
+        {
+            return std::nullopt;
+        }
+
+        auto request = this->sampler.next(this->opts.batchSize);
+        if (request.has_value() == false)
+        {
+            this->samplerFinished = true;
+            return std::nullopt;
+        }
+        return this->dataset.get_batch(*request);
+    }
+
+    if (this->opts.enforceOrdering == false)
+    {
+        if (this->inFlight == 0)
+        {
+            return std::nullopt;
+        }
+
+        Result res = this->PopResult();
+        return this->TakeResult(res);
+    }
+
+    while (true)
+    {
+        auto it = this->reorder.find(this->expectedSeq);
+        if (it != this->reorder.end())
+        {
+            Result res = std::move(it->second);
+            this->reorder.erase(it);
+            return this->TakeResult(res);
+        }
+
+        if (this->inFlight == 0)
+        {
+            return std::nullopt;
+        }
+
+        Result res = this->PopResult();
+        if (res.seq == this->expectedSeq)
+        {
+            return this->TakeResult(res);
+        }
+        this->reorder.emplace(res.seq, std::move(res));
+    }
+}
+
+/// <summary>
+/// Returned batch frees slot for next request.
+/// Exception thrown by worker is rethrown on calling thread
+/// </summary>
+template <typename Dataset, typename Sampler>
+std::optional<typename ParallelDataLoader<Dataset, Sampler>::BatchType> ParallelDataLoader<Dataset, Sampler>::TakeResult(Result& res)
+{
+    this->inFlight--;
+    this->expectedSeq = res.seq + 1;
+    this->Refill();
+
+    if (res.error)
+    {
+        std::rethrow_exception(res.error);
+    }
+
+    return std::move(res.batch);
+}
+
+template <typename Dataset, typename Sampler>
+typename ParallelDataLoader<Dataset, Sampler>::Result ParallelDataLoader<Dataset, Sampler>::PopResult()
+{
+    Result res;
+    int spin = 0;
+
+    while (true)
+    {
+        const uint32_t seen = this->resultsSignal.load(std::memory_order_acquire);
+        if (this->results.TryPop(res))
+        {
+            return res;
+        }
+
+        if (spin < SPIN_COUNT)
+        {
+            spin++;
+            std::this_thread::yield();
+            continue;
+        }
+
+        this->resultsSignal.wait(seen, std::memory_order_acquire);
+    }
+}
+
+template <typename Dataset, typename Sampler>
+void ParallelDataLoader<Dataset, Sampler>::WorkerLoop(Dataset workerDataset)
+{
+    Job job;
+    int spin = 0;
+
+    while (true)
+    {
+        const uint32_t seen = this->jobsSignal.load(std::memory_order_acquire);
+        if (this->jobs.TryPop(job) == false)
+        {
+            if (this->running.load(std::memory_order_acquire) == false)
+            {
+                return;
+            }
+
+            if (spin < SPIN_COUNT)
+            {
+                spin++;
+                std::this_thread::yield();
+                continue;
+            }
+
+            this->jobsSignal.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+        spin = 0;
+
+        Result res;
+        res.seq = job.seq;
+        try
+        {
+            res.batch.emplace(workerDataset.get_batch(job.request));
+        }
+        catch (...)
+        {
+            res.error = std::current_exception();
+        }
+
+        //at most maxInFlight results exist, push cannot fail
+        while (this->results.TryPush(res) == false)
+        {
+            std::this_thread::yield();
+        }
+
+        this->resultsSignal.fetch_add(1, std::memory_order_release);
+        this->resultsSignal.notify_one();
+    }
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SAMPLE_DATASET_H
+#define SAMPLE_DATASET_H
+
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+#include <torch/torch.h>
+
+#include "./DataLoaderSample.h"
+#include "./SampleInputLoader.h"
+
+/// <summary>
+/// DefaultDataset for typed samples of SampleInputLoader
+/// </summary>
+template <typename Sample>
+class SampleDataset : public torch::data::datasets::Dataset<SampleDataset<Sample>, Sample>
+{
+public:
+    SampleDataset(std::shared_ptr<InputLoader> loader) :
+        loader(std::dynamic_pointer_cast<SampleInputLoader<Sample>>(loader))
+    {
+        if (this->loader == nullptr)
+        {
+            throw std::invalid_argument("SampleDataset requires SampleInputLoader with the same sample type");
+        }
+    }
+
+    virtual ~SampleDataset() = default;
+
+    Sample get(size_t index) override
+    {
+        Sample s(static_cast<int64_t>(index));
+        this->loader->FillSample(index, s);
+
+        return s;
+    }
+
+    torch::optional<size_t> size() const override
+    {
+        return this->loader->GetSize();
+    }
+
+protected:
+    std::shared_ptr<SampleInputLoader<Sample>> loader;
+};
+
+#endif
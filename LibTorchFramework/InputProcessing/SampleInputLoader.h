@@ -0,0 +1,34 @@
+#ifndef SAMPLE_INPUT_LOADER_H
+#define SAMPLE_INPUT_LOADER_H
+
+#include <memory>
+
+#include "./InputLoader.h"
+#include "./DataLoaderSample.h"
+
+/// <summary>
+/// InputLoader that fills typed samples (DataLoaderSample).
+/// With SampleDataset, samples stay typed up to the collated batch.
+/// FillData is dynamic fallback (DefaultDataset) - sample is converted
+/// to DataLoaderData
+/// </summary>
+template <typename Sample>
+class SampleInputLoader : public InputLoader
+{
+public:
+    using SampleType = Sample;
+
+    using InputLoader::InputLoader;
+    virtual ~SampleInputLoader() = default;
+
+    virtual void FillSample(size_t index, Sample& s) = 0;
+
+    void FillData(size_t index, DataLoaderData& ld) override
+    {
+        Sample s(static_cast<int64_t>(index));
+        this->FillSample(index, s);
+        ld = std::move(s).ToDataLoaderData();
+    }
+};
+
+#endif
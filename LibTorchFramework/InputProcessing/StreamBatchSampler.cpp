@@ -0,0 +1,54 @@
+#include "./StreamBatchSampler.h"
+
+StreamBatchSampler::StreamBatchSampler(std::optional<size_t> epochSteps) :
+    epochSteps(epochSteps),
+    steps(0),
+    epoch(0)
+{
+}
+
+/// <summary>
+/// Called by DataLoader at the start of each epoch
+/// </summary>
+/// <param name="new_size"></param>
+void StreamBatchSampler::reset(torch::optional<size_t> new_size)
+{
+    this->steps = 0;
+    this->epoch++;
+}
+
+torch::optional<StreamBatchRequest> StreamBatchSampler::next(size_t batch_size)
+{
+    if ((this->epochSteps.has_value()) && (this->steps >= this->epochSteps.value()))
+    {
+        return torch::nullopt;
+    }
+    this->steps++;
+
+    StreamBatchRequest r;
+    r.batchSize = batch_size;
+    r.epoch = this->epoch;
+    return r;
+}
+
+void StreamBatchSampler::save(torch::serialize::OutputArchive& archive) const
+{
+    archive.write("steps", torch::tensor(static_cast<int64_t>(this->steps), torch::kInt64), true);
+}
+
+void StreamBatchSampler::load(torch::serialize::InputArchive& archive)
+{
+    auto tensor = torch::empty(1, torch::kInt64);
+    archive.read("steps", tensor, true);
+    this->steps = static_cast<size_t>(tensor.item<int64_t>());
+}
+
+/// <summary>
+/// Batches per epoch, 0 if not known (epoch ends with stream)
+/// </summary>
+/// <param name="batchSize"></param>
+/// <returns></returns>
+size_t StreamBatchSampler::GetBatchesCount(size_t batchSize) const
+{
+    return this->epochSteps.value_or(0);
+}
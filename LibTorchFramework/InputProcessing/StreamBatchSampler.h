@@ -0,0 +1,44 @@
+#ifndef STREAM_BATCH_SAMPLER_H
+#define STREAM_BATCH_SAMPLER_H
+
+#include <cstdint>
+#include <optional>
+
+#include <torch/torch.h>
+
+/// <summary>
+/// Request for next batch of StreamingDataset.
+/// Epoch is used to discard requests of previous epoch
+/// that were still in flight when epoch ended
+/// </summary>
+struct StreamBatchRequest
+{
+    size_t batchSize = 0;
+    uint64_t epoch = 0;
+};
+
+/// <summary>
+/// Batch sampler of StreamingDataset (no indices, only batch sizes).
+/// With epochSteps, epoch ends after given number of batches,
+/// otherwise epoch ends when stream returns empty batch
+/// </summary>
+class StreamBatchSampler : public torch::data::samplers::Sampler<StreamBatchRequest>
+{
+public:
+    explicit StreamBatchSampler(std::optional<size_t> epochSteps = std::nullopt);
+
+    void reset(torch::optional<size_t> new_size = torch::nullopt) override;
+    torch::optional<StreamBatchRequest> next(size_t batch_size) override;
+
+    void save(torch::serialize::OutputArchive& archive) const override;
+    void load(torch::serialize::InputArchive& archive) override;
+
+    size_t GetBatchesCount(size_t batchSize) const;
+
+protected:
+    std::optional<size_t> epochSteps;
+    size_t steps;
+    uint64_t epoch;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "./StreamInputLoader.h"
+
+#include <numeric>
+#include <stdexcept>
+
+#include "./DataLoaderData.h"
+#include "./InputLoadersWrapper.h"
+
+StreamInputLoader::StreamInputLoader(RunMode type, std::weak_ptr<InputLoadersWrapper> parent) :
+    InputLoader(type, parent)
+{
+}
+
+/// <summary>
+/// Size of stream is not known
+/// </summary>
+/// <returns></returns>
+size_t StreamInputLoader::GetSize() const
+{
+    return 0;
+}
+
+void StreamInputLoader::FillData(size_t index, DataLoaderData& ld)
+{
+    throw std::logic_error("StreamInputLoader has no random access, use StreamingDataset");
+}
+
+/// <summary>
+/// Shards that belong to this loader's RunMode, in (optionally shuffled) order.
+/// Split is done over shards, not over samples
+/// </summary>
+/// <returns></returns>
+std::vector<size_t> StreamInputLoader::GetStreamShards()
+{
+    std::vector<size_t> shards(this->GetShardsCount());
+    std::iota(shards.begin(), shards.end(), 0);
+
+    return this->BuildSplits(shards);
+}
+
+size_t StreamInputLoader::GetShuffleBufferSize() const
+{
+    return this->loaderSets.shuffleBufferSize;
+}
+
+std::optional<int> StreamInputLoader::GetShuffleSeed() const
+{
+    auto parentPtr = this->parent.lock();
+    return (parentPtr) ? parentPtr->GetShuffleSeed() : std::nullopt;
+}
@@ -0,0 +1,54 @@
+#ifndef STREAM_INPUT_LOADER_H
+#define STREAM_INPUT_LOADER_H
+
+struct DataLoaderData;
+
+#include <memory>
+#include <vector>
+#include <optional>
+
+#include "./InputLoader.h"
+
+/// <summary>
+/// Input loader without random access and without known size.
+/// Data are split to shards (files, feed partitions...), every shard
+/// is read sequentially by ShardReader. Shards are distributed among
+/// DataLoader workers by StreamingDataset, so no indexing pass is needed.
+///
+/// Samples from stream have index DataLoaderData::STREAM_INDEX
+/// </summary>
+class StreamInputLoader : public InputLoader
+{
+public:
+    class ShardReader
+    {
+    public:
+        virtual ~ShardReader() = default;
+
+        //false at the end of shard
+        virtual bool Next(DataLoaderData& ld) = 0;
+    };
+
+    StreamInputLoader(RunMode type, std::weak_ptr<InputLoadersWrapper> parent);
+    virtual ~StreamInputLoader() = default;
+
+    //==============
+    // virtual method need to be overrided
+    // in actuall StreamInputLoader implementation
+    //==============
+
+    virtual size_t GetShardsCount() const = 0;
+    virtual std::unique_ptr<ShardReader> OpenShard(size_t shard) const = 0;
+
+    //==============
+
+    size_t GetSize() const override;
+    void FillData(size_t index, DataLoaderData& ld) override;
+
+    std::vector<size_t> GetStreamShards();
+
+    size_t GetShuffleBufferSize() const;
+    std::optional<int> GetShuffleSeed() const;
+};
+
+#endif
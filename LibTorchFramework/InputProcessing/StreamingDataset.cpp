@@ -0,0 +1,320 @@
+#include "./StreamingDataset.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Utils/Logger.h>
+
+#include "./StreamInputLoader.h"
+
+//============================================
+// Shared state of all dataset copies (one per DataLoader worker).
+// Readers claim shards in order given by claim counter,
+// claim c is shard at position (c % shards) of pass (c / shards)
+//============================================
+
+struct StreamingDataset::SharedState
+{
+    std::shared_ptr<StreamInputLoader> loader;
+    bool repeat = false;
+    std::optional<int> seed;
+    size_t shuffleBufferSize = 0;
+
+    std::vector<size_t> baseShards; //order of the first pass
+    std::vector<size_t> shards; //order of the current pass
+
+    std::mutex m;
+    std::condition_variable cv;
+
+    uint64_t epoch = 0;
+    uint64_t nextClaim = 0;
+    size_t activeReaders = 0; //readers of current epoch, that are not finished
+    size_t readersCount = 0;
+
+    //repeat mode - detection of stream without any data
+    bool hasData = false;
+    size_t emptyShardsCount = 0;
+
+    bool BeginRequest(uint64_t requestEpoch);
+    std::optional<size_t> ClaimShard(uint64_t readerEpoch);
+    void ShardFinished(bool hadData);
+};
+
+struct StreamingDataset::Reader
+{
+    uint64_t epoch = 0;
+    bool active = false;
+
+    std::unique_ptr<StreamInputLoader::ShardReader> shard;
+    bool shardHasData = false;
+
+    std::vector<DataLoaderData> buffer;
+    std::mt19937_64 rng;
+
+    bool Next(SharedState& state, DataLoaderData& ld);
+    bool ReadSample(SharedState& state, DataLoaderData& ld);
+};
+
+//============================================
+
+/// <summary>
+/// Request of new epoch resets state (one pass mode),
+/// request of already finished epoch is rejected
+/// </summary>
+/// <param name="requestEpoch"></param>
+/// <returns></returns>
+bool StreamingDataset::SharedState::BeginRequest(uint64_t requestEpoch)
+{
+    std::lock_guard<std::mutex> lk(this->m);
+
+    if (requestEpoch < this->epoch)
+    {
+        return false;
+    }
+
+    if (requestEpoch > this->epoch)
+    {
+        this->epoch = requestEpoch;
+        if (this->repeat == false)
+        {
+            this->nextClaim = 0;
+            this->activeReaders = 0;
+        }
+        this->cv.notify_all();
+    }
+
+    return true;
+}
+
+std::optional<size_t> StreamingDataset::SharedState::ClaimShard(uint64_t readerEpoch)
+{
+    std::lock_guard<std::mutex> lk(this->m);
+
+    const size_t n = this->shards.size();
+    if (n == 0)
+    {
+        return std::nullopt;
+    }
+
+    if (this->repeat == false)
+    {
+        if ((readerEpoch != this->epoch) || (this->nextClaim >= n))
+        {
+            return std::nullopt;
+        }
+    }
+    else if ((this->hasData == false) && (this->emptyShardsCount >= n))
+    {
+        throw std::runtime_error("Stream has no data");
+    }
+
+    const uint64_t claim = this->nextClaim++;
+    const size_t pos = static_cast<size_t>(claim % n);
+
+    if ((pos == 0) && (claim > 0) && (this->seed.has_value()))
+    {
+        //new pass, new order of shards
+        this->shards = this->baseShards;
+        std::mt19937_64 rng(static_cast<uint64_t>(this->seed.value()) + claim / n);
+        std::shuffle(this->shards.begin(), this->shards.end(), rng);
+    }
+
+    return this->shards[pos];
+}
+
+void StreamingDataset::SharedState::ShardFinished(bool hadData)
+{
+    std::lock_guard<std::mutex> lk(this->m);
+
+    if (hadData)
+    {
+        this->hasData = true;
+    }
+    else
+    {
+        this->emptyShardsCount++;
+    }
+}
+
+//============================================
+
+/// <summary>
+/// Next sample from shuffle buffer. Buffer is refilled from shards,
+/// random sample is taken from it
+/// </summary>
+/// <param name="state"></param>
+/// <param name="ld"></param>
+/// <returns>false if stream is finished</returns>
+bool StreamingDataset::Reader::Next(SharedState& state, DataLoaderData& ld)
+{
+    const size_t capacity = std::max<size_t>(state.shuffleBufferSize, 1);
+
+    while (this->buffer.size() < capacity)
+    {
+        DataLoaderData s(DataLoaderData::STREAM_INDEX);
+        if (this->ReadSample(state, s) == false)
+        {
+            break;
+        }
+        this->buffer.push_back(std::move(s));
+    }
+
+    if (this->buffer.empty())
+    {
+        return false;
+    }
+
+    size_t i = 0;
+    if (this->buffer.size() > 1)
+    {
+        std::uniform_int_distribution<size_t> dist(0, this->buffer.size() - 1);
+        i = dist(this->rng);
+    }
+
+    std::swap(this->buffer[i], this->buffer.back());
+    ld = std::move(this->buffer.back());
+    this->buffer.pop_back();
+
+    return true;
+}
+
+bool StreamingDataset::Reader::ReadSample(SharedState& state, DataLoaderData& ld)
+{
+    while (true)
+    {
+        if (this->shard)
+        {
+            if (this->shard->Next(ld))
+            {
+                this->shardHasData = true;
+                return true;
+            }
+
+            this->shard.reset();
+            state.ShardFinished(this->shardHasData);
+        }
+
+        auto shardIndex = state.ClaimShard(this->epoch);
+        if (shardIndex.has_value() == false)
+        {
+            return false;
+        }
+
+        this->shard = state.loader->OpenShard(shardIndex.value());
+        this->shardHasData = false;
+    }
+}
+
+//============================================
+
+StreamingDataset::StreamingDataset(std::shared_ptr<InputLoader> loader, bool repeat) :
+    state(std::make_shared<SharedState>()),
+    reader(nullptr)
+{
+    this->state->loader = std::dynamic_pointer_cast<StreamInputLoader>(loader);
+    if (this->state->loader == nullptr)
+    {
+        throw std::invalid_argument("StreamingDataset requires StreamInputLoader");
+    }
+
+    this->state->repeat = repeat;
+    this->state->seed = this->state->loader->GetShuffleSeed();
+    this->state->shuffleBufferSize = this->state->loader->GetShuffleBufferSize();
+    this->state->baseShards = this->state->loader->GetStreamShards();
+    this->state->shards = this->state->baseShards;
+
+    if ((repeat) && (this->state->shards.empty()))
+    {
+        throw std::runtime_error("Stream has no shards");
+    }
+
+    MY_LOG_INFO("Stream shards: %zu (%s), shuffle buffer: %zu", this->state->shards.size(),
+        repeat ? "repeated" : "one pass", this->state->shuffleBufferSize);
+}
+
+StreamingDataset::StreamingDataset(const StreamingDataset& other) :
+    state(other.state),
+    reader(nullptr)
+{
+}
+
+StreamingDataset::StreamingDataset(StreamingDataset&& other) = default;
+
+StreamingDataset::~StreamingDataset()
+{
+}
+
+torch::optional<size_t> StreamingDataset::size() const
+{
+    return torch::nullopt;
+}
+
+/// <summary>
+/// Called from DataLoader worker thread (each worker has own copy).
+/// Empty batch is returned for request of finished epoch and at the end
+/// of stream - then reader waits until readers of all other workers
+/// are finished, so no data batch can come after the first empty one
+/// </summary>
+/// <param name="request"></param>
+/// <returns></returns>
+std::vector<DataLoaderData> StreamingDataset::get_batch(StreamBatchRequest request)
+{
+    std::vector<DataLoaderData> batch;
+
+    if (this->state->BeginRequest(request.epoch) == false)
+    {
+        return batch;
+    }
+
+    if ((this->reader == nullptr) || ((this->state->repeat == false) && (this->reader->epoch != request.epoch)))
+    {
+        std::lock_guard<std::mutex> lk(this->state->m);
+
+        this->reader = std::make_unique<Reader>();
+        this->reader->epoch = request.epoch;
+        this->reader->active = true;
+        this->state->activeReaders++;
+
+        const uint64_t readerId = this->state->readersCount++;
+        if (this->state->seed.has_value())
+        {
+            this->reader->rng.seed(static_cast<uint64_t>(this->state->seed.value()) * 1000003 + readerId);
+        }
+        else
+        {
+            this->reader->rng.seed(std::random_device{}());
+        }
+    }
+
+    batch.reserve(request.batchSize);
+    while (batch.size() < request.batchSize)
+    {
+        DataLoaderData ld(DataLoaderData::STREAM_INDEX);
+        if (this->reader->Next(*this->state, ld) == false)
+        {
+            break;
+        }
+        batch.push_back(std::move(ld));
+    }
+
+    if (batch.empty())
+    {
+        std::unique_lock<std::mutex> lk(this->state->m);
+        if (this->reader->active)
+        {
+            this->reader->active = false;
+            this->state->activeReaders--;
+            this->state->cv.notify_all();
+        }
+
+        const uint64_t epoch = this->reader->epoch;
+        this->state->cv.wait(lk, [&]() {
+            return (this->state->activeReaders == 0) || (this->state->epoch != epoch);
+        });
+    }
+
+    return batch;
+}
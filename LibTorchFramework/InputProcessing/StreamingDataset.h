@@ -0,0 +1,51 @@
+#ifndef STREAMING_DATASET_H
+#define STREAMING_DATASET_H
+
+class InputLoader;
+
+#include <memory>
+#include <vector>
+#include <optional>
+
+#include <torch/torch.h>
+
+#include "./DataLoaderData.h"
+#include "./StreamBatchSampler.h"
+
+/// <summary>
+/// Dataset over StreamInputLoader (no size, no random access).
+///
+/// Each DataLoader worker has its own copy of dataset with own reader,
+/// readers take shards one by one from shared queue, so shards are
+/// distributed among workers dynamically. Samples are shuffled
+/// in bounded buffer of each reader (InputLoaderSettings::shuffleBufferSize).
+///
+/// repeat = false: epoch is one pass over shards, end of epoch
+/// is signaled by empty batch (after all readers are finished).
+/// repeat = true: shards are cycled (reshuffled in each pass) and stream
+/// continues over epochs, epoch length is given by StreamBatchSampler steps
+/// </summary>
+class StreamingDataset : public torch::data::datasets::BatchDataset<StreamingDataset,
+    std::vector<DataLoaderData>, StreamBatchRequest>
+{
+public:
+    //sample type collated by Stack
+    using ExampleType = DataLoaderData;
+
+    StreamingDataset(std::shared_ptr<InputLoader> loader, bool repeat = false);
+    StreamingDataset(const StreamingDataset& other);
+    StreamingDataset(StreamingDataset&& other);
+    virtual ~StreamingDataset();
+
+    std::vector<DataLoaderData> get_batch(StreamBatchRequest request) override;
+    torch::optional<size_t> size() const override;
+
+protected:
+    struct SharedState;
+    struct Reader;
+
+    std::shared_ptr<SharedState> state; //shared by all copies
+    std::unique_ptr<Reader> reader; //not copied, each worker has its own
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "./TokenShardDataset.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Utils/cJSON.h>
+#include <Utils/Logger.h>
+
+#include "../core/Tokenizers/TokenShardFile.h"
+
+//============================================
+// Dataset path is expected to be:
+// -----
+// [dir] with manifest.json -> shards listed in manifest (in order)
+// [dir] without manifest -> all shard_*.bin files sorted by name
+// [file] single shard
+// ------
+//============================================
+
+TokenShardDataset::TokenShardDataset(const std::string& path) :
+	bucketShift(0)
+{
+	this->shardStarts.push_back(0);
+	this->shardDocumentStarts.push_back(0);
+
+	for (const auto& file : ListShardFiles(path))
+	{
+		auto shard = std::make_unique<TokenShardFile>(file);
+		if (shard->GetTokensCount() == 0)
+		{
+			continue;
+		}
+
+		this->shardStarts.push_back(this->shardStarts.back() + shard->GetTokensCount());
+		this->shardDocumentStarts.push_back(this->shardDocumentStarts.back() + shard->GetDocumentsCount());
+		this->shards.push_back(std::move(shard));
+	}
+
+	this->BuildBucketTable();
+
+	MY_LOG_INFO("Token shards: %zu, tokens: %llu", this->shards.size(),
+		static_cast<unsigned long long>(this->GetTokensCount()));
+}
+
+TokenShardDataset::~TokenShardDataset()
+{
+}
+
+uint64_t TokenShardDataset::GetTokensCount() const
+{
+	return this->shardStarts.back();
+}
+
+uint64_t TokenShardDataset::GetDocumentsCount() const
+{
+	return this->shardDocumentStarts.back();
+}
+
+size_t TokenShardDataset::GetShardsCount() const
+{
+	return this->shards.size();
+}
+
+/// <summary>
+/// Global start and length (in tokens) of document.
+/// Throws std::out_of_range for invalid index
+/// </summary>
+/// <param name="index"></param>
+/// <param name="start"></param>
+/// <param name="length"></param>
+void TokenShardDataset::GetDocument(uint64_t index, uint64_t& start, uint64_t& length) const
+{
+	if (index >= this->GetDocumentsCount())
+	{
+		throw std::out_of_range("Token shards - document index outside of dataset");
+	}
+
+	auto it = std::upper_bound(this->shardDocumentStarts.begin(), this->shardDocumentStarts.end(), index);
+	const size_t shard = static_cast<size_t>(it - this->shardDocumentStarts.begin()) - 1;
+	const uint64_t local = index - this->shardDocumentStarts[shard];
+
+	auto offsets = this->shards[shard]->GetDocumentOffsets();
+	start = this->shardStarts[shard] + offsets[local];
+	length = offsets[local + 1] - offsets[local];
+}
+
+std::vector<std::string> TokenShardDataset::ListShardFiles(const std::string& path)
+{
+	if (std::filesystem::is_regular_file(path))
+	{
+		return { path };
+	}
+	if (std::filesystem::is_directory(path) == false)
+	{
+		throw std::runtime_error("Token shards not found: " + path);
+	}
+
+	std::vector<std::string> files;
+	const std::filesystem::path dir(path);
+
+	std::ifstream f(dir / "manifest.json", std::ios::binary);
+	if (f)
+	{
+		std::stringstream ss;
+		ss << f.rdbuf();
+		std::string data = ss.str();
+
+		cJSON* root = cJSON_Parse(data.c_str());
+		if (root == nullptr)
+		{
+			throw std::runtime_error("Invalid token shards manifest in " + path);
+		}
+
+		const cJSON* complete = cJSON_GetObjectItemCaseSensitive(root, "complete");
+		if (cJSON_IsTrue(complete) == false)
+		{
+			MY_LOG_WARNING("Token shards in %s are not complete, using finished shards only", path.c_str());
+		}
+
+		const cJSON* item = nullptr;
+		cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(root, "shards"))
+		{
+			const cJSON* file = cJSON_GetObjectItemCaseSensitive(item, "file");
+			if (cJSON_IsString(file))
+			{
+				files.push_back((dir / file->valuestring).string());
+			}
+		}
+
+		cJSON_Delete(root);
+		return files;
+	}
+
+	for (const auto& e : std::filesystem::directory_iterator(dir))
+	{
+		const std::string name = e.path().filename().string();
+		if ((e.is_regular_file()) && (name.rfind("shard_", 0) == 0) && (e.path().extension() == ".bin"))
+		{
+			files.push_back(e.path().string());
+		}
+	}
+
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+/// <summary>
+/// Bucket size is power of 2 not larger than the smallest shard
+/// (last shard is usually smaller and is ignored), so bucket overlaps
+/// at most two shards and lookup is table read and one comparison.
+/// Bucket count is limited to MAX_BUCKETS, lookup then may
+/// step over more shards
+/// </summary>
+void TokenShardDataset::BuildBucketTable()
+{
+	this->bucketShards.clear();
+	this->bucketShift = 0;
+
+	if (this->shards.empty())
+	{
+		return;
+	}
+
+	uint64_t minSize = this->shards[0]->GetTokensCount();
+	for (size_t i = 1; i + 1 < this->shards.size(); i++)
+	{
+		minSize = std::min(minSize, this->shards[i]->GetTokensCount());
+	}
+
+	while ((uint64_t(2) << this->bucketShift) <= minSize)
+	{
+		this->bucketShift++;
+	}
+
+	const uint64_t total = this->GetTokensCount();
+	while ((total >> this->bucketShift) + 1 > MAX_BUCKETS)
+	{
+		this->bucketShift++;
+	}
+
+	const size_t bucketsCount = static_cast<size_t>(total >> this->bucketShift) + 1;
+	this->bucketShards.resize(bucketsCount);
+
+	uint32_t shard = 0;
+	for (size_t b = 0; b < bucketsCount; b++)
+	{
+		const uint64_t start = static_cast<uint64_t>(b) << this->bucketShift;
+		while ((shard + 1 < this->shards.size()) && (this->shardStarts[shard + 1] <= start))
+		{
+			shard++;
+		}
+		this->bucketShards[b] = shard;
+	}
+}
+
+size_t TokenShardDataset::FindShard(uint64_t position) const
+{
+	size_t shard = this->bucketShards[position >> this->bucketShift];
+	while (this->shardStarts[shard + 1] <= position)
+	{
+		shard++;
+	}
+	return shard;
+}
+
+/// <summary>
+/// Copy tokens [start, start + count) of the continuous stream,
+/// range may continue to the following shards.
+/// Throws std::out_of_range if range is outside of dataset
+/// </summary>
+/// <param name="start"></param>
+/// <param name="count"></param>
+/// <param name="out"></param>
+void TokenShardDataset::CopyTokens(uint64_t start, size_t count, int64_t* out) const
+{
+	this->CopyTokensImpl(start, count, out);
+}
+
+void TokenShardDataset::CopyTokens(uint64_t start, size_t count, int32_t* out) const
+{
+	this->CopyTokensImpl(start, count, out);
+}
+
+/// <summary>
+/// Global positions of documents that start inside [start, start + count),
+/// in ascending order. Each shard begins with new document
+/// </summary>
+/// <param name="start"></param>
+/// <param name="count"></param>
+/// <param name="starts"></param>
+void TokenShardDataset::GetDocumentStarts(uint64_t start, size_t count, std::vector<uint64_t>& starts) const
+{
+	starts.clear();
+
+	const uint64_t total = this->GetTokensCount();
+	if ((start > total) || (count > total - start))
+	{
+		throw std::out_of_range("Token shards - range outside of dataset");
+	}
+
+	const uint64_t end = start + count;
+	while (start < end)
+	{
+		const size_t shard = this->FindShard(start);
+		const uint64_t shardStart = this->shardStarts[shard];
+		const uint64_t localEnd = std::min(end, this->shardStarts[shard + 1]) - shardStart;
+
+		auto offsets = this->shards[shard]->GetDocumentOffsets();
+		auto it = std::lower_bound(offsets.begin(), offsets.end(), start - shardStart);
+		for (; (it != offsets.end()) && (*it < localEnd); ++it)
+		{
+			starts.push_back(shardStart + *it);
+		}
+
+		start = shardStart + localEnd;
+	}
+}
+
+template <typename T>
+void TokenShardDataset::CopyTokensImpl(uint64_t start, size_t count, T* out) const
+{
+	const uint64_t total = this->GetTokensCount();
+	if ((start > total) || (count > total - start))
+	{
+		throw std::out_of_range("Token shards - range outside of dataset");
+	}
+
+	while (count > 0)
+	{
+		const size_t shard = this->FindShard(start);
+		const uint64_t local = start - this->shardStarts[shard];
+		const size_t n = static_cast<size_t>(std::min<uint64_t>(count, this->shardStarts[shard + 1] - start));
+
+		this->shards[shard]->CopyTokens(local, n, out);
+
+		start += n;
+		out += n;
+		count -= n;
+	}
+}
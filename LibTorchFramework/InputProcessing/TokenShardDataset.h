@@ -0,0 +1,58 @@
+#ifndef TOKEN_SHARD_DATASET_H
+#define TOKEN_SHARD_DATASET_H
+
+class TokenShardFile;
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+/// <summary>
+/// Pre-tokenized corpus (shards written by TokenizeCorpus tool)
+/// viewed as one continuous token stream.
+/// All shards are memory-mapped, global token position is mapped
+/// to shard in O(1) through cumulative offsets and bucket table
+/// </summary>
+class TokenShardDataset
+{
+public:
+	explicit TokenShardDataset(const std::string& path); //directory with shards or single shard file
+	~TokenShardDataset();
+
+	uint64_t GetTokensCount() const;
+	uint64_t GetDocumentsCount() const;
+	size_t GetShardsCount() const;
+
+	void GetDocument(uint64_t index, uint64_t& start, uint64_t& length) const;
+
+	void CopyTokens(uint64_t start, size_t count, int64_t* out) const;
+	void CopyTokens(uint64_t start, size_t count, int32_t* out) const;
+
+	void GetDocumentStarts(uint64_t start, size_t count, std::vector<uint64_t>& starts) const;
+
+	static std::vector<std::string> ListShardFiles(const std::string& path);
+
+protected:
+	static constexpr size_t MAX_BUCKETS = 1 << 20;
+
+	std::vector<std::unique_ptr<TokenShardFile>> shards;
+
+	//global position of the first token of each shard, shardStarts[shards.size()] = tokens count
+	std::vector<uint64_t> shardStarts;
+
+	//global index of the first document of each shard, last is documents count
+	std::vector<uint64_t> shardDocumentStarts;
+
+	//bucket (position >> bucketShift) -> first shard that contains any of its tokens
+	std::vector<uint32_t> bucketShards;
+	uint32_t bucketShift;
+
+	void BuildBucketTable();
+	size_t FindShard(uint64_t position) const;
+
+	template <typename T>
+	void CopyTokensImpl(uint64_t start, size_t count, T* out) const;
+};
+
+#endif
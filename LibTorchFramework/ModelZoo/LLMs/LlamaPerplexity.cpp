@@ -0,0 +1,274 @@
+#include "./LlamaPerplexity.h"
+
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Utils/Logger.h>
+
+#include "../../InputProcessing/TokenShardDataset.h"
+
+using namespace ModelZoo::llama;
+
+//========================================================================
+
+static constexpr int64_t IGNORE_TARGET = -100;
+
+//max number of logits rows converted to float at once for loss
+static constexpr int64_t LOSS_CHUNK_TOKENS = 1024;
+
+//========================================================================
+
+PerplexityEvaluator::PerplexityEvaluator(std::shared_ptr<LlamaForCausalLM> model, const Options& opts) :
+	model(model),
+	opts(opts)
+{
+	if ((opts.contextLength <= 0) || (opts.stride <= 0) || (opts.stride > opts.contextLength))
+	{
+		throw std::invalid_argument("Perplexity - stride must be in range [1, contextLength]");
+	}
+	if (opts.batchSize == 0)
+	{
+		throw std::invalid_argument("Perplexity - batch size must be > 0");
+	}
+}
+
+PerplexityEvaluator::Result PerplexityEvaluator::Evaluate(const std::vector<std::vector<int64_t>>& documents)
+{
+	std::vector<size_t> lengths;
+	lengths.reserve(documents.size());
+	for (const auto& d : documents)
+	{
+		lengths.push_back(d.size());
+	}
+
+	return this->Evaluate(lengths, [&](size_t index, std::vector<int64_t>& tokens) {
+		tokens = documents[index];
+	});
+}
+
+/// <summary>
+/// Evaluate documents of pre-tokenized shards (first maxDocuments if set)
+/// </summary>
+/// <param name="dataset"></param>
+/// <param name="maxDocuments"></param>
+/// <returns></returns>
+PerplexityEvaluator::Result PerplexityEvaluator::Evaluate(const TokenShardDataset& dataset,
+	std::optional<size_t> maxDocuments)
+{
+	size_t count = static_cast<size_t>(dataset.GetDocumentsCount());
+	if (maxDocuments.has_value())
+	{
+		count = std::min(count, maxDocuments.value());
+	}
+
+	std::vector<size_t> lengths(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t start = 0;
+		uint64_t length = 0;
+		dataset.GetDocument(i, start, length);
+		lengths[i] = static_cast<size_t>(length);
+	}
+
+	return this->Evaluate(lengths, [&](size_t index, std::vector<int64_t>& tokens) {
+		uint64_t start = 0;
+		uint64_t length = 0;
+		dataset.GetDocument(index, start, length);
+
+		if (opts.maxDocumentLength.has_value())
+		{
+			length = std::min<uint64_t>(length, static_cast<uint64_t>(opts.maxDocumentLength.value()));
+		}
+
+		tokens.resize(static_cast<size_t>(length));
+		dataset.CopyTokens(start, tokens.size(), tokens.data());
+	});
+}
+
+/// <summary>
+/// Evaluate documents with given lengths, tokens are requested by callback
+/// only for current batch. Documents with less than 2 tokens are skipped
+/// </summary>
+/// <param name="lengths"></param>
+/// <param name="getDocument"></param>
+/// <returns></returns>
+PerplexityEvaluator::Result PerplexityEvaluator::Evaluate(const std::vector<size_t>& lengths,
+	const DocumentCallback& getDocument)
+{
+	auto effectiveLength = [&](size_t i) -> size_t {
+		if (opts.maxDocumentLength.has_value())
+		{
+			return std::min(lengths[i], static_cast<size_t>(opts.maxDocumentLength.value()));
+		}
+		return lengths[i];
+	};
+
+	//longest first, documents of similar length are in the same batch
+	std::vector<size_t> order;
+	order.reserve(lengths.size());
+	for (size_t i = 0; i < lengths.size(); i++)
+	{
+		if (effectiveLength(i) >= 2)
+		{
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return effectiveLength(a) > effectiveLength(b);
+	});
+
+	torch::NoGradGuard noGrad;
+	const bool wasTraining = model->is_training();
+	model->eval();
+
+	auto params = model->parameters();
+	torch::Device device = params.empty() ? torch::Device(torch::kCPU) : params[0].device();
+
+	Result res;
+	torch::Tensor nllSum = torch::zeros({}, torch::TensorOptions().dtype(torch::kDouble).device(device));
+
+	std::vector<std::vector<int64_t>> docs;
+	for (size_t i = 0; i < order.size(); i += opts.batchSize)
+	{
+		const size_t count = std::min(opts.batchSize, order.size() - i);
+
+		docs.resize(count);
+		for (size_t j = 0; j < count; j++)
+		{
+			getDocument(order[i + j], docs[j]);
+			docs[j].resize(effectiveLength(order[i + j]));
+		}
+
+		this->EvaluateBatch(docs, nllSum, res);
+		res.documents += count;
+	}
+
+	if (wasTraining)
+	{
+		model->train();
+	}
+
+	if (res.scoredTokens > 0)
+	{
+		res.nll = nllSum.item<double>() / static_cast<double>(res.scoredTokens);
+		res.perplexity = std::exp(res.nll);
+	}
+
+	MY_LOG_INFO("Perplexity: %.4f (nll %.5f), documents: %llu, scored tokens: %llu, forward tokens: %llu",
+		res.perplexity, res.nll,
+		static_cast<unsigned long long>(res.documents),
+		static_cast<unsigned long long>(res.scoredTokens),
+		static_cast<unsigned long long>(res.forwardTokens));
+
+	return res;
+}
+
+/// <summary>
+/// Documents are sorted by length (descending), so finished documents
+/// are always at the end of batch and are removed by slicing.
+/// First step feeds contextLength tokens, next steps feed stride tokens
+/// with cache of previous (contextLength - stride) tokens
+/// </summary>
+/// <param name="docs"></param>
+/// <param name="nllSum"></param>
+/// <param name="res"></param>
+void PerplexityEvaluator::EvaluateBatch(const std::vector<std::vector<int64_t>>& docs,
+	torch::Tensor& nllSum, Result& res)
+{
+	const int64_t B = static_cast<int64_t>(docs.size());
+	const int64_t maxLen = static_cast<int64_t>(docs[0].size());
+
+	//target i is token i + 1, padding and last token are ignored
+	torch::Tensor tokens = torch::zeros({ B, maxLen }, torch::kLong);
+	torch::Tensor targets = torch::full({ B, maxLen }, IGNORE_TARGET, torch::kLong);
+	{
+		auto tok = tokens.accessor<int64_t, 2>();
+		auto tgt = targets.accessor<int64_t, 2>();
+		for (int64_t b = 0; b < B; b++)
+		{
+			const auto& d = docs[b];
+			for (size_t i = 0; i < d.size(); i++)
+			{
+				tok[b][i] = d[i];
+				if (i > 0)
+				{
+					tgt[b][i - 1] = d[i];
+				}
+			}
+		}
+	}
+
+	auto device = nllSum.device();
+	tokens = tokens.to(device);
+	targets = targets.to(device);
+
+	const int64_t keep = opts.contextLength - opts.stride;
+
+	std::vector<KVCache> cache;
+	int64_t alive = B;
+	int64_t pos = 0;
+
+	while (pos < maxLen - 1)
+	{
+		//document b has targets at [0, length - 1)
+		int64_t newAlive = alive;
+		while (static_cast<int64_t>(docs[newAlive - 1].size()) - 1 <= pos)
+		{
+			newAlive--;
+		}
+		if (newAlive != alive)
+		{
+			alive = newAlive;
+			for (auto& kv : cache)
+			{
+				kv.k = kv.k.slice(0, 0, alive);
+				kv.v = kv.v.slice(0, 0, alive);
+			}
+		}
+
+		const int64_t n = std::min((pos == 0) ? opts.contextLength : opts.stride, maxLen - 1 - pos);
+
+		auto input = tokens.slice(0, 0, alive).slice(1, pos, pos + n);
+		auto out = model->forward_with_cache(input, cache, keep > 0, pos);
+
+		auto logits = out.first;
+		const int64_t V = logits.size(-1);
+		logits = logits.reshape({ -1, V });
+		auto tgt = targets.slice(0, 0, alive).slice(1, pos, pos + n).reshape({ -1 });
+
+		for (int64_t r = 0; r < logits.size(0); r += LOSS_CHUNK_TOKENS)
+		{
+			const int64_t rEnd = std::min(r + LOSS_CHUNK_TOKENS, logits.size(0));
+			auto loss = torch::nn::functional::cross_entropy(
+				logits.slice(0, r, rEnd).to(torch::kFloat),
+				tgt.slice(0, r, rEnd),
+				torch::nn::functional::CrossEntropyFuncOptions()
+					.ignore_index(IGNORE_TARGET)
+					.reduction(torch::kSum));
+			nllSum.add_(loss.to(torch::kDouble));
+		}
+
+		for (int64_t b = 0; b < alive; b++)
+		{
+			const int64_t end = std::min(pos + n, static_cast<int64_t>(docs[b].size()) - 1);
+			res.scoredTokens += static_cast<uint64_t>(std::max<int64_t>(end - pos, 0));
+		}
+		res.forwardTokens += static_cast<uint64_t>(alive * n);
+
+		//keep only keys of the overlapping part of the next window
+		cache = std::move(out.second);
+		for (auto& kv : cache)
+		{
+			const int64_t len = kv.k.size(2);
+			if (len > keep)
+			{
+				kv.k = kv.k.slice(2, len - keep);
+				kv.v = kv.v.slice(2, len - keep);
+			}
+		}
+
+		pos += n;
+	}
+}
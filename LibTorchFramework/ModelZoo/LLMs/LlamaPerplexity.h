@@ -0,0 +1,76 @@
+#ifndef LLAMA_PERPLEXITY_H
+#define LLAMA_PERPLEXITY_H
+
+class TokenShardDataset;
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <functional>
+
+#include <torch/torch.h>
+
+#include "./llama.h"
+
+namespace ModelZoo
+{
+    namespace llama
+    {
+        /// <summary>
+        /// Sliding-window perplexity of long documents.
+        ///
+        /// Every token is predicted from at least (contextLength - stride)
+        /// previous tokens (same as strided evaluation with windows of
+        /// contextLength moved by stride), but overlapping part of window
+        /// is not recomputed - KV cache of the last (contextLength - stride)
+        /// tokens is kept and only stride new tokens are fed to model.
+        /// Each token goes through forward once.
+        ///
+        /// Documents are sorted by length and processed in batches,
+        /// finished documents are dropped from batch. NLL is accumulated
+        /// on device, synchronized once at the end
+        /// </summary>
+        class PerplexityEvaluator
+        {
+        public:
+            struct Options
+            {
+                int64_t contextLength = 2048;
+                int64_t stride = 512;
+                size_t batchSize = 4;
+
+                //longer documents are truncated (RoPE table grows with document length)
+                std::optional<int64_t> maxDocumentLength = std::nullopt;
+            };
+
+            struct Result
+            {
+                double nll = 0.0; //mean negative log-likelihood per scored token
+                double perplexity = 0.0;
+                uint64_t scoredTokens = 0;
+                uint64_t forwardTokens = 0; //tokens passed through model (with padding of shorter documents)
+                uint64_t documents = 0;
+            };
+
+            //fill tokens of document with given index
+            using DocumentCallback = std::function<void(size_t index, std::vector<int64_t>& tokens)>;
+
+            PerplexityEvaluator(std::shared_ptr<LlamaForCausalLM> model, const Options& opts);
+
+            Result Evaluate(const std::vector<std::vector<int64_t>>& documents);
+            Result Evaluate(const TokenShardDataset& dataset, std::optional<size_t> maxDocuments = std::nullopt);
+
+            Result Evaluate(const std::vector<size_t>& lengths, const DocumentCallback& getDocument);
+
+        protected:
+            std::shared_ptr<LlamaForCausalLM> model;
+            Options opts;
+
+            void EvaluateBatch(const std::vector<std::vector<int64_t>>& docs,
+                torch::Tensor& nllSum, Result& res);
+        };
+    }
+}
+
+#endif
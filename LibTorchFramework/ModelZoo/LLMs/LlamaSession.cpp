@@ -0,0 +1,287 @@
+#include "./LlamaSession.h"
+
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include <Utils/Logger.h>
+
+#include "../../core/Snapshot/safetensors.h"
+#include "../../core/Snapshot/AsyncSnapshotSaver.h"
+
+using namespace ModelZoo::llama;
+
+//========================================================================
+
+static std::string DoubleToString(double v)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.17g", v);
+	return buf;
+}
+
+static std::optional<torch::ScalarType> ScalarTypeFromString(const std::string& name)
+{
+	static const std::unordered_map<std::string, torch::ScalarType> types = {
+		{ c10::toString(torch::kFloat32), torch::kFloat32 },
+		{ c10::toString(torch::kFloat16), torch::kFloat16 },
+		{ c10::toString(torch::kBFloat16), torch::kBFloat16 },
+		{ c10::toString(torch::kFloat64), torch::kFloat64 }
+	};
+
+	auto it = types.find(name);
+	if (it == types.end())
+	{
+		return std::nullopt;
+	}
+	return it->second;
+}
+
+//========================================================================
+
+int64_t LlamaSession::GetCachedLength() const
+{
+	if ((kvCache.empty()) || (kvCache[0].defined() == false))
+	{
+		return 0;
+	}
+	return kvCache[0].k.size(2);
+}
+
+void LlamaSession::Clear()
+{
+	kvCache.clear();
+	tokens.clear();
+	lastLogits = torch::Tensor();
+	sampler.rngState = torch::Tensor();
+}
+
+std::string LlamaSession::GetLayerKey(size_t layer, const char* name)
+{
+	return "layers." + std::to_string(layer) + "." + name;
+}
+
+/// <summary>
+/// Symmetric int8 quantization with one scale per last-dim vector
+/// (one head of one token)
+/// </summary>
+/// <param name="x"></param>
+/// <returns>codes (int8), scale (float32)</returns>
+std::pair<torch::Tensor, torch::Tensor> LlamaSession::QuantizeInt8(const torch::Tensor& x)
+{
+	auto xf = x.detach().to(torch::kFloat32);
+	auto scale = xf.abs().amax(-1, true).clamp_min(1e-12) / 127.0;
+	auto codes = torch::round(xf / scale).clamp(-127, 127).to(torch::kInt8);
+	return { codes, scale };
+}
+
+torch::Tensor LlamaSession::DequantizeInt8(const torch::Tensor& codes, const torch::Tensor& scale,
+	torch::Device device, torch::ScalarType dtype)
+{
+	//dequantize on target device - only int8 data are transfered
+	auto c = codes.to(device).to(torch::kFloat32);
+	auto s = scale.to(device, torch::kFloat32);
+	return (c * s).to(dtype).contiguous();
+}
+
+//========================================================================
+
+/// <summary>
+/// Save session to safetensors file
+/// File is written to temporary path, flushed to disk and renamed
+/// </summary>
+/// <param name="path"></param>
+/// <param name="cfg">config of model that produced the cache</param>
+/// <param name="storage"></param>
+/// <returns></returns>
+bool LlamaSession::Save(const std::string& path, const LlamaConfig& cfg, StorageType storage) const
+{
+	if (kvCache.size() != static_cast<size_t>(cfg.num_hidden_layers))
+	{
+		MY_LOG_ERROR("Session has %zu cache layers, model has %lld", kvCache.size(), 
+			static_cast<long long>(cfg.num_hidden_layers));
+		return false;
+	}
+
+	torch::NoGradGuard noGrad;
+
+	const int64_t kvHeads = cfg.num_key_value_heads.value_or(cfg.num_attention_heads);
+	const int64_t headDim = cfg.hidden_size / cfg.num_attention_heads;
+
+	safetensors::SafeTensorManager::TensorMap tensors;
+	torch::ScalarType kvType = torch::kFloat32;
+
+	for (size_t i = 0; i < kvCache.size(); i++)
+	{
+		const auto& c = kvCache[i];
+		if (c.defined() == false)
+		{
+			MY_LOG_ERROR("Session cache layer %zu is empty", i);
+			return false;
+		}
+
+		kvType = c.k.scalar_type();
+
+		if (storage == StorageType::INT8)
+		{
+			auto [kq, ks] = QuantizeInt8(c.k);
+			auto [vq, vs] = QuantizeInt8(c.v);
+			tensors.try_emplace(GetLayerKey(i, "k.q"), kq);
+			tensors.try_emplace(GetLayerKey(i, "k.scale"), ks);
+			tensors.try_emplace(GetLayerKey(i, "v.q"), vq);
+			tensors.try_emplace(GetLayerKey(i, "v.scale"), vs);
+		}
+		else
+		{
+			tensors.try_emplace(GetLayerKey(i, "k"), c.k.detach());
+			tensors.try_emplace(GetLayerKey(i, "v"), c.v.detach());
+		}
+	}
+
+	if (tokens.empty() == false)
+	{
+		tensors.try_emplace("tokens", torch::from_blob(const_cast<int64_t*>(tokens.data()),
+			{ static_cast<int64_t>(tokens.size()) }, torch::kInt64));
+	}
+	if (lastLogits.defined())
+	{
+		tensors.try_emplace("logits", lastLogits.detach());
+	}
+	if (sampler.rngState.defined())
+	{
+		tensors.try_emplace("sampler.rng", sampler.rngState);
+	}
+
+	std::unordered_map<std::string, std::string> metadata = {
+		{"format", "pt"},
+		{"session", "llama"},
+		{"layers", std::to_string(cfg.num_hidden_layers)},
+		{"kv_heads", std::to_string(kvHeads)},
+		{"head_dim", std::to_string(headDim)},
+		{"cached_len", std::to_string(this->GetCachedLength())},
+		{"kv_dtype", c10::toString(kvType)},
+		{"storage", (storage == StorageType::INT8) ? "int8" : "native"},
+		{"temperature", DoubleToString(sampler.temperature)},
+		{"top_k", std::to_string(sampler.top_k)},
+		{"top_p", DoubleToString(sampler.top_p)},
+		{"repetition_penalty", DoubleToString(sampler.repetition_penalty)}
+	};
+
+	std::string tmpPath = path + ".tmp";
+	try
+	{
+		safetensors::SafeTensorManager sm;
+		sm.Save(tensors, tmpPath, metadata);
+
+		AsyncSnapshotSaver::FlushFileToDisk(tmpPath);
+
+		std::filesystem::rename(tmpPath, path);
+	}
+	catch (const std::exception& e)
+	{
+		MY_LOG_ERROR("Failed to save session '%s': %s", path.c_str(), e.what());
+
+		std::error_code ec;
+		std::filesystem::remove(tmpPath, ec);
+		return false;
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Load session from file. File is memory mapped and KV tensors
+/// are copied directly to target device - no recomputation
+/// </summary>
+/// <param name="path"></param>
+/// <param name="cfg">config of model that will continue the session</param>
+/// <param name="device">device of the model</param>
+/// <param name="dtype">dtype of KV cache, if not set - dtype of saved cache</param>
+/// <returns></returns>
+bool LlamaSession::Load(const std::string& path, const LlamaConfig& cfg,
+	torch::Device device,
+	std::optional<torch::ScalarType> dtype)
+{
+	this->Clear();
+
+	try
+	{
+		safetensors::SafeTensorFile f(path);
+
+		const auto& metadata = f.GetMetadata();
+		auto getMeta = [&](const std::string& key) -> std::string {
+			auto it = metadata.find(key);
+			if (it == metadata.end())
+			{
+				throw std::runtime_error("missing metadata '" + key + "'");
+			}
+			return it->second;
+		};
+
+		const int64_t kvHeads = cfg.num_key_value_heads.value_or(cfg.num_attention_heads);
+		const int64_t headDim = cfg.hidden_size / cfg.num_attention_heads;
+
+		if ((std::stoll(getMeta("layers")) != cfg.num_hidden_layers) ||
+			(std::stoll(getMeta("kv_heads")) != kvHeads) ||
+			(std::stoll(getMeta("head_dim")) != headDim))
+		{
+			MY_LOG_ERROR("Session '%s' was created by different model", path.c_str());
+			return false;
+		}
+
+		bool quantized = (getMeta("storage") == "int8");
+		torch::ScalarType kvType = dtype.value_or(ScalarTypeFromString(getMeta("kv_dtype")).value_or(torch::kFloat32));
+
+		torch::NoGradGuard noGrad;
+
+		kvCache.reserve(static_cast<size_t>(cfg.num_hidden_layers));
+		for (size_t i = 0; i < static_cast<size_t>(cfg.num_hidden_layers); i++)
+		{
+			torch::Tensor k;
+			torch::Tensor v;
+			if (quantized)
+			{
+				k = DequantizeInt8(f.GetTensorView(GetLayerKey(i, "k.q")), f.GetTensorView(GetLayerKey(i, "k.scale")),
+					device, kvType);
+				v = DequantizeInt8(f.GetTensorView(GetLayerKey(i, "v.q")), f.GetTensorView(GetLayerKey(i, "v.scale")),
+					device, kvType);
+			}
+			else
+			{
+				//copy = true - views are backed by read-only mapping
+				k = f.GetTensorView(GetLayerKey(i, "k")).to(device, kvType, false, true);
+				v = f.GetTensorView(GetLayerKey(i, "v")).to(device, kvType, false, true);
+			}
+			kvCache.emplace_back(k, v);
+		}
+
+		if (f.Contains("tokens"))
+		{
+			auto t = f.GetTensorView("tokens").to(torch::kInt64).contiguous();
+			const int64_t* ptr = t.data_ptr<int64_t>();
+			tokens.assign(ptr, ptr + t.numel());
+		}
+		if (f.Contains("logits"))
+		{
+			lastLogits = f.GetTensorView("logits").to(device, torch::kFloat32, false, true);
+		}
+		if (f.Contains("sampler.rng"))
+		{
+			sampler.rngState = f.GetTensor("sampler.rng");
+		}
+
+		sampler.temperature = std::stod(getMeta("temperature"));
+		sampler.top_k = std::stoll(getMeta("top_k"));
+		sampler.top_p = std::stod(getMeta("top_p"));
+		sampler.repetition_penalty = std::stod(getMeta("repetition_penalty"));
+	}
+	catch (const std::exception& e)
+	{
+		MY_LOG_ERROR("Failed to load session '%s': %s", path.c_str(), e.what());
+		this->Clear();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,81 @@
+#ifndef LLAMA_SESSION_H
+#define LLAMA_SESSION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <optional>
+
+#include <torch/torch.h>
+
+#include "./llama.h"
+
+namespace ModelZoo
+{
+    namespace llama
+    {
+        struct SamplerState
+        {
+            double temperature = 0.8;
+            int64_t top_k = 40;
+            double top_p = 0.9;
+            double repetition_penalty = 1.15;
+
+            //state of generator used for sampling (uint8 tensor from Generator::get_state)
+            //if not defined, default generator is used
+            torch::Tensor rngState;
+        };
+
+        /// <summary>
+        /// Generation session - per-layer KV cache, token history
+        /// and sampler state, that can be stored to file and restored
+        /// later without prefill of the whole history.
+        ///
+        /// File is safetensors (mmap-able, tensors are copied from
+        /// mapped file directly to target device). KV cache can be
+        /// optionally stored quantized to int8 with per-token scale
+        /// </summary>
+        class LlamaSession
+        {
+        public:
+            enum class StorageType
+            {
+                NATIVE, //KV tensors as they are in memory
+                INT8    //int8 codes + float scale per (head, token) vector
+            };
+
+            std::vector<KVCache> kvCache;
+
+            //all tokens of session (prompt + generated)
+            //can be longer than cache, if last token was not yet processed
+            std::vector<int64_t> tokens;
+
+            //logits of last processed position (V), optional
+            torch::Tensor lastLogits;
+
+            SamplerState sampler;
+
+            LlamaSession() = default;
+            ~LlamaSession() = default;
+
+            int64_t GetCachedLength() const;
+            void Clear();
+
+            bool Save(const std::string& path, const LlamaConfig& cfg,
+                StorageType storage = StorageType::NATIVE) const;
+
+            bool Load(const std::string& path, const LlamaConfig& cfg,
+                torch::Device device,
+                std::optional<torch::ScalarType> dtype = std::nullopt);
+
+        protected:
+            static std::string GetLayerKey(size_t layer, const char* name);
+
+            static std::pair<torch::Tensor, torch::Tensor> QuantizeInt8(const torch::Tensor& x);
+            static torch::Tensor DequantizeInt8(const torch::Tensor& codes, const torch::Tensor& scale,
+                torch::Device device, torch::ScalarType dtype);
+        };
+    }
+}
+
+#endif
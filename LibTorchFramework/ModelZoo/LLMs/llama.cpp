@@ -172,7 +172,7 @@ torch::Tensor AttentionImpl::apply_rope(const torch::Tensor& x,
 	const torch::Tensor& cos, const torch::Tensor& sin,
 	int startPos)
 {
-	// x: (B, T, H, D), cos/sin: (T, D/2)	
+	// x: (B, T, H, D), cos/sin: (T, D/2) or per-token (B, T, D/2)
 	const auto B = x.size(0);
 	const auto T = x.size(1);
 	const auto H = x.size(2);
@@ -182,8 +182,19 @@ torch::Tensor AttentionImpl::apply_rope(const torch::Tensor& x,
 	auto x1 = x_.select(-1, 0);
 	auto x2 = x_.select(-1, 1);
 
-	auto cos_t = cos.slice(0, startPos, startPos + T).unsqueeze(0).unsqueeze(2);
-	auto sin_t = sin.slice(0, startPos, startPos + T).unsqueeze(0).unsqueeze(2);
+	torch::Tensor cos_t;
+	torch::Tensor sin_t;
+	if (cos.dim() == 3)
+	{
+		//already gathered for position ids of each token
+		cos_t = cos.unsqueeze(2);
+		sin_t = sin.unsqueeze(2);
+	}
+	else
+	{
+		cos_t = cos.slice(0, startPos, startPos + T).unsqueeze(0).unsqueeze(2);
+		sin_t = sin.slice(0, startPos, startPos + T).unsqueeze(0).unsqueeze(2);
+	}
 
 
 	auto y1 = x1 * cos_t - x2 * sin_t;
@@ -228,25 +239,8 @@ std::pair<torch::Tensor, std::optional<KVCache>> AttentionImpl::forward(
 		present_kv = KVCache{ k, v };
 	}
 
-	torch::Tensor k_attn = k;
-	torch::Tensor v_attn = v;
-
-	if (n_kv_heads != n_heads) 
-	{
-		const auto repeat = n_heads / n_kv_heads;
-		
-		//k = k.repeat_interleave(repeat, 1);
-		//v = v.repeat_interleave(repeat, 1);
-
-		// cheaper logical expand than repeat_interleave materialization
-		k_attn = k.unsqueeze(2)
-			.expand({ B, n_kv_heads, repeat, k.size(2), head_dim })
-			.reshape({ B, n_heads, k.size(2), head_dim });
-
-		v_attn = v.unsqueeze(2)
-			.expand({ B, n_kv_heads, repeat, v.size(2), head_dim })
-			.reshape({ B, n_heads, v.size(2), head_dim });
-	}
+	torch::Tensor k_attn = this->expand_kv_heads(k);
+	torch::Tensor v_attn = this->expand_kv_heads(v);
 
 	auto att = torch::matmul(q, k_attn.transpose(-2, -1));
 	att.mul_(1.0 / std::sqrt(static_cast<double>(head_dim)));
@@ -271,6 +265,82 @@ std::pair<torch::Tensor, std::optional<KVCache>> AttentionImpl::forward(
 	return { o_proj.forward(out), present_kv };
 }
 
+/// <summary>
+/// Attention of packed sequences (training, no KV cache).
+/// cos/sin are per-token (B, T, D/2), gathered by position ids
+/// </summary>
+/// <param name="x"></param>
+/// <param name="cos"></param>
+/// <param name="sin"></param>
+/// <param name="mask"></param>
+/// <returns></returns>
+torch::Tensor AttentionImpl::forward_packed(const torch::Tensor& x,
+	const torch::Tensor& cos, const torch::Tensor& sin,
+	const PackedAttentionMask& mask)
+{
+	const auto B = x.size(0);
+	const auto T = x.size(1);
+
+	auto q = q_proj.forward(x).view({ B, T, n_heads, head_dim });
+	auto k = k_proj.forward(x).view({ B, T, n_kv_heads, head_dim });
+	auto v = v_proj.forward(x).view({ B, T, n_kv_heads, head_dim });
+
+	q = this->apply_rope(q, cos, sin).transpose(1, 2);  // (B, H, T, D)
+	k = this->apply_rope(k, cos, sin).transpose(1, 2);  // (B, H_kv, T, D)
+	v = v.transpose(1, 2);  // (B, H_kv, T, D)
+
+	auto k_attn = this->expand_kv_heads(k);
+	auto v_attn = this->expand_kv_heads(v);
+
+	const double scale = 1.0 / std::sqrt(static_cast<double>(head_dim));
+
+	std::vector<torch::Tensor> outs;
+	outs.reserve(mask.tiles.size());
+
+	for (const auto& tile : mask.tiles)
+	{
+		auto q_t = q.slice(2, tile.q_begin, tile.q_end);
+		auto k_t = k_attn.slice(2, tile.k_begin, tile.q_end);
+		auto v_t = v_attn.slice(2, tile.k_begin, tile.q_end);
+
+		auto att = torch::matmul(q_t, k_t.transpose(-2, -1));
+		att.mul_(scale);
+		att.add_(tile.mask);
+		att = torch::softmax(att, -1);
+		outs.push_back(torch::matmul(att, v_t));
+	}
+
+	auto out = (outs.size() == 1) ? outs[0] : torch::cat(outs, 2);
+	out = out.transpose(1, 2).reshape({ B, T, n_heads * head_dim });
+
+	return o_proj.forward(out);
+}
+
+/// <summary>
+/// Repeat kv heads to match query heads (GQA)
+/// x: (B, H_kv, T, D) -> (B, H, T, D)
+/// </summary>
+/// <param name="x"></param>
+/// <returns></returns>
+torch::Tensor AttentionImpl::expand_kv_heads(const torch::Tensor& x) const
+{
+	if (n_kv_heads == n_heads)
+	{
+		return x;
+	}
+
+	const auto B = x.size(0);
+	const auto T = x.size(2);
+	const auto repeat = n_heads / n_kv_heads;
+
+	//x.repeat_interleave(repeat, 1);
+
+	// cheaper logical expand than repeat_interleave materialization
+	return x.unsqueeze(2)
+		.expand({ B, n_kv_heads, repeat, T, head_dim })
+		.reshape({ B, n_heads, T, head_dim });
+}
+
 
 //========================================================================
 
@@ -299,6 +369,15 @@ std::pair<torch::Tensor, std::optional<KVCache>> BlockImpl::forward(const torch:
 	return { h, attn_out.second };
 }
 
+torch::Tensor BlockImpl::forward_packed(const torch::Tensor& x,
+	const torch::Tensor& cos, const torch::Tensor& sin,
+	const PackedAttentionMask& mask)
+{
+	auto h = x + attn->forward_packed(attn_norm(x), cos, sin, mask);
+	h = h + mlp(ffn_norm(h));
+	return h;
+}
+
 //========================================================================
 
 LlamaForCausalLM::LlamaForCausalLM(const LlamaConfig& cfg) :
@@ -383,6 +462,60 @@ torch::Tensor LlamaForCausalLM::get_attn_mask(int64_t q_len, int64_t k_len,
 	return m.view({ 1, 1, q_len, k_len });
 }
 
+/// <summary>
+/// Tiles of block-diagonal causal mask for packed rows.
+/// Document of token t starts at t - position_ids[t], so tile of queries
+/// needs keys only from the start of document of its first query.
+/// Positions are copied to CPU once per forward to plan the tiles
+/// </summary>
+/// <param name="position_ids">(B, T)</param>
+/// <param name="document_ids">(B, T)</param>
+/// <param name="dtype"></param>
+/// <returns></returns>
+PackedAttentionMask LlamaForCausalLM::get_packed_attn_mask(const torch::Tensor& position_ids,
+	const torch::Tensor& document_ids, torch::ScalarType dtype)
+{
+	constexpr float minValue = std::numeric_limits<float>::lowest();
+
+	const auto B = position_ids.size(0);
+	const auto T = position_ids.size(1);
+
+	auto posCpu = position_ids.to(torch::kCPU, torch::kLong).contiguous();
+	auto pos = posCpu.accessor<int64_t, 2>();
+
+	auto docs = document_ids.to(tOptDevice.device(), torch::kLong);
+	auto idx = torch::arange(T, tOptDevice.dtype(torch::kLong));
+
+	PackedAttentionMask res;
+	for (int64_t q_begin = 0; q_begin < T; q_begin += PACKED_ATTENTION_TILE)
+	{
+		PackedAttentionMask::Tile tile;
+		tile.q_begin = q_begin;
+		tile.q_end = std::min(T, q_begin + PACKED_ATTENTION_TILE);
+		tile.k_begin = q_begin;
+		for (int64_t b = 0; b < B; b++)
+		{
+			tile.k_begin = std::min(tile.k_begin, q_begin - pos[b][q_begin]);
+		}
+		tile.k_begin = std::max<int64_t>(tile.k_begin, 0);
+
+		auto q_doc = docs.slice(1, tile.q_begin, tile.q_end).unsqueeze(2);
+		auto k_doc = docs.slice(1, tile.k_begin, tile.q_end).unsqueeze(1);
+		auto q_idx = idx.slice(0, tile.q_begin, tile.q_end).view({ 1, -1, 1 });
+		auto k_idx = idx.slice(0, tile.k_begin, tile.q_end).view({ 1, 1, -1 });
+
+		auto allowed = (q_doc == k_doc).logical_and_(k_idx <= q_idx);
+
+		tile.mask = torch::zeros({ B, tile.q_end - tile.q_begin, tile.q_end - tile.k_begin }, tOptDevice.dtype(dtype))
+			.masked_fill_(allowed.logical_not(), minValue)
+			.unsqueeze(1);
+
+		res.tiles.push_back(std::move(tile));
+	}
+
+	return res;
+}
+
 
 std::pair<torch::Tensor, torch::Tensor> LlamaForCausalLM::precompute_rope_frequencies(
 	int64_t dim,
@@ -426,10 +559,22 @@ torch::Tensor LlamaForCausalLM::forward(const torch::Tensor& input_ids)
 	return forward_with_cache(input_ids, {}, false).first;
 }
 
+/// <summary>
+/// Forward with optional KV cache.
+/// position is RoPE position of the first input token, default is cache length.
+/// Cache trimmed by caller (sliding window) keeps keys rotated at their
+/// original positions, so position must continue from them
+/// </summary>
+/// <param name="input_ids">(B, T)</param>
+/// <param name="past_key_values"></param>
+/// <param name="use_cache"></param>
+/// <param name="position"></param>
+/// <returns></returns>
 std::pair<torch::Tensor, std::vector<KVCache>> LlamaForCausalLM::forward_with_cache(
 	const torch::Tensor& input_ids,
 	const std::vector<KVCache>& past_key_values,
-	bool use_cache)
+	bool use_cache,
+	std::optional<int64_t> position)
 {
 	auto device = input_ids.device();
 	tOptDevice = torch::TensorOptions().device(device);
@@ -447,10 +592,12 @@ std::pair<torch::Tensor, std::vector<KVCache>> LlamaForCausalLM::forward_with_ca
 		past_len = past_key_values[0].k.size(2);
 	}
 
+	const int64_t start_pos = position.value_or(past_len);
+
 	auto x = tok_emb(input_ids);
 	auto total_k_len = past_len + T;
 	auto attn_mask = get_attn_mask(T, total_k_len, x.scalar_type(), past_len);
-	auto rope = get_rope(total_k_len, x.scalar_type());
+	auto rope = get_rope(start_pos + T, x.scalar_type());
 
 	std::vector<KVCache> next_past;
 	if (use_cache)
@@ -467,7 +614,7 @@ std::pair<torch::Tensor, std::vector<KVCache>> LlamaForCausalLM::forward_with_ca
 		}
 
 		auto layer = layers[layer_i]->as<Block>();
-		auto layer_out = layer->forward(x, rope.first, rope.second, attn_mask, layer_past, use_cache, past_len);
+		auto layer_out = layer->forward(x, rope.first, rope.second, attn_mask, layer_past, use_cache, start_pos);
 		x = layer_out.first;
 		if (use_cache)
 		{
@@ -483,8 +630,54 @@ std::pair<torch::Tensor, std::vector<KVCache>> LlamaForCausalLM::forward_with_ca
 
 
 
+/// <summary>
+/// Forward of packed rows (several documents in one row).
+/// RoPE positions restart at each document and attention
+/// is block-diagonal causal
+/// </summary>
+/// <param name="input_ids">(B, T)</param>
+/// <param name="position_ids">(B, T)</param>
+/// <param name="document_ids">(B, T)</param>
+/// <returns></returns>
+torch::Tensor LlamaForCausalLM::forward_packed(const torch::Tensor& input_ids,
+	const torch::Tensor& position_ids,
+	const torch::Tensor& document_ids)
+{
+	auto device = input_ids.device();
+	tOptDevice = torch::TensorOptions().device(device);
+
+	const auto B = input_ids.size(0);
+	const auto T = input_ids.size(1);
+
+	auto x = tok_emb(input_ids);
+
+	//positions within row are < T
+	auto rope = get_rope(T, x.scalar_type());
+	auto pos = position_ids.to(device, torch::kLong).reshape({ -1 });
+	auto cos = rope.first.index_select(0, pos).view({ B, T, -1 });
+	auto sin = rope.second.index_select(0, pos).view({ B, T, -1 });
+
+	auto mask = get_packed_attn_mask(position_ids, document_ids, x.scalar_type());
+
+	for (int64_t layer_i = 0; layer_i < cfg.num_hidden_layers; ++layer_i)
+	{
+		auto layer = layers[layer_i]->as<Block>();
+		x = layer->forward_packed(x, cos, sin, mask);
+	}
+
+	x = norm(x);
+	return lm_head(x);
+}
+
 std::vector<torch::Tensor> LlamaForCausalLM::RunForward(DataLoaderData& batch)
 {
+	auto posIt = batch.additionalData.find("position_ids");
+	auto docIt = batch.additionalData.find("document_ids");
+	if ((posIt != batch.additionalData.end()) && (docIt != batch.additionalData.end()))
+	{
+		return { this->forward_packed(batch.input, posIt->second, docIt->second) };
+	}
+
 	auto x = this->forward(batch.input);
 
 	return { x };
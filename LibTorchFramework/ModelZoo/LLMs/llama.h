@@ -43,6 +43,27 @@ namespace ModelZoo
             }
         };
 
+        /// <summary>
+        /// Block-diagonal causal attention of packed sequences,
+        /// split to query tiles. Each tile attends only to keys
+        /// from the start of its first document, mask is created per tile
+        /// (no dense T x T mask)
+        /// </summary>
+        struct PackedAttentionMask
+        {
+            struct Tile
+            {
+                int64_t q_begin;
+                int64_t q_end;
+                int64_t k_begin; //keys are [k_begin, q_end)
+                torch::Tensor mask; //(B, 1, q_end - q_begin, q_end - k_begin)
+            };
+
+            std::vector<Tile> tiles;
+        };
+
+        //========================================================================
+
         struct RMSNormImpl : torch::nn::Module 
         {
         public:            
@@ -90,6 +111,10 @@ namespace ModelZoo
                 bool use_cache = false,
                 int64_t cache_position = 0);
 
+            torch::Tensor forward_packed(const torch::Tensor& x,
+                const torch::Tensor& cos, const torch::Tensor& sin,
+                const PackedAttentionMask& mask);
+
         protected:            
             int64_t n_heads;
             int64_t n_kv_heads;
@@ -102,6 +127,8 @@ namespace ModelZoo
             torch::Tensor apply_rope(const torch::Tensor& x, 
                 const torch::Tensor& cos, const torch::Tensor& sin,
                 int startPos = 0);
+
+            torch::Tensor expand_kv_heads(const torch::Tensor& x) const;
         };
         TORCH_MODULE(Attention);
 
@@ -123,6 +150,10 @@ namespace ModelZoo
                 bool use_cache = false, 
                 int64_t cache_position = 0);
 
+            torch::Tensor forward_packed(const torch::Tensor& x,
+                const torch::Tensor& cos, const torch::Tensor& sin,
+                const PackedAttentionMask& mask);
+
         private:
             RMSNorm attn_norm{ nullptr };
             RMSNorm ffn_norm{ nullptr };
@@ -168,6 +199,8 @@ namespace ModelZoo
             const LlamaConfig& GetConfig() const;
 
             torch::Tensor get_attn_mask(int64_t q_len, int64_t k_len, torch::ScalarType dtype, int64_t past_len = 0);
+            PackedAttentionMask get_packed_attn_mask(const torch::Tensor& position_ids, const torch::Tensor& document_ids,
+                torch::ScalarType dtype);
             std::pair<torch::Tensor, torch::Tensor> get_rope(int64_t T, torch::ScalarType dtype);
 
             std::vector<torch::Tensor> RunForward(DataLoaderData& batch) override;
@@ -176,9 +209,16 @@ namespace ModelZoo
 
             std::pair<torch::Tensor, std::vector<KVCache>> forward_with_cache(const torch::Tensor& input_ids, 
                 const std::vector<KVCache>& past_key_values,
-                bool use_cache);
+                bool use_cache,
+                std::optional<int64_t> position = std::nullopt);
+
+            torch::Tensor forward_packed(const torch::Tensor& input_ids,
+                const torch::Tensor& position_ids,
+                const torch::Tensor& document_ids);
 
         protected:
+            static constexpr int64_t PACKED_ATTENTION_TILE = 256;
+
             LlamaConfig cfg;            
                                                       
             torch::TensorOptions tOptDevice;
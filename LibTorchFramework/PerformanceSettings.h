@@ -25,8 +25,31 @@ struct PerformanceSettings
 	bool useNonBlockingTransfers = true;
 
 	//use pin memory for InputLoaders
+	//(batch buffers of pool are pinned if device is CUDA)
 	bool usePinMemory = true;
 
+	//collate batches into reusable buffers (BatchBufferPool)
+	//instead of allocating new tensors for every batch
+	bool useBatchBufferPool = true;
+
+	//data loader - batches requested ahead per worker (Settings::numWorkers)
+	size_t loaderPrefetchDepth = 2;
+
+	//data loader - return batches in sampler order
+	//if false, batch of whichever worker finished first is returned
+	bool loaderEnforceOrdering = false;
+
+	//batches taken from data loader and moved to device ahead on helper thread
+	//while current batch is processed, 0 = no prefetch (load and process in sequence)
+	size_t batchPrefetchDepth = 2;
+
+	//write model snapshots on background thread
+	//training waits only for copy of tensors to host staging buffers
+	bool useAsyncSnapshots = true;
+
+	//max number of snapshots being written at once (limits host memory)
+	size_t asyncSnapshotsInFlight = 2;
+
 	//todo
 	//std::shared_ptr<AbstractProfiler> profiler = nullptr;
 
@@ -27,6 +27,15 @@ struct Settings
 	size_t batchSize = 3;
 
 	size_t numWorkers = 0;
+
+	//if set, samples are grouped by shape (InputLoader::GetSampleShape) into batches
+	//with at most maxBatchTokens elements (tokens, pixels...) including padding
+	//batchSize is then max number of samples in batch
+	std::optional<size_t> maxBatchTokens = std::nullopt;
+
+	//streaming datasets (StreamingDataset) - batches per epoch, stream continues
+	//over epochs and shards are repeated. If not set, epoch is one pass over stream
+	std::optional<size_t> epochSteps = std::nullopt;
 	
 	LossFnCallback lossFn = nullptr;
 
@@ -42,6 +51,11 @@ struct Settings
 
 	std::optional<int> gradientAccumulationCount = std::nullopt;
 
+	//if set, training state (weights, optimizer, RNG, processed batches) is saved
+	//every N batches (0 = only at the end of epoch) and training is resumed
+	//from existing state. Requires pretrainedManager, not used by default
+	std::optional<size_t> trainingStateInterval = std::nullopt;
+
 	Settings()
 	{		
 	}
@@ -0,0 +1,724 @@
+//=========================================================
+// Offline corpus tokenization into token shards
+//
+// Usage:
+//   TokenizeCorpus --tokenizer <tokenizer.json | compiled file> --out <dir>
+//       [--shard-tokens N] [--dtype auto|uint16|uint32] [--batch-mb MB]
+//       [--text-field text] [--txt-mode line|file] [--bos] [--no-eos]
+//       [--threads N] [--overwrite] <files or directories>...
+//
+// Directories are searched recursively for *.txt, *.md and *.jsonl files.
+// Each line of .jsonl is one document (string field --text-field),
+// text files are one document per non-empty line (or one per file).
+//
+// Output directory contains shard_XXXXX.bin files (see TokenShardFile)
+// and manifest.json. Manifest is updated after each finished shard,
+// so interrupted run continues from the last finished shard
+// when started again with the same arguments
+//=========================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Utils/cJSON.h>
+
+#include "../core/Tokenizers/TokenizerBPE.h"
+#include "../core/Tokenizers/TokenShardFile.h"
+#include "../Utils/ThreadPool.h"
+
+namespace
+{
+	const char* MANIFEST_NAME = "manifest.json";
+	const char* MANIFEST_FORMAT = "token_shards";
+	constexpr int MANIFEST_VERSION = 1;
+
+	using Clock = std::chrono::steady_clock;
+
+	struct CorpusSettings
+	{
+		std::string tokenizerPath;
+		std::string outDir;
+		std::vector<std::string> inputs;
+
+		uint64_t shardTokens = 100'000'000;
+		std::string dtype = "auto";
+		size_t batchMb = 32;
+		std::string textField = "text";
+		std::string txtMode = "line";
+		bool addBos = false;
+		bool addEos = true;
+		size_t threads = 0; //0 - hardware concurrency
+		bool overwrite = false;
+	};
+
+	struct InputFile
+	{
+		std::string path;
+		uint64_t size = 0;
+		bool jsonl = false;
+	};
+
+	struct ShardInfo
+	{
+		std::string file;
+		uint64_t tokens = 0;
+		uint64_t documents = 0;
+	};
+
+	/// <summary>
+	/// Position of the first document not yet stored in finished shard
+	/// </summary>
+	struct ResumePosition
+	{
+		size_t input = 0;
+		uint64_t offset = 0;
+	};
+
+	struct Manifest
+	{
+		std::string settingsJson; //unformatted JSON, compared on resume
+		std::vector<ShardInfo> shards;
+		ResumePosition resume;
+		uint64_t skippedDocuments = 0;
+		bool complete = false;
+	};
+
+	//=========================================================
+
+	CorpusSettings ParseArgs(int argc, char** argv)
+	{
+		CorpusSettings s;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string a = argv[i];
+			auto next = [&]() -> const char* {
+				if (i + 1 >= argc)
+				{
+					throw std::runtime_error("Missing value for " + a);
+				}
+				return argv[++i];
+			};
+
+			if (a == "--tokenizer") s.tokenizerPath = next();
+			else if (a == "--out") s.outDir = next();
+			else if (a == "--shard-tokens") s.shardTokens = std::strtoull(next(), nullptr, 10);
+			else if (a == "--dtype") s.dtype = next();
+			else if (a == "--batch-mb") s.batchMb = std::strtoull(next(), nullptr, 10);
+			else if (a == "--text-field") s.textField = next();
+			else if (a == "--txt-mode") s.txtMode = next();
+			else if (a == "--bos") s.addBos = true;
+			else if (a == "--no-eos") s.addEos = false;
+			else if (a == "--threads") s.threads = std::strtoull(next(), nullptr, 10);
+			else if (a == "--overwrite") s.overwrite = true;
+			else s.inputs.push_back(a);
+		}
+
+		if ((s.tokenizerPath.empty()) || (s.outDir.empty()) || (s.inputs.empty()))
+		{
+			throw std::runtime_error("Usage: TokenizeCorpus --tokenizer <path> --out <dir> [--shard-tokens N] "
+				"[--dtype auto|uint16|uint32] [--batch-mb MB] [--text-field text] [--txt-mode line|file] "
+				"[--bos] [--no-eos] [--threads N] [--overwrite] <files or directories>...");
+		}
+		if ((s.dtype != "auto") && (s.dtype != "uint16") && (s.dtype != "uint32"))
+		{
+			throw std::runtime_error("Unknown dtype: " + s.dtype);
+		}
+		if ((s.txtMode != "line") && (s.txtMode != "file"))
+		{
+			throw std::runtime_error("Unknown txt mode: " + s.txtMode);
+		}
+		if (s.shardTokens == 0)
+		{
+			throw std::runtime_error("--shard-tokens must be greater than 0");
+		}
+		s.batchMb = std::max<size_t>(s.batchMb, 1);
+
+		return s;
+	}
+
+	bool IsJsonl(const std::filesystem::path& p)
+	{
+		return (p.extension() == ".jsonl");
+	}
+
+	bool IsSupportedExtension(const std::filesystem::path& p)
+	{
+		auto ext = p.extension();
+		return (ext == ".txt") || (ext == ".md") || (ext == ".jsonl");
+	}
+
+	/// <summary>
+	/// Expand directories and sort files, so order (and resume positions)
+	/// do not depend on file system enumeration order
+	/// </summary>
+	std::vector<InputFile> CollectInputs(const std::vector<std::string>& inputs)
+	{
+		std::vector<std::filesystem::path> paths;
+		for (const auto& in : inputs)
+		{
+			std::filesystem::path p(in);
+			if (std::filesystem::is_directory(p))
+			{
+				for (const auto& e : std::filesystem::recursive_directory_iterator(p))
+				{
+					if ((e.is_regular_file()) && (IsSupportedExtension(e.path())))
+					{
+						paths.push_back(e.path());
+					}
+				}
+			}
+			else if (std::filesystem::is_regular_file(p))
+			{
+				paths.push_back(p);
+			}
+			else
+			{
+				throw std::runtime_error("Input not found: " + in);
+			}
+		}
+
+		std::sort(paths.begin(), paths.end());
+		paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+		std::vector<InputFile> files;
+		for (const auto& p : paths)
+		{
+			InputFile f;
+			f.path = p.generic_string();
+			f.size = std::filesystem::file_size(p);
+			f.jsonl = IsJsonl(p);
+			files.push_back(f);
+		}
+		return files;
+	}
+
+	//=========================================================
+	// Reading documents
+	//=========================================================
+
+	/// <summary>
+	/// Documents and byte position in file after each of them
+	/// </summary>
+	struct DocumentBatch
+	{
+		std::vector<StringUtf8> docs;
+		std::vector<uint64_t> ends;
+		uint64_t bytes = 0;
+		uint64_t skipped = 0;
+	};
+
+	class DocumentReader
+	{
+	public:
+		DocumentReader(const InputFile& input, uint64_t offset, const CorpusSettings& settings) :
+			input(input),
+			settings(settings),
+			f(input.path, std::ios::binary),
+			position(offset)
+		{
+			if (!f)
+			{
+				throw std::runtime_error("Failed to open: " + input.path);
+			}
+			f.seekg(static_cast<std::streamoff>(offset));
+		}
+
+		/// <summary>
+		/// Read documents with total size about maxBytes.
+		/// Empty batch means end of file
+		/// </summary>
+		DocumentBatch ReadBatch(size_t maxBytes)
+		{
+			DocumentBatch batch;
+
+			if ((!input.jsonl) && (settings.txtMode == "file"))
+			{
+				this->ReadWholeFile(batch);
+				return batch;
+			}
+
+			std::string line;
+			while ((batch.bytes < maxBytes) && (std::getline(f, line)))
+			{
+				const uint64_t lineBytes = line.size() + (f.eof() ? 0 : 1);
+				this->position += lineBytes;
+				batch.bytes += lineBytes;
+
+				if ((!line.empty()) && (line.back() == '\r'))
+				{
+					line.pop_back();
+				}
+				if (line.empty())
+				{
+					continue;
+				}
+
+				StringUtf8 doc;
+				if (!this->ParseLine(line, doc))
+				{
+					batch.skipped++;
+					continue;
+				}
+
+				batch.docs.push_back(std::move(doc));
+				batch.ends.push_back(this->position);
+			}
+
+			return batch;
+		}
+
+	protected:
+		const InputFile& input;
+		const CorpusSettings& settings;
+		std::ifstream f;
+		uint64_t position;
+
+		bool ParseLine(const std::string& line, StringUtf8& doc) const
+		{
+			if (!input.jsonl)
+			{
+				doc.assign(reinterpret_cast<const char8_t*>(line.data()), line.size());
+				return true;
+			}
+
+			cJSON* json = cJSON_Parse(line.c_str());
+			if (json == nullptr)
+			{
+				return false;
+			}
+
+			cJSON* text = cJSON_GetObjectItemCaseSensitive(json, settings.textField.c_str());
+			const bool ok = (cJSON_IsString(text)) && (text->valuestring != nullptr) && (text->valuestring[0] != 0);
+			if (ok)
+			{
+				doc = reinterpret_cast<const char8_t*>(text->valuestring);
+			}
+
+			cJSON_Delete(json);
+			return ok;
+		}
+
+		void ReadWholeFile(DocumentBatch& batch)
+		{
+			if (this->position >= input.size)
+			{
+				return;
+			}
+
+			std::ostringstream ss;
+			ss << f.rdbuf();
+			std::string data = ss.str();
+
+			this->position += data.size();
+			batch.bytes = data.size();
+			if (data.empty())
+			{
+				return;
+			}
+
+			batch.docs.emplace_back(reinterpret_cast<const char8_t*>(data.data()), data.size());
+			batch.ends.push_back(this->position);
+		}
+	};
+
+	//=========================================================
+	// Manifest
+	//=========================================================
+
+	std::string CreateSettingsJson(const CorpusSettings& s, const std::vector<InputFile>& inputs,
+		const TokenizerBPE& tokenizer, uint32_t tokenBytes)
+	{
+		cJSON* root = cJSON_CreateObject();
+		cJSON_AddNumberToObject(root, "vocab_size", static_cast<double>(tokenizer.GetVocabSize()));
+		cJSON_AddNumberToObject(root, "token_bytes", tokenBytes);
+		cJSON_AddNumberToObject(root, "bos_id", tokenizer.GetBos().id);
+		cJSON_AddNumberToObject(root, "eos_id", tokenizer.GetEos().id);
+		cJSON_AddBoolToObject(root, "add_bos", s.addBos);
+		cJSON_AddBoolToObject(root, "add_eos", s.addEos);
+		cJSON_AddNumberToObject(root, "shard_tokens", static_cast<double>(s.shardTokens));
+		cJSON_AddStringToObject(root, "text_field", s.textField.c_str());
+		cJSON_AddStringToObject(root, "txt_mode", s.txtMode.c_str());
+
+		cJSON* files = cJSON_AddArrayToObject(root, "inputs");
+		for (const auto& in : inputs)
+		{
+			cJSON* item = cJSON_CreateObject();
+			cJSON_AddStringToObject(item, "path", in.path.c_str());
+			cJSON_AddNumberToObject(item, "size", static_cast<double>(in.size));
+			cJSON_AddItemToArray(files, item);
+		}
+
+		char* str = cJSON_PrintUnformatted(root);
+		std::string res = str;
+		cJSON_free(str);
+		cJSON_Delete(root);
+
+		return res;
+	}
+
+	/// <summary>
+	/// Write manifest to temporary file and rename it,
+	/// so manifest on disk is never partially written
+	/// </summary>
+	void SaveManifest(const std::filesystem::path& dir, const Manifest& m)
+	{
+		cJSON* root = cJSON_CreateObject();
+		cJSON_AddStringToObject(root, "format", MANIFEST_FORMAT);
+		cJSON_AddNumberToObject(root, "version", MANIFEST_VERSION);
+		cJSON_AddItemToObject(root, "settings", cJSON_Parse(m.settingsJson.c_str()));
+
+		uint64_t totalTokens = 0;
+		uint64_t totalDocs = 0;
+
+		cJSON* shards = cJSON_AddArrayToObject(root, "shards");
+		for (const auto& s : m.shards)
+		{
+			cJSON* item = cJSON_CreateObject();
+			cJSON_AddStringToObject(item, "file", s.file.c_str());
+			cJSON_AddNumberToObject(item, "tokens", static_cast<double>(s.tokens));
+			cJSON_AddNumberToObject(item, "documents", static_cast<double>(s.documents));
+			cJSON_AddItemToArray(shards, item);
+
+			totalTokens += s.tokens;
+			totalDocs += s.documents;
+		}
+
+		cJSON_AddNumberToObject(root, "total_tokens", static_cast<double>(totalTokens));
+		cJSON_AddNumberToObject(root, "total_documents", static_cast<double>(totalDocs));
+		cJSON_AddNumberToObject(root, "skipped_documents", static_cast<double>(m.skippedDocuments));
+
+		cJSON* resume = cJSON_AddObjectToObject(root, "resume");
+		cJSON_AddNumberToObject(resume, "input", static_cast<double>(m.resume.input));
+		cJSON_AddNumberToObject(resume, "offset", static_cast<double>(m.resume.offset));
+
+		cJSON_AddBoolToObject(root, "complete", m.complete);
+
+		char* str = cJSON_Print(root);
+		std::string json = str;
+		cJSON_free(str);
+		cJSON_Delete(root);
+
+		const auto path = dir / MANIFEST_NAME;
+		const auto tmpPath = dir / (std::string(MANIFEST_NAME) + ".tmp");
+		{
+			std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+			f << json;
+			if (!f)
+			{
+				throw std::runtime_error("Failed to write manifest: " + tmpPath.string());
+			}
+		}
+		std::filesystem::rename(tmpPath, path);
+	}
+
+	bool LoadManifest(const std::filesystem::path& dir, Manifest& m)
+	{
+		std::ifstream f(dir / MANIFEST_NAME, std::ios::binary);
+		if (!f)
+		{
+			return false;
+		}
+
+		std::stringstream ss;
+		ss << f.rdbuf();
+		std::string data = ss.str();
+
+		cJSON* root = cJSON_Parse(data.c_str());
+		if (root == nullptr)
+		{
+			throw std::runtime_error("Invalid manifest in " + dir.string());
+		}
+
+		auto getNumber = [](const cJSON* obj, const char* name) -> uint64_t {
+			const cJSON* v = cJSON_GetObjectItemCaseSensitive(obj, name);
+			if (!cJSON_IsNumber(v))
+			{
+				throw std::runtime_error(std::string("Manifest - missing ") + name);
+			}
+			return static_cast<uint64_t>(v->valuedouble);
+		};
+
+		try
+		{
+			const cJSON* format = cJSON_GetObjectItemCaseSensitive(root, "format");
+			if ((!cJSON_IsString(format)) || (std::strcmp(format->valuestring, MANIFEST_FORMAT) != 0) ||
+				(getNumber(root, "version") != MANIFEST_VERSION))
+			{
+				throw std::runtime_error("Unsupported manifest in " + dir.string());
+			}
+
+			char* settings = cJSON_PrintUnformatted(cJSON_GetObjectItemCaseSensitive(root, "settings"));
+			m.settingsJson = (settings != nullptr) ? settings : "";
+			cJSON_free(settings);
+
+			const cJSON* item = nullptr;
+			cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(root, "shards"))
+			{
+				ShardInfo s;
+				s.file = cJSON_GetObjectItemCaseSensitive(item, "file")->valuestring;
+				s.tokens = getNumber(item, "tokens");
+				s.documents = getNumber(item, "documents");
+				m.shards.push_back(s);
+			}
+
+			const cJSON* resume = cJSON_GetObjectItemCaseSensitive(root, "resume");
+			m.resume.input = static_cast<size_t>(getNumber(resume, "input"));
+			m.resume.offset = getNumber(resume, "offset");
+			m.skippedDocuments = getNumber(root, "skipped_documents");
+			m.complete = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(root, "complete"));
+		}
+		catch (...)
+		{
+			cJSON_Delete(root);
+			throw;
+		}
+
+		cJSON_Delete(root);
+		return true;
+	}
+
+	std::string GetShardName(size_t index)
+	{
+		char name[64];
+		std::snprintf(name, sizeof(name), "shard_%05zu.bin", index);
+		return name;
+	}
+
+	/// <summary>
+	/// Remove shard files and manifest from output directory
+	/// </summary>
+	void ClearOutput(const std::filesystem::path& dir)
+	{
+		for (const auto& e : std::filesystem::directory_iterator(dir))
+		{
+			const std::string name = e.path().filename().string();
+			if ((name.rfind("shard_", 0) == 0) || (name.rfind(MANIFEST_NAME, 0) == 0))
+			{
+				std::filesystem::remove(e.path());
+			}
+		}
+	}
+
+	/// <summary>
+	/// Check that finished shards listed in manifest are on disk
+	/// and remove everything written after the last manifest update
+	/// </summary>
+	void PrepareResume(const std::filesystem::path& dir, const Manifest& m)
+	{
+		for (const auto& s : m.shards)
+		{
+			auto header = TokenShardFile::ReadHeader((dir / s.file).string());
+			if ((header.tokensCount != s.tokens) || (header.documentsCount != s.documents))
+			{
+				throw std::runtime_error("Shard does not match manifest: " + s.file + " (use --overwrite)");
+			}
+		}
+
+		for (const auto& e : std::filesystem::directory_iterator(dir))
+		{
+			const std::string name = e.path().filename().string();
+			if (name.rfind("shard_", 0) != 0)
+			{
+				continue;
+			}
+
+			bool listed = std::any_of(m.shards.begin(), m.shards.end(),
+				[&](const ShardInfo& s) { return (s.file == name); });
+			if (!listed)
+			{
+				std::filesystem::remove(e.path());
+			}
+		}
+	}
+}
+
+//=========================================================
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		const CorpusSettings settings = ParseArgs(argc, argv);
+		const std::filesystem::path outDir(settings.outDir);
+		std::filesystem::create_directories(outDir);
+
+		const std::vector<InputFile> inputs = CollectInputs(settings.inputs);
+		if (inputs.empty())
+		{
+			throw std::runtime_error("No input files found");
+		}
+
+		TokenizerBPE tokenizer(settings.tokenizerPath);
+		tokenizer.Load();
+
+		const size_t vocabSize = tokenizer.GetVocabSize();
+		uint32_t tokenBytes = TokenShardFile::GetMinTokenBytes(vocabSize);
+		if (settings.dtype == "uint32")
+		{
+			tokenBytes = 4;
+		}
+		else if (settings.dtype == "uint16")
+		{
+			if (tokenBytes != 2)
+			{
+				throw std::runtime_error("Vocab size " + std::to_string(vocabSize) + " does not fit into uint16");
+			}
+		}
+
+		//start new run or continue previous one
+		Manifest manifest;
+		manifest.settingsJson = CreateSettingsJson(settings, inputs, tokenizer, tokenBytes);
+
+		Manifest previous;
+		if ((!settings.overwrite) && (LoadManifest(outDir, previous)))
+		{
+			if (previous.settingsJson != manifest.settingsJson)
+			{
+				throw std::runtime_error("Output directory contains shards created with different settings "
+					"or inputs (use --overwrite)");
+			}
+			if (previous.complete)
+			{
+				std::fprintf(stderr, "Output is already complete: %zu shards\n", previous.shards.size());
+				return 0;
+			}
+
+			PrepareResume(outDir, previous);
+			manifest = previous;
+
+			std::fprintf(stderr, "Resuming after %zu shards (input %zu, offset %llu)\n",
+				manifest.shards.size(), manifest.resume.input,
+				static_cast<unsigned long long>(manifest.resume.offset));
+		}
+		else
+		{
+			ClearOutput(outDir);
+			SaveManifest(outDir, manifest);
+		}
+
+		ThreadPool pool(settings.threads);
+		const size_t batchBytes = settings.batchMb * 1024 * 1024;
+
+		const TokenId bosId = tokenizer.GetBos().id;
+		const TokenId eosId = tokenizer.GetEos().id;
+		const bool addBos = (settings.addBos) && (bosId != -1);
+		const bool addEos = (settings.addEos) && (eosId != -1);
+
+		std::unique_ptr<TokenShardFile::Writer> writer;
+		uint64_t pendingSkipped = 0;
+
+		auto finishShard = [&](const ResumePosition& pos) {
+			ShardInfo info;
+			info.file = GetShardName(manifest.shards.size());
+			info.tokens = writer->GetTokensCount();
+			info.documents = writer->GetDocumentsCount();
+
+			writer->Finish();
+			writer.reset();
+
+			manifest.shards.push_back(info);
+			manifest.resume = pos;
+			manifest.skippedDocuments += pendingSkipped;
+			pendingSkipped = 0;
+			SaveManifest(outDir, manifest);
+
+			std::fprintf(stderr, "Finished %s: %llu tokens, %llu documents\n", info.file.c_str(),
+				static_cast<unsigned long long>(info.tokens), static_cast<unsigned long long>(info.documents));
+		};
+
+		auto start = Clock::now();
+		uint64_t bytesDone = 0;
+		uint64_t tokensDone = 0;
+
+		ResumePosition lastPos = manifest.resume;
+
+		for (size_t inputIndex = manifest.resume.input; inputIndex < inputs.size(); inputIndex++)
+		{
+			const InputFile& input = inputs[inputIndex];
+			const uint64_t offset = (inputIndex == manifest.resume.input) ? manifest.resume.offset : 0;
+
+			DocumentReader reader(input, offset, settings);
+
+			//read next batch while current one is tokenized
+			DocumentBatch batch = reader.ReadBatch(batchBytes);
+			while (batch.bytes > 0)
+			{
+				auto nextBatch = std::async(std::launch::async, [&]() { return reader.ReadBatch(batchBytes); });
+
+				auto flat = tokenizer.EncodeBatchFlat(batch.docs, &pool);
+
+				for (size_t i = 0; i < batch.docs.size(); i++)
+				{
+					if (writer == nullptr)
+					{
+						writer = std::make_unique<TokenShardFile::Writer>(
+							(outDir / GetShardName(manifest.shards.size())).string(), tokenBytes);
+					}
+
+					if (addBos)
+					{
+						writer->AppendTokens(std::span<const TokenId>(&bosId, 1));
+					}
+					writer->AppendTokens(flat.Get(i));
+					if (addEos)
+					{
+						writer->AppendTokens(std::span<const TokenId>(&eosId, 1));
+					}
+					writer->EndDocument();
+
+					tokensDone += flat.Get(i).size();
+					lastPos = { inputIndex, batch.ends[i] };
+
+					if (writer->GetTokensCount() >= settings.shardTokens)
+					{
+						finishShard(lastPos);
+					}
+				}
+
+				pendingSkipped += batch.skipped;
+				bytesDone += batch.bytes;
+
+				const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+				std::fprintf(stderr, "\r%s: %.1f MB, %.2f MB/s, %llu tokens", input.path.c_str(),
+					bytesDone / (1024.0 * 1024.0), bytesDone / (1024.0 * 1024.0) / std::max(seconds, 1e-9),
+					static_cast<unsigned long long>(tokensDone));
+
+				batch = nextBatch.get();
+			}
+			std::fprintf(stderr, "\n");
+		}
+
+		if (writer != nullptr)
+		{
+			finishShard(lastPos);
+		}
+
+		manifest.resume = { inputs.size(), 0 };
+		manifest.skippedDocuments += pendingSkipped;
+		manifest.complete = true;
+		SaveManifest(outDir, manifest);
+
+		const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		std::fprintf(stderr, "Done: %zu shards, %llu new tokens in %.1f s (%llu documents skipped)\n",
+			manifest.shards.size(), static_cast<unsigned long long>(tokensDone), seconds,
+			static_cast<unsigned long long>(manifest.skippedDocuments));
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
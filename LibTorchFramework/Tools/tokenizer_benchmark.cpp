@@ -0,0 +1,552 @@
+//=========================================================
+// Tokenizer throughput benchmark
+//
+// Usage:
+//   TokenizerBenchmark <tokenizer.json | compiled file>
+//       [--out result.json] [--threads N] [--size-mb MB] [--repeat R]
+//
+// Corpora (English prose, code, CJK, emoji) are generated locally
+// with fixed seed, so results of different builds can be compared.
+// Result is written as JSON (stdout if --out is not set)
+//=========================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <stdexcept>
+
+#include <Utils/cJSON.h>
+
+#include "../core/Tokenizers/TokenizerBPE.h"
+#include "../core/Tokenizers/StreamingDecoder.h"
+#include "../core/Tokenizers/TokenizerBinaryFile.h"
+#include "../Utils/ThreadPool.h"
+
+namespace
+{
+	struct BenchmarkSettings
+	{
+		std::string tokenizerPath;
+		std::string outPath;
+		size_t threads = 0; //0 - hardware concurrency
+		size_t sizeMb = 4; //per corpus
+		size_t repeat = 3;
+	};
+
+	struct Corpus
+	{
+		std::string name;
+		std::vector<StringUtf8> docs;
+		size_t bytes = 0;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	double ElapsedSeconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	/// <summary>
+	/// Run fn repeat times and return the best time.
+	/// prepare is called before each run and is not measured
+	/// </summary>
+	double MeasureBest(size_t repeat, const std::function<void()>& prepare, const std::function<void()>& fn)
+	{
+		double best = 0.0;
+		for (size_t i = 0; i < std::max<size_t>(repeat, 1); i++)
+		{
+			if (prepare)
+			{
+				prepare();
+			}
+
+			auto start = Clock::now();
+			fn();
+			double t = ElapsedSeconds(start);
+
+			if ((i == 0) || (t < best))
+			{
+				best = t;
+			}
+		}
+		return best;
+	}
+
+	//=========================================================
+	// Synthetic corpora
+	//=========================================================
+
+	void AppendUtf8(char32_t cp, StringUtf8& out)
+	{
+		if (cp < 0x80)
+		{
+			out.push_back(static_cast<char8_t>(cp));
+		}
+		else if (cp < 0x800)
+		{
+			out.push_back(static_cast<char8_t>(0xC0 | (cp >> 6)));
+			out.push_back(static_cast<char8_t>(0x80 | (cp & 0x3F)));
+		}
+		else if (cp < 0x10000)
+		{
+			out.push_back(static_cast<char8_t>(0xE0 | (cp >> 12)));
+			out.push_back(static_cast<char8_t>(0x80 | ((cp >> 6) & 0x3F)));
+			out.push_back(static_cast<char8_t>(0x80 | (cp & 0x3F)));
+		}
+		else
+		{
+			out.push_back(static_cast<char8_t>(0xF0 | (cp >> 18)));
+			out.push_back(static_cast<char8_t>(0x80 | ((cp >> 12) & 0x3F)));
+			out.push_back(static_cast<char8_t>(0x80 | ((cp >> 6) & 0x3F)));
+			out.push_back(static_cast<char8_t>(0x80 | (cp & 0x3F)));
+		}
+	}
+
+	void Append(const char* s, StringUtf8& out)
+	{
+		out.append(reinterpret_cast<const char8_t*>(s));
+	}
+
+	template <size_t N>
+	const char* Pick(const char* const (&arr)[N], std::mt19937_64& rng)
+	{
+		return arr[rng() % N];
+	}
+
+	static const char* const ENGLISH_WORDS[] = {
+		"the", "of", "and", "to", "in", "is", "was", "that", "for", "it", "with", "as", "on",
+		"be", "at", "by", "this", "had", "not", "are", "but", "from", "or", "have", "an",
+		"they", "which", "one", "you", "were", "all", "we", "her", "she", "there", "would",
+		"their", "will", "when", "who", "him", "been", "has", "more", "if", "no", "out",
+		"weather", "warning", "forecast", "river", "mountain", "northern", "temperature",
+		"government", "committee", "announced", "yesterday", "significantly", "information",
+		"development", "international", "understanding", "experience", "particularly",
+		"approximately", "responsibility", "characteristics", "infrastructure", "storm",
+		"city", "people", "water", "history", "system", "program", "question", "number",
+		"Monday", "September", "London", "Europe", "Prague", "university", "research"
+	};
+
+	static const char* const CODE_IDENTIFIERS[] = {
+		"count", "index", "buffer", "result", "value", "tokens", "offset", "length", "data",
+		"config", "tensor", "batchSize", "learningRate", "maxSeqLen", "vocab", "kvCache",
+		"input_ids", "hidden_states", "attention_mask", "num_heads", "head_dim", "logits",
+		"std::vector<int>", "std::string", "torch::Tensor", "self", "ptr", "it", "i", "j", "k"
+	};
+
+	static const char* const CODE_LINES[] = {
+		"for (size_t %s = 0; %s < %s.size(); %s++)\n",
+		"if (%s == nullptr) {\n    return %s;\n}\n",
+		"auto %s = std::make_shared<%s>(%s);\n",
+		"def %s(%s, %s=None):\n",
+		"    return %s[%s] + %s\n",
+		"%s = torch.matmul(%s, %s.transpose(-2, -1)) / math.sqrt(%s)\n",
+		"// TODO: check %s before using %s\n",
+		"#include <%s>\n",
+		"%s.push_back(static_cast<int32_t>(%s));\n",
+		"    %s += %s * 0.5f; // update %s\n",
+		"}\n\n",
+		"class %s : public %s {\npublic:\n",
+		"    std::printf(\"%%s=%%d\\n\", %s, %s);\n"
+	};
+
+	static const char* const EMOJI_WORDS[] = {
+		"lol", "ok", "yes", "wow", "omg", "love", "party", "cat", "dog", "soon", "nice", "gg"
+	};
+
+	StringUtf8 GenerateEnglishDoc(std::mt19937_64& rng, size_t targetBytes)
+	{
+		StringUtf8 doc;
+		while (doc.size() < targetBytes)
+		{
+			size_t words = 5 + rng() % 16;
+			for (size_t w = 0; w < words; w++)
+			{
+				std::string word = Pick(ENGLISH_WORDS, rng);
+				if (w == 0)
+				{
+					word[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(word[0])));
+				}
+				else
+				{
+					doc.push_back(u8' ');
+				}
+				if (rng() % 25 == 0)
+				{
+					word = std::to_string(rng() % 10000);
+				}
+				Append(word.c_str(), doc);
+				if ((w + 1 < words) && (rng() % 12 == 0))
+				{
+					doc.push_back(u8',');
+				}
+			}
+			Append((rng() % 8 == 0) ? "?" : ".", doc);
+			Append((rng() % 6 == 0) ? "\n\n" : " ", doc);
+		}
+		return doc;
+	}
+
+	StringUtf8 GenerateCodeDoc(std::mt19937_64& rng, size_t targetBytes)
+	{
+		StringUtf8 doc;
+		char line[512];
+		while (doc.size() < targetBytes)
+		{
+			const char* fmt = Pick(CODE_LINES, rng);
+			std::snprintf(line, sizeof(line), fmt,
+				Pick(CODE_IDENTIFIERS, rng), Pick(CODE_IDENTIFIERS, rng), Pick(CODE_IDENTIFIERS, rng),
+				Pick(CODE_IDENTIFIERS, rng), Pick(CODE_IDENTIFIERS, rng), Pick(CODE_IDENTIFIERS, rng));
+
+			size_t indent = (rng() % 4) * 4;
+			doc.append(indent, u8' ');
+			Append(line, doc);
+		}
+		return doc;
+	}
+
+	StringUtf8 GenerateCjkDoc(std::mt19937_64& rng, size_t targetBytes)
+	{
+		static const char32_t PUNCT[] = { 0x3002, 0x3001, 0x300C, 0x300D, 0xFF01, 0xFF1F };
+
+		StringUtf8 doc;
+		while (doc.size() < targetBytes)
+		{
+			size_t len = 8 + rng() % 40;
+			uint64_t script = rng() % 10;
+			for (size_t i = 0; i < len; i++)
+			{
+				char32_t cp;
+				if (script < 5) cp = 0x4E00 + static_cast<char32_t>(rng() % 3000); //common Han
+				else if (script < 7) cp = 0x3041 + static_cast<char32_t>(rng() % 86); //Hiragana
+				else if (script < 8) cp = 0x30A1 + static_cast<char32_t>(rng() % 90); //Katakana
+				else cp = 0xAC00 + static_cast<char32_t>(rng() % 2000); //Hangul
+				AppendUtf8(cp, doc);
+
+				if ((script >= 8) && (rng() % 4 == 0))
+				{
+					doc.push_back(u8' ');
+				}
+			}
+			AppendUtf8(PUNCT[rng() % std::size(PUNCT)], doc);
+			if (rng() % 5 == 0)
+			{
+				doc.push_back(u8'\n');
+			}
+		}
+		return doc;
+	}
+
+	StringUtf8 GenerateEmojiDoc(std::mt19937_64& rng, size_t targetBytes)
+	{
+		StringUtf8 doc;
+		while (doc.size() < targetBytes)
+		{
+			uint64_t kind = rng() % 6;
+			if (kind == 0)
+			{
+				Append(Pick(EMOJI_WORDS, rng), doc);
+			}
+			else if (kind == 1)
+			{
+				//skin tone modifier
+				AppendUtf8(0x1F44B + static_cast<char32_t>(rng() % 5), doc);
+				AppendUtf8(0x1F3FB + static_cast<char32_t>(rng() % 5), doc);
+			}
+			else if (kind == 2)
+			{
+				//ZWJ family sequence
+				AppendUtf8(0x1F468, doc);
+				AppendUtf8(0x200D, doc);
+				AppendUtf8(0x1F469, doc);
+				AppendUtf8(0x200D, doc);
+				AppendUtf8(0x1F467 + static_cast<char32_t>(rng() % 2), doc);
+			}
+			else if (kind == 3)
+			{
+				//flag - pair of regional indicators
+				AppendUtf8(0x1F1E6 + static_cast<char32_t>(rng() % 26), doc);
+				AppendUtf8(0x1F1E6 + static_cast<char32_t>(rng() % 26), doc);
+			}
+			else
+			{
+				size_t n = 1 + rng() % 3;
+				for (size_t i = 0; i < n; i++)
+				{
+					char32_t cp = (rng() % 2) ?
+						0x1F600 + static_cast<char32_t>(rng() % 80) :
+						0x1F300 + static_cast<char32_t>(rng() % 256);
+					AppendUtf8(cp, doc);
+				}
+			}
+
+			doc.push_back((rng() % 10 == 0) ? u8'\n' : u8' ');
+		}
+		return doc;
+	}
+
+	Corpus GenerateCorpus(const std::string& name, size_t totalBytes, uint64_t seed,
+		StringUtf8(*generate)(std::mt19937_64&, size_t))
+	{
+		std::mt19937_64 rng(seed);
+
+		Corpus c;
+		c.name = name;
+		while (c.bytes < totalBytes)
+		{
+			size_t docBytes = 512 + rng() % 4096;
+			c.docs.push_back(generate(rng, docBytes));
+			c.bytes += c.docs.back().size();
+		}
+		return c;
+	}
+
+	//=========================================================
+	// Measurements
+	//=========================================================
+
+	cJSON* CreateEncodeResult(double seconds, size_t bytes, size_t tokens, const TokenCache::Stats& cache)
+	{
+		cJSON* o = cJSON_CreateObject();
+		cJSON_AddNumberToObject(o, "seconds", seconds);
+		cJSON_AddNumberToObject(o, "mb_per_s", (seconds > 0) ? (bytes / (1024.0 * 1024.0)) / seconds : 0.0);
+		cJSON_AddNumberToObject(o, "tokens_per_s", (seconds > 0) ? tokens / seconds : 0.0);
+		cJSON_AddNumberToObject(o, "cache_hit_rate", cache.GetHitRate());
+		cJSON_AddNumberToObject(o, "cache_entries", static_cast<double>(cache.entries));
+		cJSON_AddNumberToObject(o, "cache_bytes", static_cast<double>(cache.bytes));
+		return o;
+	}
+
+	cJSON* CreateDecodeResult(double seconds, size_t tokens)
+	{
+		cJSON* o = cJSON_CreateObject();
+		cJSON_AddNumberToObject(o, "seconds", seconds);
+		cJSON_AddNumberToObject(o, "tokens_per_s", (seconds > 0) ? tokens / seconds : 0.0);
+		return o;
+	}
+
+	/// <summary>
+	/// Encode corpus with cold cache (cleared before each run)
+	/// and warm cache (filled by previous run)
+	/// </summary>
+	cJSON* BenchmarkEncode(TokenizerBPE& tok, const Corpus& c, size_t tokens, size_t repeat,
+		const std::function<void()>& encode)
+	{
+		cJSON* res = cJSON_CreateObject();
+
+		double cold = MeasureBest(repeat, [&]() { tok.ClearWordCache(); }, encode);
+		TokenCache::Stats coldStats = tok.GetWordCacheStats();
+		//stats are accumulated over all repeats, each of them is cold
+		cJSON_AddItemToObject(res, "cold", CreateEncodeResult(cold, c.bytes, tokens, coldStats));
+
+		tok.ClearWordCache();
+		encode();
+		TokenCache::Stats before = tok.GetWordCacheStats();
+		double warm = MeasureBest(repeat, nullptr, encode);
+		TokenCache::Stats warmStats = tok.GetWordCacheStats();
+		warmStats.hits -= before.hits;
+		warmStats.misses -= before.misses;
+		cJSON_AddItemToObject(res, "warm", CreateEncodeResult(warm, c.bytes, tokens, warmStats));
+
+		return res;
+	}
+
+	cJSON* BenchmarkCorpus(TokenizerBPE& tok, const Corpus& c, ThreadPool& pool, size_t repeat)
+	{
+		std::fprintf(stderr, "Benchmark corpus: %s (%zu docs, %zu bytes)\n", c.name.c_str(), c.docs.size(), c.bytes);
+
+		//reference ids
+		std::vector<std::vector<TokenId>> ids(c.docs.size());
+		size_t tokens = 0;
+		for (size_t i = 0; i < c.docs.size(); i++)
+		{
+			ids[i] = tok.Encode(c.docs[i]);
+			tokens += ids[i].size();
+		}
+
+		cJSON* o = cJSON_CreateObject();
+		cJSON_AddStringToObject(o, "name", c.name.c_str());
+		cJSON_AddNumberToObject(o, "docs", static_cast<double>(c.docs.size()));
+		cJSON_AddNumberToObject(o, "bytes", static_cast<double>(c.bytes));
+		cJSON_AddNumberToObject(o, "tokens", static_cast<double>(tokens));
+		cJSON_AddNumberToObject(o, "bytes_per_token", (tokens > 0) ? static_cast<double>(c.bytes) / tokens : 0.0);
+
+		//single thread
+		cJSON_AddItemToObject(o, "encode_single", BenchmarkEncode(tok, c, tokens, repeat, [&]() {
+			for (const auto& d : c.docs)
+			{
+				auto tmp = tok.Encode(d);
+			}
+		}));
+
+		//multi thread
+		Tokenizer::FlatBatch flat;
+		cJSON_AddItemToObject(o, "encode_multi", BenchmarkEncode(tok, c, tokens, repeat, [&]() {
+			flat = tok.EncodeBatchFlat(c.docs, &pool);
+		}));
+
+		bool matches = (flat.GetCount() == ids.size());
+		for (size_t i = 0; (matches) && (i < ids.size()); i++)
+		{
+			auto got = flat.Get(i);
+			matches = std::equal(got.begin(), got.end(), ids[i].begin(), ids[i].end());
+		}
+		cJSON_AddBoolToObject(o, "batch_matches_single", matches);
+
+		//decode
+		double decode = MeasureBest(repeat, nullptr, [&]() {
+			for (const auto& v : ids)
+			{
+				auto tmp = tok.Decode(v);
+			}
+		});
+		cJSON_AddItemToObject(o, "decode", CreateDecodeResult(decode, tokens));
+
+		double decodeMulti = MeasureBest(repeat, nullptr, [&]() {
+			auto tmp = tok.DecodeBatch(ids, &pool);
+		});
+		cJSON_AddItemToObject(o, "decode_multi", CreateDecodeResult(decodeMulti, tokens));
+
+		double decodeStream = MeasureBest(repeat, nullptr, [&]() {
+			StreamingDecoder stream(tok);
+			size_t total = 0;
+			for (const auto& v : ids)
+			{
+				for (auto id : v)
+				{
+					total += stream.Push(id).size();
+				}
+				total += stream.Flush().size();
+			}
+			if (total == 0)
+			{
+				std::fprintf(stderr, "Streaming decoder returned no text\n");
+			}
+		});
+		cJSON_AddItemToObject(o, "decode_stream", CreateDecodeResult(decodeStream, tokens));
+
+		return o;
+	}
+
+	BenchmarkSettings ParseArgs(int argc, char** argv)
+	{
+		BenchmarkSettings s;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string a = argv[i];
+			auto next = [&]() -> const char* {
+				if (i + 1 >= argc)
+				{
+					throw std::runtime_error("Missing value for " + a);
+				}
+				return argv[++i];
+			};
+
+			if (a == "--out") s.outPath = next();
+			else if (a == "--threads") s.threads = std::strtoull(next(), nullptr, 10);
+			else if (a == "--size-mb") s.sizeMb = std::strtoull(next(), nullptr, 10);
+			else if (a == "--repeat") s.repeat = std::strtoull(next(), nullptr, 10);
+			else if (s.tokenizerPath.empty()) s.tokenizerPath = a;
+			else throw std::runtime_error("Unknown argument: " + a);
+		}
+
+		if (s.tokenizerPath.empty())
+		{
+			throw std::runtime_error("Usage: TokenizerBenchmark <tokenizer.json> [--out result.json] [--threads N] [--size-mb MB] [--repeat R]");
+		}
+		return s;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		BenchmarkSettings settings = ParseArgs(argc, argv);
+
+		cJSON* root = cJSON_CreateObject();
+		cJSON_AddStringToObject(root, "tokenizer", settings.tokenizerPath.c_str());
+
+		//load time
+		std::fprintf(stderr, "Loading tokenizer: %s\n", settings.tokenizerPath.c_str());
+
+		auto start = Clock::now();
+		TokenizerBPE tok(settings.tokenizerPath);
+		tok.Load();
+		double loadSeconds = ElapsedSeconds(start);
+
+		cJSON* load = cJSON_AddObjectToObject(root, "load");
+		cJSON_AddNumberToObject(load, "ms", loadSeconds * 1000.0);
+		cJSON_AddBoolToObject(load, "compiled", TokenizerBinaryFile::IsBinaryFile(settings.tokenizerPath));
+
+		if (TokenizerBinaryFile::IsBinaryFile(settings.tokenizerPath) == false)
+		{
+			//compare with compiled file
+			auto compiledPath = std::filesystem::temp_directory_path() / "tokenizer_benchmark.bin";
+			tok.SaveCompiled(compiledPath.string());
+
+			start = Clock::now();
+			{
+				TokenizerBPE compiled(compiledPath.string());
+				compiled.Load();
+			}
+			cJSON_AddNumberToObject(load, "compiled_ms", ElapsedSeconds(start) * 1000.0);
+
+			std::error_code ec;
+			std::filesystem::remove(compiledPath, ec);
+		}
+
+		ThreadPool pool(settings.threads);
+		cJSON_AddNumberToObject(root, "threads", static_cast<double>(pool.GetThreadsCount()));
+		cJSON_AddNumberToObject(root, "repeat", static_cast<double>(settings.repeat));
+
+		const size_t bytes = settings.sizeMb * 1024 * 1024;
+		std::vector<Corpus> corpora;
+		corpora.push_back(GenerateCorpus("english", bytes, 1, GenerateEnglishDoc));
+		corpora.push_back(GenerateCorpus("code", bytes, 2, GenerateCodeDoc));
+		corpora.push_back(GenerateCorpus("cjk", bytes, 3, GenerateCjkDoc));
+		corpora.push_back(GenerateCorpus("emoji", bytes, 4, GenerateEmojiDoc));
+
+		cJSON* results = cJSON_AddArrayToObject(root, "corpora");
+		for (const auto& c : corpora)
+		{
+			cJSON_AddItemToArray(results, BenchmarkCorpus(tok, c, pool, settings.repeat));
+		}
+
+		char* json = cJSON_Print(root);
+		if (settings.outPath.empty())
+		{
+			std::printf("%s\n", json);
+		}
+		else
+		{
+			FILE* f = std::fopen(settings.outPath.c_str(), "wb");
+			if (f == nullptr)
+			{
+				cJSON_free(json);
+				cJSON_Delete(root);
+				throw std::runtime_error("Failed to open output: " + settings.outPath);
+			}
+			std::fputs(json, f);
+			std::fclose(f);
+		}
+
+		cJSON_free(json);
+		cJSON_Delete(root);
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+//=========================================================
+// Train byte-level BPE tokenizer
+//
+// Usage:
+//   TokenizerTrain --out tokenizer.json [--vocab-size N] [--min-frequency N]
+//       [--pattern llama3|gpt2] [--special <token>]... [--threads N] <text files>...
+//
+// Each line of input files is a separate text.
+// Result is tokenizer.json loadable by TokenizerBPE
+//=========================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "../core/Tokenizers/TokenizerBPETrainer.h"
+#include "../Utils/ThreadPool.h"
+
+namespace
+{
+	struct TrainSettings
+	{
+		TokenizerBPETrainer::Settings trainer;
+		std::vector<std::string> files;
+		std::string outPath;
+		size_t threads = 0;
+	};
+
+	TrainSettings ParseArgs(int argc, char** argv)
+	{
+		TrainSettings s;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string a = argv[i];
+			auto next = [&]() -> const char* {
+				if (i + 1 >= argc)
+				{
+					throw std::runtime_error("Missing value for " + a);
+				}
+				return argv[++i];
+			};
+
+			if (a == "--out") s.outPath = next();
+			else if (a == "--vocab-size") s.trainer.vocabSize = std::strtoull(next(), nullptr, 10);
+			else if (a == "--min-frequency") s.trainer.minFrequency = std::strtoull(next(), nullptr, 10);
+			else if (a == "--threads") s.threads = std::strtoull(next(), nullptr, 10);
+			else if (a == "--special") s.trainer.specialTokens.push_back(reinterpret_cast<const char8_t*>(next()));
+			else if (a == "--pattern")
+			{
+				std::string p = next();
+				if (p == "llama3") s.trainer.pattern = PreTokenizer::PatternType::LLAMA3;
+				else if (p == "gpt2") s.trainer.pattern = PreTokenizer::PatternType::GPT2;
+				else throw std::runtime_error("Unknown pattern: " + p);
+			}
+			else s.files.push_back(a);
+		}
+
+		if ((s.outPath.empty()) || (s.files.empty()))
+		{
+			throw std::runtime_error("Usage: TokenizerTrain --out tokenizer.json [--vocab-size N] [--min-frequency N] "
+				"[--pattern llama3|gpt2] [--special <token>]... [--threads N] <text files>...");
+		}
+		return s;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		TrainSettings settings = ParseArgs(argc, argv);
+
+		ThreadPool pool(settings.threads);
+		TokenizerBPETrainer trainer(settings.trainer);
+
+		auto start = std::chrono::steady_clock::now();
+		for (const auto& f : settings.files)
+		{
+			std::fprintf(stderr, "Counting words: %s\n", f.c_str());
+			trainer.AddFile(f, &pool);
+		}
+		std::fprintf(stderr, "Unique words: %zu\n", trainer.GetUniqueWordsCount());
+
+		trainer.Train(&pool);
+		trainer.Save(settings.outPath);
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::fprintf(stderr, "Saved %s (%zu merges) in %.1f s\n", settings.outPath.c_str(), trainer.GetMerges().size(), seconds);
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,140 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <new>
+
+/// <summary>
+/// Bounded lock-free multi-producer multi-consumer ring queue
+/// (D. Vyukov's algorithm). Every cell has sequence number, producers
+/// and consumers only compete on head / tail counters with CAS.
+/// Capacity is rounded up to power of 2.
+///
+/// TryPush / TryPop never block, waiting is left to the caller
+/// </summary>
+template <typename T>
+class MpmcQueue
+{
+public:
+    explicit MpmcQueue(size_t capacity)
+    {
+        size_t c = 2;
+        while (c < capacity)
+        {
+            c <<= 1;
+        }
+
+        this->mask = c - 1;
+        this->cells = std::make_unique<Cell[]>(c);
+        for (size_t i = 0; i < c; i++)
+        {
+            this->cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        this->head.store(0, std::memory_order_relaxed);
+        this->tail.store(0, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    size_t GetCapacity() const
+    {
+        return this->mask + 1;
+    }
+
+    /// <summary>
+    /// false if queue is full (value is not moved)
+    /// </summary>
+    bool TryPush(T& value)
+    {
+        size_t pos = this->tail.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+
+        while (true)
+        {
+            cell = &this->cells[pos & this->mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (diff == 0)
+            {
+                if (this->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = this->tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// <summary>
+    /// false if queue is empty
+    /// </summary>
+    bool TryPop(T& value)
+    {
+        size_t pos = this->head.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+
+        while (true)
+        {
+            cell = &this->cells[pos & this->mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+            if (diff == 0)
+            {
+                if (this->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = this->head.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = std::move(cell->data);
+        cell->data = T();
+        cell->sequence.store(pos + this->mask + 1, std::memory_order_release);
+        return true;
+    }
+
+protected:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static constexpr size_t CACHE_LINE = 64;
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    //producers and consumers on separate cache lines
+    alignas(CACHE_LINE) std::atomic<size_t> tail;
+    alignas(CACHE_LINE) std::atomic<size_t> head;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "./ProgressBar.h"
 
 #include <iostream>
+#include <iomanip>
 #include <string>
 
 ProgressBar::ProgressBar(int width) : 
@@ -46,18 +47,9 @@ void ProgressBar::Update(int current)
 {
     lastCurrent = current;
 
-    int progress = static_cast<int>(100.0 * current / total);    
-    lastProgress = progress;
-
-    double ratio = static_cast<double>(current) / total;
-    int filled = static_cast<int>(barWidth * ratio);
-
     auto now = std::chrono::steady_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count();
 
-    std::string bar(filled, '#');
-    bar.resize(barWidth, '-');
-
     std::string paramsStr = "";
     for (const auto& [p, v] : this->params)    
     {
@@ -68,6 +60,27 @@ void ProgressBar::Update(int current)
         paramsStr += "]";
     }
 
+    if (total <= 0)
+    {
+        //total is not known (stream) - steps count and speed only
+        auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time).count();
+        double speed = (elapsedMs > 0) ? (1000.0 * current / elapsedMs) : 0.0;
+
+        std::cout << "\r[" << current << " steps] "
+            << elapsed << "s " << std::fixed << std::setprecision(2) << speed << " it/s " 
+            << std::defaultfloat << paramsStr << std::flush;
+        return;
+    }
+
+    int progress = static_cast<int>(100.0 * current / total);    
+    lastProgress = progress;
+
+    double ratio = static_cast<double>(current) / total;
+    int filled = static_cast<int>(barWidth * ratio);
+
+    std::string bar(filled, '#');
+    bar.resize(barWidth, '-');
+
     std::cout << "\r[" << bar << "] "
         << progress << "% (" << current << "/" << total << ") "
         << elapsed << "s " << paramsStr << std::flush;
@@ -75,6 +88,6 @@ void ProgressBar::Update(int current)
 
 void ProgressBar::Finish() 
 {
-    this->Update(total);
+    this->Update((total > 0) ? total : lastCurrent);
     std::cout << std::endl;
 }
\ No newline at end of file
@@ -13,7 +13,7 @@ public:
     void ClearParams();
     void SetParam(const std::string& name, const std::string& val);
 
-    void Start(int total);
+    void Start(int total); //total <= 0 - unknown
     void NextStep();
     void Update(int current);
 
@@ -0,0 +1,236 @@
+#include "./ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+/// <summary>
+/// threadsCount = 0 - use number of hardware threads
+/// (calling thread also runs tasks, so one less worker is created)
+/// </summary>
+/// <param name="threadsCount"></param>
+ThreadPool::ThreadPool(size_t threadsCount) :
+    queuedCount(0),
+    nextQueue(0),
+    running(true)
+{
+    if (threadsCount == 0)
+    {
+        threadsCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    size_t workersCount = threadsCount - 1;
+
+    for (size_t i = 0; i < std::max<size_t>(1, workersCount); i++)
+    {
+        this->queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (size_t i = 0; i < workersCount; i++)
+    {
+        this->workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->waitMutex);
+        this->running = false;
+    }
+    this->waitCv.notify_all();
+
+    for (auto& w : this->workers)
+    {
+        if (w.joinable())
+        {
+            w.join();
+        }
+    }
+}
+
+ThreadPool& ThreadPool::GetDefault()
+{
+    static ThreadPool pool(0);
+    return pool;
+}
+
+/// <summary>
+/// Number of threads that execute tasks (including the caller)
+/// </summary>
+/// <returns></returns>
+size_t ThreadPool::GetThreadsCount() const
+{
+    return this->workers.size() + 1;
+}
+
+void ThreadPool::Submit(std::vector<Task>&& tasks)
+{
+    this->queuedCount += tasks.size();
+
+    size_t q = this->nextQueue.fetch_add(1) % this->queues.size();
+    for (auto& t : tasks)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->queues[q]->m);
+            this->queues[q]->tasks.push_back(std::move(t));
+        }
+        q = (q + 1) % this->queues.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->waitMutex);
+    }
+    this->waitCv.notify_all();
+}
+
+/// <summary>
+/// Run one task - from front of preferred queue,
+/// or stolen from back of other queues
+/// </summary>
+/// <param name="preferredQueue"></param>
+/// <returns>false if there was no task</returns>
+bool ThreadPool::TryRunTask(size_t preferredQueue)
+{
+    const size_t count = this->queues.size();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& q = *this->queues[(preferredQueue + i) % count];
+
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(q.m);
+            if (q.tasks.empty())
+            {
+                continue;
+            }
+
+            if (i == 0)
+            {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            else
+            {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+        }
+
+        this->queuedCount--;
+        task();
+        return true;
+    }
+
+    return false;
+}
+
+void ThreadPool::WorkerLoop(size_t id)
+{
+    while (true)
+    {
+        if (this->TryRunTask(id))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->waitMutex);
+        this->waitCv.wait(lock, [&]() {
+            return (this->running == false) || (this->queuedCount > 0);
+        });
+
+        if ((this->running == false) && (this->queuedCount == 0))
+        {
+            return;
+        }
+    }
+}
+
+/// <summary>
+/// Split [0, count) into chunks of grainSize and run fn(begin, end)
+/// for each of them in parallel. Blocks until all chunks are done,
+/// first exception thrown by fn is rethrown
+/// </summary>
+/// <param name="count"></param>
+/// <param name="grainSize"></param>
+/// <param name="fn"></param>
+void ThreadPool::ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& fn)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    grainSize = std::max<size_t>(1, grainSize);
+    const size_t chunks = (count + grainSize - 1) / grainSize;
+
+    if ((this->workers.empty()) || (chunks == 1))
+    {
+        for (size_t b = 0; b < count; b += grainSize)
+        {
+            fn(b, std::min(count, b + grainSize));
+        }
+        return;
+    }
+
+    struct Job
+    {
+        std::atomic<size_t> remaining;
+        std::mutex m;
+        std::condition_variable cv;
+        std::exception_ptr error;
+    };
+
+    auto job = std::make_shared<Job>();
+    job->remaining = chunks;
+
+    std::vector<Task> tasks;
+    tasks.reserve(chunks);
+    for (size_t b = 0; b < count; b += grainSize)
+    {
+        size_t e = std::min(count, b + grainSize);
+        tasks.emplace_back([job, &fn, b, e]() {
+            try
+            {
+                fn(b, e);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(job->m);
+                if (!job->error)
+                {
+                    job->error = std::current_exception();
+                }
+            }
+
+            if (job->remaining.fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> lock(job->m);
+                job->cv.notify_all();
+            }
+        });
+    }
+
+    this->Submit(std::move(tasks));
+
+    //help with tasks, until our job is done
+    size_t helperQueue = this->nextQueue.fetch_add(1) % this->queues.size();
+    while (job->remaining > 0)
+    {
+        if (this->TryRunTask(helperQueue))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(job->m);
+        job->cv.wait_for(lock, std::chrono::milliseconds(1), [&]() {
+            return job->remaining == 0;
+        });
+    }
+
+    if (job->error)
+    {
+        std::rethrow_exception(job->error);
+    }
+}
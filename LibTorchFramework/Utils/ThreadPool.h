@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/// <summary>
+/// Simple work-stealing thread pool.
+/// Each worker has its own task queue, takes tasks from its front
+/// and if empty, steals from the back of other queues.
+/// Thread that waits for ParallelFor also executes tasks,
+/// so it can be called from inside of a pool task
+/// </summary>
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t threadsCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t GetThreadsCount() const;
+
+    void ParallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& fn);
+
+    static ThreadPool& GetDefault();
+
+protected:
+    using Task = std::function<void()>;
+
+    struct WorkerQueue
+    {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex waitMutex;
+    std::condition_variable waitCv;
+    std::atomic<size_t> queuedCount;
+    std::atomic<size_t> nextQueue;
+    bool running;
+
+    void Submit(std::vector<Task>&& tasks);
+    bool TryRunTask(size_t preferredQueue);
+
+    void WorkerLoop(size_t id);
+};
+
+#endif
@@ -18,6 +18,7 @@ class ProgressBar;
 #include "../core/Structures.h"
 #include "../core/Runner.h"
 #include "../core/Trainer.h"
+#include "../core/Snapshot/TrainingState.h"
 
 #include "../InputProcessing/InputLoader.h"
 #include "../InputProcessing/InputLoadersWrapper.h"
@@ -72,15 +73,28 @@ void TrainingHelper::Run(std::shared_ptr<InputLoadersWrapper> loaders)
     int bacthesCountValid = 0;
     int bacthesCountTest = 0;
 
-    auto dlTrain = this->BuildDataLoader<DatasetType>(RunMode::TRAIN, loaders, bacthesCountTrain);
-    auto dlValid = this->BuildDataLoader<DatasetType>(RunMode::VALID, loaders, bacthesCountValid);
-    auto dlTest = this->BuildDataLoader<DatasetType>(RunMode::TEST, loaders, bacthesCountTest);
-      
     Runner runnerValid(RunMode::VALID, sets, model);
     Runner runnerTest(RunMode::TEST, sets, model);
     Trainer train(sets, model);
 
-    for (int i = 0; i < sets.epochCount; i++)
+    //resume interrupted training
+    //must be done before loaders are loaded - data split depends on shuffle seed
+    int startEpoch = 0;
+    if (auto state = train.ResumeTrainingState())
+    {
+        startEpoch = state->GetEpochId();
+        if (state->GetShuffleSeed().has_value())
+        {
+            loaders->SetShuffleSeed(state->GetShuffleSeed());
+        }
+    }
+    train.SetDataShuffleSeed(loaders->GetShuffleSeed());
+
+    auto dlTrain = this->BuildDataLoader<DatasetType>(RunMode::TRAIN, loaders, bacthesCountTrain);
+    auto dlValid = this->BuildDataLoader<DatasetType>(RunMode::VALID, loaders, bacthesCountValid);
+    auto dlTest = this->BuildDataLoader<DatasetType>(RunMode::TEST, loaders, bacthesCountTest);
+      
+    for (int i = startEpoch; i < sets.epochCount; i++)
     {
         MY_LOG_INFO("Running epoch: %d / %d", i, sets.epochCount);
          
@@ -0,0 +1,246 @@
+#include "./BatchPrefetcher.h"
+
+#include <chrono>
+#include <algorithm>
+#include <exception>
+
+#ifdef USE_CUDA
+#   include <ATen/cuda/CUDAContext.h>
+#   include <ATen/cuda/CUDAEvent.h>
+#   include <c10/cuda/CUDAGuard.h>
+#   include <c10/cuda/CUDACachingAllocator.h>
+#endif
+
+#include "../Settings.h"
+
+//============================================
+// Batch ready for consumer, batch without data
+// and without error is the end of epoch
+//============================================
+
+struct BatchPrefetcher::PreparedBatch
+{
+    std::optional<DataLoaderData> batch;
+    std::exception_ptr error;
+
+#ifdef USE_CUDA
+    std::optional<at::cuda::CUDAEvent> copied;
+#endif
+};
+
+#ifdef USE_CUDA
+
+/// <summary>
+/// Tensors were allocated on side stream, caching allocator
+/// must not reuse their memory until consumer stream is done with them
+/// </summary>
+/// <param name="batch"></param>
+/// <param name="stream"></param>
+static void RecordStream(DataLoaderData& batch, const at::cuda::CUDAStream& stream)
+{
+    auto record = [&](const at::Tensor& t) {
+        if ((t.defined()) && (t.is_cuda()))
+        {
+            c10::cuda::CUDACachingAllocator::recordStream(t.storage().data_ptr(), stream);
+        }
+    };
+
+    record(batch.input);
+    record(batch.target);
+    for (const auto& [k, v] : batch.additionalData)
+    {
+        record(v);
+    }
+}
+
+#endif
+
+//============================================
+
+BatchPrefetcher::BatchPrefetcher(const Settings& sets, size_t depth) :
+    sets(sets),
+    depth(std::max<size_t>(depth, 1)),
+    stopRequested(false),
+    finished(true),
+    waitTime(0.0),
+    deviceIndex(0)
+{
+}
+
+BatchPrefetcher::~BatchPrefetcher()
+{
+    this->Stop();
+}
+
+void BatchPrefetcher::StartWorker(NextBatchCallback nextStagedBatch)
+{
+    this->Stop();
+
+    this->stopRequested = false;
+    this->finished = false;
+    this->waitTime = 0.0;
+
+#ifdef USE_CUDA
+    //current device is per thread, helper uses device of consumer
+    if ((sets.device == torch::kCUDA) && (torch::cuda::is_available()))
+    {
+        this->deviceIndex = c10::cuda::current_device();
+    }
+#endif
+
+    this->worker = std::thread(&BatchPrefetcher::WorkerLoop, this, std::move(nextStagedBatch));
+}
+
+/// <summary>
+/// Stop helper thread (waits for batch being prepared)
+/// and drop all prepared batches
+/// </summary>
+void BatchPrefetcher::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(m);
+        this->stopRequested = true;
+    }
+    cv.notify_all();
+
+    if (this->worker.joinable())
+    {
+        this->worker.join();
+    }
+
+#ifdef USE_CUDA
+    //dropped batches release pooled host buffers,
+    //copies from them on side stream must be finished
+    for (auto& pb : this->ready)
+    {
+        if (pb->copied.has_value())
+        {
+            pb->copied->synchronize();
+        }
+    }
+#endif
+
+    this->ready.clear();
+    this->finished = true;
+}
+
+/// <summary>
+/// Next prepared batch, waits if helper is behind.
+/// Exception from data loader is rethrown here
+/// </summary>
+/// <returns>nullopt at the end of epoch</returns>
+std::optional<DataLoaderData> BatchPrefetcher::Next()
+{
+    if (this->finished)
+    {
+        return std::nullopt;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::unique_ptr<PreparedBatch> pb = nullptr;
+    {
+        std::unique_lock<std::mutex> lk(m);
+        cv.wait(lk, [&] { return (ready.empty() == false); });
+
+        pb = std::move(ready.front());
+        ready.pop_front();
+    }
+    cv.notify_all();
+
+    this->waitTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (pb->error)
+    {
+        this->finished = true;
+        std::rethrow_exception(pb->error);
+    }
+
+    if (pb->batch.has_value() == false)
+    {
+        this->finished = true;
+        return std::nullopt;
+    }
+
+#ifdef USE_CUDA
+    if (pb->copied.has_value())
+    {
+        auto stream = at::cuda::getCurrentCUDAStream(this->deviceIndex);
+        pb->copied->block(stream);
+        RecordStream(*pb->batch, stream);
+    }
+#endif
+
+    return std::move(pb->batch);
+}
+
+double BatchPrefetcher::GetWaitTime() const
+{
+    return this->waitTime;
+}
+
+/// <summary>
+/// Batches are loaded and copied to device (on side stream)
+/// by nextStagedBatch, event is recorded after the copy
+/// </summary>
+/// <param name="nextStagedBatch"></param>
+void BatchPrefetcher::WorkerLoop(NextBatchCallback nextStagedBatch)
+{
+#ifdef USE_CUDA
+    std::optional<c10::cuda::CUDAStreamGuard> streamGuard;
+    if ((sets.device == torch::kCUDA) && (torch::cuda::is_available()))
+    {
+        streamGuard.emplace(at::cuda::getStreamFromPool(false, static_cast<c10::DeviceIndex>(this->deviceIndex)));
+    }
+#endif
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lk(m);
+            cv.wait(lk, [&] { return (stopRequested) || (ready.size() < depth); });
+
+            if (stopRequested)
+            {
+                return;
+            }
+        }
+
+        auto pb = std::make_unique<PreparedBatch>();
+        bool last = false;
+
+        try
+        {
+            pb->batch = nextStagedBatch();
+
+            if (pb->batch.has_value() == false)
+            {
+                last = true;
+            }
+#ifdef USE_CUDA
+            else if (streamGuard.has_value())
+            {
+                pb->copied.emplace();
+                pb->copied->record(at::cuda::getCurrentCUDAStream());
+            }
+#endif
+        }
+        catch (...)
+        {
+            pb->batch.reset();
+            pb->error = std::current_exception();
+            last = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(m);
+            ready.push_back(std::move(pb));
+        }
+        cv.notify_all();
+
+        if (last)
+        {
+            return;
+        }
+    }
+}
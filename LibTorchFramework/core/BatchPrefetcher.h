@@ -0,0 +1,100 @@
+#ifndef BATCH_PREFETCHER_H
+#define BATCH_PREFETCHER_H
+
+struct Settings;
+
+#include <memory>
+#include <deque>
+#include <optional>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "../InputProcessing/DataLoaderData.h"
+#include "../InputProcessing/DataLoaderSample.h"
+
+/// <summary>
+/// Prepares next batches on helper thread while current batch
+/// is processed. Helper takes batch from data loader (with numWorkers = 0
+/// samples are loaded and collated on this thread) and moves it to device.
+/// Typed batch (DataLoaderSample) is moved by its own setupDevice and
+/// converted to DataLoaderData on helper thread, after it is staged.
+/// Batches marked by skip callback are passed to consumer without copy.
+///
+/// On CUDA, copies are done on side stream and consumer stream waits
+/// only for event recorded after copy of its batch.
+///
+/// At most depth batches are prepared ahead
+/// </summary>
+class BatchPrefetcher
+{
+public:
+    BatchPrefetcher(const Settings& sets, size_t depth);
+    ~BatchPrefetcher();
+
+    template <typename NextFn, typename SkipFn>
+    void Start(NextFn nextBatch, SkipFn skipBatch);
+    void Stop();
+
+    std::optional<DataLoaderData> Next();
+
+    double GetWaitTime() const;
+
+protected:
+    //returns batch already on device, nullopt at the end of epoch
+    using NextBatchCallback = std::function<std::optional<DataLoaderData>()>;
+
+    struct PreparedBatch;
+
+    const Settings& sets;
+    size_t depth;
+
+    std::deque<std::unique_ptr<PreparedBatch>> ready;
+    bool stopRequested;
+    bool finished;
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::thread worker;
+
+    double waitTime; //seconds spent by consumer in Next since Start
+    int deviceIndex;
+
+    void StartWorker(NextBatchCallback nextStagedBatch);
+    void WorkerLoop(NextBatchCallback nextStagedBatch);
+};
+
+//================================================================================
+
+/// <summary>
+/// Start preparing batches of new epoch.
+/// nextBatch returns std::optional of batch (DataLoaderData or DataLoaderSample),
+/// nullopt at the end of epoch. 
+/// skipBatch(dataIndices) returns true for batch that will not be processed,
+/// it is not moved to device.
+/// Both are called only from helper thread
+/// </summary>
+/// <param name="nextBatch"></param>
+/// <param name="skipBatch"></param>
+template <typename NextFn, typename SkipFn>
+void BatchPrefetcher::Start(NextFn nextBatch, SkipFn skipBatch)
+{
+    this->StartWorker([this, nextBatch = std::move(nextBatch), skipBatch = std::move(skipBatch)]() mutable -> std::optional<DataLoaderData> {
+        auto batch = nextBatch();
+        if ((batch.has_value() == false) || (batch->GetBatchSize() == 0))
+        {
+            //end of epoch or end of stream (StreamingDataset)
+            return std::nullopt;
+        }
+
+        if (skipBatch(batch->GetDataIndices()) == false)
+        {
+            batch->setupDevice(this->sets);
+        }
+
+        return ToDataLoaderData(std::move(*batch));
+    });
+}
+
+#endif
@@ -392,7 +392,7 @@ public:
 		if (_enabled)
 		{
 			if (_growth_tracker.defined())
-				_growth_tracker.item<int64_t>();
+				return _growth_tracker.item<int64_t>();
 			else
 				return _init_growth_tracker;
 		}
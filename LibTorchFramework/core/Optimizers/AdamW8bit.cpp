@@ -506,3 +506,116 @@ void AdamW8bit::save_max_state_tensor(ParamState& state, const torch::Tensor& va
 }
 
 
+
+// =======================
+// Named state (checkpointing)
+// =======================
+
+void AdamW8bit::save_named_state(const NamedParams& params, TensorMap& out) const
+{
+    for (const auto& p : params)
+    {
+        auto it = state_.find(static_cast<void*>(p.value().unsafeGetTensorImpl()));
+        if (it == state_.end())
+        {
+            continue;
+        }
+
+        const auto& name = p.key();
+        const auto& s = it->second;
+
+        out[name + ".step"] = torch::tensor({ s.step }, torch::dtype(torch::kInt64));
+
+        if (s.quantized)
+        {
+            out[name + ".exp_avg.codes"] = s.exp_avg_q.codes;
+            out[name + ".exp_avg.scale"] = s.exp_avg_q.scale;
+            out[name + ".exp_avg_sq.codes"] = s.exp_avg_sq_q.codes;
+            out[name + ".exp_avg_sq.scale"] = s.exp_avg_sq_q.scale;
+            if (s.max_exp_avg_sq_q.codes.defined())
+            {
+                out[name + ".max_exp_avg_sq.codes"] = s.max_exp_avg_sq_q.codes;
+                out[name + ".max_exp_avg_sq.scale"] = s.max_exp_avg_sq_q.scale;
+            }
+        }
+        else
+        {
+            out[name + ".exp_avg"] = s.exp_avg_fp32;
+            out[name + ".exp_avg_sq"] = s.exp_avg_sq_fp32;
+            if (s.max_exp_avg_sq_fp32.defined())
+            {
+                out[name + ".max_exp_avg_sq"] = s.max_exp_avg_sq_fp32;
+            }
+        }
+    }
+}
+
+size_t AdamW8bit::load_named_state(const NamedParams& params, const TensorMap& in)
+{
+    torch::NoGradGuard no_grad;
+
+    auto& opt = this->options();
+
+    //state is created for current options and stored tensors are copied into it
+    //if layout does not match (e.g. changed min_quantized_numel), state starts from zero
+    auto restore = [&](torch::Tensor& dst, const std::string& key) -> bool {
+        auto it = in.find(key);
+        if ((it == in.end()) || (dst.defined() == false) || (it->second.sizes() != dst.sizes()))
+        {
+            return false;
+        }
+        dst.copy_(it->second);
+        return true;
+    };
+
+    size_t loaded = 0;
+    for (const auto& p : params)
+    {
+        const auto& name = p.key();
+
+        auto stepIt = in.find(name + ".step");
+        if (stepIt == in.end())
+        {
+            continue;
+        }
+
+        auto* key = static_cast<void*>(p.value().unsafeGetTensorImpl());
+        state_.erase(key);
+
+        auto& s = get_or_init_state(p.value());
+
+        bool ok = true;
+        if (s.quantized)
+        {
+            ok = ok && restore(s.exp_avg_q.codes, name + ".exp_avg.codes");
+            ok = ok && restore(s.exp_avg_q.scale, name + ".exp_avg.scale");
+            ok = ok && restore(s.exp_avg_sq_q.codes, name + ".exp_avg_sq.codes");
+            ok = ok && restore(s.exp_avg_sq_q.scale, name + ".exp_avg_sq.scale");
+            if (opt.amsgrad())
+            {
+                ok = ok && restore(s.max_exp_avg_sq_q.codes, name + ".max_exp_avg_sq.codes");
+                ok = ok && restore(s.max_exp_avg_sq_q.scale, name + ".max_exp_avg_sq.scale");
+            }
+        }
+        else
+        {
+            ok = ok && restore(s.exp_avg_fp32, name + ".exp_avg");
+            ok = ok && restore(s.exp_avg_sq_fp32, name + ".exp_avg_sq");
+            if (opt.amsgrad())
+            {
+                ok = ok && restore(s.max_exp_avg_sq_fp32, name + ".max_exp_avg_sq");
+            }
+        }
+
+        if (ok == false)
+        {
+            state_.erase(key);
+            continue;
+        }
+
+        s.step = stepIt->second.item<int64_t>();
+        loaded++;
+    }
+
+    return loaded;
+}
@@ -10,6 +10,8 @@
 #include <torch/torch.h>
 #include <torch/optim/optimizer.h>
 
+#include "./NamedStateOptimizer.h"
+
 struct AdamW8bitOptions : public torch::optim::OptimizerCloneableOptions<AdamW8bitOptions>
 {
     AdamW8bitOptions(double lr = 1e-3);
@@ -38,7 +40,7 @@ struct AdamW8bitOptions : public torch::optim::OptimizerCloneableOptions<AdamW8b
 
 //======================================================================
 
-class AdamW8bit : public torch::optim::Optimizer 
+class AdamW8bit : public torch::optim::Optimizer, public NamedStateOptimizer
 {
 public:
     explicit AdamW8bit(const std::vector<torch::Tensor>& params, AdamW8bitOptions defaults = {});
@@ -47,6 +49,9 @@ public:
 
     torch::Tensor step(torch::optim::Optimizer::LossClosure closure = nullptr) override;
 
+    void save_named_state(const NamedParams& params, TensorMap& out) const override;
+    size_t load_named_state(const NamedParams& params, const TensorMap& in) override;
+
     const AdamW8bitOptions& options() const noexcept 
     { 
         return *(dynamic_cast<AdamW8bitOptions*>(this->defaults_.get()));
@@ -10,6 +10,8 @@
 #include <torch/torch.h>
 #include <torch/optim/optimizer.h>
 
+#include "./NamedStateOptimizer.h"
+
 struct FusedAdamW8bitOptions : public torch::optim::OptimizerCloneableOptions<FusedAdamW8bitOptions> 
 {
     FusedAdamW8bitOptions(double lr = 1e-3);
@@ -37,7 +39,7 @@ struct FusedAdamW8bitOptions : public torch::optim::OptimizerCloneableOptions<Fu
     void set_lr(const double lr) override;
 };
 
-class FusedAdamW8bit : public torch::optim::Optimizer 
+class FusedAdamW8bit : public torch::optim::Optimizer, public NamedStateOptimizer
 {
   public:
     explicit FusedAdamW8bit(const std::vector<torch::Tensor>& params, FusedAdamW8bitOptions defaults = {});
@@ -48,6 +50,9 @@ class FusedAdamW8bit : public torch::optim::Optimizer
 
     torch::Tensor step(torch::optim::Optimizer::LossClosure closure = nullptr) override;
 
+    void save_named_state(const NamedParams& params, TensorMap& out) const override;
+    size_t load_named_state(const NamedParams& params, const TensorMap& in) override;
+
     const FusedAdamW8bitOptions& options() const noexcept 
     {
         return *(static_cast<FusedAdamW8bitOptions*>(this->defaults_.get()));
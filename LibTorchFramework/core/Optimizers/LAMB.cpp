@@ -214,4 +214,54 @@ LAMB::ParamState& LAMB::get_or_init_state(const torch::Tensor& param)
     auto [inserted_it, inserted] = state_.emplace(key, std::move(s));
     (void)inserted;
     return inserted_it->second;
+}
+
+void LAMB::save_named_state(const NamedParams& params, TensorMap& out) const
+{
+    for (const auto& p : params)
+    {
+        auto it = state_.find(static_cast<void*>(p.value().unsafeGetTensorImpl()));
+        if (it == state_.end())
+        {
+            continue;
+        }
+
+        const auto& name = p.key();
+        const auto& s = it->second;
+
+        out[name + ".step"] = torch::tensor({ s.step }, torch::dtype(torch::kInt64));
+        out[name + ".exp_avg"] = s.exp_avg;
+        out[name + ".exp_avg_sq"] = s.exp_avg_sq;
+    }
+}
+
+size_t LAMB::load_named_state(const NamedParams& params, const TensorMap& in)
+{
+    torch::NoGradGuard no_grad;
+
+    size_t loaded = 0;
+    for (const auto& p : params)
+    {
+        const auto& name = p.key();
+
+        auto stepIt = in.find(name + ".step");
+        auto avgIt = in.find(name + ".exp_avg");
+        auto avgSqIt = in.find(name + ".exp_avg_sq");
+        if ((stepIt == in.end()) || (avgIt == in.end()) || (avgSqIt == in.end()))
+        {
+            continue;
+        }
+        if ((avgIt->second.sizes() != p.value().sizes()) || (avgSqIt->second.sizes() != p.value().sizes()))
+        {
+            continue;
+        }
+
+        auto& s = get_or_init_state(p.value());
+        s.step = stepIt->second.item<int64_t>();
+        s.exp_avg.copy_(avgIt->second);
+        s.exp_avg_sq.copy_(avgSqIt->second);
+        loaded++;
+    }
+
+    return loaded;
 }
\ No newline at end of file
@@ -7,6 +7,8 @@
 
 #include <torch/torch.h>
 
+#include "./NamedStateOptimizer.h"
+
 struct LambOptions : public torch::optim::OptimizerCloneableOptions<LambOptions>
 {    
     LambOptions(double lr = 1e-3);
@@ -30,7 +32,7 @@ struct LambOptions : public torch::optim::OptimizerCloneableOptions<LambOptions>
 
 //======================================================================
 
-class LAMB : public torch::optim::Optimizer
+class LAMB : public torch::optim::Optimizer, public NamedStateOptimizer
 {
 public:        
     explicit LAMB(const std::vector<torch::Tensor>& params, LambOptions defaults = {});
@@ -38,6 +40,9 @@ public:
 
     torch::Tensor step(torch::optim::Optimizer::LossClosure closure = nullptr) override;
 
+    void save_named_state(const NamedParams& params, TensorMap& out) const override;
+    size_t load_named_state(const NamedParams& params, const TensorMap& in) override;
+
     const LambOptions& options() const noexcept
     {
         return *(dynamic_cast<LambOptions*>(this->defaults_.get()));
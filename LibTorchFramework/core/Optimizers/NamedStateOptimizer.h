@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include <torch/torch.h>
+
+// Interface for optimizers that keep per-parameter state in their own
+// map keyed by TensorImpl address (not in torch::optim::Optimizer::state_).
+// That state is invisible to Optimizer::save / load and the addresses
+// are not stable across restarts, so it is exported and imported
+// by parameter name instead.
+//
+// Keys are "<param name>.<state name>", e.g. "layers.0.weight.exp_avg.codes".
+// Quantized states are stored as they are in memory (uint8 codes + per-block
+// float scale), quantization maps are recreated from options.
+class NamedStateOptimizer
+{
+public:
+    using NamedParams = torch::OrderedDict<std::string, torch::Tensor>;
+    using TensorMap = std::unordered_map<std::string, torch::Tensor>;
+
+    virtual ~NamedStateOptimizer() = default;
+
+    virtual void save_named_state(const NamedParams& params, TensorMap& out) const = 0;
+
+    // Returns number of parameters whose state was restored.
+    virtual size_t load_named_state(const NamedParams& params, const TensorMap& in) = 0;
+};
@@ -94,6 +94,31 @@ void Runner::OnEpochStart()
     this->pBar->Start(this->dataLoaderBatchesCount);
 }
 
+/// <summary>
+/// Called before batch is processed
+/// (with PerformanceSettings::batchPrefetchDepth it is already on device,
+/// unless IsBatchSkipped returned true for it)
+/// If true, batch is not processed (e.g. already done in resumed training)
+/// </summary>
+/// <param name="dataIndices">data indices of batch samples</param>
+/// <returns></returns>
+bool Runner::SkipBatch(const std::vector<int64_t>& dataIndices)
+{
+    return false;
+}
+
+/// <summary>
+/// Called on BatchPrefetcher thread before batch is moved to device.
+/// If true, batch is not moved (SkipBatch must return true for it later).
+/// Must not depend on state changed while epoch is running
+/// </summary>
+/// <param name="dataIndices">data indices of batch samples</param>
+/// <returns></returns>
+bool Runner::IsBatchSkipped(const std::vector<int64_t>& dataIndices) const
+{
+    return false;
+}
+
 void Runner::ProcessBatch(DataLoaderData& batch)
 {
     auto loss = this->ForwardAndLoss(batch);
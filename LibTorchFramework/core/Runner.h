@@ -5,6 +5,7 @@ struct DataLoaderData;
 class MetricsDefault;
 class DefaultDataset;
 class ProgressBar;
+class BatchPrefetcher;
 
 #include <torch/torch.h>
 
@@ -13,10 +14,12 @@ class ProgressBar;
 #include "./Structures.h"
 
 #include "../InputProcessing/InputLoader.h"
+#include "../InputProcessing/DataLoaderSample.h"
 
 #include "../Settings.h"
 
 #include "./AbstractModel.h"
+#include "./BatchPrefetcher.h"
 
 class Runner
 {
@@ -39,6 +42,8 @@ protected:
     std::shared_ptr<MetricsDefault> metrics;
     
     std::shared_ptr<ProgressBar> pBar;
+
+    std::shared_ptr<BatchPrefetcher> prefetcher;
     
     size_t batchIndex;
     size_t dataLoaderBatchesCount;
@@ -47,7 +52,12 @@ protected:
 
     torch::Tensor ForwardAndLoss(DataLoaderData& batch);
 
+    template <typename BatchType>
+    void RunBatch(BatchType& loaded);
+
     virtual void OnEpochStart();
+    virtual bool SkipBatch(const std::vector<int64_t>& dataIndices);
+    virtual bool IsBatchSkipped(const std::vector<int64_t>& dataIndices) const;
     virtual void ProcessBatch(DataLoaderData& batch);
     virtual void OnEpochEnd();
     
@@ -86,23 +96,99 @@ void Runner::RunEpoch(DataLoaderType& dl, int epochId, int batchesCount)
     model->OnEpochStart();
 
     batchIndex = 0;
-    
-    for (auto& batch : *dl)
-    {
-        model->OnBatchStart();
 
-        batch.setupDevice(sets);
+    if (sets.perf.batchPrefetchDepth == 0)
+    {
+        for (auto& loaded : *dl)
+        {
+            if (loaded.GetBatchSize() == 0)
+            {
+                //end of stream (StreamingDataset without epoch steps)
+                break;
+            }
+
+            this->RunBatch(loaded);
+        }
+    }
+    else
+    {
+        if (this->prefetcher == nullptr)
+        {
+            this->prefetcher = std::make_shared<BatchPrefetcher>(sets, sets.perf.batchPrefetchDepth);
+        }
+
+        using BatchType = std::decay_t<decltype(*dl->begin())>;
+
+        //data loader is iterated only on prefetcher thread
+        std::optional<decltype(dl->begin())> it;
+        this->prefetcher->Start([&]() -> std::optional<BatchType> {
+            if (it.has_value() == false)
+            {
+                it.emplace(dl->begin());
+            }
+            else
+            {
+                ++(*it);
+            }
+
+            if (*it == dl->end())
+            {
+                return std::nullopt;
+            }
+            return std::move(**it);
+        }, [this](const std::vector<int64_t>& dataIndices) {
+            return this->IsBatchSkipped(dataIndices);
+        });
+
+        try
+        {
+            while (auto batch = this->prefetcher->Next())
+            {
+                this->RunBatch(*batch);
+            }
+        }
+        catch (...)
+        {
+            this->prefetcher->Stop();
+            throw;
+        }
+        this->prefetcher->Stop();
+
+        MY_LOG_INFO("Data wait time: %.3f s", this->prefetcher->GetWaitTime());
+    }
 
-        this->ProcessBatch(batch);
+    model->OnEpochEnd();
 
-        model->OnBatchEnd();
+    this->OnEpochEnd();
+}
 
+/// <summary>
+/// Process single batch of epoch (batchIndex is incremented)
+/// Batch may be already on device (BatchPrefetcher).
+/// Typed batch (DataLoaderSample) is moved to device by its own
+/// setupDevice and converted to DataLoaderData only for the model
+/// </summary>
+/// <param name="loaded"></param>
+template <typename BatchType>
+void Runner::RunBatch(BatchType& loaded)
+{
+    if (this->SkipBatch(loaded.GetDataIndices()))
+    {
         batchIndex++;
+        return;
     }
 
-    model->OnEpochEnd();
+    model->OnBatchStart();
 
-    this->OnEpochEnd();
+    loaded.setupDevice(sets);
+
+    DataLoaderData batch = ToDataLoaderData(std::move(loaded));
+
+    this->ProcessBatch(batch);
+
+    model->OnBatchEnd();
+
+    batchIndex++;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include "./AsyncSnapshotSaver.h"
+
+#include <filesystem>
+#include <unordered_map>
+#include <optional>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#   include <io.h>
+#else
+#   include <unistd.h>
+#endif
+
+#ifdef USE_CUDA
+#   include <ATen/cuda/CUDAContext.h>
+#   include <ATen/cuda/CUDAEvent.h>
+#endif
+
+#include <Utils/Logger.h>
+
+#include "../AbstractModel.h"
+
+#include "./PretrainedManager.h"
+#include "./safetensors.h"
+
+//============================================
+
+struct AsyncSnapshotSaver::StagingBuffer
+{
+    std::string path;
+    std::unordered_map<std::string, std::string> metadata;
+    std::vector<std::pair<std::string, at::Tensor>> tensors;
+
+#ifdef USE_CUDA
+    //recorded after non-blocking copies from device,
+    //writer waits for it before staged data are used
+    std::optional<at::cuda::CUDAEvent> copied;
+#endif
+};
+
+//============================================
+
+AsyncSnapshotSaver::AsyncSnapshotSaver(const AbstractModel* model, size_t maxInFlight) :
+    SnapshotSaver(model),
+    maxInFlight(std::max<size_t>(maxInFlight, 1)),
+    allocatedBuffers(0),
+    writing(0),
+    running(true)
+{
+    writer = std::thread(&AsyncSnapshotSaver::WriterLoop, this);
+}
+
+AsyncSnapshotSaver::~AsyncSnapshotSaver()
+{
+    {
+        std::lock_guard<std::mutex> lk(m);
+        running = false;
+    }
+    cv.notify_all();
+
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+}
+
+/// <summary>
+/// Copy model tensors to staging buffer and enqueue write
+/// Returns after the copy is done, file is written later
+/// </summary>
+/// <param name="pathVariant"></param>
+/// <returns></returns>
+bool AsyncSnapshotSaver::Save(const std::variant<std::string, std::shared_ptr<PretrainedManager>>& pathVariant)
+{
+    std::string path = this->ResolveSavePath(pathVariant);
+
+    if (path.empty())
+    {
+        MY_LOG_INFO("No trained model will be saved");
+        return false;
+    }
+
+    //same tensors as synchronous save of the same format
+    bool isSafetensors = (std::filesystem::path(path).extension() == ".safetensors");
+    auto src = this->CollectTensors(isSafetensors);
+
+    MY_LOG_INFO("Saving trained model%s to %s (async)", deltaMode ? " (delta)" : "", path.c_str());
+
+    this->SaveTensors(path, src, this->BuildMetadata(src));
+
+    return true;
+}
+
+/// <summary>
+/// Copy tensors to staging buffer and enqueue write
+/// Returns after the copy is done, file is written later
+/// </summary>
+/// <param name="path"></param>
+/// <param name="tensors"></param>
+/// <param name="metadata">used only by safetensors</param>
+void AsyncSnapshotSaver::SaveTensors(const std::string& path,
+    const std::vector<std::pair<std::string, at::Tensor>>& tensors,
+    const std::unordered_map<std::string, std::string>& metadata)
+{
+    auto sb = this->AcquireBuffer();
+    sb->path = path;
+    sb->metadata = metadata;
+
+    this->CopyToStaging(tensors, *sb);
+
+    {
+        std::lock_guard<std::mutex> lk(m);
+        pending.push_back(sb);
+    }
+    cv.notify_all();
+}
+
+/// <summary>
+/// Block until all enqueued snapshots are written
+/// </summary>
+void AsyncSnapshotSaver::WaitForAll()
+{
+    std::unique_lock<std::mutex> lk(m);
+    cv.wait(lk, [&] { return pending.empty() && (writing == 0); });
+}
+
+size_t AsyncSnapshotSaver::GetInFlightCount() const
+{
+    std::lock_guard<std::mutex> lk(m);
+    return pending.size() + writing;
+}
+
+/// <summary>
+/// Get free staging buffer from pool
+/// If maxInFlight buffers are already used, wait for writer
+/// </summary>
+/// <returns></returns>
+std::shared_ptr<AsyncSnapshotSaver::StagingBuffer> AsyncSnapshotSaver::AcquireBuffer()
+{
+    std::unique_lock<std::mutex> lk(m);
+    cv.wait(lk, [&] { return (freeBuffers.empty() == false) || (allocatedBuffers < maxInFlight); });
+
+    if (freeBuffers.empty() == false)
+    {
+        auto sb = freeBuffers.back();
+        freeBuffers.pop_back();
+        return sb;
+    }
+
+    allocatedBuffers++;
+    return std::make_shared<StagingBuffer>();
+}
+
+/// <summary>
+/// Copy collected tensors to host staging tensors
+/// Staging tensors are reused if name, shape and dtype match,
+/// so in steady state no host memory is allocated.
+/// Copies from device to pinned staging are non-blocking,
+/// they are ordered on current stream before later updates of tensors
+/// </summary>
+/// <param name="src"></param>
+/// <param name="sb"></param>
+void AsyncSnapshotSaver::CopyToStaging(const std::vector<std::pair<std::string, at::Tensor>>& src, StagingBuffer& sb) const
+{
+    std::unordered_map<std::string, at::Tensor> oldStaging;
+    for (auto& [name, t] : sb.tensors)
+    {
+        oldStaging.try_emplace(name, std::move(t));
+    }
+    sb.tensors.clear();
+    sb.tensors.reserve(src.size());
+
+    torch::NoGradGuard noGrad;
+
+#ifdef USE_CUDA
+    sb.copied.reset();
+#endif
+
+    for (const auto& [name, t] : src)
+    {
+        at::Tensor dst;
+
+        auto it = oldStaging.find(name);
+        if ((it != oldStaging.end()) &&
+            (it->second.sizes() == t.sizes()) &&
+            (it->second.scalar_type() == t.scalar_type()))
+        {
+            dst = it->second;
+        }
+        else
+        {
+            bool pin = (t.device().is_cpu() == false) && torch::cuda::is_available();
+            dst = torch::empty(t.sizes(),
+                torch::TensorOptions().dtype(t.scalar_type()).device(torch::kCPU).pinned_memory(pin));
+        }
+
+        bool nonBlocking = (t.is_cuda()) && (dst.is_pinned());
+        dst.copy_(t, nonBlocking);
+
+#ifdef USE_CUDA
+        if ((nonBlocking) && (sb.copied.has_value() == false))
+        {
+            sb.copied.emplace();
+        }
+#endif
+
+        sb.tensors.emplace_back(name, dst);
+    }
+
+#ifdef USE_CUDA
+    if (sb.copied.has_value())
+    {
+        sb.copied->record(at::cuda::getCurrentCUDAStream());
+    }
+#endif
+}
+
+void AsyncSnapshotSaver::WriterLoop()
+{
+    while (true)
+    {
+        std::shared_ptr<StagingBuffer> sb = nullptr;
+        {
+            std::unique_lock<std::mutex> lk(m);
+            cv.wait(lk, [&] { return (pending.empty() == false) || (running == false); });
+
+            if (pending.empty())
+            {
+                //not running and nothing to write
+                return;
+            }
+
+            sb = pending.front();
+            pending.pop_front();
+            writing++;
+        }
+
+        this->WriteBuffer(*sb);
+
+        {
+            std::lock_guard<std::mutex> lk(m);
+            writing--;
+            freeBuffers.push_back(sb);
+        }
+        cv.notify_all();
+    }
+}
+
+/// <summary>
+/// Write staged tensors to temporary file, flush it to disk
+/// and rename it to final path - partially written snapshot
+/// is never visible under final name
+/// </summary>
+/// <param name="sb"></param>
+void AsyncSnapshotSaver::WriteBuffer(const StagingBuffer& sb) const
+{
+    std::string tmpPath = sb.path + ".tmp";
+
+#ifdef USE_CUDA
+    if (sb.copied.has_value())
+    {
+        sb.copied->synchronize();
+    }
+#endif
+
+    try
+    {
+        if (std::filesystem::path(sb.path).extension() == ".safetensors")
+        {
+            safetensors::SafeTensorManager::TensorMap tensors;
+            for (const auto& [name, t] : sb.tensors)
+            {
+                tensors.try_emplace(name, t);
+            }
+
+            safetensors::SafeTensorManager sm;
+            sm.Save(tensors, tmpPath, sb.metadata);
+        }
+        else
+        {
+            torch::serialize::OutputArchive archive;
+            for (const auto& [name, t] : sb.tensors)
+            {
+                archive.write(name, t);
+            }
+            archive.save_to(tmpPath);
+        }
+
+        FlushFileToDisk(tmpPath);
+
+        std::filesystem::rename(tmpPath, sb.path);
+    }
+    catch (const std::exception& e)
+    {
+        MY_LOG_ERROR("Failed to write snapshot '%s': %s", sb.path.c_str(), e.what());
+
+        std::error_code ec;
+        std::filesystem::remove(tmpPath, ec);
+    }
+}
+
+/// <summary>
+/// Flush written file from OS cache to disk, so it is complete
+/// before it is renamed to its final name
+/// </summary>
+/// <param name="path"></param>
+void AsyncSnapshotSaver::FlushFileToDisk(const std::string& path)
+{
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0)
+    {
+        return;
+    }
+    _commit(fd);
+    _close(fd);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+    fsync(fd);
+    close(fd);
+#endif
+}
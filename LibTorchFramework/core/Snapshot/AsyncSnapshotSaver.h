@@ -0,0 +1,75 @@
+#ifndef ASYNC_SNAPSHOT_SAVER_H
+#define ASYNC_SNAPSHOT_SAVER_H
+
+class AbstractModel;
+class PretrainedManager;
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <string>
+#include <variant>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <torch/torch.h>
+
+#include "./SnapshotSaver.h"
+
+/// <summary>
+/// Snapshot saver that writes files on background thread.
+///
+/// Save copies model tensors into reusable host staging buffers
+/// (pinned if model is on accelerator) - this is the only part
+/// that blocks caller. Copy from device is asynchronous, writer
+/// waits for it. Serialization, fsync and rename of the file
+/// is done on the writer thread.
+///
+/// Saved tensors are the same as with SnapshotSaver for given format.
+///
+/// Number of staging buffers is limited by maxInFlight,
+/// if all are used, Save waits until some write is finished.
+/// </summary>
+class AsyncSnapshotSaver : public SnapshotSaver
+{
+public:
+    explicit AsyncSnapshotSaver(const AbstractModel* model, size_t maxInFlight = 2);
+    virtual ~AsyncSnapshotSaver();
+
+    bool Save(const std::variant<std::string, std::shared_ptr<PretrainedManager>>& path) override;
+
+    //any set of named tensors, format is given by path extension
+    void SaveTensors(const std::string& path,
+        const std::vector<std::pair<std::string, at::Tensor>>& tensors,
+        const std::unordered_map<std::string, std::string>& metadata);
+
+    void WaitForAll();
+    size_t GetInFlightCount() const;
+
+    static void FlushFileToDisk(const std::string& path);
+
+protected:
+    struct StagingBuffer;
+
+    size_t maxInFlight;
+    size_t allocatedBuffers;
+
+    std::vector<std::shared_ptr<StagingBuffer>> freeBuffers;
+    std::deque<std::shared_ptr<StagingBuffer>> pending;
+    size_t writing;
+
+    mutable std::mutex m;
+    std::condition_variable cv;
+    std::thread writer;
+    bool running;
+
+    std::shared_ptr<StagingBuffer> AcquireBuffer();
+    void CopyToStaging(const std::vector<std::pair<std::string, at::Tensor>>& src, StagingBuffer& sb) const;
+
+    void WriterLoop();
+    void WriteBuffer(const StagingBuffer& sb) const;
+};
+
+#endif
@@ -60,6 +60,11 @@ void PretrainedManager::EnableTrainingSnapshot(bool val)
     trainingSnapshot = val; 
 }
 
+bool PretrainedManager::IsTrainingSnapshotEnabled() const
+{
+    return trainingSnapshot;
+}
+
 void PretrainedManager::EnableSaving(bool val) 
 { 
     saveModelEnabled = val; 
@@ -76,6 +81,54 @@ void PretrainedManager::EnableDeleteOldSavedFiles(bool val)
     deleteOldTrainFiles = val; 
 }
 
+/// <summary>
+/// Set format used for saving model weights
+/// Loading detects format from file extension
+/// </summary>
+/// <param name="format"></param>
+void PretrainedManager::SetSnapshotFormat(SnapshotFormat format)
+{
+    snapshotFormat = format;
+}
+
+PretrainedManager::SnapshotFormat PretrainedManager::GetSnapshotFormat() const
+{
+    return snapshotFormat;
+}
+
+/// <summary>
+/// Save only trainable parameters (requires_grad) - e.g. LoRA or partially
+/// frozen model. Delta is always saved as safetensors.
+/// If basePath is set, it is stored in delta and base is loaded
+/// automatically when delta is loaded to model without it
+/// </summary>
+/// <param name="val"></param>
+/// <param name="basePath">path to full snapshot the delta is applied to</param>
+void PretrainedManager::EnableDeltaSnapshots(bool val, std::optional<std::string> basePath)
+{
+    deltaSnapshots = val;
+    deltaBasePath = basePath;
+}
+
+bool PretrainedManager::IsDeltaSnapshotEnabled() const
+{
+    return deltaSnapshots;
+}
+
+std::optional<std::string> PretrainedManager::GetDeltaBasePath() const
+{
+    return deltaBasePath;
+}
+
+std::string PretrainedManager::GetSnapshotExtension(SnapshotFormat format)
+{
+    if (format == SnapshotFormat::SAFETENSORS)
+    {
+        return "safetensors";
+    }
+    return "bin";
+}
+
 void PretrainedManager::ClearFolder()  const
 {
     MY_LOG_INFO("Clearing folder");
@@ -85,28 +138,30 @@ void PretrainedManager::ClearFolder()  const
     }
 }
 
-void PretrainedManager::DeleteOldTrainingFiles(const AbstractModel* model) const
+/// <summary>
+/// Remove files saved by this manager during training, except the
+/// last saved snapshot (and files that share its name, e.g. suffixed ones).
+/// Called after new snapshot was successfully saved
+/// </summary>
+void PretrainedManager::DeleteOldTrainingFiles()
 {
-    if (!deleteOldTrainFiles)
+    if ((!deleteOldTrainFiles) || (saveHistory.empty()))
     {
         return;
     }
     MY_LOG_INFO("Deleting old training files");
 
-    auto lastPath = this->GetPreTrainedWeightsPath(model);
-    if (lastPath.has_value() == false)
-    {
-        return;
-    }
-
-    std::filesystem::path lastFile(lastPath.value());
+    std::filesystem::path lastFile(saveHistory.back());
     std::string lastStem = lastFile.stem().string();
 
+    std::vector<std::string> keep;
+
     for (const auto& pathStr : saveHistory) 
     {
         std::filesystem::path p(pathStr);
         if (p.stem().string().find(lastStem) == 0)
         {
+            keep.push_back(pathStr);
             continue;
         }
         try
@@ -118,9 +173,12 @@ void PretrainedManager::DeleteOldTrainingFiles(const AbstractModel* model) const
         }
         catch (...) 
         {
+            keep.push_back(pathStr);
             continue;
         }
     }
+
+    saveHistory = std::move(keep);
 }
 
 std::string PretrainedManager::BuildFilePathForSave(const AbstractModel* model,
@@ -163,7 +221,10 @@ std::string PretrainedManager::BuildFilePathForSave(const AbstractModel* model,
 
 std::string PretrainedManager::CreatePreTrainedWeightsPath(const AbstractModel* model)
 {
-    return BuildFilePathForSave(model, "", "bin", std::nullopt);
+    //delta needs metadata with base fingerprint - only safetensors can store it
+    auto format = deltaSnapshots ? SnapshotFormat::SAFETENSORS : snapshotFormat;
+
+    return BuildFilePathForSave(model, "", GetSnapshotExtension(format), std::nullopt);
 }
 
 std::optional<std::string> PretrainedManager::GetPreTrainedWeightsPath(const AbstractModel* model) const
@@ -175,20 +236,46 @@ std::optional<std::string> PretrainedManager::GetPreTrainedWeightsPath(const Abs
     std::string wp = "";
 
     std::string fileName = this->GetModelFileName(model);
-    std::filesystem::path finalPath = modelsDir / (fileName + ".bin");
+    std::string ext = "." + GetSnapshotExtension(snapshotFormat);
+    std::filesystem::path finalPath = modelsDir / (fileName + ext);
 
     if (snapshot == "latest")
     {
-        wp = this->GetLatestTimeStampFile(finalPath.string());
+        //newest snapshot of any known format
+        wp = this->GetLatestTimeStampFile(finalPath.string(), { ".bin", ".safetensors" });
     }
     else
     {
         wp = finalPath.string();
+        if (this->CanLoadFile(wp) == false)
+        {
+            //try other format
+            std::string otherExt = (ext == ".bin") ? ".safetensors" : ".bin";
+            std::filesystem::path otherPath = modelsDir / (fileName + otherExt);
+            if (this->CanLoadFile(otherPath.string()))
+            {
+                wp = otherPath.string();
+            }
+        }
     }
 
     return this->CanLoadFile(wp) ? std::make_optional(wp) : std::nullopt;
 }
 
+/// <summary>
+/// Path of training state used to resume interrupted training
+/// There is only one state per model (no timestamp), it is overwritten
+/// during training. State is stored in its own subdirectory,
+/// so it is never found as the latest weights snapshot
+/// </summary>
+/// <param name="model"></param>
+/// <returns></returns>
+std::string PretrainedManager::GetTrainingStatePath(const AbstractModel* model) const
+{
+    std::string fileName = this->GetModelFileName(model);
+    return (modelsDir / TRAINING_STATE_DIR / (fileName + ".safetensors")).string();
+}
+
 std::string PretrainedManager::GetModelFileName(const AbstractModel* model) const
 {    
     std::string fileName = (model != nullptr) ? model->GetName() : "";
@@ -220,6 +307,20 @@ std::string PretrainedManager::AddTimeStampToFilePath(const std::string& filePat
 }
 
 std::string PretrainedManager::GetLatestTimeStampFile(const std::string& filePath) const 
+{
+    return this->GetLatestTimeStampFile(filePath, {});
+}
+
+/// <summary>
+/// Find newest file with timestamp added to filePath
+/// If exts is not empty, only files with one of given extensions
+/// (with leading dot) are considered
+/// </summary>
+/// <param name="filePath"></param>
+/// <param name="exts"></param>
+/// <returns></returns>
+std::string PretrainedManager::GetLatestTimeStampFile(const std::string& filePath, 
+    const std::vector<std::string>& exts) const
 {
     std::filesystem::path basePath(filePath);
     std::string stem = basePath.stem().string();
@@ -232,12 +333,23 @@ std::string PretrainedManager::GetLatestTimeStampFile(const std::string& filePat
 
     for (const auto& entry : std::filesystem::directory_iterator(parent)) 
     {
+        if (entry.is_regular_file() == false)
+        {
+            continue;
+        }
+
         std::string name = entry.path().filename().string();
         if (name.find(patternPrefix) != 0)
         {
             continue;
         }
 
+        if ((exts.empty() == false) && 
+            (std::find(exts.begin(), exts.end(), entry.path().extension().string()) == exts.end()))
+        {
+            continue;
+        }
+
         auto t = std::filesystem::last_write_time(entry);
         auto sysTime = to_time_t(t);
         if (sysTime > bestTime) 
@@ -14,6 +14,15 @@ class FreezeInfo;
 class PretrainedManager 
 {
 public:
+    enum class SnapshotFormat
+    {
+        SERIALIZED,  //torch::serialize::OutputArchive (.bin)
+        SAFETENSORS  //safetensors (.safetensors), loaded via mmap
+    };
+
+    //subdirectory of models directory with training states
+    static constexpr const char* TRAINING_STATE_DIR = "training_state";
+
     explicit PretrainedManager(const std::string& directory,
         std::string snapshot = "latest",
         const std::string& prefix = "");
@@ -23,11 +32,17 @@ public:
     std::string GetModelDir() const;
     
     void EnableTrainingSnapshot(bool val);
+    bool IsTrainingSnapshotEnabled() const;
     void EnableSaving(bool val);
     void EnableLoading(bool val, std::shared_ptr<FreezeInfo> freeze = nullptr);
     void EnableDeleteOldSavedFiles(bool val);
+    void SetSnapshotFormat(SnapshotFormat format);
+    SnapshotFormat GetSnapshotFormat() const;
+    void EnableDeltaSnapshots(bool val, std::optional<std::string> basePath = std::nullopt);
+    bool IsDeltaSnapshotEnabled() const;
+    std::optional<std::string> GetDeltaBasePath() const;
     void ClearFolder() const;
-    void DeleteOldTrainingFiles(const AbstractModel* model) const;
+    void DeleteOldTrainingFiles();
 
     // File path builders
     std::string BuildFilePathForSave(const AbstractModel* model,
@@ -38,6 +53,7 @@ public:
 
     std::string CreatePreTrainedWeightsPath(const AbstractModel* model);
     std::optional<std::string> GetPreTrainedWeightsPath(const AbstractModel* model) const;
+    std::string GetTrainingStatePath(const AbstractModel* model) const;
 
     friend class SnapshotLoader;
 
@@ -49,6 +65,9 @@ private:
     bool loadModelEnabled = true;
     bool deleteOldTrainFiles = false;
     bool saveModelSummaryEnabled = true;
+    SnapshotFormat snapshotFormat = SnapshotFormat::SERIALIZED;
+    bool deltaSnapshots = false;
+    std::optional<std::string> deltaBasePath;
     
     std::filesystem::path modelsDir;
     std::shared_ptr<FreezeInfo> freezeInfo;
@@ -60,6 +79,8 @@ private:
     std::string GetTimeStampFile(const std::string& filePath, const std::tm& date) const;
     std::string AddTimeStampToFilePath(const std::string& filePath) const;
     std::string GetLatestTimeStampFile(const std::string& filePath) const;
+    std::string GetLatestTimeStampFile(const std::string& filePath, const std::vector<std::string>& exts) const;
+    static std::string GetSnapshotExtension(SnapshotFormat format);
     bool CanLoadFile(const std::string& path) const;
 
 };
@@ -3,6 +3,7 @@
 #include <unordered_set>
 #include <string>
 #include <regex>
+#include <filesystem>
 
 #include <FileUtils/Reading/RawFileReader.h>
 #include <Utils/Logger.h>
@@ -11,6 +12,8 @@
 
 #include "./FreezeInfo.h"
 #include "./PretrainedManager.h"
+#include "./SnapshotSaver.h"
+#include "./safetensors.h"
 
 SnapshotLoader::SnapshotLoader(const AbstractModel* model)  :
     model(model) 
@@ -43,6 +46,38 @@ bool SnapshotLoader::Load(const std::variant<std::string, std::shared_ptr<Pretra
         return false;
     }
 
+    deltaTrainable.clear();
+
+    if (this->LoadParameters(path) == false)
+    {
+        return false;
+    }
+
+    if ((fi == nullptr) && (deltaTrainable.empty() == false))
+    {
+        //delta snapshot - train the same parameters as before
+        for (auto& p : model->named_parameters())
+        {
+            p.value().set_requires_grad(deltaTrainable.find(p.key()) != deltaTrainable.end());
+        }
+    }
+    else
+    {
+        model->SetFrozen(fi);
+    }
+
+    return true;
+}
+
+bool SnapshotLoader::LoadParameters(const std::string& path)
+{
+    if (std::filesystem::path(path).extension() == ".safetensors")
+    {
+        MY_LOG_INFO("Loading safetensors trained model from %s", path.c_str());
+
+        return this->LoadParametersFromSafetensors(path);
+    }
+
     MY_LOG_INFO("Loading serialized trained model from %s", path.c_str());
 
     if (this->LoadParametersFromSerialized(path) == false)
@@ -52,8 +87,6 @@ bool SnapshotLoader::Load(const std::variant<std::string, std::shared_ptr<Pretra
         //try to load from pickled pytorch
         this->LoadParametersFromDict(path);        
     }
-                
-    model->SetFrozen(freezeInfo);
 
     return true;
 }
@@ -199,3 +232,117 @@ bool SnapshotLoader::LoadParametersFromDict(const std::string& path)
     return true;
 }
 
+
+
+/// <summary>
+/// Load parameters and buffers from safetensors file
+/// File is memory mapped and each tensor is copied directly
+/// from mapped data to model tensor
+/// 
+/// If file is delta snapshot (only trainable parameters),
+/// model must already contain its base - this is checked by fingerprint.
+/// If it does not and delta has path to the base, base is loaded first
+/// </summary>
+/// <param name="path"></param>
+/// <returns></returns>
+bool SnapshotLoader::LoadParametersFromSafetensors(const std::string& path)
+{
+    std::unique_ptr<safetensors::SafeTensorFile> file;
+    try
+    {
+        file = std::make_unique<safetensors::SafeTensorFile>(path);
+    }
+    catch (const std::exception& e)
+    {
+        MY_LOG_ERROR("Failed to open safetensors %s: %s", path.c_str(), e.what());
+        return false;
+    }
+
+    const auto& metadata = file->GetMetadata();
+    auto deltaIt = metadata.find("delta");
+    bool isDelta = (deltaIt != metadata.end()) && (deltaIt->second == "1");
+
+    if (isDelta)
+    {
+        auto names = file->GetNames();
+        std::unordered_set<std::string> deltaNames(names.begin(), names.end());
+
+        auto fpIt = metadata.find("base_fingerprint");
+        std::string expected = (fpIt != metadata.end()) ? fpIt->second : "";
+
+        if (SnapshotSaver::BuildBaseFingerprint(model, deltaNames) != expected)
+        {
+            auto baseIt = metadata.find("base_path");
+            if ((baseIt == metadata.end()) || (std::filesystem::exists(baseIt->second) == false))
+            {
+                MY_LOG_ERROR("Delta snapshot %s does not match base model and base is not available", path.c_str());
+                return false;
+            }
+
+            MY_LOG_INFO("Loading base of delta snapshot from %s", baseIt->second.c_str());
+            if ((this->LoadParameters(baseIt->second) == false) ||
+                (SnapshotSaver::BuildBaseFingerprint(model, deltaNames) != expected))
+            {
+                MY_LOG_ERROR("Delta snapshot %s does not match its base %s", path.c_str(), baseIt->second.c_str());
+                return false;
+            }
+        }
+
+        deltaTrainable.insert(deltaNames.begin(), deltaNames.end());
+    }
+
+    size_t loaded = 0;
+    auto copyTensor = [&](const std::string& name, at::Tensor& dst) {
+        if (file->Contains(name) == false)
+        {
+            if (isDelta)
+            {
+                //part of base
+                return;
+            }
+            MY_LOG_WARNING("[%s] does not exist in snapshot", name.c_str());
+            return;
+        }
+
+        try
+        {
+            at::Tensor src = file->GetTensorView(name);
+            if (src.sizes() != dst.sizes())
+            {
+                MY_LOG_ERROR("Shape mismatch for key '%s'", name.c_str());
+                return;
+            }
+
+            torch::NoGradGuard no_grad;
+            dst.copy_(src);
+            loaded++;
+        }
+        catch (const std::exception& e)
+        {
+            MY_LOG_ERROR("Error reading '%s': %s", name.c_str(), e.what());
+        }
+    };
+
+    for (auto& p : model->named_parameters())
+    {
+        copyTensor(p.key(), p.value());
+    }
+
+    //see SnapshotSaver - named_buffers on model without buffers may crash
+    if ((isDelta == false) && (model->buffers().size() > 0))
+    {
+        for (auto& b : model->named_buffers())
+        {
+            copyTensor(b.key(), b.value());
+        }
+    }
+
+    //e.g. file with different model or not a weights snapshot
+    if (loaded == 0)
+    {
+        MY_LOG_ERROR("No model tensor was loaded from %s", path.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -8,6 +8,7 @@ class PretrainedManager;
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <variant>
 
@@ -24,11 +25,15 @@ public:
 
 private:
 
+    bool LoadParameters(const std::string& path);
     bool LoadParametersFromSerialized(const std::string& path);
     bool LoadParametersFromDict(const std::string& path);
+    bool LoadParametersFromSafetensors(const std::string& path);
         
    
     const AbstractModel* model;
+
+    std::unordered_set<std::string> deltaTrainable;
 };
 
 #endif
\ No newline at end of file
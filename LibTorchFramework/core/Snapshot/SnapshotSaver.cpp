@@ -1,35 +1,101 @@
 #include "./SnapshotSaver.h"
 
 #include <unordered_set>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
 
 #include <FileUtils/Writing/RawFileWriter.h>
 #include <Utils/Logger.h>
+#include <Utils/3rdParty/xxhash.hpp>
 
 #include "../AbstractModel.h"
 
 #include "./FreezeInfo.h"
 #include "./PretrainedManager.h"
+#include "./safetensors.h"
 
 SnapshotSaver::SnapshotSaver(const AbstractModel* model) :
-    model(model)
+    model(model),
+    deltaMode(false),
+    deltaBasePath(std::nullopt),
+    baseFingerprintKey(0),
+    baseFingerprint("")
 {
 }
 
+/// <summary>
+/// In delta mode, only trainable parameters (requires_grad) are saved
+/// together with fingerprint of the rest of the model (the base).
+/// Size and save time of snapshot depends only on trainable parameters.
+/// Delta is always saved as safetensors
+/// </summary>
+/// <param name="val"></param>
+/// <param name="basePath">optional path to base snapshot, stored in delta</param>
+void SnapshotSaver::EnableDeltaMode(bool val, std::optional<std::string> basePath)
+{
+    deltaMode = val;
+    deltaBasePath = basePath;
+}
+
+bool SnapshotSaver::IsDeltaModeEnabled() const
+{
+    return deltaMode;
+}
+
 
 bool SnapshotSaver::Save(const std::variant<std::string, std::shared_ptr<PretrainedManager>>& pathVariant)
 {
+    std::string path = this->ResolveSavePath(pathVariant);
+
+    if (path.empty())
+    {
+        MY_LOG_INFO("No trained model will be saved");
+        return false;
+    }
+
+    if (deltaMode)
+    {
+        MY_LOG_INFO("Saving trained model (delta) to %s", path.c_str());
+
+        return this->SaveParametersSafetensors(path);
+    }
+
+    MY_LOG_INFO("Saving trained model to %s", path.c_str());
+
+    if (std::filesystem::path(path).extension() == ".safetensors")
+    {
+        return this->SaveParametersSafetensors(path);
+    }
+    else
+    {
+        this->SaveParametersSerialized(path);
+    }
+
+    
+    return true;
+}
 
+
+/// <summary>
+/// Path of saved file. Delta mode is not changed here,
+/// it must be enabled by EnableDeltaMode 
+/// (e.g. Trainer does it if PretrainedManager has delta snapshots enabled)
+/// </summary>
+/// <param name="pathVariant"></param>
+/// <returns>empty if nothing should be saved</returns>
+std::string SnapshotSaver::ResolveSavePath(const std::variant<std::string, std::shared_ptr<PretrainedManager>>& pathVariant) const
+{
     std::string path;
-   
 
     if (std::holds_alternative<std::shared_ptr<PretrainedManager>>(pathVariant))
     {
         std::shared_ptr<PretrainedManager> pm = std::get<std::shared_ptr<PretrainedManager>>(pathVariant);
         if (pm == nullptr)
         {
-            MY_LOG_INFO("No trained model will be saved");
-            return false;
+            return "";
         }
+
         path = pm->CreatePreTrainedWeightsPath(model);
     }
     else
@@ -37,20 +103,159 @@ bool SnapshotSaver::Save(const std::variant<std::string, std::shared_ptr<Pretrai
         path = std::get<std::string>(pathVariant);
     }
 
-    if (path.empty())
+    if ((deltaMode) && (std::filesystem::path(path).extension() != ".safetensors"))
     {
-        MY_LOG_INFO("No trained model will be saved");
-        return false;
+        MY_LOG_WARNING("Delta snapshot is saved as safetensors");
+        path = std::filesystem::path(path).replace_extension(".safetensors").string();
     }
 
-    MY_LOG_INFO("Saving trained model to %s", path.c_str());
+    return path;
+}
 
-    this->SaveParametersSerialized(path);
+/// <summary>
+/// Get tensors that are saved to snapshot
+/// All parameters and buffers, or only trainable parameters in delta mode.
+/// Serialized (.bin) snapshot has no buffers (see SaveParametersSerialized)
+/// </summary>
+/// <param name="includeBuffers"></param>
+/// <returns></returns>
+std::vector<std::pair<std::string, at::Tensor>> SnapshotSaver::CollectTensors(bool includeBuffers) const
+{
+    std::vector<std::pair<std::string, at::Tensor>> tensors;
 
-    
-    return true;
+    for (const auto& p : model->named_parameters())
+    {
+        if ((deltaMode) && (p.value().requires_grad() == false))
+        {
+            continue;
+        }
+        tensors.emplace_back(p.key(), p.value().detach());
+    }
+
+    if ((deltaMode) || (includeBuffers == false))
+    {
+        return tensors;
+    }
+
+    //see SaveParametersSerialized - named_buffers on model without buffers may crash
+    if (model->buffers().size() > 0)
+    {
+        for (const auto& b : model->named_buffers())
+        {
+            tensors.emplace_back(b.key(), b.value().detach());
+        }
+    }
+
+    return tensors;
 }
 
+/// <summary>
+/// Metadata stored in safetensors snapshot
+/// Delta has base fingerprint, it is computed only once
+/// for the same set of trainable parameters (frozen ones do not change)
+/// </summary>
+/// <param name="tensors"></param>
+/// <returns></returns>
+std::unordered_map<std::string, std::string> SnapshotSaver::BuildMetadata(const std::vector<std::pair<std::string, at::Tensor>>& tensors)
+{
+    std::unordered_map<std::string, std::string> metadata = { {"format", "pt"} };
+
+    if (deltaMode == false)
+    {
+        return metadata;
+    }
+
+    std::unordered_set<std::string> deltaNames;
+    std::string namesKey;
+    for (const auto& [name, t] : tensors)
+    {
+        deltaNames.insert(name);
+        namesKey += name;
+        namesKey += ';';
+    }
+
+    uint64_t key = xxh::xxhash<64>(namesKey);
+    if ((baseFingerprint.empty()) || (key != baseFingerprintKey))
+    {
+        baseFingerprint = BuildBaseFingerprint(model, deltaNames);
+        baseFingerprintKey = key;
+    }
+
+    metadata["delta"] = "1";
+    metadata["base_fingerprint"] = baseFingerprint;
+    if (deltaBasePath.has_value())
+    {
+        metadata["base_path"] = *deltaBasePath;
+    }
+
+    return metadata;
+}
+
+/// <summary>
+/// Fingerprint of model parameters that are not part of delta.
+/// Uses names, dtypes, shapes and few sampled values of each tensor,
+/// so it is cheap even for large models and detects different
+/// architecture or different base weights
+/// </summary>
+/// <param name="model"></param>
+/// <param name="deltaNames"></param>
+/// <returns></returns>
+std::string SnapshotSaver::BuildBaseFingerprint(const AbstractModel* model,
+    const std::unordered_set<std::string>& deltaNames)
+{
+    const int64_t SAMPLES = 8;
+
+    std::vector<std::pair<std::string, at::Tensor>> base;
+    for (const auto& p : model->named_parameters())
+    {
+        if (deltaNames.find(p.key()) == deltaNames.end())
+        {
+            base.emplace_back(p.key(), p.value());
+        }
+    }
+
+    std::sort(base.begin(), base.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    torch::NoGradGuard noGrad;
+
+    std::string data;
+    for (const auto& [name, t] : base)
+    {
+        data += name;
+        data += ':';
+        data += c10::toString(t.scalar_type());
+        for (auto s : t.sizes())
+        {
+            data += ',';
+            data += std::to_string(s);
+        }
+        data += ';';
+
+        auto flat = t.detach().reshape({ -1 });
+        int64_t n = flat.numel();
+        if (n == 0)
+        {
+            continue;
+        }
+
+        //first, middle and last values
+        int64_t mid = n / 2;
+        auto samples = torch::cat({
+            flat.slice(0, 0, std::min(SAMPLES, n)),
+            flat.slice(0, mid, std::min(mid + SAMPLES, n)),
+            flat.slice(0, std::max<int64_t>(n - SAMPLES, 0), n)
+        }).to(torch::kCPU).contiguous();
+
+        data.append(static_cast<const char*>(samples.data_ptr()), samples.nbytes());
+    }
+
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(xxh::xxhash<64>(data)));
+    
+    return buf;
+}
 
 void SnapshotSaver::SaveParametersSerialized(const std::string& path)
 {
@@ -142,3 +347,37 @@ void SnapshotSaver::SaveParametersAsDict(const std::string& path)
     wf.Write(f);
     wf.Close();    
 }
+
+
+/// <summary>
+/// Save parameters and buffers (only trainable parameters in delta mode) 
+/// to safetensors file
+/// File can be directly loaded in python with safetensors.torch.load_file
+/// </summary>
+/// <param name="path"></param>
+/// <returns>false if file was not written</returns>
+bool SnapshotSaver::SaveParametersSafetensors(const std::string& path)
+{
+    auto collected = this->CollectTensors();
+    auto metadata = this->BuildMetadata(collected);
+
+    // Tensors are moved to CPU one by one during write
+    safetensors::SafeTensorManager::TensorMap tensors;
+    for (auto& [name, t] : collected)
+    {
+        tensors.try_emplace(name, t);
+    }
+
+    try
+    {
+        safetensors::SafeTensorManager sm;
+        sm.Save(tensors, path, metadata);
+    }
+    catch (const std::exception& e)
+    {
+        MY_LOG_ERROR("Failed to save safetensors '%s': %s", path.c_str(), e.what());
+        return false;
+    }
+
+    return true;
+}
@@ -8,7 +8,9 @@ class PretrainedManager;
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <optional>
 #include <variant>
 
 #include <torch/torch.h>
@@ -17,13 +19,32 @@ class SnapshotSaver
 {
 public:
     explicit SnapshotSaver(const AbstractModel* model);
+    virtual ~SnapshotSaver() = default;
 
-    bool Save(const std::variant<std::string, std::shared_ptr<PretrainedManager>>& path);
+    virtual bool Save(const std::variant<std::string, std::shared_ptr<PretrainedManager>>& path);
 
-private:
+    void EnableDeltaMode(bool val, std::optional<std::string> basePath = std::nullopt);
+    bool IsDeltaModeEnabled() const;
+
+    static std::string BuildBaseFingerprint(const AbstractModel* model, 
+        const std::unordered_set<std::string>& deltaNames);
+
+protected:
+
+    bool deltaMode;
+    std::optional<std::string> deltaBasePath;
+
+    uint64_t baseFingerprintKey;
+    std::string baseFingerprint;
+
+    std::string ResolveSavePath(const std::variant<std::string, std::shared_ptr<PretrainedManager>>& path) const;
+
+    std::vector<std::pair<std::string, at::Tensor>> CollectTensors(bool includeBuffers = true) const;
+    std::unordered_map<std::string, std::string> BuildMetadata(const std::vector<std::pair<std::string, at::Tensor>>& tensors);
 
     void SaveParametersSerialized(const std::string& path);
     void SaveParametersAsDict(const std::string& path);
+    bool SaveParametersSafetensors(const std::string& path);
     
     const AbstractModel* model;
 };
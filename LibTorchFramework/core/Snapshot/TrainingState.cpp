@@ -0,0 +1,442 @@
+#include "./TrainingState.h"
+
+#include <filesystem>
+#include <sstream>
+#include <cstring>
+#include <mutex>
+
+#include <ATen/CPUGeneratorImpl.h>
+#ifdef USE_CUDA
+#   include <ATen/cuda/CUDAGeneratorImpl.h>
+#endif
+
+#include <Utils/Logger.h>
+
+#include "../AbstractModel.h"
+
+#include "../Optimizers/NamedStateOptimizer.h"
+
+#include "../Modules/gradscaler.hpp"
+
+#include "./AsyncSnapshotSaver.h"
+#include "./safetensors.h"
+
+TrainingState::TrainingState() :
+    epochId(0),
+    batchesCount(0),
+    processedCount(0),
+    shuffleSeed(std::nullopt)
+{
+}
+
+int TrainingState::GetEpochId() const
+{
+    return this->epochId;
+}
+
+size_t TrainingState::GetBatchesCount() const
+{
+    return this->batchesCount;
+}
+
+size_t TrainingState::GetProcessedBatchesCount() const
+{
+    return this->processedCount;
+}
+
+std::optional<int> TrainingState::GetShuffleSeed() const
+{
+    return this->shuffleSeed;
+}
+
+/// <summary>
+/// Start new epoch - all batches are marked as not processed
+/// </summary>
+/// <param name="epochId"></param>
+/// <param name="batchesCount">batches in epoch (batch ids may be larger, see MarkBatchProcessed)</param>
+void TrainingState::SetEpoch(int epochId, size_t batchesCount)
+{
+    this->epochId = epochId;
+    this->batchesCount = batchesCount;
+    this->processedBatches.assign(batchesCount, 0);
+    this->processedCount = 0;
+}
+
+void TrainingState::SetShuffleSeed(std::optional<int> seed)
+{
+    this->shuffleSeed = seed;
+}
+
+/// <summary>
+/// Batch id does not have to be smaller than batches count
+/// (e.g. bucketed batches use first data index), flags grow as needed
+/// </summary>
+/// <param name="batchId"></param>
+void TrainingState::MarkBatchProcessed(size_t batchId)
+{
+    if (batchId >= processedBatches.size())
+    {
+        processedBatches.resize(batchId + 1, 0);
+    }
+    if (processedBatches[batchId] == 0)
+    {
+        processedBatches[batchId] = 1;
+        processedCount++;
+    }
+}
+
+bool TrainingState::IsBatchProcessed(size_t batchId) const
+{
+    return (batchId < processedBatches.size()) && (processedBatches[batchId] != 0);
+}
+
+/// <summary>
+/// Capture current model weights, optimizer, scaler and RNG states.
+/// Captured tensors reference live data, Save should be called
+/// right after Capture
+/// </summary>
+/// <param name="model"></param>
+/// <param name="scaler">can be nullptr</param>
+void TrainingState::Capture(const AbstractModel* model, const torch::amp::GradScaler* scaler)
+{
+    tensors.clear();
+
+    for (const auto& p : model->named_parameters())
+    {
+        tensors["model." + p.key()] = p.value().detach();
+    }
+
+    //see SnapshotSaver - named_buffers on model without buffers may crash
+    if (model->buffers().size() > 0)
+    {
+        for (const auto& b : model->named_buffers())
+        {
+            tensors["model." + b.key()] = b.value().detach();
+        }
+    }
+
+    if (model->optimizer)
+    {
+        if (auto named = dynamic_cast<const NamedStateOptimizer*>(model->optimizer.get()))
+        {
+            NamedStateOptimizer::TensorMap state;
+            named->save_named_state(model->named_parameters(), state);
+            for (auto& [k, v] : state)
+            {
+                tensors["optim." + k] = v;
+            }
+        }
+        else
+        {
+            //torch optimizers keep state in base class, use its own serialization
+            torch::serialize::OutputArchive archive;
+            model->optimizer->save(archive);
+            tensors["optim_archive"] = ArchiveToTensor(archive);
+        }
+    }
+
+    if (scaler)
+    {
+        torch::serialize::OutputArchive archive;
+        scaler->save(archive);
+        tensors["scaler_archive"] = ArchiveToTensor(archive);
+    }
+
+    {
+        auto gen = at::detail::getDefaultCPUGenerator();
+        std::lock_guard<std::mutex> lock(gen.mutex());
+        tensors["rng.cpu"] = gen.get_state();
+    }
+
+#ifdef USE_CUDA
+    for (int i = 0; i < int(torch::cuda::device_count()); i++)
+    {
+        auto gen = at::cuda::detail::getDefaultCUDAGenerator(i);
+        std::lock_guard<std::mutex> lock(gen.mutex());
+        tensors["rng.cuda." + std::to_string(i)] = gen.get_state();
+    }
+#endif
+}
+
+/// <summary>
+/// Restore loaded state to model, optimizer, scaler and RNG.
+/// Model should already be on its training device, so optimizer
+/// state is created on the same device as parameters
+/// </summary>
+/// <param name="model"></param>
+/// <param name="scaler">can be nullptr</param>
+void TrainingState::Restore(AbstractModel* model, torch::amp::GradScaler* scaler) const
+{
+    torch::NoGradGuard noGrad;
+
+    auto weights = GetWithPrefix(tensors, "model.");
+
+    size_t restored = 0;
+    auto copyWeight = [&](const std::string& name, torch::Tensor& t) {
+        auto it = weights.find(name);
+        if (it == weights.end())
+        {
+            MY_LOG_WARNING("Training state - %s not found", name.c_str());
+            return;
+        }
+        if (it->second.sizes() != t.sizes())
+        {
+            MY_LOG_WARNING("Training state - %s has different shape", name.c_str());
+            return;
+        }
+        t.copy_(it->second);
+        restored++;
+    };
+
+    for (auto& p : model->named_parameters())
+    {
+        copyWeight(p.key(), p.value());
+    }
+    if (model->buffers().size() > 0)
+    {
+        for (auto& b : model->named_buffers())
+        {
+            copyWeight(b.key(), b.value());
+        }
+    }
+    MY_LOG_INFO("Training state - restored %zu / %zu model tensors", restored, weights.size());
+
+    if (model->optimizer)
+    {
+        if (auto named = dynamic_cast<NamedStateOptimizer*>(model->optimizer.get()))
+        {
+            size_t count = named->load_named_state(model->named_parameters(), GetWithPrefix(tensors, "optim."));
+            MY_LOG_INFO("Training state - optimizer state restored for %zu parameters", count);
+        }
+        else if (auto it = tensors.find("optim_archive"); it != tensors.end())
+        {
+            torch::serialize::InputArchive archive;
+            TensorToArchive(it->second, archive);
+            model->optimizer->load(archive);
+        }
+    }
+
+    if (scaler)
+    {
+        if (auto it = tensors.find("scaler_archive"); it != tensors.end())
+        {
+            try
+            {
+                torch::serialize::InputArchive archive;
+                TensorToArchive(it->second, archive);
+                scaler->load(archive);
+            }
+            catch (const std::exception& e)
+            {
+                MY_LOG_WARNING("Training state - unable to restore GradScaler: %s", e.what());
+            }
+        }
+    }
+
+    if (auto it = tensors.find("rng.cpu"); it != tensors.end())
+    {
+        auto gen = at::detail::getDefaultCPUGenerator();
+        std::lock_guard<std::mutex> lock(gen.mutex());
+        gen.set_state(it->second);
+    }
+
+#ifdef USE_CUDA
+    for (int i = 0; i < int(torch::cuda::device_count()); i++)
+    {
+        auto it = tensors.find("rng.cuda." + std::to_string(i));
+        if (it == tensors.end())
+        {
+            continue;
+        }
+        auto gen = at::cuda::detail::getDefaultCUDAGenerator(i);
+        std::lock_guard<std::mutex> lock(gen.mutex());
+        gen.set_state(it->second);
+    }
+#endif
+}
+
+/// <summary>
+/// Tensors and metadata of state file. Scalars are stored in metadata,
+/// processed flags reference this object (copied during save)
+/// </summary>
+/// <param name="all"></param>
+/// <param name="metadata"></param>
+void TrainingState::BuildFileContent(std::vector<std::pair<std::string, torch::Tensor>>& all,
+    std::unordered_map<std::string, std::string>& metadata) const
+{
+    all.assign(tensors.begin(), tensors.end());
+    if (processedBatches.empty() == false)
+    {
+        all.emplace_back("loader.processed", torch::from_blob(const_cast<uint8_t*>(processedBatches.data()),
+            { int64_t(processedBatches.size()) }, torch::kUInt8));
+    }
+
+    metadata = {
+        {"format", "pt"},
+        {"epoch", std::to_string(epochId)},
+        {"batches", std::to_string(batchesCount)},
+        {"processed_batches", std::to_string(processedCount)}
+    };
+    if (shuffleSeed.has_value())
+    {
+        metadata["shuffle_seed"] = std::to_string(*shuffleSeed);
+    }
+}
+
+/// <summary>
+/// Save state to temporary file, flush it to disk and rename it,
+/// so the previous state stays valid if writing is interrupted
+/// </summary>
+/// <param name="path"></param>
+/// <returns></returns>
+bool TrainingState::Save(const std::string& path) const
+{
+    std::string tmpPath = path + ".tmp";
+
+    try
+    {
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+
+        std::vector<std::pair<std::string, torch::Tensor>> content;
+        std::unordered_map<std::string, std::string> metadata;
+        this->BuildFileContent(content, metadata);
+
+        safetensors::SafeTensorManager::TensorMap all(content.begin(), content.end());
+
+        safetensors::SafeTensorManager sm;
+        sm.Save(all, tmpPath, metadata);
+
+        AsyncSnapshotSaver::FlushFileToDisk(tmpPath);
+
+        std::filesystem::rename(tmpPath, path);
+    }
+    catch (const std::exception& e)
+    {
+        MY_LOG_ERROR("Failed to save training state '%s': %s", path.c_str(), e.what());
+
+        std::error_code ec;
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Save state on writer thread of saver. Only copy of tensors
+/// to staging buffers is done on calling thread
+/// </summary>
+/// <param name="path"></param>
+/// <param name="saver"></param>
+void TrainingState::Save(const std::string& path, AsyncSnapshotSaver& saver) const
+{
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+
+    std::vector<std::pair<std::string, torch::Tensor>> content;
+    std::unordered_map<std::string, std::string> metadata;
+    this->BuildFileContent(content, metadata);
+
+    saver.SaveTensors(path, content, metadata);
+}
+
+bool TrainingState::Load(const std::string& path)
+{
+    if (std::filesystem::exists(path) == false)
+    {
+        return false;
+    }
+
+    try
+    {
+        safetensors::SafeTensorFile f(path);
+
+        const auto& metadata = f.GetMetadata();
+        auto getMeta = [&](const std::string& key) -> std::optional<std::string> {
+            auto it = metadata.find(key);
+            return (it != metadata.end()) ? std::make_optional(it->second) : std::nullopt;
+        };
+
+        tensors = f.GetTensors("*", true);
+
+        this->epochId = std::stoi(getMeta("epoch").value_or("0"));
+        this->shuffleSeed = std::nullopt;
+        if (auto seed = getMeta("shuffle_seed"))
+        {
+            this->shuffleSeed = std::stoi(*seed);
+        }
+
+        this->batchesCount = std::stoull(getMeta("batches").value_or("0"));
+        this->processedBatches.assign(batchesCount, 0);
+        this->processedCount = 0;
+
+        if (auto it = tensors.find("loader.processed"); it != tensors.end())
+        {
+            auto flags = it->second.contiguous();
+            if (size_t(flags.numel()) > processedBatches.size())
+            {
+                processedBatches.resize(size_t(flags.numel()), 0);
+            }
+            std::memcpy(processedBatches.data(), flags.data_ptr<uint8_t>(), size_t(flags.numel()));
+
+            for (auto v : processedBatches)
+            {
+                processedCount += (v != 0) ? 1 : 0;
+            }
+
+            tensors.erase(it);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        MY_LOG_ERROR("Failed to load training state '%s': %s", path.c_str(), e.what());
+        tensors.clear();
+        return false;
+    }
+
+    MY_LOG_INFO("Training state loaded from %s (epoch: %d, processed batches: %zu / %zu)",
+        path.c_str(), epochId, processedCount, batchesCount);
+
+    return true;
+}
+
+/// <summary>
+/// Release captured / loaded tensors
+/// (loaded state holds copy of weights and optimizer state)
+/// </summary>
+void TrainingState::ReleaseTensors()
+{
+    tensors.clear();
+}
+
+//============================================================
+
+torch::Tensor TrainingState::ArchiveToTensor(torch::serialize::OutputArchive& archive)
+{
+    std::ostringstream oss;
+    archive.save_to(oss);
+    std::string data = oss.str();
+
+    auto t = torch::empty({ int64_t(data.size()) }, torch::kUInt8);
+    std::memcpy(t.data_ptr<uint8_t>(), data.data(), data.size());
+    return t;
+}
+
+void TrainingState::TensorToArchive(const torch::Tensor& t, torch::serialize::InputArchive& archive)
+{
+    auto c = t.to(torch::kCPU).contiguous();
+    std::istringstream iss(std::string(reinterpret_cast<const char*>(c.data_ptr<uint8_t>()), c.numel()));
+    archive.load_from(iss);
+}
+
+TrainingState::TensorMap TrainingState::GetWithPrefix(const TensorMap& src, const std::string& prefix)
+{
+    TensorMap res;
+    for (const auto& [k, v] : src)
+    {
+        if (k.compare(0, prefix.size(), prefix) == 0)
+        {
+            res.try_emplace(k.substr(prefix.size()), v);
+        }
+    }
+    return res;
+}
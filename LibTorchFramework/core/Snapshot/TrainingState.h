@@ -0,0 +1,77 @@
+#ifndef TRAINING_STATE_H
+#define TRAINING_STATE_H
+
+class AbstractModel;
+class AsyncSnapshotSaver;
+
+namespace torch {
+    namespace amp {
+        class GradScaler;
+    }
+}
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+
+#include <torch/torch.h>
+
+/// <summary>
+/// Everything besides model weights that is needed to continue
+/// interrupted training at exactly the same place:
+/// optimizer state (by parameter name), GradScaler, RNG states,
+/// epoch index, data split seed and already processed batches
+/// of the current epoch.
+///
+/// Stored as single safetensors file, scalars are in metadata.
+/// Processed batches are stored as per-batch flags (not a counter),
+/// because with multiple workers batches do not arrive in order.
+/// </summary>
+class TrainingState
+{
+public:
+    TrainingState();
+    ~TrainingState() = default;
+
+    int GetEpochId() const;
+    size_t GetBatchesCount() const;
+    size_t GetProcessedBatchesCount() const;
+    std::optional<int> GetShuffleSeed() const;
+
+    void SetEpoch(int epochId, size_t batchesCount);
+    void SetShuffleSeed(std::optional<int> seed);
+
+    void MarkBatchProcessed(size_t batchId);
+    bool IsBatchProcessed(size_t batchId) const;
+
+    void Capture(const AbstractModel* model, const torch::amp::GradScaler* scaler);
+    void Restore(AbstractModel* model, torch::amp::GradScaler* scaler) const;
+
+    bool Save(const std::string& path) const;
+    void Save(const std::string& path, AsyncSnapshotSaver& saver) const;
+    bool Load(const std::string& path);
+
+    void ReleaseTensors();
+
+protected:
+    using TensorMap = std::unordered_map<std::string, torch::Tensor>;
+
+    int epochId;
+    size_t batchesCount;
+    std::vector<uint8_t> processedBatches; //indexed by batch id
+    size_t processedCount;
+    std::optional<int> shuffleSeed;
+
+    TensorMap tensors;
+
+    void BuildFileContent(std::vector<std::pair<std::string, torch::Tensor>>& all,
+        std::unordered_map<std::string, std::string>& metadata) const;
+
+    static torch::Tensor ArchiveToTensor(torch::serialize::OutputArchive& archive);
+    static void TensorToArchive(const torch::Tensor& t, torch::serialize::InputArchive& archive);
+
+    static TensorMap GetWithPrefix(const TensorMap& src, const std::string& prefix);
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <cstring>
 #include <algorithm>
 #include <climits>
+#include <cstdio>
 #include <fcntl.h>
 #include <FileUtils/MemMapFile.h>
 
@@ -22,27 +23,99 @@ void SimpleJSONParser::skipWhitespace()
 		pos++;
 }
 
+/// <summary>
+/// Parse string at current position, escape sequences are decoded
+/// (\uXXXX is stored as UTF-8)
+/// </summary>
+/// <returns></returns>
 std::string SimpleJSONParser::parseString()
 {
 	std::string result;
 	pos++; // Skip opening quote
 	while (json[pos] != '"')
 	{
-		if (json[pos] == '\\')
+		if (json[pos] == '\0')
 		{
-			pos++;
-			if (json[pos] == 'u')
+			throw SafetensorsException("Unterminated string");
+		}
+
+		if (json[pos] != '\\')
+		{
+			result += json[pos++];
+			continue;
+		}
+
+		pos++; // Skip backslash
+		char c = json[pos++];
+		switch (c)
+		{
+		case '"': result += '"'; break;
+		case '\\': result += '\\'; break;
+		case '/': result += '/'; break;
+		case 'b': result += '\b'; break;
+		case 'f': result += '\f'; break;
+		case 'n': result += '\n'; break;
+		case 'r': result += '\r'; break;
+		case 't': result += '\t'; break;
+		case 'u':
+		{
+			uint32_t cp = parseHex4();
+
+			//surrogate pair
+			if ((cp >= 0xD800) && (cp <= 0xDBFF) && (json[pos] == '\\') && (json[pos + 1] == 'u'))
 			{
-				// Handle Unicode escape (simplified)
-				pos += 4;
+				pos += 2;
+				uint32_t low = parseHex4();
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
 			}
+
+			if (cp < 0x80)
+			{
+				result += char(cp);
+			}
+			else if (cp < 0x800)
+			{
+				result += char(0xC0 | (cp >> 6));
+				result += char(0x80 | (cp & 0x3F));
+			}
+			else if (cp < 0x10000)
+			{
+				result += char(0xE0 | (cp >> 12));
+				result += char(0x80 | ((cp >> 6) & 0x3F));
+				result += char(0x80 | (cp & 0x3F));
+			}
+			else
+			{
+				result += char(0xF0 | (cp >> 18));
+				result += char(0x80 | ((cp >> 12) & 0x3F));
+				result += char(0x80 | ((cp >> 6) & 0x3F));
+				result += char(0x80 | (cp & 0x3F));
+			}
+			break;
+		}
+		default:
+			throw SafetensorsException("Invalid escape sequence in string");
 		}
-		result += json[pos++];
 	}
 	pos++; // Skip closing quote
 	return result;
 }
 
+uint32_t SimpleJSONParser::parseHex4()
+{
+	uint32_t v = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		char c = json[pos++];
+		v <<= 4;
+		if ((c >= '0') && (c <= '9')) v |= uint32_t(c - '0');
+		else if ((c >= 'a') && (c <= 'f')) v |= uint32_t(c - 'a' + 10);
+		else if ((c >= 'A') && (c <= 'F')) v |= uint32_t(c - 'A' + 10);
+		else throw SafetensorsException("Invalid \\u escape in string");
+	}
+	return v;
+}
+
 std::vector<int64_t> SimpleJSONParser::parseArray()
 {
 	std::vector<int64_t> result;
@@ -202,6 +275,57 @@ std::unordered_map<std::string, TensorInfo> SimpleJSONParser::parse()
 	return result;
 }
 
+std::unordered_map<std::string, std::string> SimpleJSONParser::parseMetadata()
+{
+	size_t startPos = pos;
+	std::unordered_map<std::string, std::string> result;
+	skipWhitespace();
+	if (json[pos++] != '{')
+		throw SafetensorsException("Expected object");
+	while (json[pos] != '}')
+	{
+		skipWhitespace();
+		std::string key = parseString();
+		skipWhitespace();
+		pos++; // Skip colon
+		skipWhitespace();
+		if (key == "__metadata__")
+		{
+			pos++; // Skip opening brace
+			skipWhitespace();
+			while (json[pos] != '}')
+			{
+				std::string metaKey = parseString();
+				skipWhitespace();
+				pos++; // Skip colon
+				skipWhitespace();
+				if (json[pos] == '"')
+				{
+					result[metaKey] = parseString();
+				}
+				else
+				{
+					//only string values are allowed by the format
+					skipValue();
+				}
+				skipWhitespace();
+				if (json[pos] == ',')
+					pos++;
+				skipWhitespace();
+			}
+			break;
+		}
+		skipValue();
+		skipWhitespace();
+		if (json[pos] == ',')
+		{
+			pos++;
+		}
+	}
+	pos = startPos;
+	return result;
+}
+
 
 //===============================================================================
 
@@ -270,6 +394,43 @@ void SafeTensorManager::validate_string_length(const std::string& str, const std
 	}
 }
 
+/// <summary>
+/// Escape string for JSON header (quotes, backslashes, control characters),
+/// e.g. Windows paths in metadata
+/// </summary>
+/// <param name="str"></param>
+/// <returns></returns>
+std::string SafeTensorManager::escape_json_string(const std::string& str)
+{
+	std::string res;
+	res.reserve(str.size());
+	for (char c : str)
+	{
+		switch (c)
+		{
+		case '"': res += "\\\""; break;
+		case '\\': res += "\\\\"; break;
+		case '\b': res += "\\b"; break;
+		case '\f': res += "\\f"; break;
+		case '\n': res += "\\n"; break;
+		case '\r': res += "\\r"; break;
+		case '\t': res += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char buf[7];
+				snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+				res += buf;
+			}
+			else
+			{
+				res += c;
+			}
+		}
+	}
+	return res;
+}
+
 std::unordered_map<std::string, TensorInfo> SafeTensorManager::ParseHeaderInfo(const char* data, size_t size)
 {
 	if (size < 8)
@@ -419,7 +580,7 @@ SafeTensorManager::TensorMap SafeTensorManager::Load(const std::string& filename
 
 
 
-inline void SafeTensorManager::Save(const SafeTensorManager::TensorMap& tensors, const std::string& filename, 
+void SafeTensorManager::Save(const SafeTensorManager::TensorMap& tensors, const std::string& filename, 
 	const std::unordered_map<std::string, std::string>& metadata)
 {
 	if (tensors.size() > SAFETENSORS_MAX_TENSORS)
@@ -427,8 +588,16 @@ inline void SafeTensorManager::Save(const SafeTensorManager::TensorMap& tensors,
 		throw SafetensorsException("Number of tensors exceeds maximum allowed");
 	}
 
+	//sorted names - file content does not depend on map ordering
+	std::vector<std::string> names;
+	names.reserve(tensors.size());
+	for (const auto& [name, _] : tensors)
+	{
+		names.push_back(name);
+	}
+	std::sort(names.begin(), names.end());
+
 	std::string header_json = "{";
-	std::vector<char> data_buffer;
 	size_t current_offset = 0;
 
 	if (!metadata.empty())
@@ -442,40 +611,37 @@ inline void SafeTensorManager::Save(const SafeTensorManager::TensorMap& tensors,
 
 			if (!first_meta)
 				header_json += ",";
-			header_json += "\"" + key + "\":\"" + value + "\"";
+			header_json += "\"" + escape_json_string(key) + "\":\"" + escape_json_string(value) + "\"";
 			first_meta = false;
 		}
 		header_json += "},";
+
+		if (header_json.size() > SAFETENSORS_MAX_METADATA_SIZE)
+		{
+			throw SafetensorsException("Metadata size exceeds maximum allowed size");
+		}
 	}
 
-	for (const auto& [name, tensor] : tensors)
+	//first pass - header is built only from tensor properties,
+	//data are not touched (tensors may still be on device)
+	for (const auto& name : names)
 	{
-		validate_string_length(name, "Tensor name");
+		const torch::Tensor& tensor = tensors.at(name);
 
-		auto cpu_tensor = tensor.to(torch::kCPU).contiguous();
-
-		if (is_big_endian() && (cpu_tensor.dtype() == torch::kFloat16 || cpu_tensor.dtype() == torch::kFloat32 || cpu_tensor.dtype() == torch::kFloat64))
-		{
-			cpu_tensor = cpu_tensor.to(torch::kCPU, cpu_tensor.dtype(), /*non_blocking=*/false, /*copy=*/true);
-			auto data_ptr = static_cast<char*>(cpu_tensor.data_ptr());
-			for (int64_t i = 0; i < cpu_tensor.numel() * cpu_tensor.element_size(); i += cpu_tensor.element_size())
-			{
-				std::reverse(data_ptr + i, data_ptr + i + cpu_tensor.element_size());
-			}
-		}
+		validate_string_length(name, "Tensor name");
 
-		if (cpu_tensor.dim() > SAFETENSORS_MAX_DIM)
+		if (tensor.dim() > SAFETENSORS_MAX_DIM)
 		{
 			throw SafetensorsException("Tensor dimension exceeds maximum allowed");
 		}
 
-		auto dtype = get_safetensors_dtype(cpu_tensor.scalar_type());
-		auto shape = cpu_tensor.sizes().vec();
-		size_t tensor_size = cpu_tensor.numel() * cpu_tensor.element_size();
+		auto dtype = get_safetensors_dtype(tensor.scalar_type());
+		auto shape = tensor.sizes().vec();
+		size_t tensor_size = tensor.numel() * tensor.element_size();
 
-		if (header_json.length() > 1)
+		if (header_json.length() > 1 && header_json.back() != ',')
 			header_json += ",";
-		header_json += "\"" + name + "\":{";
+		header_json += "\"" + escape_json_string(name) + "\":{";
 		header_json += "\"dtype\":\"" + std::string(dtype) + "\",";
 		header_json += "\"shape\":[";
 		for (size_t i = 0; i < shape.size(); ++i)
@@ -488,21 +654,29 @@ inline void SafeTensorManager::Save(const SafeTensorManager::TensorMap& tensors,
 		header_json += "\"data_offsets\":[" + std::to_string(current_offset) + "," + std::to_string(current_offset + tensor_size) + "]";
 		header_json += "}";
 
-		const char* tensor_data = static_cast<const char*>(cpu_tensor.data_ptr());
-		data_buffer.insert(data_buffer.end(), tensor_data, tensor_data + tensor_size);
-
 		current_offset += tensor_size;
 	}
 
+	if (header_json.back() == ',')
+		header_json.pop_back();
+
 	header_json += "}";
+
+	//pad header with spaces, so data start is 8-byte aligned
+	//(same as python implementation, needed for zero-copy views)
+	while (header_json.size() % 8 != 0)
+	{
+		header_json += " ";
+	}
+
 	uint64_t header_size = header_json.size();
 
-	if (header_size > SAFETENSORS_MAX_METADATA_SIZE)
+	if (header_size > SAFETENSORS_MAX_HEADER_SIZE)
 	{
-		throw SafetensorsException("Metadata size exceeds maximum allowed size");
+		throw SafetensorsException("Header size exceeds maximum allowed size");
 	}
 
-	if (8 + header_size + data_buffer.size() > SAFETENSORS_MAX_FILE_SIZE)
+	if (8 + header_size + current_offset > SAFETENSORS_MAX_FILE_SIZE)
 	{
 		throw SafetensorsException("Total file size exceeds maximum allowed size");
 	}
@@ -522,7 +696,25 @@ inline void SafeTensorManager::Save(const SafeTensorManager::TensorMap& tensors,
 
 	file.write(header_json.data(), header_json.size());
 
-	file.write(data_buffer.data(), data_buffer.size());
+	//second pass - tensors are moved to CPU one by one and streamed
+	//directly to file, so only single tensor copy is kept in memory
+	for (const auto& name : names)
+	{
+		auto cpu_tensor = tensors.at(name).detach().to(torch::kCPU).contiguous();
+
+		if (is_big_endian() && (cpu_tensor.dtype() == torch::kFloat16 || cpu_tensor.dtype() == torch::kFloat32 || cpu_tensor.dtype() == torch::kFloat64))
+		{
+			cpu_tensor = cpu_tensor.to(torch::kCPU, cpu_tensor.dtype(), /*non_blocking=*/false, /*copy=*/true);
+			auto data_ptr = static_cast<char*>(cpu_tensor.data_ptr());
+			for (int64_t i = 0; i < cpu_tensor.numel() * cpu_tensor.element_size(); i += cpu_tensor.element_size())
+			{
+				std::reverse(data_ptr + i, data_ptr + i + cpu_tensor.element_size());
+			}
+		}
+
+		size_t tensor_size = cpu_tensor.numel() * cpu_tensor.element_size();
+		file.write(static_cast<const char*>(cpu_tensor.data_ptr()), tensor_size);
+	}
 
 	if (!file)
 	{
@@ -531,3 +723,298 @@ inline void SafeTensorManager::Save(const SafeTensorManager::TensorMap& tensors,
 }
 
 
+//===============================================================================
+
+struct SafeTensorFile::Mapping
+{
+	MemMapFile file;
+
+	explicit Mapping(const std::string& filename) :
+		file(filename.c_str(), O_RDONLY)
+	{
+	}
+
+	~Mapping()
+	{
+		file.Close();
+	}
+};
+
+SafeTensorFile::SafeTensorFile(const std::string& filename) :
+	filename(filename),
+	mapping(nullptr),
+	dataStart(nullptr),
+	dataSize(0)
+{
+	auto m = std::make_shared<Mapping>(filename);
+
+	if (m->file.IsOpened() == false)
+	{
+		throw SafetensorsException("Failed to open file: " + filename);
+	}
+
+	size_t file_size = m->file.GetSize();
+
+	if (file_size > SAFETENSORS_MAX_FILE_SIZE)
+	{
+		throw SafetensorsException("File size exceeds maximum allowed size");
+	}
+
+	void* mapped_file = m->file.Map(PROT_READ, MAP_PRIVATE);
+
+	if (mapped_file == MAP_FAILED)
+	{
+		throw SafetensorsException("Failed to memory map file");
+	}
+
+	uint64_t header_size;
+	std::memcpy(&header_size, mapped_file, sizeof(uint64_t));
+	if (SafeTensorManager::is_big_endian())
+	{
+		header_size = SafeTensorManager::swap_endian(header_size);
+	}
+
+	if (8 + header_size > file_size)
+	{
+		throw SafetensorsException("Invalid header size");
+	}
+
+	//header is parsed only once, tensor data stays untouched
+	//until some tensor is requested
+	infos = SafeTensorManager::ParseHeaderInfo(static_cast<char*>(mapped_file), file_size);
+
+	SimpleJSONParser metaParser(static_cast<char*>(mapped_file) + 8);
+	metadata = metaParser.parseMetadata();
+
+	if (infos.size() > SAFETENSORS_MAX_TENSORS)
+	{
+		throw SafetensorsException("Number of tensors exceeds maximum allowed");
+	}
+
+	dataStart = static_cast<char*>(mapped_file) + 8 + header_size;
+	dataSize = file_size - 8 - header_size;
+
+	for (const auto& [name, info] : infos)
+	{
+		SafeTensorManager::validate_string_length(name, "Tensor name");
+
+		if (info.shape.size() > SAFETENSORS_MAX_DIM)
+		{
+			throw SafetensorsException("Tensor dimension exceeds maximum allowed");
+		}
+
+		if ((info.data_offsets[0] > info.data_offsets[1]) || (info.data_offsets[1] > dataSize))
+		{
+			throw SafetensorsException("Invalid data offsets for tensor: " + name);
+		}
+	}
+
+	mapping = m;
+}
+
+SafeTensorFile::~SafeTensorFile()
+{
+	//mapping is released once all views are released
+	mapping = nullptr;
+}
+
+const std::string& SafeTensorFile::GetFileName() const
+{
+	return filename;
+}
+
+size_t SafeTensorFile::GetTensorsCount() const
+{
+	return infos.size();
+}
+
+std::vector<std::string> SafeTensorFile::GetNames() const
+{
+	std::vector<std::string> names;
+	names.reserve(infos.size());
+	for (const auto& [name, _] : infos)
+	{
+		names.push_back(name);
+	}
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+std::vector<std::string> SafeTensorFile::FindNames(const std::string& globPattern) const
+{
+	std::vector<std::string> names;
+	for (const auto& [name, _] : infos)
+	{
+		if (MatchGlob(name, globPattern))
+		{
+			names.push_back(name);
+		}
+	}
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+bool SafeTensorFile::Contains(const std::string& name) const
+{
+	return infos.find(name) != infos.end();
+}
+
+const TensorInfo& SafeTensorFile::FindInfo(const std::string& name) const
+{
+	auto it = infos.find(name);
+	if (it == infos.end())
+	{
+		throw SafetensorsException("Tensor not found: " + name);
+	}
+	return it->second;
+}
+
+const TensorInfo& SafeTensorFile::GetInfo(const std::string& name) const
+{
+	return this->FindInfo(name);
+}
+
+torch::ScalarType SafeTensorFile::GetDtype(const std::string& name) const
+{
+	return SafeTensorManager::get_torch_dtype(this->FindInfo(name).dtype);
+}
+
+const std::vector<int64_t>& SafeTensorFile::GetShape(const std::string& name) const
+{
+	return this->FindInfo(name).shape;
+}
+
+size_t SafeTensorFile::GetByteSize(const std::string& name) const
+{
+	const auto& info = this->FindInfo(name);
+	return info.data_offsets[1] - info.data_offsets[0];
+}
+
+const std::unordered_map<std::string, std::string>& SafeTensorFile::GetMetadata() const
+{
+	return metadata;
+}
+
+/// <summary>
+/// Get zero-copy view to mapped data
+/// View holds reference to mapping, so it stays valid even
+/// if SafeTensorFile is destroyed. View must not be written into.
+/// 
+/// On big-endian systems, data must be swapped, so the copy is returned
+/// </summary>
+/// <param name="name"></param>
+/// <returns></returns>
+torch::Tensor SafeTensorFile::GetTensorView(const std::string& name) const
+{
+	const auto& info = this->FindInfo(name);
+
+	torch::ScalarType dtype = SafeTensorManager::get_torch_dtype(info.dtype);
+
+	auto options = torch::TensorOptions()
+		.dtype(dtype)
+		.device(torch::kCPU);
+
+	int64_t numel = 1;
+	for (auto d : info.shape)
+	{
+		numel *= d;
+	}
+
+	if (static_cast<size_t>(numel) * c10::elementSize(dtype) != info.data_offsets[1] - info.data_offsets[0])
+	{
+		throw SafetensorsException("Tensor size does not match data offsets: " + name);
+	}
+
+	//deleter holds the mapping until the last view is released
+	std::shared_ptr<Mapping> keepAlive = mapping;
+
+	torch::Tensor cpu_tensor = torch::from_blob(
+		const_cast<char*>(dataStart + info.data_offsets[0]),
+		info.shape,
+		[keepAlive](void*) {},
+		options);
+
+	if (SafeTensorManager::is_big_endian() &&
+		(dtype == torch::kFloat16 || dtype == torch::kFloat32 || dtype == torch::kFloat64))
+	{
+		cpu_tensor = cpu_tensor.clone();
+
+		auto data_ptr = static_cast<char*>(cpu_tensor.data_ptr());
+		for (int64_t i = 0; i < cpu_tensor.numel() * cpu_tensor.element_size(); i += cpu_tensor.element_size())
+		{
+			std::reverse(data_ptr + i, data_ptr + i + cpu_tensor.element_size());
+		}
+	}
+
+	return cpu_tensor;
+}
+
+/// <summary>
+/// Get tensor with its own copy of data
+/// </summary>
+/// <param name="name"></param>
+/// <returns></returns>
+torch::Tensor SafeTensorFile::GetTensor(const std::string& name) const
+{
+	return this->GetTensorView(name).clone();
+}
+
+/// <summary>
+/// Get all tensors whose name match glob pattern (* and ? are supported)
+/// eg. "model.layers.0.*"
+/// </summary>
+/// <param name="globPattern"></param>
+/// <param name="copy">if false, zero-copy views are returned</param>
+/// <returns></returns>
+SafeTensorFile::TensorMap SafeTensorFile::GetTensors(const std::string& globPattern, bool copy) const
+{
+	TensorMap tensors;
+	for (const auto& [name, _] : infos)
+	{
+		if (MatchGlob(name, globPattern) == false)
+		{
+			continue;
+		}
+		tensors.try_emplace(name, (copy) ? this->GetTensor(name) : this->GetTensorView(name));
+	}
+	return tensors;
+}
+
+bool SafeTensorFile::MatchGlob(const std::string& name, const std::string& globPattern)
+{
+	size_t n = 0;
+	size_t p = 0;
+	size_t starPos = std::string::npos;
+	size_t matchPos = 0;
+
+	while (n < name.size())
+	{
+		if ((p < globPattern.size()) && ((globPattern[p] == '?') || (globPattern[p] == name[n])))
+		{
+			n++;
+			p++;
+		}
+		else if ((p < globPattern.size()) && (globPattern[p] == '*'))
+		{
+			starPos = p++;
+			matchPos = n;
+		}
+		else if (starPos != std::string::npos)
+		{
+			//backtrack - let last star consume one more character
+			p = starPos + 1;
+			n = ++matchPos;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while ((p < globPattern.size()) && (globPattern[p] == '*'))
+	{
+		p++;
+	}
+
+	return p == globPattern.size();
+}
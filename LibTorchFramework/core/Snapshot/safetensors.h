@@ -9,12 +9,14 @@
 #include <array>
 #include <functional>
 #include <stdexcept>
+#include <memory>
 
 #define SAFETENSORS_MAX_DIM 8
-#define SAFETENSORS_MAX_TENSORS 2048
+#define SAFETENSORS_MAX_TENSORS 16384
 #define SAFETENSORS_MAX_FILE_SIZE (2ULL << 40)
 #define SAFETENSORS_MAX_STRING_SIZE 2048
 #define SAFETENSORS_MAX_METADATA_SIZE 8192
+#define SAFETENSORS_MAX_HEADER_SIZE (100ULL << 20)
 
 namespace safetensors
 {
@@ -44,6 +46,7 @@ namespace safetensors
     public:
         explicit SimpleJSONParser(const char* json_str);
         std::unordered_map<std::string, TensorInfo> parse();
+        std::unordered_map<std::string, std::string> parseMetadata();
 
     private:
         const char* json;
@@ -51,6 +54,7 @@ namespace safetensors
 
         void skipWhitespace();
         std::string parseString();
+        uint32_t parseHex4();
         std::vector<int64_t> parseArray();
         std::array<size_t, 2> parseDataOffsets();
         void skipValue();
@@ -59,6 +63,8 @@ namespace safetensors
 
     //==========================================================
 
+    class SafeTensorFile;
+
     class SafeTensorManager
     {
     public:
@@ -84,6 +90,7 @@ namespace safetensors
         static std::string_view get_safetensors_dtype(torch::ScalarType dtype);
 
         static void validate_string_length(const std::string& str, const std::string& context);
+        static std::string escape_json_string(const std::string& str);
         static bool is_big_endian();
 
         static std::unordered_map<std::string, TensorInfo> ParseHeaderInfo(const char* data, size_t size);
@@ -112,7 +119,65 @@ namespace safetensors
             std::function<std::string(const std::string&)> remapName,
             std::function<void(const std::string&, const torch::Tensor&)> fill);
 
+        friend class SafeTensorFile;
     };
+
+    //==========================================================
+
+    /// <summary>
+    /// Opened safetensors file with parsed header.
+    /// Data are memory mapped and tensors are created lazily on request,
+    /// so only bytes of requested tensors are touched.
+    /// 
+    /// Views returned by GetTensorView keep the mapping alive
+    /// and are read-only (file is mapped with PROT_READ)
+    /// </summary>
+    class SafeTensorFile
+    {
+    public:
+        using TensorMap = std::unordered_map<std::string, torch::Tensor>;
+
+        explicit SafeTensorFile(const std::string& filename);
+        ~SafeTensorFile();
+
+        SafeTensorFile(const SafeTensorFile&) = delete;
+        SafeTensorFile& operator=(const SafeTensorFile&) = delete;
+
+        const std::string& GetFileName() const;
+
+        size_t GetTensorsCount() const;
+        std::vector<std::string> GetNames() const;
+        std::vector<std::string> FindNames(const std::string& globPattern) const;
+        bool Contains(const std::string& name) const;
+
+        const TensorInfo& GetInfo(const std::string& name) const;
+        torch::ScalarType GetDtype(const std::string& name) const;
+        const std::vector<int64_t>& GetShape(const std::string& name) const;
+        size_t GetByteSize(const std::string& name) const;
+
+        const std::unordered_map<std::string, std::string>& GetMetadata() const;
+
+        torch::Tensor GetTensorView(const std::string& name) const;
+        torch::Tensor GetTensor(const std::string& name) const;
+
+        TensorMap GetTensors(const std::string& globPattern, bool copy = true) const;
+
+        static bool MatchGlob(const std::string& name, const std::string& globPattern);
+
+    protected:
+        struct Mapping;
+
+        std::string filename;
+        std::shared_ptr<Mapping> mapping;
+        const char* dataStart;
+        size_t dataSize;
+
+        std::unordered_map<std::string, TensorInfo> infos;
+        std::unordered_map<std::string, std::string> metadata;
+
+        const TensorInfo& FindInfo(const std::string& name) const;
+    };
+
 } // namespace safetensors
 
 #endif
@@ -0,0 +1,183 @@
+#include "./BpeMergeTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+BpeMergeTable::BpeMergeTable() :
+	count(0),
+	mask(0)
+{
+}
+
+void BpeMergeTable::Clear()
+{
+	this->entries.clear();
+	this->table = this->entries;
+	this->count = 0;
+	this->mask = 0;
+}
+
+/// <summary>
+/// Use external table (eg. memory-mapped file),
+/// data must outlive this object
+/// </summary>
+/// <param name="table"></param>
+void BpeMergeTable::Attach(std::span<const Entry> table)
+{
+	if ((table.empty() == false) && ((table.size() & (table.size() - 1)) != 0))
+	{
+		throw std::runtime_error("Merge table size must be power of 2");
+	}
+
+	this->entries.clear();
+	this->table = table;
+	this->mask = (table.empty()) ? 0 : table.size() - 1;
+	this->count = std::count_if(table.begin(), table.end(), [](const Entry& e) {
+		return e.key != EMPTY_KEY;
+	});
+}
+
+std::span<const BpeMergeTable::Entry> BpeMergeTable::GetTable() const
+{
+	return this->table;
+}
+
+/// <summary>
+/// Prepare table for given number of rules
+/// (load factor is kept at most 0.5)
+/// </summary>
+/// <param name="count"></param>
+void BpeMergeTable::Reserve(size_t count)
+{
+	size_t capacity = 16;
+	while (capacity < count * 2)
+	{
+		capacity *= 2;
+	}
+
+	if (capacity > this->table.size())
+	{
+		this->Rehash(capacity);
+	}
+}
+
+size_t BpeMergeTable::GetCount() const
+{
+	return this->count;
+}
+
+uint64_t BpeMergeTable::MakeKey(TokenId left, TokenId right)
+{
+	return (uint64_t(uint32_t(left)) << 32) | uint64_t(uint32_t(right));
+}
+
+/// <summary>
+/// splitmix64 finalizer - keys are small consecutive integers,
+/// so they must be mixed before masking
+/// </summary>
+/// <param name="key"></param>
+/// <returns></returns>
+uint64_t BpeMergeTable::HashKey(uint64_t key)
+{
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return key;
+}
+
+void BpeMergeTable::Rehash(size_t newCapacity)
+{
+	std::vector<Entry> old(this->table.begin(), this->table.end());
+
+	this->entries.assign(newCapacity, Entry{ EMPTY_KEY, { -1, -1 } });
+	this->table = this->entries;
+	this->mask = newCapacity - 1;
+	this->count = 0;
+
+	for (const auto& e : old)
+	{
+		if (e.key == EMPTY_KEY)
+		{
+			continue;
+		}
+
+		size_t i = HashKey(e.key) & this->mask;
+		while (this->entries[i].key != EMPTY_KEY)
+		{
+			i = (i + 1) & this->mask;
+		}
+		this->entries[i] = e;
+		this->count++;
+	}
+}
+
+/// <summary>
+/// Add rule, if the pair is not already present
+/// (first occurence in merges list wins, same as in HF tokenizers)
+/// </summary>
+/// <param name="left"></param>
+/// <param name="right"></param>
+/// <param name="rank"></param>
+/// <param name="merged"></param>
+/// <returns>false if pair already exist or ids are invalid</returns>
+bool BpeMergeTable::TryAdd(TokenId left, TokenId right, int32_t rank, TokenId merged)
+{
+	if ((left < 0) || (right < 0))
+	{
+		return false;
+	}
+
+	if ((this->table.empty() == false) && (this->table.data() != this->entries.data()))
+	{
+		//attached table is read-only, make own copy
+		this->Rehash(this->table.size());
+	}
+
+	if ((this->count + 1) * 2 > this->table.size())
+	{
+		this->Rehash(std::max<size_t>(16, this->table.size() * 2));
+	}
+
+	uint64_t key = MakeKey(left, right);
+	size_t i = HashKey(key) & this->mask;
+	while (this->entries[i].key != EMPTY_KEY)
+	{
+		if (this->entries[i].key == key)
+		{
+			return false;
+		}
+		i = (i + 1) & this->mask;
+	}
+
+	this->entries[i].key = key;
+	this->entries[i].rule = { rank, merged };
+	this->count++;
+
+	return true;
+}
+
+const BpeMergeTable::MergeRule* BpeMergeTable::Find(TokenId left, TokenId right) const
+{
+	if ((this->count == 0) || (left < 0) || (right < 0))
+	{
+		return nullptr;
+	}
+
+	uint64_t key = MakeKey(left, right);
+	size_t i = HashKey(key) & this->mask;
+	while (true)
+	{
+		const auto& e = this->table[i];
+		if (e.key == key)
+		{
+			return &e.rule;
+		}
+		if (e.key == EMPTY_KEY)
+		{
+			return nullptr;
+		}
+		i = (i + 1) & this->mask;
+	}
+}
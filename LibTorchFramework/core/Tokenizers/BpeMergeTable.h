@@ -0,0 +1,60 @@
+#ifndef BPE_MERGE_TABLE_H
+#define BPE_MERGE_TABLE_H
+
+#include <cstdint>
+#include <vector>
+#include <span>
+
+#include "./Tokenizers.h"
+
+/// <summary>
+/// Flat open-addressing hash table of BPE merge rules
+/// (left id, right id) -> (rank, merged id).
+/// Keys are packed into single 64bit value, table is a single
+/// array with linear probing - no per-entry allocations.
+/// Table can be attached to external memory (compiled tokenizer file)
+/// </summary>
+class BpeMergeTable
+{
+public:
+	struct MergeRule
+	{
+		int32_t rank;
+		TokenId merged;
+	};
+
+	struct Entry
+	{
+		uint64_t key;
+		MergeRule rule;
+	};
+
+	BpeMergeTable();
+	~BpeMergeTable() = default;
+
+	void Clear();
+	void Reserve(size_t count);
+
+	bool TryAdd(TokenId left, TokenId right, int32_t rank, TokenId merged);
+	const MergeRule* Find(TokenId left, TokenId right) const;
+
+	void Attach(std::span<const Entry> table);
+	std::span<const Entry> GetTable() const;
+
+	size_t GetCount() const;
+
+protected:
+	static constexpr uint64_t EMPTY_KEY = ~uint64_t(0);
+
+	std::vector<Entry> entries;
+	std::span<const Entry> table;
+	size_t count;
+	uint64_t mask;
+
+	static uint64_t MakeKey(TokenId left, TokenId right);
+	static uint64_t HashKey(uint64_t key);
+
+	void Rehash(size_t newCapacity);
+};
+
+#endif
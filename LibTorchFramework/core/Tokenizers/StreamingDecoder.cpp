@@ -0,0 +1,102 @@
+#include "./StreamingDecoder.h"
+
+#include "./TokenizerBPE.h"
+
+StreamingDecoder::StreamingDecoder(const TokenizerBPE& tokenizer) :
+	tokenizer(tokenizer)
+{
+}
+
+void StreamingDecoder::Reset()
+{
+	this->pending.clear();
+}
+
+size_t StreamingDecoder::GetPendingBytesCount() const
+{
+	return this->pending.size();
+}
+
+/// <summary>
+/// Add token and return text that can be printed.
+/// Returned text is always complete UTF-8
+/// (invalid bytes are passed as they are, so they are not held forever)
+/// </summary>
+/// <param name="id"></param>
+/// <returns></returns>
+StringUtf8 StreamingDecoder::Push(TokenId id)
+{
+	auto bytes = this->tokenizer.GetTokenBytes(id);
+	if (bytes.empty())
+	{
+		return u8"";
+	}
+
+	if (this->pending.empty())
+	{
+		//most common case - token is complete text
+		const char8_t last = bytes.back();
+		if (last < 0x80)
+		{
+			return StringUtf8(bytes);
+		}
+	}
+
+	this->pending.insert(this->pending.end(), bytes.begin(), bytes.end());
+
+	const size_t complete = GetCompleteLength(this->pending);
+
+	StringUtf8 out(this->pending.data(), complete);
+	this->pending.erase(this->pending.begin(), this->pending.begin() + complete);
+
+	return out;
+}
+
+/// <summary>
+/// Return held bytes at the end of generation
+/// (it is incomplete UTF-8 sequence)
+/// </summary>
+/// <returns></returns>
+StringUtf8 StreamingDecoder::Flush()
+{
+	StringUtf8 out(this->pending.data(), this->pending.size());
+	this->pending.clear();
+	return out;
+}
+
+/// <summary>
+/// Get length of bytes prefix without incomplete
+/// UTF-8 sequence at the end
+/// </summary>
+/// <param name="bytes"></param>
+/// <returns></returns>
+size_t StreamingDecoder::GetCompleteLength(const std::vector<char8_t>& bytes)
+{
+	const size_t n = bytes.size();
+
+	//find start of last sequence - skip at most 3 continuation bytes
+	size_t start = n;
+	for (size_t k = 0; (k < 4) && (start > 0); k++)
+	{
+		start--;
+		if ((bytes[start] & 0xC0) != 0x80)
+		{
+			break;
+		}
+	}
+
+	const char8_t lead = bytes[start];
+
+	size_t expected = 1;
+	if ((lead & 0xE0) == 0xC0) expected = 2;
+	else if ((lead & 0xF0) == 0xE0) expected = 3;
+	else if ((lead & 0xF8) == 0xF0) expected = 4;
+
+	if (((lead & 0xC0) == 0x80) || (expected == 1))
+	{
+		//ascii, invalid lead or stray continuation bytes
+		return n;
+	}
+
+	return (n - start < expected) ? start : n;
+}
@@ -0,0 +1,40 @@
+#ifndef STREAMING_DECODER_H
+#define STREAMING_DECODER_H
+
+class TokenizerBPE;
+
+#include <string>
+#include <vector>
+
+#include "./Tokenizers.h"
+
+/// <summary>
+/// Incremental detokenizer for generation.
+/// Takes one token id at a time and returns only complete
+/// UTF-8 sequences. Incomplete multi-byte character at the end
+/// is kept until the next token completes it.
+/// Cost per token does not depend on the length of generated text
+/// </summary>
+class StreamingDecoder
+{
+public:
+	explicit StreamingDecoder(const TokenizerBPE& tokenizer);
+	~StreamingDecoder() = default;
+
+	void Reset();
+
+	StringUtf8 Push(TokenId id);
+	StringUtf8 Flush();
+
+	size_t GetPendingBytesCount() const;
+
+protected:
+	const TokenizerBPE& tokenizer;
+
+	//bytes of incomplete UTF-8 sequence (at most 3)
+	std::vector<char8_t> pending;
+
+	static size_t GetCompleteLength(const std::vector<char8_t>& bytes);
+};
+
+#endif
@@ -0,0 +1,527 @@
+#include "./PreTokenizer.h"
+
+#include <unicode/uchar.h>
+
+//=============================================================
+// Known patterns (as they are stored in tokenizer.json,
+// after JSON unescape)
+//=============================================================
+
+static const char8_t* PATTERN_GPT2 =
+	u8R"('s|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+)";
+
+static const char8_t* PATTERN_LLAMA3 =
+	u8R"((?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+)";
+
+//=============================================================
+// Text accessors for scanners
+// ASCII text is used directly, other is decoded to code points first
+//=============================================================
+
+struct AsciiText
+{
+	std::u8string_view s;
+	const uint8_t* classes;
+
+	size_t size() const { return s.size(); }
+	char32_t cp(size_t i) const { return static_cast<char32_t>(s[i]); }
+	uint8_t cls(size_t i) const { return classes[s[i]]; }
+	std::u8string_view Slice(size_t a, size_t b) const { return s.substr(a, b - a); }
+};
+
+struct DecodedText
+{
+	std::u8string_view s;
+	const std::vector<char32_t>& cps;
+	const std::vector<uint8_t>& classes;
+	const std::vector<uint32_t>& offsets; //size() + 1 items
+
+	size_t size() const { return cps.size(); }
+	char32_t cp(size_t i) const { return cps[i]; }
+	uint8_t cls(size_t i) const { return classes[i]; }
+	std::u8string_view Slice(size_t a, size_t b) const { return s.substr(offsets[a], offsets[b] - offsets[a]); }
+};
+
+//=============================================================
+
+PreTokenizer::PreTokenizer(PatternType type) :
+	type(type)
+{
+}
+
+PreTokenizer::PatternType PreTokenizer::GetType() const
+{
+	return this->type;
+}
+
+/// <summary>
+/// Find if regex is one of the patterns with hand-written scanner
+/// </summary>
+/// <param name="regex"></param>
+/// <returns></returns>
+PreTokenizer::PatternType PreTokenizer::DetectPattern(const std::u8string& regex)
+{
+	if (regex == PATTERN_LLAMA3)
+	{
+		return PatternType::LLAMA3;
+	}
+	if (regex == PATTERN_GPT2)
+	{
+		return PatternType::GPT2;
+	}
+	return PatternType::UNKNOWN;
+}
+
+/// <summary>
+/// Get regex of the pattern (as it is stored in tokenizer.json)
+/// </summary>
+/// <param name="type"></param>
+/// <returns></returns>
+const char8_t* PreTokenizer::GetPattern(PatternType type)
+{
+	if (type == PatternType::LLAMA3)
+	{
+		return PATTERN_LLAMA3;
+	}
+	if (type == PatternType::GPT2)
+	{
+		return PATTERN_GPT2;
+	}
+	return nullptr;
+}
+
+//=============================================================
+// Character classes
+//=============================================================
+
+/// <summary>
+/// Class of code point from ICU properties - same sets as
+/// \p{L}, \p{N} and \s use in ICU regex
+/// </summary>
+/// <param name="cp"></param>
+/// <returns></returns>
+uint8_t PreTokenizer::GetClassNonAscii(char32_t cp)
+{
+	uint8_t c = OTHER;
+
+	switch (u_charType(static_cast<UChar32>(cp)))
+	{
+	case U_UPPERCASE_LETTER:
+	case U_LOWERCASE_LETTER:
+	case U_TITLECASE_LETTER:
+	case U_MODIFIER_LETTER:
+	case U_OTHER_LETTER:
+		c = LETTER;
+		break;
+	case U_DECIMAL_DIGIT_NUMBER:
+	case U_LETTER_NUMBER:
+	case U_OTHER_NUMBER:
+		c = NUMBER;
+		break;
+	default:
+		break;
+	}
+
+	if (u_hasBinaryProperty(static_cast<UChar32>(cp), UCHAR_WHITE_SPACE))
+	{
+		c |= SPACE;
+	}
+	if ((cp == U'\r') || (cp == U'\n'))
+	{
+		c |= NEW_LINE;
+	}
+
+	return c;
+}
+
+/// <summary>
+/// Classes of BMP code points are looked up in a table,
+/// that is filled on first use
+/// </summary>
+/// <param name="cp"></param>
+/// <returns></returns>
+uint8_t PreTokenizer::GetClass(char32_t cp)
+{
+	static const std::vector<uint8_t> bmpClasses = []() {
+		std::vector<uint8_t> t(0x10000);
+		for (char32_t i = 0; i < 0x10000; i++)
+		{
+			t[i] = GetClassNonAscii(i);
+		}
+		return t;
+	}();
+
+	if (cp < 0x10000)
+	{
+		return bmpClasses[cp];
+	}
+	return GetClassNonAscii(cp);
+}
+
+/// <summary>
+/// Decode UTF-8 to code points and byte offsets of each of them
+/// </summary>
+/// <param name="str"></param>
+/// <param name="cps"></param>
+/// <param name="offsets">byte offset of each code point + end</param>
+/// <returns>false if str is not valid UTF-8</returns>
+bool PreTokenizer::DecodeUtf8(std::u8string_view str, std::vector<char32_t>& cps, std::vector<uint32_t>& offsets)
+{
+	cps.clear();
+	offsets.clear();
+	cps.reserve(str.size());
+	offsets.reserve(str.size() + 1);
+
+	size_t i = 0;
+	while (i < str.size())
+	{
+		uint8_t c = static_cast<uint8_t>(str[i]);
+
+		size_t len = 0;
+		char32_t cp = 0;
+		char32_t minCp = 0;
+		if (c < 0x80)
+		{
+			len = 1;
+			cp = c;
+		}
+		else if ((c & 0xE0) == 0xC0)
+		{
+			len = 2;
+			cp = c & 0x1F;
+			minCp = 0x80;
+		}
+		else if ((c & 0xF0) == 0xE0)
+		{
+			len = 3;
+			cp = c & 0x0F;
+			minCp = 0x800;
+		}
+		else if ((c & 0xF8) == 0xF0)
+		{
+			len = 4;
+			cp = c & 0x07;
+			minCp = 0x10000;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (i + len > str.size())
+		{
+			return false;
+		}
+
+		for (size_t k = 1; k < len; k++)
+		{
+			uint8_t cc = static_cast<uint8_t>(str[i + k]);
+			if ((cc & 0xC0) != 0x80)
+			{
+				return false;
+			}
+			cp = (cp << 6) | (cc & 0x3F);
+		}
+
+		if ((cp < minCp) || (cp > 0x10FFFF) || ((cp >= 0xD800) && (cp <= 0xDFFF)))
+		{
+			return false;
+		}
+
+		cps.push_back(cp);
+		offsets.push_back(static_cast<uint32_t>(i));
+		i += len;
+	}
+
+	offsets.push_back(static_cast<uint32_t>(i));
+	return true;
+}
+
+//=============================================================
+// Split
+//=============================================================
+
+/// <summary>
+/// Split str to pieces (views into str).
+/// Input that is not valid UTF-8 is not split - ICU converts it
+/// with replacement characters and it must be handled by regex
+/// </summary>
+/// <param name="str"></param>
+/// <param name="out"></param>
+/// <returns>false if pattern is unknown or str is invalid UTF-8</returns>
+bool PreTokenizer::Split(std::u8string_view str, std::vector<std::u8string_view>& out) const
+{
+	if (this->type == PatternType::UNKNOWN)
+	{
+		return false;
+	}
+
+	bool isAscii = true;
+	for (auto c : str)
+	{
+		if (static_cast<uint8_t>(c) >= 0x80)
+		{
+			isAscii = false;
+			break;
+		}
+	}
+
+	if (isAscii)
+	{
+		static const std::vector<uint8_t> asciiClasses = []() {
+			std::vector<uint8_t> t(128);
+			for (char32_t i = 0; i < 128; i++)
+			{
+				t[i] = GetClass(i);
+			}
+			return t;
+		}();
+
+		AsciiText text{ str, asciiClasses.data() };
+		if (this->type == PatternType::LLAMA3)
+		{
+			SplitLlama3(text, out);
+		}
+		else
+		{
+			SplitGpt2(text, out);
+		}
+		return true;
+	}
+
+	std::vector<char32_t> cps;
+	std::vector<uint32_t> offsets;
+	if (DecodeUtf8(str, cps, offsets) == false)
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> classes(cps.size());
+	for (size_t i = 0; i < cps.size(); i++)
+	{
+		classes[i] = GetClass(cps[i]);
+	}
+
+	DecodedText text{ str, cps, classes, offsets };
+	if (this->type == PatternType::LLAMA3)
+	{
+		SplitLlama3(text, out);
+	}
+	else
+	{
+		SplitGpt2(text, out);
+	}
+	return true;
+}
+
+/// <summary>
+/// (?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}{1,3}|
+///  ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
+///
+/// Alternatives are tried in order at each position,
+/// every character is matched by some of them, so there are no gaps
+/// </summary>
+/// <param name="t"></param>
+/// <param name="out"></param>
+template <typename Text>
+void PreTokenizer::SplitLlama3(const Text& t, std::vector<std::u8string_view>& out)
+{
+	const size_t n = t.size();
+
+	//case-insensitive ASCII letter (long s folds to s in ICU)
+	auto lower = [&](size_t i) -> char32_t {
+		char32_t c = t.cp(i);
+		if ((c >= U'A') && (c <= U'Z'))
+		{
+			return c + 32;
+		}
+		if (c == 0x017F)
+		{
+			return U's';
+		}
+		return c;
+	};
+
+	auto isL = [&](size_t i) { return (t.cls(i) & LETTER) != 0; };
+	auto isN = [&](size_t i) { return (t.cls(i) & NUMBER) != 0; };
+	auto isS = [&](size_t i) { return (t.cls(i) & SPACE) != 0; };
+	auto isNL = [&](size_t i) { return (t.cls(i) & NEW_LINE) != 0; };
+	auto isP = [&](size_t i) { return (t.cls(i) & (LETTER | NUMBER | SPACE)) == 0; };
+
+	size_t i = 0;
+	while (i < n)
+	{
+		size_t j = i;
+
+		//'s|'t|'re|'ve|'m|'ll|'d
+		if ((t.cp(i) == U'\'') && (i + 1 < n))
+		{
+			char32_t c1 = lower(i + 1);
+			if ((c1 == U's') || (c1 == U't') || (c1 == U'm') || (c1 == U'd'))
+			{
+				j = i + 2;
+			}
+			else if (i + 2 < n)
+			{
+				char32_t c2 = lower(i + 2);
+				if (((c1 == U'r') && (c2 == U'e')) || ((c1 == U'v') && (c2 == U'e')) || ((c1 == U'l') && (c2 == U'l')))
+				{
+					j = i + 3;
+				}
+			}
+		}
+
+		//[^\r\n\p{L}\p{N}]?\p{L}+
+		if ((j == i) && (isL(i) || ((!isN(i)) && (!isNL(i)) && (i + 1 < n) && isL(i + 1))))
+		{
+			j = i + 1;
+			while ((j < n) && isL(j))
+			{
+				j++;
+			}
+		}
+
+		//\p{N}{1,3}
+		if ((j == i) && isN(i))
+		{
+			j = i + 1;
+			while ((j < n) && (j < i + 3) && isN(j))
+			{
+				j++;
+			}
+		}
+
+		// ?[^\s\p{L}\p{N}]+[\r\n]*
+		if (j == i)
+		{
+			size_t k = i;
+			if ((t.cp(i) == U' ') && (i + 1 < n) && isP(i + 1))
+			{
+				k = i + 1;
+			}
+			if (isP(k))
+			{
+				j = k + 1;
+				while ((j < n) && isP(j))
+				{
+					j++;
+				}
+				while ((j < n) && isNL(j))
+				{
+					j++;
+				}
+			}
+		}
+
+		if ((j == i) && isS(i))
+		{
+			size_t end = i + 1;
+			while ((end < n) && isS(end))
+			{
+				end++;
+			}
+
+			//\s*[\r\n]+ - up to the last new line of whitespace run
+			for (size_t k = end; k > i; k--)
+			{
+				if (isNL(k - 1))
+				{
+					j = k;
+					break;
+				}
+			}
+
+			if (j == i)
+			{
+				//\s+(?!\S) - whole run at the end, otherwise without last space
+				//\s+ - single space before non-space
+				j = ((end == n) || (end - 1 == i)) ? end : end - 1;
+			}
+		}
+
+		out.push_back(t.Slice(i, j));
+		i = j;
+	}
+}
+
+/// <summary>
+/// 's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+/// </summary>
+/// <param name="t"></param>
+/// <param name="out"></param>
+template <typename Text>
+void PreTokenizer::SplitGpt2(const Text& t, std::vector<std::u8string_view>& out)
+{
+	const size_t n = t.size();
+
+	auto isS = [&](size_t i) { return (t.cls(i) & SPACE) != 0; };
+
+	//class of " ?X+" alternatives: LETTER, NUMBER or OTHER (punctuation)
+	auto runClass = [&](size_t i) -> uint8_t {
+		uint8_t c = t.cls(i);
+		if (c & SPACE)
+		{
+			return SPACE;
+		}
+		return (c & LETTER) ? LETTER : ((c & NUMBER) ? NUMBER : OTHER);
+	};
+
+	size_t i = 0;
+	while (i < n)
+	{
+		size_t j = i;
+
+		//'s|'t|'re|'ve|'m|'ll|'d
+		if ((t.cp(i) == U'\'') && (i + 1 < n))
+		{
+			char32_t c1 = t.cp(i + 1);
+			if ((c1 == U's') || (c1 == U't') || (c1 == U'm') || (c1 == U'd'))
+			{
+				j = i + 2;
+			}
+			else if (i + 2 < n)
+			{
+				char32_t c2 = t.cp(i + 2);
+				if (((c1 == U'r') && (c2 == U'e')) || ((c1 == U'v') && (c2 == U'e')) || ((c1 == U'l') && (c2 == U'l')))
+				{
+					j = i + 3;
+				}
+			}
+		}
+
+		// ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+
+		if (j == i)
+		{
+			size_t k = i;
+			if ((t.cp(i) == U' ') && (i + 1 < n) && (runClass(i + 1) != SPACE))
+			{
+				k = i + 1;
+			}
+
+			uint8_t rc = runClass(k);
+			if (rc != SPACE)
+			{
+				j = k + 1;
+				while ((j < n) && (runClass(j) == rc))
+				{
+					j++;
+				}
+			}
+		}
+
+		if (j == i)
+		{
+			size_t end = i + 1;
+			while ((end < n) && isS(end))
+			{
+				end++;
+			}
+
+			//\s+(?!\S)|\s+
+			j = ((end == n) || (end - 1 == i)) ? end : end - 1;
+		}
+
+		out.push_back(t.Slice(i, j));
+		i = j;
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef PRE_TOKENIZER_H
+#define PRE_TOKENIZER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// Hand-written scanner for the common split regexes
+/// (GPT-2 and Llama-3 / GPT-4 cl100k patterns).
+/// Produces same spans as ICU regex with these patterns, but without
+/// UTF-16 conversion and without copying matched strings.
+/// ASCII input is classified by table lookup, Unicode categories
+/// are only queried for non-ASCII code points
+/// </summary>
+class PreTokenizer
+{
+public:
+	enum class PatternType
+	{
+		UNKNOWN,
+		GPT2,
+		LLAMA3 //also GPT-4 cl100k
+	};
+
+	explicit PreTokenizer(PatternType type);
+	~PreTokenizer() = default;
+
+	PatternType GetType() const;
+
+	bool Split(std::u8string_view str, std::vector<std::u8string_view>& out) const;
+
+	static PatternType DetectPattern(const std::u8string& regex);
+	static const char8_t* GetPattern(PatternType type);
+
+protected:
+	enum CharClass : uint8_t
+	{
+		OTHER = 0,
+		LETTER = 1,
+		NUMBER = 2,
+		SPACE = 4,
+		NEW_LINE = 8 //\r or \n, also SPACE
+	};
+
+	PatternType type;
+
+	static uint8_t GetClass(char32_t cp);
+	static uint8_t GetClassNonAscii(char32_t cp);
+
+	static bool DecodeUtf8(std::u8string_view str, std::vector<char32_t>& cps, std::vector<uint32_t>& offsets);
+
+	template <typename Text>
+	static void SplitLlama3(const Text& text, std::vector<std::u8string_view>& out);
+
+	template <typename Text>
+	static void SplitGpt2(const Text& text, std::vector<std::u8string_view>& out);
+};
+
+#endif
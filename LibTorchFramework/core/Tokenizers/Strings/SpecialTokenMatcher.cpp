@@ -0,0 +1,269 @@
+#include "./SpecialTokenMatcher.h"
+
+#include <algorithm>
+#include <queue>
+
+SpecialTokenMatcher::SpecialTokenMatcher()
+{
+	this->Clear();
+}
+
+void SpecialTokenMatcher::Clear()
+{
+	this->buildNodes.clear();
+	this->buildNodes.emplace_back();
+
+	this->nodes.clear();
+	this->edges.clear();
+	this->rootNext.fill(ROOT);
+	this->firstBytes.fill(false);
+}
+
+bool SpecialTokenMatcher::IsEmpty() const
+{
+	return (this->nodes.size() <= 1);
+}
+
+/// <summary>
+/// Add token to trie. If the same token is added
+/// more times, first id is used.
+/// Build must be called after all tokens are added
+/// </summary>
+/// <param name="token"></param>
+/// <param name="id"></param>
+void SpecialTokenMatcher::Add(std::u8string_view token, int32_t id)
+{
+	if (token.empty())
+	{
+		return;
+	}
+
+	int32_t state = ROOT;
+	for (char8_t ch : token)
+	{
+		const uint8_t c = static_cast<uint8_t>(ch);
+
+		auto& children = this->buildNodes[state].children;
+		auto it = std::find_if(children.begin(), children.end(), [c](const Edge& e) {
+			return e.c == c;
+		});
+
+		if (it != children.end())
+		{
+			state = it->target;
+			continue;
+		}
+
+		const int32_t next = static_cast<int32_t>(this->buildNodes.size());
+		const uint32_t depth = this->buildNodes[state].depth + 1;
+
+		this->buildNodes[state].children.push_back({ c, next });
+		this->buildNodes.emplace_back();
+		this->buildNodes.back().depth = depth;
+		state = next;
+	}
+
+	auto& node = this->buildNodes[state];
+	if (node.terminal == false)
+	{
+		node.terminal = true;
+		node.id = id;
+	}
+}
+
+/// <summary>
+/// Flatten trie (edges sorted by byte) and calculate
+/// failure links and outputs in BFS order
+/// </summary>
+void SpecialTokenMatcher::Build()
+{
+	this->nodes.clear();
+	this->edges.clear();
+	this->rootNext.fill(ROOT);
+	this->firstBytes.fill(false);
+
+	this->nodes.resize(this->buildNodes.size());
+
+	for (size_t i = 0; i < this->buildNodes.size(); i++)
+	{
+		auto children = this->buildNodes[i].children;
+		std::sort(children.begin(), children.end(), [](const Edge& a, const Edge& b) {
+			return a.c < b.c;
+		});
+
+		Node& n = this->nodes[i];
+		n.firstEdge = static_cast<uint32_t>(this->edges.size());
+		n.edgesCount = static_cast<uint32_t>(children.size());
+		n.fail = ROOT;
+		n.depth = this->buildNodes[i].depth;
+		n.outLength = 0;
+		n.outId = -1;
+
+		this->edges.insert(this->edges.end(), children.begin(), children.end());
+	}
+
+	const Node& root = this->nodes[ROOT];
+	for (uint32_t e = root.firstEdge; e < root.firstEdge + root.edgesCount; e++)
+	{
+		this->rootNext[this->edges[e].c] = this->edges[e].target;
+		this->firstBytes[this->edges[e].c] = true;
+	}
+
+	std::queue<int32_t> q;
+	q.push(ROOT);
+
+	while (q.empty() == false)
+	{
+		const int32_t u = q.front();
+		q.pop();
+
+		const Node& nu = this->nodes[u];
+		for (uint32_t e = nu.firstEdge; e < nu.firstEdge + nu.edgesCount; e++)
+		{
+			const uint8_t c = this->edges[e].c;
+			const int32_t v = this->edges[e].target;
+
+			Node& nv = this->nodes[v];
+			nv.fail = (u == ROOT) ? ROOT : this->Next(this->nodes[u].fail, c);
+
+			//longest token that is suffix of this node - its own
+			//or inherited from failure link (already processed, it is shallower)
+			if (this->buildNodes[v].terminal)
+			{
+				nv.outLength = nv.depth;
+				nv.outId = this->buildNodes[v].id;
+			}
+			else
+			{
+				nv.outLength = this->nodes[nv.fail].outLength;
+				nv.outId = this->nodes[nv.fail].outId;
+			}
+
+			q.push(v);
+		}
+	}
+}
+
+int32_t SpecialTokenMatcher::FindChild(int32_t state, uint8_t c) const
+{
+	const Node& n = this->nodes[state];
+	auto begin = this->edges.begin() + n.firstEdge;
+	auto end = begin + n.edgesCount;
+
+	auto it = std::lower_bound(begin, end, c, [](const Edge& e, uint8_t v) {
+		return e.c < v;
+	});
+
+	return ((it != end) && (it->c == c)) ? it->target : -1;
+}
+
+int32_t SpecialTokenMatcher::Next(int32_t state, uint8_t c) const
+{
+	while (true)
+	{
+		if (state == ROOT)
+		{
+			return this->rootNext[c];
+		}
+
+		int32_t next = this->FindChild(state, c);
+		if (next >= 0)
+		{
+			return next;
+		}
+
+		state = this->nodes[state].fail;
+	}
+}
+
+/// <summary>
+/// Split str to plain segments and special tokens.
+/// Segments are views into str.
+///
+/// Match candidate is the leftmost (then longest) token seen so far.
+/// It is emitted once no partial match in the automaton can
+/// start at or before it - that is when (pos - depth) > candidate start
+/// </summary>
+/// <param name="str"></param>
+/// <param name="out"></param>
+void SpecialTokenMatcher::Split(std::u8string_view str, std::vector<Segment>& out) const
+{
+	if (str.empty())
+	{
+		return;
+	}
+
+	if (this->IsEmpty())
+	{
+		out.push_back({ str, -1 });
+		return;
+	}
+
+	const size_t n = str.size();
+	constexpr size_t NONE = static_cast<size_t>(-1);
+
+	size_t plainStart = 0;
+	size_t i = 0;
+	int32_t state = ROOT;
+
+	size_t bestStart = NONE;
+	size_t bestLength = 0;
+	int32_t bestId = -1;
+
+	while (true)
+	{
+		if ((state == ROOT) && (bestStart == NONE))
+		{
+			//nothing in progress - skip bytes that cannot start any token
+			while ((i < n) && (this->firstBytes[static_cast<uint8_t>(str[i])] == false))
+			{
+				i++;
+			}
+		}
+
+		const bool atEnd = (i >= n);
+		if (atEnd == false)
+		{
+			state = this->Next(state, static_cast<uint8_t>(str[i]));
+			i++;
+
+			const Node& node = this->nodes[state];
+			if (node.outLength > 0)
+			{
+				const size_t start = i - node.outLength;
+				if ((bestStart == NONE) || (start < bestStart) ||
+					((start == bestStart) && (node.outLength > bestLength)))
+				{
+					bestStart = start;
+					bestLength = node.outLength;
+					bestId = node.outId;
+				}
+			}
+		}
+
+		if ((bestStart != NONE) && ((atEnd) || (i - this->nodes[state].depth > bestStart)))
+		{
+			if (bestStart > plainStart)
+			{
+				out.push_back({ str.substr(plainStart, bestStart - plainStart), -1 });
+			}
+			out.push_back({ str.substr(bestStart, bestLength), bestId });
+
+			plainStart = bestStart + bestLength;
+			i = plainStart;
+			state = ROOT;
+			bestStart = NONE;
+			continue;
+		}
+
+		if (atEnd)
+		{
+			break;
+		}
+	}
+
+	if (plainStart < n)
+	{
+		out.push_back({ str.substr(plainStart), -1 });
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef SPECIAL_TOKEN_MATCHER_H
+#define SPECIAL_TOKEN_MATCHER_H
+
+#include <cstdint>
+#include <array>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// Aho-Corasick automaton over added / special tokens.
+/// Splits text to plain segments and special tokens in single pass,
+/// so the cost does not depend on number of special tokens.
+/// Matching is leftmost-longest: earliest match wins,
+/// for same start position the longest token wins
+/// </summary>
+class SpecialTokenMatcher
+{
+public:
+	struct Segment
+	{
+		std::u8string_view text;
+		int32_t id; //-1 - plain text
+	};
+
+	SpecialTokenMatcher();
+	~SpecialTokenMatcher() = default;
+
+	void Clear();
+	void Add(std::u8string_view token, int32_t id);
+	void Build();
+
+	bool IsEmpty() const;
+
+	void Split(std::u8string_view str, std::vector<Segment>& out) const;
+
+protected:
+	static constexpr int32_t ROOT = 0;
+
+	struct Node
+	{
+		uint32_t firstEdge;
+		uint32_t edgesCount;
+		int32_t fail;
+		uint32_t depth;
+		uint32_t outLength; //length of longest token that ends in this node, 0 - none
+		int32_t outId;
+	};
+
+	struct Edge
+	{
+		uint8_t c;
+		int32_t target;
+	};
+
+	//trie while adding tokens, flattened in Build
+	struct BuildNode
+	{
+		std::vector<Edge> children;
+		uint32_t depth = 0;
+		int32_t id = -1;
+		bool terminal = false;
+	};
+
+	std::vector<BuildNode> buildNodes;
+
+	std::vector<Node> nodes;
+	std::vector<Edge> edges;
+	std::array<int32_t, 256> rootNext;
+	std::array<bool, 256> firstBytes;
+
+	int32_t Next(int32_t state, uint8_t c) const;
+	int32_t FindChild(int32_t state, uint8_t c) const;
+};
+
+#endif
@@ -39,7 +39,7 @@ UnicodeRegex::~UnicodeRegex()
 {
 }
 
-std::vector<std::string> UnicodeRegex::Run(const std::u8string& utf8)
+std::vector<std::string> UnicodeRegex::Run(const std::u8string& utf8) const
 {
     
     icu::UnicodeString text = icu::UnicodeString::fromUTF8(
@@ -64,7 +64,7 @@ std::vector<std::string> UnicodeRegex::Run(const std::u8string& utf8)
     return out;
 }
 
-std::vector<UnicodeRegex::MatchSpanUtf8> UnicodeRegex::FindSpans(const std::u8string& utf8)
+std::vector<UnicodeRegex::MatchSpanUtf8> UnicodeRegex::FindSpans(const std::u8string& utf8) const
 {
     UErrorCode status = U_ZERO_ERROR;
 
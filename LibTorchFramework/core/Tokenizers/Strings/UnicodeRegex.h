@@ -22,8 +22,8 @@ public:
 	UnicodeRegex(const std::u8string& pattern);
 	~UnicodeRegex();
 
-	std::vector<std::string> Run(const std::u8string& utf8);
-	std::vector<MatchSpanUtf8> FindSpans(const std::u8string& utf8);
+	std::vector<std::string> Run(const std::u8string& utf8) const;
+	std::vector<MatchSpanUtf8> FindSpans(const std::u8string& utf8) const;
 
 protected:
 
@@ -0,0 +1,175 @@
+#include "./TokenCache.h"
+
+#include <algorithm>
+
+double TokenCache::Stats::GetHitRate() const
+{
+	uint64_t total = hits + misses;
+	return (total == 0) ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+}
+
+TokenCache::TokenCache(size_t maxBytes, size_t shardsCount) :
+	maxBytes(maxBytes)
+{
+	shardsCount = std::max<size_t>(1, shardsCount);
+	for (size_t i = 0; i < shardsCount; i++)
+	{
+		this->shards.push_back(std::make_unique<Shard>());
+	}
+}
+
+/// <summary>
+/// Set memory limit, 0 disables cache.
+/// Not thread-safe with running Put / TryGet
+/// </summary>
+/// <param name="maxBytes"></param>
+void TokenCache::SetMaxBytes(size_t maxBytes)
+{
+	this->maxBytes = maxBytes;
+	this->Clear();
+}
+
+size_t TokenCache::GetMaxBytes() const
+{
+	return this->maxBytes;
+}
+
+bool TokenCache::IsEnabled() const
+{
+	return this->maxBytes > 0;
+}
+
+/// <summary>
+/// Approximate memory used by entry
+/// (key and ids data + list node + hash map node)
+/// </summary>
+/// <param name="key"></param>
+/// <param name="idsCount"></param>
+/// <returns></returns>
+size_t TokenCache::CalcEntrySize(std::u8string_view key, size_t idsCount)
+{
+	constexpr size_t NODES_OVERHEAD = sizeof(Entry) + 2 * sizeof(void*) +
+		sizeof(std::u8string_view) + sizeof(std::list<Entry>::iterator) + 2 * sizeof(void*);
+
+	return key.size() + idsCount * sizeof(TokenId) + NODES_OVERHEAD;
+}
+
+TokenCache::Shard& TokenCache::GetShard(std::u8string_view key) const
+{
+	auto h = xxh::xxhash<64>(key.data(), key.size());
+	return *this->shards[h % this->shards.size()];
+}
+
+/// <summary>
+/// Append cached ids for key to out
+/// </summary>
+/// <param name="key"></param>
+/// <param name="out"></param>
+/// <returns>false if key is not cached</returns>
+bool TokenCache::TryGet(std::u8string_view key, std::vector<TokenId>& out)
+{
+	if (this->maxBytes == 0)
+	{
+		return false;
+	}
+
+	Shard& s = this->GetShard(key);
+	std::lock_guard<std::mutex> lock(s.m);
+
+	auto it = s.map.find(key);
+	if (it == s.map.end())
+	{
+		s.misses++;
+		return false;
+	}
+
+	s.lru.splice(s.lru.begin(), s.lru, it->second);
+
+	const auto& ids = it->second->ids;
+	out.insert(out.end(), ids.begin(), ids.end());
+
+	s.hits++;
+	return true;
+}
+
+/// <summary>
+/// Insert ids for key and evict least recently used entries
+/// of the shard, until it fits its part of memory limit
+/// </summary>
+/// <param name="key"></param>
+/// <param name="ids"></param>
+void TokenCache::Put(std::u8string_view key, const std::vector<TokenId>& ids)
+{
+	if (this->maxBytes == 0)
+	{
+		return;
+	}
+
+	const size_t shardLimit = this->maxBytes / this->shards.size();
+	const size_t entrySize = CalcEntrySize(key, ids.size());
+	if (entrySize > shardLimit)
+	{
+		return;
+	}
+
+	Shard& s = this->GetShard(key);
+	std::lock_guard<std::mutex> lock(s.m);
+
+	if (s.map.find(key) != s.map.end())
+	{
+		//inserted by other thread in the meantime
+		return;
+	}
+
+	while ((s.lru.empty() == false) && (s.bytes + entrySize > shardLimit))
+	{
+		const auto& last = s.lru.back();
+		s.bytes -= CalcEntrySize(last.key, last.ids.size());
+		s.map.erase(std::u8string_view(last.key));
+		s.lru.pop_back();
+		s.evictions++;
+	}
+
+	s.lru.push_front(Entry{ StringUtf8(key), ids });
+	s.map.try_emplace(std::u8string_view(s.lru.front().key), s.lru.begin());
+	s.bytes += entrySize;
+}
+
+void TokenCache::Clear()
+{
+	for (const auto& s : this->shards)
+	{
+		std::lock_guard<std::mutex> lock(s->m);
+		s->map.clear();
+		s->lru.clear();
+		s->bytes = 0;
+	}
+}
+
+TokenCache::Stats TokenCache::GetStats() const
+{
+	Stats st = {};
+
+	for (const auto& s : this->shards)
+	{
+		std::lock_guard<std::mutex> lock(s->m);
+		st.hits += s->hits;
+		st.misses += s->misses;
+		st.evictions += s->evictions;
+		st.entries += s->lru.size();
+		st.bytes += s->bytes;
+	}
+
+	return st;
+}
+
+void TokenCache::ResetStats()
+{
+	for (const auto& s : this->shards)
+	{
+		std::lock_guard<std::mutex> lock(s->m);
+		s->hits = 0;
+		s->misses = 0;
+		s->evictions = 0;
+	}
+}
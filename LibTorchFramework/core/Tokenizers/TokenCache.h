@@ -0,0 +1,77 @@
+#ifndef TOKEN_CACHE_H
+#define TOKEN_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+
+#include "./Tokenizers.h"
+
+/// <summary>
+/// Bounded thread-safe cache of pre-tokenized word -> token ids.
+/// Cache is split into shards (selected by key hash), each shard
+/// has its own lock and LRU list, so concurrent encoders rarely
+/// wait for each other. Memory limit is divided equally among shards.
+/// Statistics are counted per shard under its lock and summed in GetStats
+/// </summary>
+class TokenCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t entries;
+		size_t bytes;
+
+		double GetHitRate() const;
+	};
+
+	TokenCache(size_t maxBytes = 32 * 1024 * 1024, size_t shardsCount = 16);
+	~TokenCache() = default;
+
+	void SetMaxBytes(size_t maxBytes);
+	size_t GetMaxBytes() const;
+
+	bool IsEnabled() const;
+
+	bool TryGet(std::u8string_view key, std::vector<TokenId>& out);
+	void Put(std::u8string_view key, const std::vector<TokenId>& ids);
+
+	void Clear();
+
+	Stats GetStats() const;
+	void ResetStats();
+
+protected:
+	struct Entry
+	{
+		StringUtf8 key;
+		std::vector<TokenId> ids;
+	};
+
+	struct Shard
+	{
+		std::mutex m;
+		std::list<Entry> lru; //front - most recently used
+		std::unordered_map<std::u8string_view, std::list<Entry>::iterator> map;
+		size_t bytes = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+	};
+
+	size_t maxBytes;
+	std::vector<std::unique_ptr<Shard>> shards;
+
+	Shard& GetShard(std::u8string_view key) const;
+
+	static size_t CalcEntrySize(std::u8string_view key, size_t idsCount);
+};
+
+#endif
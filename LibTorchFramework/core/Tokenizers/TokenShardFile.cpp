@@ -0,0 +1,334 @@
+#include "./TokenShardFile.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <fcntl.h>
+
+#include <FileUtils/MemMapFile.h>
+
+struct TokenShardFile::Mapping
+{
+	MemMapFile file;
+
+	explicit Mapping(const std::string& filename) :
+		file(filename.c_str(), O_RDONLY)
+	{
+	}
+
+	~Mapping()
+	{
+		file.Close();
+	}
+};
+
+//=============================================================
+// Reading
+//=============================================================
+
+TokenShardFile::TokenShardFile(const std::string& path) :
+	path(path),
+	mapping(nullptr),
+	data(nullptr),
+	header(ReadHeader(path))
+{
+	auto m = std::make_shared<Mapping>(path);
+	if (m->file.IsOpened() == false)
+	{
+		throw std::runtime_error("Token shard - failed to open: " + path);
+	}
+
+	void* mapped = m->file.Map(PROT_READ, MAP_PRIVATE);
+	if (mapped == MAP_FAILED)
+	{
+		throw std::runtime_error("Token shard - failed to memory map: " + path);
+	}
+
+	this->data = static_cast<const uint8_t*>(mapped);
+	this->mapping = m;
+}
+
+TokenShardFile::~TokenShardFile()
+{
+}
+
+const TokenShardFile::Header& TokenShardFile::GetHeader() const
+{
+	return this->header;
+}
+
+uint64_t TokenShardFile::GetTokensCount() const
+{
+	return this->header.tokensCount;
+}
+
+uint64_t TokenShardFile::GetDocumentsCount() const
+{
+	return this->header.documentsCount;
+}
+
+std::span<const uint64_t> TokenShardFile::GetDocumentOffsets() const
+{
+	return std::span<const uint64_t>(
+		reinterpret_cast<const uint64_t*>(this->data + this->header.documentsOffset),
+		this->header.documentsCount + 1);
+}
+
+/// <summary>
+/// Copy tokens [start, start + count) widened to output type.
+/// Throws std::out_of_range if range is outside of shard
+/// </summary>
+/// <param name="start"></param>
+/// <param name="count"></param>
+/// <param name="out"></param>
+void TokenShardFile::CopyTokens(uint64_t start, size_t count, int64_t* out) const
+{
+	this->CopyTokensImpl(start, count, out);
+}
+
+void TokenShardFile::CopyTokens(uint64_t start, size_t count, int32_t* out) const
+{
+	this->CopyTokensImpl(start, count, out);
+}
+
+template <typename T>
+void TokenShardFile::CopyTokensImpl(uint64_t start, size_t count, T* out) const
+{
+	if ((start > this->header.tokensCount) || (count > this->header.tokensCount - start))
+	{
+		throw std::out_of_range("Token shard - range outside of " + this->path);
+	}
+
+	const uint8_t* tokens = this->data + this->header.tokensOffset;
+
+	if (this->header.tokenBytes == 2)
+	{
+		const uint16_t* src = reinterpret_cast<const uint16_t*>(tokens) + start;
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = static_cast<T>(src[i]);
+		}
+	}
+	else
+	{
+		const uint32_t* src = reinterpret_cast<const uint32_t*>(tokens) + start;
+		for (size_t i = 0; i < count; i++)
+		{
+			out[i] = static_cast<T>(src[i]);
+		}
+	}
+}
+
+//=============================================================
+// Writer
+//=============================================================
+
+TokenShardFile::Writer::Writer(const std::string& path, uint32_t tokenBytes) :
+	path(path),
+	tmpPath(path + ".tmp"),
+	f(nullptr),
+	tokenBytes(tokenBytes),
+	maxTokenId((tokenBytes == 2) ? UINT16_MAX : UINT32_MAX),
+	tokensCount(0)
+{
+	if ((tokenBytes != 2) && (tokenBytes != 4))
+	{
+		throw std::runtime_error("Token shard - unsupported token size: " + std::to_string(tokenBytes));
+	}
+
+	this->f = std::fopen(this->tmpPath.c_str(), "wb");
+	if (this->f == nullptr)
+	{
+		throw std::runtime_error("Token shard - failed to create: " + this->tmpPath);
+	}
+
+	//header is rewritten in Finish, when counts are known
+	std::vector<uint8_t> zeros(ALIGNMENT, 0);
+	this->WriteRaw(zeros.data(), zeros.size());
+
+	this->buffer.reserve(FLUSH_SIZE + ALIGNMENT);
+	this->documentOffsets.push_back(0);
+}
+
+/// <summary>
+/// Unfinished shard is removed
+/// </summary>
+TokenShardFile::Writer::~Writer()
+{
+	if (this->f != nullptr)
+	{
+		std::fclose(this->f);
+		this->f = nullptr;
+
+		std::error_code ec;
+		std::filesystem::remove(this->tmpPath, ec);
+	}
+}
+
+uint64_t TokenShardFile::Writer::GetTokensCount() const
+{
+	return this->tokensCount;
+}
+
+uint64_t TokenShardFile::Writer::GetDocumentsCount() const
+{
+	return this->documentOffsets.size() - 1;
+}
+
+void TokenShardFile::Writer::AppendTokens(std::span<const TokenId> ids)
+{
+	for (TokenId id : ids)
+	{
+		if ((id < 0) || (static_cast<uint64_t>(id) > this->maxTokenId))
+		{
+			throw std::runtime_error("Token shard - token id " + std::to_string(id) +
+				" does not fit into " + std::to_string(this->tokenBytes) + " bytes");
+		}
+	}
+
+	const size_t start = this->buffer.size();
+	this->buffer.resize(start + ids.size() * this->tokenBytes);
+	uint8_t* out = this->buffer.data() + start;
+
+	if (this->tokenBytes == 2)
+	{
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			const uint16_t v = static_cast<uint16_t>(ids[i]);
+			std::memcpy(out + i * sizeof(uint16_t), &v, sizeof(uint16_t));
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			const uint32_t v = static_cast<uint32_t>(ids[i]);
+			std::memcpy(out + i * sizeof(uint32_t), &v, sizeof(uint32_t));
+		}
+	}
+
+	this->tokensCount += ids.size();
+
+	if (this->buffer.size() >= FLUSH_SIZE)
+	{
+		this->Flush();
+	}
+}
+
+void TokenShardFile::Writer::EndDocument()
+{
+	this->documentOffsets.push_back(this->tokensCount);
+}
+
+/// <summary>
+/// Write document offsets and header, close file and
+/// move it to final path.
+/// Tokens after last EndDocument are dropped from document list,
+/// but stay in token array
+/// </summary>
+void TokenShardFile::Writer::Finish()
+{
+	if (this->f == nullptr)
+	{
+		throw std::runtime_error("Token shard - already finished: " + this->path);
+	}
+
+	Header header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.tokenBytes = this->tokenBytes;
+	header.tokensCount = this->tokensCount;
+	header.documentsCount = this->documentOffsets.size() - 1;
+	header.tokensOffset = ALIGNMENT;
+
+	const uint64_t tokensEnd = header.tokensOffset + this->tokensCount * this->tokenBytes;
+	header.documentsOffset = (tokensEnd + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+	this->buffer.resize(this->buffer.size() + static_cast<size_t>(header.documentsOffset - tokensEnd), 0);
+	this->Flush();
+
+	this->WriteRaw(this->documentOffsets.data(), this->documentOffsets.size() * sizeof(uint64_t));
+
+	bool ok = (std::fseek(this->f, 0, SEEK_SET) == 0);
+	ok = ok && (std::fwrite(&header, sizeof(Header), 1, this->f) == 1);
+	ok = (std::fclose(this->f) == 0) && ok;
+	this->f = nullptr;
+
+	if (!ok)
+	{
+		std::error_code ec;
+		std::filesystem::remove(this->tmpPath, ec);
+		throw std::runtime_error("Token shard - failed to write: " + this->tmpPath);
+	}
+
+	std::filesystem::rename(this->tmpPath, this->path);
+}
+
+void TokenShardFile::Writer::Flush()
+{
+	this->WriteRaw(this->buffer.data(), this->buffer.size());
+	this->buffer.clear();
+}
+
+void TokenShardFile::Writer::WriteRaw(const void* data, size_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	if (std::fwrite(data, 1, size, this->f) != size)
+	{
+		throw std::runtime_error("Token shard - failed to write: " + this->tmpPath);
+	}
+}
+
+//=============================================================
+// Helpers
+//=============================================================
+
+/// <summary>
+/// Read and validate header of finished shard.
+/// Throws std::runtime_error if file is not complete shard
+/// </summary>
+/// <param name="path"></param>
+/// <returns></returns>
+TokenShardFile::Header TokenShardFile::ReadHeader(const std::string& path)
+{
+	FILE* f = std::fopen(path.c_str(), "rb");
+	if (f == nullptr)
+	{
+		throw std::runtime_error("Token shard - failed to open: " + path);
+	}
+
+	Header header = {};
+	const bool read = (std::fread(&header, sizeof(Header), 1, f) == 1);
+	std::fclose(f);
+
+	if ((!read) || (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) || (header.version != VERSION) ||
+		((header.tokenBytes != 2) && (header.tokenBytes != 4)))
+	{
+		throw std::runtime_error("Token shard - unsupported format: " + path);
+	}
+
+	std::error_code ec;
+	const uint64_t size = std::filesystem::file_size(path, ec);
+	const uint64_t expected = header.documentsOffset + (header.documentsCount + 1) * sizeof(uint64_t);
+	if ((ec) || (size < expected) ||
+		(header.tokensOffset + header.tokensCount * header.tokenBytes > header.documentsOffset))
+	{
+		throw std::runtime_error("Token shard - file is truncated: " + path);
+	}
+
+	return header;
+}
+
+/// <summary>
+/// Smallest token width that can store all ids of vocab
+/// </summary>
+/// <param name="vocabSize"></param>
+/// <returns></returns>
+uint32_t TokenShardFile::GetMinTokenBytes(size_t vocabSize)
+{
+	return (vocabSize <= static_cast<size_t>(UINT16_MAX) + 1) ? 2 : 4;
+}
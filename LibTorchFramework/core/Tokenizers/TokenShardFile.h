@@ -0,0 +1,109 @@
+#ifndef TOKEN_SHARD_FILE_H
+#define TOKEN_SHARD_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <span>
+#include <memory>
+
+#include "./Tokenizers.h"
+
+/// <summary>
+/// Pre-tokenized corpus shard.
+/// Tokens are stored as fixed-width uint16 or uint32 values,
+/// documents as offsets into token array (document i is
+/// [documentOffsets[i], documentOffsets[i + 1])).
+///
+/// Layout: Header, tokens, document offsets (uint64, count + 1),
+/// sections aligned to 64 bytes, so file can be memory-mapped directly.
+///
+/// Opened shard is memory-mapped, tokens are read directly from the mapping
+/// </summary>
+class TokenShardFile
+{
+public:
+	static constexpr char MAGIC[8] = { 'T', 'O', 'K', 'S', 'H', 'A', 'R', 'D' };
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t ALIGNMENT = 64;
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t tokenBytes; //2 or 4
+
+		uint64_t tokensCount;
+		uint64_t documentsCount;
+
+		uint64_t tokensOffset;
+		uint64_t documentsOffset;
+	};
+
+	/// <summary>
+	/// Shard is written into "path.tmp" and renamed to path
+	/// in Finish, so existing path is always complete shard
+	/// </summary>
+	class Writer
+	{
+	public:
+		Writer(const std::string& path, uint32_t tokenBytes);
+		~Writer();
+
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		void AppendTokens(std::span<const TokenId> ids);
+		void EndDocument();
+
+		uint64_t GetTokensCount() const;
+		uint64_t GetDocumentsCount() const;
+
+		void Finish();
+
+	protected:
+		static constexpr size_t FLUSH_SIZE = 4 * 1024 * 1024;
+
+		std::string path;
+		std::string tmpPath;
+		FILE* f;
+
+		uint32_t tokenBytes;
+		uint64_t maxTokenId;
+
+		std::vector<uint8_t> buffer;
+		std::vector<uint64_t> documentOffsets;
+		uint64_t tokensCount;
+
+		void Flush();
+		void WriteRaw(const void* data, size_t size);
+	};
+
+	explicit TokenShardFile(const std::string& path);
+	~TokenShardFile();
+
+	const Header& GetHeader() const;
+	uint64_t GetTokensCount() const;
+	uint64_t GetDocumentsCount() const;
+	std::span<const uint64_t> GetDocumentOffsets() const;
+
+	void CopyTokens(uint64_t start, size_t count, int64_t* out) const;
+	void CopyTokens(uint64_t start, size_t count, int32_t* out) const;
+
+	static Header ReadHeader(const std::string& path);
+	static uint32_t GetMinTokenBytes(size_t vocabSize);
+
+protected:
+	struct Mapping;
+
+	std::string path;
+	std::shared_ptr<Mapping> mapping;
+	const uint8_t* data;
+	Header header;
+
+	template <typename T>
+	void CopyTokensImpl(uint64_t start, size_t count, T* out) const;
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "./TokenVocab.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+TokenVocab::TokenVocab() :
+	count(0)
+{
+}
+
+void TokenVocab::Clear()
+{
+	this->ownedTable.clear();
+	this->ownedSpans.clear();
+	this->ownedBlob.clear();
+	this->count = 0;
+	this->UpdateViews();
+}
+
+/// <summary>
+/// Prepare table for given number of tokens
+/// (load factor is kept at most 0.5)
+/// </summary>
+/// <param name="count"></param>
+void TokenVocab::Reserve(size_t count)
+{
+	size_t capacity = 16;
+	while (capacity < count * 2)
+	{
+		capacity *= 2;
+	}
+
+	if (capacity > this->ownedTable.size())
+	{
+		this->Rehash(capacity);
+	}
+	this->ownedSpans.reserve(count);
+}
+
+void TokenVocab::UpdateViews()
+{
+	this->table = this->ownedTable;
+	this->spans = this->ownedSpans;
+	this->blob = this->ownedBlob;
+}
+
+void TokenVocab::Rehash(size_t newCapacity)
+{
+	std::vector<Entry> old;
+	old.swap(this->ownedTable);
+
+	this->ownedTable.assign(newCapacity, Entry{ 0, -1, 0 });
+	const size_t mask = newCapacity - 1;
+
+	for (const auto& e : old)
+	{
+		if (e.id < 0)
+		{
+			continue;
+		}
+
+		size_t i = e.hash & mask;
+		while (this->ownedTable[i].id >= 0)
+		{
+			i = (i + 1) & mask;
+		}
+		this->ownedTable[i] = e;
+	}
+
+	this->UpdateViews();
+}
+
+/// <summary>
+/// Add token. Hashes are xxhash of code points, so they are
+/// used directly as table index
+/// </summary>
+/// <param name="hash"></param>
+/// <param name="id"></param>
+/// <param name="token"></param>
+/// <returns>false if hash is already in vocab</returns>
+bool TokenVocab::TryAdd(StringUtf8Hash hash, TokenId id, std::u8string_view token)
+{
+	if (id < 0)
+	{
+		return false;
+	}
+	if ((this->table.empty() == false) && (this->table.data() != this->ownedTable.data()))
+	{
+		throw std::runtime_error("Unable to add token to attached vocab");
+	}
+
+	if ((this->count + 1) * 2 > this->ownedTable.size())
+	{
+		this->Rehash(std::max<size_t>(16, this->ownedTable.size() * 2));
+	}
+
+	const size_t mask = this->ownedTable.size() - 1;
+	size_t i = hash & mask;
+	while (this->ownedTable[i].id >= 0)
+	{
+		if (this->ownedTable[i].hash == hash)
+		{
+			return false;
+		}
+		i = (i + 1) & mask;
+	}
+
+	this->ownedTable[i] = Entry{ hash, id, 0 };
+	this->count++;
+
+	if (static_cast<size_t>(id) >= this->ownedSpans.size())
+	{
+		this->ownedSpans.resize(static_cast<size_t>(id) + 1, TokenSpan{ 0, 0, 0 });
+	}
+	if (this->ownedSpans[id].valid == 0)
+	{
+		this->ownedSpans[id] = TokenSpan{ this->ownedBlob.size(), static_cast<uint32_t>(token.size()), 1 };
+		this->ownedBlob.insert(this->ownedBlob.end(), token.begin(), token.end());
+	}
+
+	this->UpdateViews();
+
+	return true;
+}
+
+/// <summary>
+/// Use external data (eg. memory-mapped file) instead of owned ones.
+/// Data must outlive the vocab
+/// </summary>
+/// <param name="table"></param>
+/// <param name="spans"></param>
+/// <param name="blob"></param>
+void TokenVocab::Attach(std::span<const Entry> table, std::span<const TokenSpan> spans, std::span<const char8_t> blob)
+{
+	if ((table.empty() == false) && ((table.size() & (table.size() - 1)) != 0))
+	{
+		throw std::runtime_error("Vocab table size must be power of 2");
+	}
+
+	this->ownedTable.clear();
+	this->ownedSpans.clear();
+	this->ownedBlob.clear();
+
+	this->table = table;
+	this->spans = spans;
+	this->blob = blob;
+
+	this->count = std::count_if(table.begin(), table.end(), [](const Entry& e) { 
+		return e.id >= 0; 
+	});
+}
+
+TokenId TokenVocab::Find(StringUtf8Hash hash) const
+{
+	if (this->table.empty())
+	{
+		return -1;
+	}
+
+	const size_t mask = this->table.size() - 1;
+	size_t i = hash & mask;
+	while (true)
+	{
+		const auto& e = this->table[i];
+		if (e.id < 0)
+		{
+			return -1;
+		}
+		if (e.hash == hash)
+		{
+			return e.id;
+		}
+		i = (i + 1) & mask;
+	}
+}
+
+bool TokenVocab::TryGetToken(TokenId id, std::u8string_view& token) const
+{
+	if ((id < 0) || (static_cast<size_t>(id) >= this->spans.size()))
+	{
+		return false;
+	}
+
+	const auto& s = this->spans[id];
+	if (s.valid == 0)
+	{
+		return false;
+	}
+
+	token = std::u8string_view(this->blob.data() + s.offset, s.length);
+	return true;
+}
+
+size_t TokenVocab::GetCount() const
+{
+	return this->count;
+}
+
+/// <summary>
+/// Largest id in vocab, -1 if vocab is empty
+/// </summary>
+/// <returns></returns>
+TokenId TokenVocab::GetMaxId() const
+{
+	return static_cast<TokenId>(this->spans.size()) - 1;
+}
+
+std::span<const TokenVocab::Entry> TokenVocab::GetTable() const
+{
+	return this->table;
+}
+
+std::span<const TokenVocab::TokenSpan> TokenVocab::GetSpans() const
+{
+	return this->spans;
+}
+
+std::span<const char8_t> TokenVocab::GetBlob() const
+{
+	return this->blob;
+}
@@ -0,0 +1,76 @@
+#ifndef TOKEN_VOCAB_H
+#define TOKEN_VOCAB_H
+
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <string_view>
+
+#include "./Tokenizers.h"
+
+/// <summary>
+/// Flat vocabulary:
+/// - open-addressing table token hash -> id
+/// - token strings stored in single blob, with spans indexed by id
+///
+/// Data are either owned (built during json parsing)
+/// or attached from memory-mapped compiled tokenizer file.
+/// All arrays are plain structures, so they can be written
+/// to file and used without any conversion
+/// </summary>
+class TokenVocab
+{
+public:
+	struct Entry
+	{
+		StringUtf8Hash hash;
+		TokenId id; //-1 - empty slot
+		uint32_t reserved;
+	};
+
+	struct TokenSpan
+	{
+		uint64_t offset;
+		uint32_t length;
+		uint32_t valid;
+	};
+
+	TokenVocab();
+	~TokenVocab() = default;
+
+	TokenVocab(const TokenVocab&) = delete;
+	TokenVocab& operator=(const TokenVocab&) = delete;
+
+	void Clear();
+	void Reserve(size_t count);
+
+	bool TryAdd(StringUtf8Hash hash, TokenId id, std::u8string_view token);
+
+	void Attach(std::span<const Entry> table, std::span<const TokenSpan> spans, std::span<const char8_t> blob);
+
+	TokenId Find(StringUtf8Hash hash) const;
+	bool TryGetToken(TokenId id, std::u8string_view& token) const;
+
+	size_t GetCount() const;
+	TokenId GetMaxId() const;
+
+	std::span<const Entry> GetTable() const;
+	std::span<const TokenSpan> GetSpans() const;
+	std::span<const char8_t> GetBlob() const;
+
+protected:
+	std::vector<Entry> ownedTable;
+	std::vector<TokenSpan> ownedSpans;
+	std::vector<char8_t> ownedBlob;
+
+	std::span<const Entry> table;
+	std::span<const TokenSpan> spans;
+	std::span<const char8_t> blob;
+
+	size_t count;
+
+	void Rehash(size_t newCapacity);
+	void UpdateViews();
+};
+
+#endif
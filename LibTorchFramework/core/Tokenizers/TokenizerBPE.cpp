@@ -6,11 +6,16 @@
 #include <cstring>
 #include <limits>
 #include <utility>
+#include <queue>
+#include <functional>
 
 #include "./Strings/UnicodeRegex.h"
+#include "./Strings/PreTokenizer.h"
+#include "./TokenizerBinaryFile.h"
 
 #include <Utils/Strings/StringUtils.h>
 #include <Utils/Strings/StringIterators.h>
+#include <Utils/Logger.h>
 
 
 TokenizerBPE::TokenizerBPE(const std::string& jsonPath) : 
@@ -19,6 +24,7 @@ TokenizerBPE::TokenizerBPE(const std::string& jsonPath) :
 	eos(u8"", -1),
 	pad(u8"", -1),
 	unk(u8"", -1),
+	firstSyntheticId(0),
 	splitBehavior("Isolated"),
 	splitInvert(false),
 	useByteLevelEncoding(true)	
@@ -46,6 +52,50 @@ const Token& TokenizerBPE::GetEos() const
 	return this->eos;
 }
 
+/// <summary>
+/// Set memory limit of pre-tokenized word cache (0 - disabled)
+/// </summary>
+/// <param name="maxBytes"></param>
+void TokenizerBPE::SetWordCacheLimit(size_t maxBytes)
+{
+	this->wordCache.SetMaxBytes(maxBytes);
+}
+
+/// <summary>
+/// Remove all cached words and reset cache statistics
+/// </summary>
+void TokenizerBPE::ClearWordCache()
+{
+	this->wordCache.Clear();
+	this->wordCache.ResetStats();
+}
+
+TokenCache::Stats TokenizerBPE::GetWordCacheStats() const
+{
+	return this->wordCache.GetStats();
+}
+
+/// <summary>
+/// Write loaded tokenizer as compiled binary file,
+/// that can be later used instead of tokenizer.json.
+/// Throws std::runtime_error on failure
+/// </summary>
+/// <param name="path"></param>
+void TokenizerBPE::SaveCompiled(const std::string& path) const
+{
+	TokenizerBinaryFile::Content content;
+	content.configJson = json->GetConfigJson();
+	content.vocab = &json->GetVocab();
+	content.merges = &this->bpeMerges;
+	content.firstSyntheticId = this->firstSyntheticId;
+	for (const auto& [h, id] : this->syntheticIds)
+	{
+		content.syntheticIds.push_back({ h, id, 0 });
+	}
+
+	TokenizerBinaryFile::Write(path, content);
+}
+
 //==========================================================================
 // Loading and prepearing data
 //==========================================================================
@@ -55,9 +105,10 @@ void TokenizerBPE::Load()
 	this->CreateBytesToUnicodeMapping();
 	
 	json->Load();
+	this->wordCache.Clear();
 	this->splitRx.reset();
+	this->splitScanner.reset();
 	this->splitStr.clear();
-	this->bpeRanks.clear();
 
 	auto split = json->GetPretokenizerType<TokenizerJsonLoader::SplitType>();
 	if (split)
@@ -69,6 +120,12 @@ void TokenizerBPE::Load()
 		if (split->splitType == TokenizerJsonLoader::SplitType::SplitDataType::Regex)
 		{
 			splitRx = std::make_shared<UnicodeRegex>(split->splitData);
+
+			auto patternType = PreTokenizer::DetectPattern(split->splitData);
+			if (patternType != PreTokenizer::PatternType::UNKNOWN)
+			{
+				splitScanner = std::make_shared<PreTokenizer>(patternType);
+			}
 		}
 		else if (split->splitType == TokenizerJsonLoader::SplitType::SplitDataType::String)
 		{
@@ -123,30 +180,104 @@ void TokenizerBPE::Load()
 	}
 	
 
-	this->specialTokenIds.clear();
+	this->specialTokens.Clear();
 		
 	const auto& added = json->AddedTokens();
 	for (const auto& it : added)
 	{
-		//StringUtf8Hash h = Token::CalcHash(it.content);
-		this->specialTokenIds.try_emplace(it.content, it.id);
+		this->specialTokens.Add(it.content, it.id);
 	}
+	this->specialTokens.Build();
 	
 		
 
+	this->BuildMergeTable();
+	this->BuildTokenBytes();
+}
+
+/// <summary>
+/// Convert merges from loader to table over token ids.
+/// Rank of merge is its index in the merges list.
+/// Parts or results of merges, that are not in vocab, get synthetic id,
+/// so merging runs same as with strings.
+/// Compiled tokenizer already contains the table
+/// </summary>
+void TokenizerBPE::BuildMergeTable()
+{
+	const auto& vocab = json->GetVocab();
 	const auto& merges = json->GetMerges();
-		
+
+	this->bpeMerges.Clear();
+	this->syntheticIds.clear();
+
+	if (auto binary = json->GetBinaryFile())
+	{
+		this->bpeMerges.Attach(binary->GetMergeTable());
+		this->firstSyntheticId = binary->GetFirstSyntheticId();
+		for (const auto& s : binary->GetSyntheticIds())
+		{
+			this->syntheticIds.try_emplace(s.hash, s.id);
+		}
+		return;
+	}
+
+	this->firstSyntheticId = vocab.GetMaxId() + 1;
+
+	auto getOrCreateId = [&](StringUtf8Hash h) -> TokenId {
+		TokenId id = vocab.Find(h);
+		if (id != -1)
+		{
+			return id;
+		}
+
+		TokenId newId = this->firstSyntheticId + static_cast<TokenId>(this->syntheticIds.size());
+		return this->syntheticIds.try_emplace(h, newId).first->second;
+	};
+
+	this->bpeMerges.Reserve(merges.size());
+
 	for (size_t i = 0; i < merges.size(); i++)
 	{
 		const auto& mi = merges[i];
-			
-		if (mi.hashes.size() == 2)
-		{			
-			auto it = this->bpeRanks.try_emplace(mi.hashes[0]);
-			it.first->second.try_emplace(mi.hashes[1], static_cast<int>(i));
-		}		
-	}	
-	
+
+		if (mi.hashes.size() != 2)
+		{
+			continue;
+		}
+
+		TokenId left = getOrCreateId(mi.hashes[0]);
+		TokenId right = getOrCreateId(mi.hashes[1]);
+		TokenId merged = getOrCreateId(Token::CalcHash(mi.parts[0] + mi.parts[1]));
+
+		this->bpeMerges.TryAdd(left, right, static_cast<int32_t>(i), merged);
+	}
+
+	if (this->syntheticIds.empty() == false)
+	{
+		MY_LOG_WARNING("Tokenizer - %zu merge symbols are not in vocab", this->syntheticIds.size());
+	}
+}
+
+/// <summary>
+/// Get id of symbol used for merging - vocab id or synthetic id
+/// </summary>
+/// <param name="hash"></param>
+/// <returns>-1 if symbol can not take part in any merge</returns>
+TokenId TokenizerBPE::GetSymbolId(StringUtf8Hash hash) const
+{
+	TokenId id = json->GetVocab().Find(hash);
+	if (id != -1)
+	{
+		return id;
+	}
+
+	auto jt = this->syntheticIds.find(hash);
+	if (jt != this->syntheticIds.end())
+	{
+		return jt->second;
+	}
+
+	return -1;
 }
 
 TokenId TokenizerBPE::GetSpecialTokenId(const StringUtf8& token) const
@@ -166,10 +297,10 @@ TokenId TokenizerBPE::GetSpecialTokenId(const StringUtf8& token) const
 
 	auto tokenHash = Token::CalcHash(token);
 
-	auto jt = vocab.find(tokenHash);
-	if (jt != vocab.end())
+	TokenId id = vocab.Find(tokenHash);
+	if (id != -1)
 	{
-		return jt->second;
+		return id;
 	}
 	else
 	{
@@ -186,7 +317,12 @@ TokenId TokenizerBPE::GetSpecialTokenId(const StringUtf8& token) const
 }
 
 
-void TokenizerBPE::CreateBytesToUnicodeMapping()
+/// <summary>
+/// GPT-2 byte encoder table byte -> unicode char
+/// (printable bytes map to themselves, the rest to 256+)
+/// </summary>
+/// <returns></returns>
+std::array<UnicodeCodePoint, 256> TokenizerBPE::CreateBytesToUnicodeTable()
 {
 	// GPT-2 byte encoder mapping bytes -> unicode chars
 	std::vector<char8_t> bs;
@@ -233,13 +369,26 @@ void TokenizerBPE::CreateBytesToUnicodeMapping()
 		}
 	}
 
+	std::array<UnicodeCodePoint, 256> table = {};
+	for (size_t i = 0; i < bs.size(); ++i) 
+	{
+		table[bs[i]] = cs[i];
+	}
+
+	return table;
+}
+
+void TokenizerBPE::CreateBytesToUnicodeMapping()
+{
+	auto table = CreateBytesToUnicodeTable();
+
 	bytesToUnicodeMapping.clear();
 	bytesToUnicodeMapping.reserve(256);
-	for (size_t i = 0; i < bs.size(); ++i) 
+	for (int b = 0; b < 256; ++b) 
 	{
-		bytesToUnicodeMapping.try_emplace(bs[i], cs[i]);
+		bytesToUnicodeMapping.try_emplace(static_cast<char8_t>(b), table[b]);
 
-		unicodeToBytesMapping.try_emplace(cs[i], bs[i]);
+		unicodeToBytesMapping.try_emplace(table[b], static_cast<char8_t>(b));
 	}	
 }
 
@@ -247,7 +396,7 @@ void TokenizerBPE::CreateBytesToUnicodeMapping()
 // Run encode for input text
 //==========================================================================
 
-StringUtf8 TokenizerBPE::RunNormalizer(const StringUtf8& str)
+StringUtf8 TokenizerBPE::RunNormalizer(const StringUtf8& str) const
 {
 	auto n = json->GetNormalizer();
 	if (n == nullptr)
@@ -265,13 +414,28 @@ StringUtf8 TokenizerBPE::RunNormalizer(const StringUtf8& str)
 	return str;
 }
 
-std::vector<StringUtf8> TokenizerBPE::SplitIsolated(const StringUtf8& str)
+/// <summary>
+/// Split text to pieces for BPE.
+/// Returned pieces are views into str
+/// </summary>
+/// <param name="str"></param>
+/// <returns></returns>
+std::vector<std::u8string_view> TokenizerBPE::SplitIsolated(std::u8string_view str) const
 {
 	if (str.empty())
 	{
 		return {};
 	}
 
+	if (this->splitScanner)
+	{
+		std::vector<std::u8string_view> res;
+		if (this->splitScanner->Split(str, res))
+		{
+			return res;
+		}
+	}
+
 	if (this->splitRx)
 	{
 		return this->SplitIsolatedRegex(str);
@@ -292,7 +456,7 @@ std::vector<StringUtf8> TokenizerBPE::SplitIsolated(const StringUtf8& str)
 		return this->SplitMergedWithPrevious(str);
 	}
 	
-	return StringUtils::Split(str, this->splitStr);	
+	return this->SplitByString(str);
 }
 
 /// <summary>
@@ -301,12 +465,13 @@ std::vector<StringUtf8> TokenizerBPE::SplitIsolated(const StringUtf8& str)
 /// </summary>
 /// <param name="str"></param>
 /// <returns></returns>
-std::vector<StringUtf8> TokenizerBPE::SplitIsolatedRegex(const StringUtf8& str)
+std::vector<std::u8string_view> TokenizerBPE::SplitIsolatedRegex(std::u8string_view str) const
 {
-	std::vector<StringUtf8> res;
+	std::vector<std::u8string_view> res;
+	std::u8string_view strView = str;
 	size_t last = 0;
 
-	auto spans = this->splitRx->FindSpans(str);
+	auto spans = this->splitRx->FindSpans(StringUtf8(str));
 	
 	for (const auto& span : spans)
 	{		
@@ -316,26 +481,57 @@ std::vector<StringUtf8> TokenizerBPE::SplitIsolatedRegex(const StringUtf8& str)
 		if (a > last)
 		{
 			//gap = str[last:a]			
-			res.emplace_back(str.substr(last, a - last));
+			res.emplace_back(strView.substr(last, a - last));
 		}
 
 		//tok = text[a:b]		
-		res.emplace_back(str.substr(a, b - a));
+		res.emplace_back(strView.substr(a, b - a));
 		last = b;
 	}
 
 	if (last < str.length())
 	{
 		//tail = text[last:]			
-		res.emplace_back(str.substr(last));
+		res.emplace_back(strView.substr(last));
 	}
 
 	return res;
 }
 
-std::vector<StringUtf8> TokenizerBPE::SplitMergedWithPrevious(const StringUtf8& str) const
+/// <summary>
+/// Split by splitStr, delimiters are dropped
+/// </summary>
+/// <param name="str"></param>
+/// <returns></returns>
+std::vector<std::u8string_view> TokenizerBPE::SplitByString(std::u8string_view str) const
 {
-	std::vector<StringUtf8> out;
+	std::vector<std::u8string_view> out;
+
+	size_t pos = 0;
+	while (true)
+	{
+		size_t found = str.find(this->splitStr, pos);
+		if (found == std::u8string_view::npos)
+		{
+			out.emplace_back(str.substr(pos));
+			break;
+		}
+
+		out.emplace_back(str.substr(pos, found - pos));
+		pos = found + this->splitStr.size();
+	}
+
+	return out;
+}
+
+/// <summary>
+/// Split by splitStr, delimiter is kept at the end of previous piece
+/// </summary>
+/// <param name="str"></param>
+/// <returns></returns>
+std::vector<std::u8string_view> TokenizerBPE::SplitMergedWithPrevious(std::u8string_view str) const
+{
+	std::vector<std::u8string_view> out;
 	if (str.empty())
 	{
 		return out;
@@ -351,30 +547,22 @@ std::vector<StringUtf8> TokenizerBPE::SplitMergedWithPrevious(const StringUtf8&
 	while (pos < str.size())
 	{
 		size_t found = str.find(this->splitStr, pos);
-		if (found == StringUtf8::npos)
+		if (found == std::u8string_view::npos)
 		{
-			if (pos < str.size())
-			{
-				out.emplace_back(str.substr(pos));
-			}
+			out.emplace_back(str.substr(pos));
 			break;
 		}
 
 		size_t next = found + dlen;
-		if (found > pos)
+		if ((found > pos) || (out.empty()))
 		{
 			out.emplace_back(str.substr(pos, next - pos));
 		}
 		else
 		{
-			if (!out.empty())
-			{
-				out.back().append(this->splitStr);
-			}
-			else
-			{
-				out.emplace_back(this->splitStr);
-			}
+			//delimiter directly after previous piece - pieces are contiguous,
+			//so just extend the view
+			out.back() = std::u8string_view(out.back().data(), out.back().size() + dlen);
 		}
 		pos = next;
 	}
@@ -383,7 +571,7 @@ std::vector<StringUtf8> TokenizerBPE::SplitMergedWithPrevious(const StringUtf8&
 }
 
 
-void TokenizerBPE::AppendFallbackIds(UnicodeCodePoint cp, std::vector<TokenId>& ids)
+void TokenizerBPE::AppendFallbackIds(UnicodeCodePoint cp, std::vector<TokenId>& ids) const
 {
 	if (cp < 0x80) {                   // one octet
 		ids.push_back(FindByteFallbackId(static_cast<char8_t>(cp)));		
@@ -415,71 +603,42 @@ TokenId TokenizerBPE::FindByteFallbackId(char8_t b) const
 	const auto& vocab = json->GetVocab();
 
 	auto h = Token::CalcHash(tok);
-	auto it = vocab.find(h);
-	if (it != vocab.end())
+	TokenId id = vocab.Find(h);
+	if (id != -1)
 	{
-		return it->second;
+		return id;
 	}
 
 	return this->unk.id;
 }
 
 
-std::vector<std::pair<bool, StringUtf8>> TokenizerBPE::SplitSpecialTokens(const StringUtf8& str) const
+/// <summary>
+/// Split text to plain segments and added tokens
+/// (single pass over text with Aho-Corasick automaton).
+/// Returned segments are views into str
+/// </summary>
+/// <param name="str"></param>
+/// <returns></returns>
+std::vector<SpecialTokenMatcher::Segment> TokenizerBPE::SplitSpecialTokens(std::u8string_view str) const
 {
-	if (str.empty())
-	{
-		return {};
-	}
-	if (this->specialTokenIds.empty())
-	{
-		return { { false, str } };
-	}
-
-	std::vector<std::pair<bool, StringUtf8>> out;
-	size_t pos = 0;
-	while (pos < str.size())
-	{
-		size_t bestPos = StringUtf8::npos;
-		StringUtf8 bestToken;
-
-		for (const auto& kv : this->specialTokenIds)
-		{
-			const auto& tok = kv.first;
-			
-			size_t found = str.find(tok, pos);
-			if (found == StringUtf8::npos)
-			{
-				continue;
-			}
-
-			if ((bestPos == StringUtf8::npos) || (found < bestPos) || ((found == bestPos) && (tok.size() > bestToken.size())))
-			{
-				bestPos = found;
-				bestToken = tok;
-			}
-		}
-
-		if (bestPos == StringUtf8::npos)
-		{
-			out.emplace_back(false, str.substr(pos));
-			break;
-		}
-
-		if (bestPos > pos)
-		{
-			out.emplace_back(false, str.substr(pos, bestPos - pos));
-		}
-
-		out.emplace_back(true, bestToken);
-		pos = bestPos + bestToken.size();
-	}
-
+	std::vector<SpecialTokenMatcher::Segment> out;
+	this->specialTokens.Split(str, out);
 	return out;
 }
 
 
-std::vector<TokenId> TokenizerBPE::EncodePiece(const std::vector<UnicodeCodePoint>& unicodes)
+/// <summary>
+/// Run BPE merges over single pre-tokenized piece.
+/// Symbols are kept as doubly-linked list of token ids (spans in input),
+/// candidate pairs are in min-heap ordered by (rank, position).
+/// Heap entries are not removed when neighbours change - they are
+/// validated when popped. Gives the same result as repeated full scans
+/// for the lowest-rank pair, in O(n log n)
+/// </summary>
+/// <param name="unicodes"></param>
+/// <returns></returns>
+std::vector<TokenId> TokenizerBPE::EncodePiece(const std::vector<UnicodeCodePoint>& unicodes) const
 {
 	
 	const auto& vocab = json->GetVocab();
@@ -488,114 +647,154 @@ std::vector<TokenId> TokenizerBPE::EncodePiece(const std::vector<UnicodeCodePoin
 	if (json->GetModelInfo().ignore_merges)
 	{
 		auto tokenHash = Token::CalcHash(unicodes);
-		auto it = vocab.find(tokenHash);
-		if (it != vocab.end())
+		TokenId id = vocab.Find(tokenHash);
+		if (id != -1)
 		{
-			return { it->second };
+			return { id };
 		}
 	}
 
 	//if not found, look in merges
 
-	
-	std::vector<std::vector<UnicodeCodePoint>> symbols;
-	for (auto ch : unicodes)
+	struct Symbol
+	{
+		TokenId id;
+		int32_t prev;
+		int32_t next;
+		uint32_t start;
+		uint32_t len; //0 - symbol was merged to its left neighbour
+	};
+
+	struct Candidate
+	{
+		int32_t rank;
+		int32_t pos;
+		TokenId left;
+		TokenId right;
+
+		bool operator>(const Candidate& o) const
+		{
+			return (rank > o.rank) || ((rank == o.rank) && (pos > o.pos));
+		}
+	};
+
+	const int32_t n = static_cast<int32_t>(unicodes.size());
+
+	std::vector<Symbol> symbols;
+	symbols.reserve(n);
+	for (int32_t i = 0; i < n; i++)
 	{
-		symbols.push_back({ ch });
+		symbols.push_back({ this->GetSymbolId(Token::CalcHash(unicodes[i])), i - 1, (i + 1 < n) ? i + 1 : -1, uint32_t(i), 1 });
 	}
-	
-	while (symbols.size() > 1) 
-	{		
-		int best_rank = std::numeric_limits<int>::max();
-		std::pair<StringUtf8Hash, StringUtf8Hash> best_pair{};
 
-		for (size_t i = 0; i < symbols.size() - 1; i++) 
+	std::vector<Candidate> heapData;
+	heapData.reserve(n);
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap(std::greater<Candidate>(), std::move(heapData));
+
+	//merges are done in rounds - all occurences of the lowest-rank pair,
+	//same as with full rescans. New pairs with lower rank than the current
+	//round are deferred until the round ends
+	int32_t roundRank = -1;
+	std::vector<Candidate> deferred;
+
+	auto pushCandidate = [&](int32_t pos) {
+		int32_t next = symbols[pos].next;
+		if (next == -1)
 		{
-			auto h0 = Token::CalcHash(symbols[i]);
-						
-			auto it = bpeRanks.find(h0);
-			if (it == bpeRanks.end())
+			return;
+		}
+		if (auto rule = this->bpeMerges.Find(symbols[pos].id, symbols[next].id))
+		{
+			Candidate c = { rule->rank, pos, symbols[pos].id, symbols[next].id };
+			if (c.rank < roundRank)
 			{
-				continue;
+				deferred.push_back(c);
 			}
+			else
+			{
+				heap.push(c);
+			}
+		}
+	};
 
-			auto h1 = Token::CalcHash(symbols[i + 1]);
+	for (int32_t i = 0; i + 1 < n; i++)
+	{
+		pushCandidate(i);
+	}
 
-			auto jt = it->second.find(h1);
-			if (jt == it->second.end())
+	while (true)
+	{
+		if (heap.empty() || (heap.top().rank != roundRank))
+		{
+			for (const auto& d : deferred)
 			{
-				continue;
+				heap.push(d);
 			}
+			deferred.clear();
 
-			if (jt->second < best_rank) 
+			if (heap.empty())
 			{
-				best_rank = jt->second;
-				best_pair = { h0, h1 };				
+				break;
 			}
+			roundRank = heap.top().rank;
 		}
 
-		if (best_rank == std::numeric_limits<int>::max())
+		Candidate c = heap.top();
+		heap.pop();
+
+		Symbol& l = symbols[c.pos];
+		if ((l.len == 0) || (l.next == -1) || (l.id != c.left))
 		{
-			break;
+			continue;
 		}
 
-		std::vector<std::vector<UnicodeCodePoint>> merged;
-		merged.reserve(symbols.size());
+		Symbol& r = symbols[l.next];
+		if (r.id != c.right)
+		{
+			continue;
+		}
 
-		size_t i = 0;
-		while (i < symbols.size()) 
-		{			
-			if ((i + 1 < symbols.size()) &&
-				(Token::CalcHash(symbols[i]) == best_pair.first) &&
-				(Token::CalcHash(symbols[i + 1]) == best_pair.second))
-			{				
-				auto& tmp = merged.emplace_back(symbols[i]);
-				tmp.insert(tmp.end(), symbols[i + 1].begin(), symbols[i + 1].end());
-				i += 2;
-			}
-			else 
-			{
-				merged.push_back(symbols[i]);
-				i++;
-			}
+		auto rule = this->bpeMerges.Find(l.id, r.id);
+
+		l.id = rule->merged;
+		l.len += r.len;
+		l.next = r.next;
+		if (r.next != -1)
+		{
+			symbols[r.next].prev = c.pos;
 		}
+		r.len = 0;
 
-		symbols.swap(merged);
+		if (l.prev != -1)
+		{
+			pushCandidate(l.prev);
+		}
+		pushCandidate(c.pos);
 	}
 	
 	std::vector<TokenId> ids;
-	for (const auto& s : symbols)
+	ids.reserve(n);
+	for (int32_t i = (n > 0) ? 0 : -1; i != -1; i = symbols[i].next)
 	{
-		auto tokenHash = Token::CalcHash(s);
-		auto it = vocab.find(tokenHash);
-		if (it != vocab.end())
+		const auto& s = symbols[i];
+		if ((s.id >= 0) && (s.id < this->firstSyntheticId))
 		{
-			ids.push_back(it->second);
+			ids.push_back(s.id);
+			continue;
 		}
-		else 
+
+		//symbol not in vocab
+		for (uint32_t k = s.start; k < s.start + s.len; k++)
 		{
+			auto ch = unicodes[k];
 			if (json->GetModelInfo().byte_fallback)
-			{								
-				for (auto ch : s)
-				{
-					AppendFallbackIds(ch, ids);
-				}
+			{
+				AppendFallbackIds(ch, ids);
 			}
 			else
 			{
-				for (auto ch : s)
-				{
-					auto tokenHash = Token::CalcHash(ch);
-					auto it = vocab.find(tokenHash);
-					if (it != vocab.end())
-					{
-						ids.push_back(it->second);
-					}
-					else 
-					{
-						ids.push_back(this->unk.id);
-					}
-				}
+				TokenId id = vocab.Find(Token::CalcHash(ch));
+				ids.push_back((id != -1) ? id : this->unk.id);
 			}
 		}
 	}
@@ -603,7 +802,7 @@ std::vector<TokenId> TokenizerBPE::EncodePiece(const std::vector<UnicodeCodePoin
 	return ids;
 }
 
-std::vector<TokenId> TokenizerBPE::Encode(const StringUtf8& str)
+std::vector<TokenId> TokenizerBPE::Encode(const StringUtf8& str) const
 {
 	return this->Encode(str, false, false);
 }
@@ -615,7 +814,7 @@ std::vector<TokenId> TokenizerBPE::Encode(const StringUtf8& str)
 /// <param name="addBos"></param>
 /// <param name="addEos"></param>
 /// <returns></returns>
-std::vector<TokenId> TokenizerBPE::Encode(const StringUtf8& str, bool addBos, bool addEos)
+std::vector<TokenId> TokenizerBPE::Encode(const StringUtf8& str, bool addBos, bool addEos) const
 {	
 	std::vector<TokenId> ids;
 
@@ -631,22 +830,18 @@ std::vector<TokenId> TokenizerBPE::Encode(const StringUtf8& str, bool addBos, bo
 	auto split = this->SplitSpecialTokens(normalizedStr);
 	for (const auto& segment : split)
 	{
-		if (segment.second.empty())
+		if (segment.text.empty())
 		{
 			continue;
 		}
 
-		if (segment.first)
+		if (segment.id != -1)
 		{
-			auto it = this->specialTokenIds.find(segment.second);
-			if (it != this->specialTokenIds.end())
-			{
-				ids.push_back(it->second);
-			}
+			ids.push_back(segment.id);
 			continue;
 		}
 
-		auto pieces = this->SplitIsolated(segment.second);
+		auto pieces = this->SplitIsolated(segment.text);
 		for (const auto& p : pieces)
 		{
 			if (p.empty())
@@ -654,6 +849,12 @@ std::vector<TokenId> TokenizerBPE::Encode(const StringUtf8& str, bool addBos, bo
 				continue;
 			}
 
+			const bool useCache = (p.size() <= MAX_CACHED_PIECE_BYTES);
+			if ((useCache) && (this->wordCache.TryGet(p, ids)))
+			{
+				continue;
+			}
+
 			std::vector<UnicodeCodePoint> unicodes;
 			unicodes.reserve(p.size());
 
@@ -677,6 +878,10 @@ std::vector<TokenId> TokenizerBPE::Encode(const StringUtf8& str, bool addBos, bo
 
 
 			auto tmp = this->EncodePiece(unicodes);
+			if (useCache)
+			{
+				this->wordCache.Put(p, tmp);
+			}
 
 			ids.insert(ids.end(), tmp.begin(), tmp.end());
 		}
@@ -761,60 +966,133 @@ void TokenizerBPE::AppendUtf8Bytes(UnicodeCodePoint cp, std::vector<char8_t>& ou
 	}
 }
 
-StringUtf8 TokenizerBPE::Decode(const std::vector<TokenId>& ids)
+StringUtf8 TokenizerBPE::Decode(const std::vector<TokenId>& ids) const
 {
-	const auto& revVocab = json->GetVocabReversed();
+	size_t len = 0;
+	for (auto id : ids)
+	{
+		len += this->GetTokenBytes(id).size();
+	}
 
-	std::vector<char8_t> outBytes;
+	StringUtf8 out;
+	out.reserve(len);
 
 	for (auto id : ids)
 	{
-		auto it = revVocab.find(id);
-		if (it == revVocab.end())
-		{
-			continue;
-		}
+		out += this->GetTokenBytes(id);
+	}
 
-		auto token = it->second;
-		if (!this->decodeReplaceFrom.empty())
-		{
-			StringUtils::ReplaceAllSubStr(token, this->decodeReplaceFrom, this->decodeReplaceTo);
-		}
+	return out;
+}
+
+/// <summary>
+/// Get final decoded bytes of single token
+/// (byte-level mapping, byte fallback and decoder replace already applied).
+/// Bytes may end in the middle of UTF-8 sequence, that continues
+/// in the next token. Unknown ids return empty view
+/// </summary>
+/// <param name="id"></param>
+/// <returns></returns>
+std::u8string_view TokenizerBPE::GetTokenBytes(TokenId id) const
+{
+	if ((id < 0) || (static_cast<size_t>(id) + 1 >= this->tokenBytesOffsets.size()))
+	{
+		return {};
+	}
+
+	const uint32_t start = this->tokenBytesOffsets[id];
+	const uint32_t end = this->tokenBytesOffsets[id + 1];
+
+	return std::u8string_view(this->tokenBytes.data() + start, end - start);
+}
+
+/// <summary>
+/// Number of token ids (max id + 1), including added tokens
+/// that are not part of model vocab
+/// </summary>
+/// <returns></returns>
+size_t TokenizerBPE::GetVocabSize() const
+{
+	TokenId maxId = json->GetVocab().GetMaxId();
+	for (const auto& t : json->AddedTokens())
+	{
+		maxId = std::max(maxId, t.id);
+	}
 
-		char8_t decodedByte = 0;
-		if (json->GetModelInfo().byte_fallback && TryParseByteFallbackToken(token, decodedByte))
+	return static_cast<size_t>(maxId + 1);
+}
+
+/// <summary>
+/// Precompute decoded bytes of all tokens, so Decode
+/// is only concatenation of ready byte strings
+/// </summary>
+void TokenizerBPE::BuildTokenBytes()
+{
+	const auto& vocab = json->GetVocab();
+	const TokenId maxId = vocab.GetMaxId();
+
+	this->tokenBytes.clear();
+	this->tokenBytesOffsets.clear();
+	
+	if (maxId < 0)
+	{
+		return;
+	}
+
+	this->tokenBytesOffsets.reserve(static_cast<size_t>(maxId) + 2);
+	this->tokenBytesOffsets.push_back(0);
+
+	for (TokenId id = 0; id <= maxId; id++)
+	{
+		std::u8string_view tokenView;
+		if (vocab.TryGetToken(id, tokenView))
 		{
-			outBytes.push_back(decodedByte);
-			continue;
+			this->AppendTokenBytes(tokenView, this->tokenBytes);
 		}
 
-		if (this->useByteLevelEncoding)
+		this->tokenBytesOffsets.push_back(static_cast<uint32_t>(this->tokenBytes.size()));
+	}
+}
+
+/// <summary>
+/// Decode single vocab token to output bytes
+/// </summary>
+/// <param name="tokenView"></param>
+/// <param name="outBytes"></param>
+void TokenizerBPE::AppendTokenBytes(std::u8string_view tokenView, std::vector<char8_t>& outBytes) const
+{
+	StringUtf8 token(tokenView);
+	if (!this->decodeReplaceFrom.empty())
+	{
+		StringUtils::ReplaceAllSubStr(token, this->decodeReplaceFrom, this->decodeReplaceTo);
+	}
+
+	char8_t decodedByte = 0;
+	if (json->GetModelInfo().byte_fallback && TryParseByteFallbackToken(token, decodedByte))
+	{
+		outBytes.push_back(decodedByte);
+		return;
+	}
+
+	if (this->useByteLevelEncoding)
+	{
+		CustomU8Iterator itU8(token);
+		UnicodeCodePoint ch;
+		while ((ch = itU8.GetCurrentAndAdvance()) != itU8.DONE)
 		{
-			CustomU8Iterator itU8(token);
-			UnicodeCodePoint ch;
-			while ((ch = itU8.GetCurrentAndAdvance()) != itU8.DONE)
+			auto jt = unicodeToBytesMapping.find(ch);
+			if (jt != unicodeToBytesMapping.end())
 			{
-				auto jt = unicodeToBytesMapping.find(ch);
-				if (jt != unicodeToBytesMapping.end())
-				{
-					outBytes.push_back(jt->second);
-				}
-				else
-				{
-					AppendUtf8Bytes(ch, outBytes);
-				}
+				outBytes.push_back(jt->second);
+			}
+			else
+			{
+				AppendUtf8Bytes(ch, outBytes);
 			}
 		}
-		else
-		{
-			outBytes.insert(outBytes.end(), token.begin(), token.end());
-		}		
 	}
-
-	if (outBytes.empty())
+	else
 	{
-		return u8"";
+		outBytes.insert(outBytes.end(), token.begin(), token.end());
 	}
-
-	return StringUtf8(outBytes.data(), outBytes.size());
 }
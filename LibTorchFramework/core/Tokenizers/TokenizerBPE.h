@@ -2,17 +2,23 @@
 #define TOKENIZER_BPE_H
 
 class UnicodeRegex;
+class PreTokenizer;
 
 #include <string>
 #include <memory>
+#include <string_view>
+#include <array>
 
 #include "./Tokenizers.h"
 #include "./TokenizerJsonLoader.h"
+#include "./BpeMergeTable.h"
+#include "./TokenCache.h"
+#include "./Strings/SpecialTokenMatcher.h"
 
 class TokenizerBPE : public Tokenizer
 {
 public:
-	TokenizerBPE(const std::string& jsonPath);
+	TokenizerBPE(const std::string& jsonPath); //tokenizer.json or compiled file
 	virtual ~TokenizerBPE();
 
 	const Token& GetPad() const;
@@ -20,13 +26,24 @@ public:
 	const Token& GetEos() const;
 
 	void Load();
+	void SaveCompiled(const std::string& path) const;
 
-	std::vector<TokenId> Encode(const StringUtf8& str) override;
-	std::vector<TokenId> Encode(const StringUtf8& str, bool addBos, bool addEos);
+	std::vector<TokenId> Encode(const StringUtf8& str) const override;
+	std::vector<TokenId> Encode(const StringUtf8& str, bool addBos, bool addEos) const;
 	
-	StringUtf8 Decode(const std::vector<TokenId>& ids) override;
+	StringUtf8 Decode(const std::vector<TokenId>& ids) const override;
+	std::u8string_view GetTokenBytes(TokenId id) const;
+	size_t GetVocabSize() const;
+
+	void SetWordCacheLimit(size_t maxBytes);
+	void ClearWordCache();
+	TokenCache::Stats GetWordCacheStats() const;
+
+	static std::array<UnicodeCodePoint, 256> CreateBytesToUnicodeTable();
+	static void AppendUtf8Bytes(UnicodeCodePoint cp, std::vector<char8_t>& out);
 
 protected:
+	static constexpr size_t MAX_CACHED_PIECE_BYTES = 256;
 
 	std::shared_ptr<TokenizerJsonLoader> json;
 
@@ -35,11 +52,21 @@ protected:
 	Token pad;
 	Token unk;
 
-	std::unordered_map<StringUtf8, TokenId> specialTokenIds;
+	//automaton over added tokens, built in Load
+	SpecialTokenMatcher specialTokens;
+
+	//merge rules over token ids
+	//symbols that take part in merges, but are not in vocab
+	//get synthetic ids starting at firstSyntheticId (never emitted)
+	BpeMergeTable bpeMerges;
+	std::unordered_map<StringUtf8Hash, TokenId> syntheticIds;
+	TokenId firstSyntheticId;
 
-	std::unordered_map<StringUtf8Hash, std::unordered_map<StringUtf8Hash, int>> bpeRanks;
+	//pre-tokenized piece -> ids (thread-safe, used from const Encode)
+	mutable TokenCache wordCache;
 
 	std::shared_ptr<UnicodeRegex> splitRx;
+	std::shared_ptr<PreTokenizer> splitScanner; //used instead of splitRx for known patterns
 	StringUtf8 splitStr;
 	std::string splitBehavior;
 	bool splitInvert;
@@ -48,30 +75,38 @@ protected:
 	StringUtf8 decodeReplaceFrom;
 	StringUtf8 decodeReplaceTo;
 
+	//decoded bytes of each token, token id -> [offsets[id], offsets[id + 1])
+	std::vector<char8_t> tokenBytes;
+	std::vector<uint32_t> tokenBytesOffsets;
+
 	std::unordered_map<char8_t, UnicodeCodePoint> bytesToUnicodeMapping;
 	std::unordered_map<UnicodeCodePoint, char8_t> unicodeToBytesMapping;
 
 	
 	TokenId GetSpecialTokenId(const StringUtf8& token) const;
+	TokenId GetSymbolId(StringUtf8Hash hash) const;
+
+	void BuildMergeTable();
+	void BuildTokenBytes();
+	void AppendTokenBytes(std::u8string_view tokenView, std::vector<char8_t>& outBytes) const;
 
 	void CreateBytesToUnicodeMapping();
 
-	StringUtf8 RunNormalizer(const StringUtf8& str);
+	StringUtf8 RunNormalizer(const StringUtf8& str) const;
 
-	std::vector<StringUtf8> SplitIsolated(const StringUtf8& str);
-	std::vector<StringUtf8> SplitIsolatedRegex(const StringUtf8& str);
-	std::vector<StringUtf8> SplitMergedWithPrevious(const StringUtf8& str) const;
+	std::vector<std::u8string_view> SplitIsolated(std::u8string_view str) const;
+	std::vector<std::u8string_view> SplitIsolatedRegex(std::u8string_view str) const;
+	std::vector<std::u8string_view> SplitByString(std::u8string_view str) const;
+	std::vector<std::u8string_view> SplitMergedWithPrevious(std::u8string_view str) const;
 	TokenId FindByteFallbackId(char8_t b) const;
-	void AppendFallbackIds(UnicodeCodePoint cp, std::vector<TokenId>& ids);
+	void AppendFallbackIds(UnicodeCodePoint cp, std::vector<TokenId>& ids) const;
 	
-	std::vector<std::pair<bool, StringUtf8>> SplitSpecialTokens(const StringUtf8& str) const;
+	std::vector<SpecialTokenMatcher::Segment> SplitSpecialTokens(std::u8string_view str) const;
 
-	std::vector<TokenId> EncodePiece(const std::vector<UnicodeCodePoint>& u);
+	std::vector<TokenId> EncodePiece(const std::vector<UnicodeCodePoint>& u) const;
 	
 
 	static bool TryParseByteFallbackToken(const StringUtf8& token, char8_t& outByte);
-
-	void AppendUtf8Bytes(UnicodeCodePoint cp, std::vector<char8_t>& out);
 };
 
 #endif
@@ -0,0 +1,719 @@
+#include "./TokenizerBPETrainer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <limits>
+
+#include <Utils/cJSON.h>
+#include <Utils/Logger.h>
+
+#include "./TokenizerBPE.h"
+
+#include "../../Utils/ThreadPool.h"
+
+//=============================================================
+// Pair statistics used during training
+//=============================================================
+
+namespace
+{
+	struct Pair
+	{
+		TokenId left;
+		TokenId right;
+		int64_t count;
+		std::vector<uint32_t> words; //words, where pair occurs (may contain stale entries)
+	};
+
+	uint64_t MakePairKey(TokenId left, TokenId right)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(left)) << 32) | static_cast<uint32_t>(right);
+	}
+
+	/// <summary>
+	/// Max-heap of pair indices ordered by count
+	/// (ties by smaller pair key - result is deterministic).
+	/// Position of each pair in the heap is stored, so its count
+	/// can be changed in O(log n)
+	/// </summary>
+	class PairHeap
+	{
+	public:
+		explicit PairHeap(const std::vector<Pair>& pairs) :
+			pairs(pairs)
+		{
+		}
+
+		bool IsEmpty() const
+		{
+			return this->heap.empty();
+		}
+
+		uint32_t Top() const
+		{
+			return this->heap.front();
+		}
+
+		/// <summary>
+		/// Pair count was changed - insert, remove or move pair
+		/// </summary>
+		void Update(uint32_t pairIndex)
+		{
+			if (pairIndex >= this->pos.size())
+			{
+				this->pos.resize(this->pairs.size(), NONE);
+			}
+
+			const bool active = (this->pairs[pairIndex].count > 0);
+			size_t p = this->pos[pairIndex];
+
+			if (p == NONE)
+			{
+				if (active)
+				{
+					this->heap.push_back(pairIndex);
+					this->pos[pairIndex] = this->heap.size() - 1;
+					this->SiftUp(this->heap.size() - 1);
+				}
+				return;
+			}
+
+			if (active == false)
+			{
+				this->Remove(p);
+				return;
+			}
+
+			this->SiftUp(p);
+			this->SiftDown(this->pos[pairIndex]);
+		}
+
+	protected:
+		static constexpr size_t NONE = std::numeric_limits<size_t>::max();
+
+		const std::vector<Pair>& pairs;
+		std::vector<uint32_t> heap;
+		std::vector<size_t> pos;
+
+		bool Less(uint32_t a, uint32_t b) const
+		{
+			const Pair& pa = this->pairs[a];
+			const Pair& pb = this->pairs[b];
+			if (pa.count != pb.count)
+			{
+				return pa.count < pb.count;
+			}
+			return MakePairKey(pa.left, pa.right) > MakePairKey(pb.left, pb.right);
+		}
+
+		void Swap(size_t a, size_t b)
+		{
+			std::swap(this->heap[a], this->heap[b]);
+			this->pos[this->heap[a]] = a;
+			this->pos[this->heap[b]] = b;
+		}
+
+		void SiftUp(size_t i)
+		{
+			while (i > 0)
+			{
+				size_t parent = (i - 1) / 2;
+				if (this->Less(this->heap[parent], this->heap[i]) == false)
+				{
+					break;
+				}
+				this->Swap(parent, i);
+				i = parent;
+			}
+		}
+
+		void SiftDown(size_t i)
+		{
+			const size_t n = this->heap.size();
+			while (true)
+			{
+				size_t best = i;
+				size_t l = 2 * i + 1;
+				size_t r = l + 1;
+				if ((l < n) && (this->Less(this->heap[best], this->heap[l]))) best = l;
+				if ((r < n) && (this->Less(this->heap[best], this->heap[r]))) best = r;
+				if (best == i)
+				{
+					break;
+				}
+				this->Swap(i, best);
+				i = best;
+			}
+		}
+
+		void Remove(size_t p)
+		{
+			const uint32_t removed = this->heap[p];
+			const size_t last = this->heap.size() - 1;
+			if (p != last)
+			{
+				this->Swap(p, last);
+			}
+			this->heap.pop_back();
+			this->pos[removed] = NONE;
+
+			if (p < this->heap.size())
+			{
+				const uint32_t moved = this->heap[p];
+				this->SiftUp(p);
+				this->SiftDown(this->pos[moved]);
+			}
+		}
+	};
+}
+
+//=============================================================
+
+TokenizerBPETrainer::TokenizerBPETrainer(const Settings& settings) :
+	settings(settings),
+	preTokenizer(settings.pattern),
+	bytesToUnicode(TokenizerBPE::CreateBytesToUnicodeTable())
+{
+	if (PreTokenizer::GetPattern(settings.pattern) == nullptr)
+	{
+		throw std::runtime_error("BPE trainer - unsupported pre-tokenizer pattern");
+	}
+}
+
+size_t TokenizerBPETrainer::GetUniqueWordsCount() const
+{
+	return this->words.size();
+}
+
+const std::vector<StringUtf8>& TokenizerBPETrainer::GetVocab() const
+{
+	return this->vocab;
+}
+
+const std::vector<std::pair<TokenId, TokenId>>& TokenizerBPETrainer::GetMerges() const
+{
+	return this->merges;
+}
+
+//=============================================================
+// Word counting
+//=============================================================
+
+/// <summary>
+/// Split text with pre-tokenizer and count pieces.
+/// Text with invalid UTF-8 is skipped
+/// </summary>
+/// <param name="text"></param>
+/// <param name="counts"></param>
+void TokenizerBPETrainer::CountWords(std::u8string_view text, WordCounts& counts) const
+{
+	std::vector<std::u8string_view> pieces;
+	if (this->preTokenizer.Split(text, pieces) == false)
+	{
+		return;
+	}
+
+	for (const auto& p : pieces)
+	{
+		if (p.empty() == false)
+		{
+			counts[StringUtf8(p)]++;
+		}
+	}
+}
+
+void TokenizerBPETrainer::MergeCounts(WordCounts& counts)
+{
+	if (this->words.empty())
+	{
+		this->words = std::move(counts);
+		return;
+	}
+
+	for (auto& [w, c] : counts)
+	{
+		this->words[w] += c;
+	}
+	counts.clear();
+}
+
+/// <summary>
+/// Count words of texts in parallel - each task has its
+/// own counts, they are merged at the end
+/// </summary>
+/// <param name="texts"></param>
+/// <param name="pool"></param>
+void TokenizerBPETrainer::CountWordsParallel(const std::vector<std::u8string_view>& texts, ThreadPool* pool)
+{
+	if (pool == nullptr)
+	{
+		pool = &ThreadPool::GetDefault();
+	}
+
+	const size_t parts = std::max<size_t>(1, std::min(texts.size(), pool->GetThreadsCount()));
+	std::vector<WordCounts> counts(parts);
+
+	pool->ParallelFor(parts, 1, [&](size_t begin, size_t end) {
+		for (size_t p = begin; p < end; p++)
+		{
+			const size_t from = texts.size() * p / parts;
+			const size_t to = texts.size() * (p + 1) / parts;
+			for (size_t i = from; i < to; i++)
+			{
+				this->CountWords(texts[i], counts[p]);
+			}
+		}
+	});
+
+	for (auto& c : counts)
+	{
+		this->MergeCounts(c);
+	}
+}
+
+void TokenizerBPETrainer::AddText(std::u8string_view text)
+{
+	this->CountWords(text, this->words);
+}
+
+void TokenizerBPETrainer::AddTexts(std::span<const StringUtf8> texts, ThreadPool* pool)
+{
+	std::vector<std::u8string_view> views(texts.begin(), texts.end());
+	this->CountWordsParallel(views, pool);
+}
+
+/// <summary>
+/// Add text file - it is read in blocks and each line
+/// is counted as a separate text (lines keep their new line char)
+/// </summary>
+/// <param name="path"></param>
+/// <param name="pool"></param>
+void TokenizerBPETrainer::AddFile(const std::string& path, ThreadPool* pool)
+{
+	std::ifstream f(path, std::ios::binary);
+	if (!f)
+	{
+		throw std::runtime_error("BPE trainer - failed to open: " + path);
+	}
+
+	std::vector<char8_t> block;
+	std::vector<std::u8string_view> lines;
+	size_t carry = 0;
+
+	while (true)
+	{
+		block.resize(carry + FILE_BLOCK_SIZE);
+		f.read(reinterpret_cast<char*>(block.data() + carry), FILE_BLOCK_SIZE);
+
+		const size_t size = carry + static_cast<size_t>(f.gcount());
+		const bool eof = (static_cast<size_t>(f.gcount()) < FILE_BLOCK_SIZE);
+
+		std::u8string_view data(block.data(), size);
+
+		lines.clear();
+		size_t start = 0;
+		while (start < data.size())
+		{
+			size_t nl = data.find(u8'\n', start);
+			if (nl == std::u8string_view::npos)
+			{
+				break;
+			}
+			lines.push_back(data.substr(start, nl + 1 - start));
+			start = nl + 1;
+		}
+
+		if ((eof) && (start < data.size()))
+		{
+			lines.push_back(data.substr(start));
+			start = data.size();
+		}
+
+		this->CountWordsParallel(lines, pool);
+
+		if (eof)
+		{
+			break;
+		}
+
+		//unfinished line continues in next block
+		carry = data.size() - start;
+		std::copy(block.begin() + start, block.begin() + start + carry, block.begin());
+	}
+}
+
+//=============================================================
+// Training
+//=============================================================
+
+/// <summary>
+/// Learn merges from counted words.
+///
+/// Words are stored as symbol ids in single array, each unique
+/// word once with its frequency. Pair counts are computed once
+/// (in parallel) and then updated only for words that contain
+/// the merged pair. The best pair is taken from indexed max-heap
+/// </summary>
+/// <param name="pool"></param>
+void TokenizerBPETrainer::Train(ThreadPool* pool)
+{
+	if (pool == nullptr)
+	{
+		pool = &ThreadPool::GetDefault();
+	}
+
+	this->vocab.clear();
+	this->merges.clear();
+
+	std::unordered_map<StringUtf8, TokenId> tokenIds;
+
+	//base symbols - bytes in byte-level encoding
+	for (int b = 0; b < 256; b++)
+	{
+		std::vector<char8_t> tmp;
+		TokenizerBPE::AppendUtf8Bytes(this->bytesToUnicode[b], tmp);
+
+		this->vocab.emplace_back(tmp.begin(), tmp.end());
+		tokenIds.try_emplace(this->vocab.back(), static_cast<TokenId>(b));
+	}
+
+	const size_t specialsCount = this->settings.specialTokens.size();
+	const size_t targetSize = (this->settings.vocabSize > specialsCount) ? this->settings.vocabSize - specialsCount : 0;
+
+	//words as byte ids, words with single byte have no pairs
+	struct Word
+	{
+		size_t offset;
+		uint32_t length;
+		uint64_t count;
+	};
+
+	std::vector<Word> ws;
+	std::vector<TokenId> symbols;
+	ws.reserve(this->words.size());
+
+	for (const auto& [w, c] : this->words)
+	{
+		if (w.size() < 2)
+		{
+			continue;
+		}
+
+		ws.push_back({ symbols.size(), static_cast<uint32_t>(w.size()), c });
+		for (char8_t ch : w)
+		{
+			symbols.push_back(static_cast<TokenId>(ch));
+		}
+	}
+
+	MY_LOG_INFO("BPE trainer - %zu unique words, %zu symbols", ws.size(), symbols.size());
+
+	//initial pair counts - in parallel, each part has own map
+	const size_t parts = std::max<size_t>(1, std::min(ws.size(), pool->GetThreadsCount()));
+	std::vector<std::unordered_map<uint64_t, int64_t>> partCounts(parts);
+
+	pool->ParallelFor(parts, 1, [&](size_t begin, size_t end) {
+		for (size_t p = begin; p < end; p++)
+		{
+			const size_t from = ws.size() * p / parts;
+			const size_t to = ws.size() * (p + 1) / parts;
+			for (size_t i = from; i < to; i++)
+			{
+				const TokenId* s = symbols.data() + ws[i].offset;
+				for (uint32_t k = 0; k + 1 < ws[i].length; k++)
+				{
+					partCounts[p][MakePairKey(s[k], s[k + 1])] += static_cast<int64_t>(ws[i].count);
+				}
+			}
+		}
+	});
+
+	std::vector<Pair> pairs;
+	std::unordered_map<uint64_t, uint32_t> pairIndex;
+
+	auto getPair = [&](uint64_t key) -> uint32_t {
+		auto it = pairIndex.find(key);
+		if (it != pairIndex.end())
+		{
+			return it->second;
+		}
+		uint32_t idx = static_cast<uint32_t>(pairs.size());
+		pairs.push_back({ static_cast<TokenId>(key >> 32), static_cast<TokenId>(key & 0xFFFFFFFF), 0, {} });
+		pairIndex.emplace(key, idx);
+		return idx;
+	};
+
+	for (auto& pc : partCounts)
+	{
+		for (const auto& [key, c] : pc)
+		{
+			pairs[getPair(key)].count += c;
+		}
+		pc.clear();
+	}
+
+	for (uint32_t w = 0; w < ws.size(); w++)
+	{
+		const TokenId* s = symbols.data() + ws[w].offset;
+		for (uint32_t k = 0; k + 1 < ws[w].length; k++)
+		{
+			auto& list = pairs[pairIndex[MakePairKey(s[k], s[k + 1])]].words;
+			if (list.empty() || (list.back() != w))
+			{
+				list.push_back(w);
+			}
+		}
+	}
+
+	PairHeap heap(pairs);
+	for (uint32_t i = 0; i < pairs.size(); i++)
+	{
+		heap.Update(i);
+	}
+
+	//merge loop
+	std::vector<uint32_t> stamp(ws.size(), std::numeric_limits<uint32_t>::max());
+	std::vector<std::pair<uint64_t, int64_t>> deltas;
+
+	uint32_t iteration = 0;
+	while ((this->vocab.size() < targetSize) && (heap.IsEmpty() == false))
+	{
+		const uint32_t top = heap.Top();
+		if (static_cast<uint64_t>(pairs[top].count) < this->settings.minFrequency)
+		{
+			break;
+		}
+
+		const TokenId left = pairs[top].left;
+		const TokenId right = pairs[top].right;
+
+		StringUtf8 merged = this->vocab[left] + this->vocab[right];
+		auto [itId, inserted] = tokenIds.try_emplace(merged, static_cast<TokenId>(this->vocab.size()));
+		if (inserted)
+		{
+			this->vocab.push_back(std::move(merged));
+		}
+		const TokenId newId = itId->second;
+
+		this->merges.emplace_back(left, right);
+
+		std::vector<uint32_t> affected = std::move(pairs[top].words);
+		pairs[top].words.clear();
+
+		for (uint32_t w : affected)
+		{
+			if (stamp[w] == iteration)
+			{
+				continue;
+			}
+			stamp[w] = iteration;
+
+			Word& word = ws[w];
+			TokenId* s = symbols.data() + word.offset;
+
+			bool found = false;
+			for (uint32_t k = 0; (k + 1 < word.length) && (found == false); k++)
+			{
+				found = (s[k] == left) && (s[k + 1] == right);
+			}
+			if (found == false)
+			{
+				continue;
+			}
+
+			deltas.clear();
+			for (uint32_t k = 0; k + 1 < word.length; k++)
+			{
+				deltas.emplace_back(MakePairKey(s[k], s[k + 1]), -1);
+			}
+
+			uint32_t j = 0;
+			for (uint32_t k = 0; k < word.length;)
+			{
+				if ((k + 1 < word.length) && (s[k] == left) && (s[k + 1] == right))
+				{
+					s[j++] = newId;
+					k += 2;
+				}
+				else
+				{
+					s[j++] = s[k++];
+				}
+			}
+			word.length = j;
+
+			for (uint32_t k = 0; k + 1 < word.length; k++)
+			{
+				deltas.emplace_back(MakePairKey(s[k], s[k + 1]), 1);
+			}
+
+			std::sort(deltas.begin(), deltas.end());
+
+			for (size_t d = 0; d < deltas.size();)
+			{
+				const uint64_t key = deltas[d].first;
+				int64_t sum = 0;
+				for (; (d < deltas.size()) && (deltas[d].first == key); d++)
+				{
+					sum += deltas[d].second;
+				}
+
+				if (sum == 0)
+				{
+					continue;
+				}
+
+				const uint32_t idx = getPair(key);
+				pairs[idx].count += sum * static_cast<int64_t>(word.count);
+				if ((sum > 0) && (pairs[idx].words.empty() || (pairs[idx].words.back() != w)))
+				{
+					pairs[idx].words.push_back(w);
+				}
+				heap.Update(idx);
+			}
+		}
+
+		//all occurrences are merged
+		pairs[top].count = 0;
+		heap.Update(top);
+
+		iteration++;
+	}
+
+	MY_LOG_INFO("BPE trainer - %zu merges, vocab size %zu", this->merges.size(), this->vocab.size());
+}
+
+//=============================================================
+// Save
+//=============================================================
+
+/// <summary>
+/// Save trained tokenizer as tokenizer.json
+/// (byte-level BPE, same layout as Llama-3 tokenizer).
+/// Throws std::runtime_error on failure
+/// </summary>
+/// <param name="jsonPath"></param>
+void TokenizerBPETrainer::Save(const std::string& jsonPath) const
+{
+	auto str = [](const StringUtf8& s) {
+		return reinterpret_cast<const char*>(s.c_str());
+	};
+
+	cJSON* root = cJSON_CreateObject();
+	cJSON_AddStringToObject(root, "version", "1.0");
+	cJSON_AddNullToObject(root, "truncation");
+	cJSON_AddNullToObject(root, "padding");
+
+	//special tokens after trained vocab, already existing tokens keep their id
+	cJSON* vocabJson = cJSON_CreateObject();
+	for (size_t i = 0; i < this->vocab.size(); i++)
+	{
+		cJSON_AddNumberToObject(vocabJson, str(this->vocab[i]), static_cast<double>(i));
+	}
+
+	cJSON* added = cJSON_AddArrayToObject(root, "added_tokens");
+	size_t nextId = this->vocab.size();
+	for (const auto& t : this->settings.specialTokens)
+	{
+		auto existing = std::find(this->vocab.begin(), this->vocab.end(), t);
+
+		size_t id = nextId;
+		if (existing != this->vocab.end())
+		{
+			id = static_cast<size_t>(existing - this->vocab.begin());
+		}
+		else
+		{
+			cJSON_AddNumberToObject(vocabJson, str(t), static_cast<double>(id));
+			nextId++;
+		}
+
+		cJSON* item = cJSON_CreateObject();
+		cJSON_AddNumberToObject(item, "id", static_cast<double>(id));
+		cJSON_AddStringToObject(item, "content", str(t));
+		cJSON_AddBoolToObject(item, "single_word", false);
+		cJSON_AddBoolToObject(item, "lstrip", false);
+		cJSON_AddBoolToObject(item, "rstrip", false);
+		cJSON_AddBoolToObject(item, "normalized", false);
+		cJSON_AddBoolToObject(item, "special", true);
+		cJSON_AddItemToArray(added, item);
+	}
+
+	cJSON_AddNullToObject(root, "normalizer");
+
+	//pre-tokenizer: Split with regex + ByteLevel without regex
+	cJSON* pre = cJSON_AddObjectToObject(root, "pre_tokenizer");
+	cJSON_AddStringToObject(pre, "type", "Sequence");
+	cJSON* preSeq = cJSON_AddArrayToObject(pre, "pretokenizers");
+
+	cJSON* split = cJSON_CreateObject();
+	cJSON_AddStringToObject(split, "type", "Split");
+	cJSON* pattern = cJSON_AddObjectToObject(split, "pattern");
+	cJSON_AddStringToObject(pattern, "Regex", reinterpret_cast<const char*>(PreTokenizer::GetPattern(this->settings.pattern)));
+	cJSON_AddStringToObject(split, "behavior", "Isolated");
+	cJSON_AddBoolToObject(split, "invert", false);
+	cJSON_AddItemToArray(preSeq, split);
+
+	cJSON* byteLevel = cJSON_CreateObject();
+	cJSON_AddStringToObject(byteLevel, "type", "ByteLevel");
+	cJSON_AddBoolToObject(byteLevel, "add_prefix_space", false);
+	cJSON_AddBoolToObject(byteLevel, "trim_offsets", true);
+	cJSON_AddBoolToObject(byteLevel, "use_regex", false);
+	cJSON_AddItemToArray(preSeq, byteLevel);
+
+	cJSON_AddNullToObject(root, "post_processor");
+
+	cJSON* decoder = cJSON_AddObjectToObject(root, "decoder");
+	cJSON_AddStringToObject(decoder, "type", "ByteLevel");
+	cJSON_AddBoolToObject(decoder, "add_prefix_space", true);
+	cJSON_AddBoolToObject(decoder, "trim_offsets", true);
+	cJSON_AddBoolToObject(decoder, "use_regex", true);
+
+	cJSON* model = cJSON_AddObjectToObject(root, "model");
+	cJSON_AddStringToObject(model, "type", "BPE");
+	cJSON_AddNullToObject(model, "dropout");
+	cJSON_AddNullToObject(model, "unk_token");
+	cJSON_AddNullToObject(model, "continuing_subword_prefix");
+	cJSON_AddNullToObject(model, "end_of_word_suffix");
+	cJSON_AddBoolToObject(model, "fuse_unk", false);
+	cJSON_AddBoolToObject(model, "byte_fallback", false);
+	cJSON_AddBoolToObject(model, "ignore_merges", false);
+	cJSON_AddItemToObject(model, "vocab", vocabJson);
+
+	cJSON* mergesJson = cJSON_AddArrayToObject(model, "merges");
+	for (const auto& [l, r] : this->merges)
+	{
+		cJSON* m = cJSON_CreateArray();
+		cJSON_AddItemToArray(m, cJSON_CreateString(str(this->vocab[l])));
+		cJSON_AddItemToArray(m, cJSON_CreateString(str(this->vocab[r])));
+		cJSON_AddItemToArray(mergesJson, m);
+	}
+
+	char* data = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+
+	if (data == nullptr)
+	{
+		throw std::runtime_error("BPE trainer - failed to create json");
+	}
+
+	FILE* f = std::fopen(jsonPath.c_str(), "wb");
+	if (f == nullptr)
+	{
+		cJSON_free(data);
+		throw std::runtime_error("BPE trainer - failed to create: " + jsonPath);
+	}
+
+	const size_t len = std::strlen(data);
+	const bool ok = (std::fwrite(data, 1, len, f) == len);
+	std::fclose(f);
+	cJSON_free(data);
+
+	if (ok == false)
+	{
+		throw std::runtime_error("BPE trainer - failed to write: " + jsonPath);
+	}
+}
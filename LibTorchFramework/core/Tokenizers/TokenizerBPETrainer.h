@@ -0,0 +1,73 @@
+#ifndef TOKENIZER_BPE_TRAINER_H
+#define TOKENIZER_BPE_TRAINER_H
+
+class ThreadPool;
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <array>
+#include <span>
+
+#include "./Tokenizers.h"
+#include "./Strings/PreTokenizer.h"
+
+/// <summary>
+/// Byte-level BPE trainer.
+/// Text is split with the same pre-tokenizer as TokenizerBPE uses,
+/// pieces are counted (each unique word is stored once with its frequency)
+/// and merges are learned with pair counts updated incrementally
+/// and the best pair selected from indexed max-heap.
+///
+/// Result is saved as tokenizer.json loadable by TokenizerJsonLoader.
+/// Vocab: 256 byte symbols, merged tokens, special tokens at the end
+/// </summary>
+class TokenizerBPETrainer
+{
+public:
+	struct Settings
+	{
+		size_t vocabSize = 32000; //including byte symbols and special tokens
+		uint64_t minFrequency = 2;
+		PreTokenizer::PatternType pattern = PreTokenizer::PatternType::LLAMA3;
+		std::vector<StringUtf8> specialTokens;
+	};
+
+	explicit TokenizerBPETrainer(const Settings& settings);
+	~TokenizerBPETrainer() = default;
+
+	void AddText(std::u8string_view text);
+	void AddTexts(std::span<const StringUtf8> texts, ThreadPool* pool = nullptr);
+	void AddFile(const std::string& path, ThreadPool* pool = nullptr);
+
+	size_t GetUniqueWordsCount() const;
+
+	void Train(ThreadPool* pool = nullptr);
+	void Save(const std::string& jsonPath) const;
+
+	const std::vector<StringUtf8>& GetVocab() const;
+	const std::vector<std::pair<TokenId, TokenId>>& GetMerges() const;
+
+protected:
+	using WordCounts = std::unordered_map<StringUtf8, uint64_t>;
+
+	static constexpr size_t FILE_BLOCK_SIZE = 64 * 1024 * 1024;
+
+	Settings settings;
+	PreTokenizer preTokenizer;
+	std::array<UnicodeCodePoint, 256> bytesToUnicode;
+
+	WordCounts words;
+
+	//trained tokens (index is id) and merges (left id, right id), in rank order
+	std::vector<StringUtf8> vocab;
+	std::vector<std::pair<TokenId, TokenId>> merges;
+
+	void CountWords(std::u8string_view text, WordCounts& counts) const;
+	void CountWordsParallel(const std::vector<std::u8string_view>& texts, ThreadPool* pool);
+	void MergeCounts(WordCounts& counts);
+};
+
+#endif
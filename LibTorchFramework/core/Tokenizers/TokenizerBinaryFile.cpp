@@ -0,0 +1,199 @@
+#include "./TokenizerBinaryFile.h"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+
+#include <FileUtils/MemMapFile.h>
+
+struct TokenizerBinaryFile::Mapping
+{
+	MemMapFile file;
+
+	explicit Mapping(const std::string& filename) :
+		file(filename.c_str(), O_RDONLY)
+	{
+	}
+
+	~Mapping()
+	{
+		file.Close();
+	}
+};
+
+TokenizerBinaryFile::TokenizerBinaryFile(const std::string& path) :
+	mapping(nullptr),
+	data(nullptr),
+	size(0),
+	header{}
+{
+	auto m = std::make_shared<Mapping>(path);
+	if (m->file.IsOpened() == false)
+	{
+		throw std::runtime_error("Failed to open compiled tokenizer: " + path);
+	}
+
+	this->size = m->file.GetSize();
+	if (this->size < sizeof(Header))
+	{
+		throw std::runtime_error("Compiled tokenizer is too small: " + path);
+	}
+
+	void* mapped = m->file.Map(PROT_READ, MAP_PRIVATE);
+	if (mapped == MAP_FAILED)
+	{
+		throw std::runtime_error("Failed to memory map compiled tokenizer: " + path);
+	}
+
+	this->data = static_cast<const uint8_t*>(mapped);
+	std::memcpy(&this->header, this->data, sizeof(Header));
+
+	if ((std::memcmp(this->header.magic, MAGIC, sizeof(MAGIC)) != 0) || (this->header.version != VERSION))
+	{
+		throw std::runtime_error("Unsupported compiled tokenizer format: " + path);
+	}
+
+	for (const Section* s : { &header.config, &header.vocabTable, &header.vocabSpans,
+		&header.vocabBlob, &header.mergeTable, &header.syntheticIds })
+	{
+		if ((s->offset > this->size) || (s->size > this->size - s->offset))
+		{
+			throw std::runtime_error("Compiled tokenizer is truncated: " + path);
+		}
+	}
+
+	this->mapping = m;
+}
+
+TokenizerBinaryFile::~TokenizerBinaryFile()
+{
+}
+
+template <typename T>
+std::span<const T> TokenizerBinaryFile::GetSection(const Section& s) const
+{
+	return std::span<const T>(reinterpret_cast<const T*>(this->data + s.offset), s.size / sizeof(T));
+}
+
+std::string_view TokenizerBinaryFile::GetConfigJson() const
+{
+	auto s = this->GetSection<char>(this->header.config);
+	return std::string_view(s.data(), s.size());
+}
+
+std::span<const TokenVocab::Entry> TokenizerBinaryFile::GetVocabTable() const
+{
+	return this->GetSection<TokenVocab::Entry>(this->header.vocabTable);
+}
+
+std::span<const TokenVocab::TokenSpan> TokenizerBinaryFile::GetVocabSpans() const
+{
+	return this->GetSection<TokenVocab::TokenSpan>(this->header.vocabSpans);
+}
+
+std::span<const char8_t> TokenizerBinaryFile::GetVocabBlob() const
+{
+	return this->GetSection<char8_t>(this->header.vocabBlob);
+}
+
+std::span<const BpeMergeTable::Entry> TokenizerBinaryFile::GetMergeTable() const
+{
+	return this->GetSection<BpeMergeTable::Entry>(this->header.mergeTable);
+}
+
+std::span<const TokenizerBinaryFile::SyntheticId> TokenizerBinaryFile::GetSyntheticIds() const
+{
+	return this->GetSection<SyntheticId>(this->header.syntheticIds);
+}
+
+TokenId TokenizerBinaryFile::GetFirstSyntheticId() const
+{
+	return this->header.firstSyntheticId;
+}
+
+//=============================================================
+
+/// <summary>
+/// Check file magic - compiled files can be passed
+/// instead of tokenizer.json
+/// </summary>
+/// <param name="path"></param>
+/// <returns></returns>
+bool TokenizerBinaryFile::IsBinaryFile(const std::string& path)
+{
+	std::ifstream f(path, std::ios::binary);
+	if (!f)
+	{
+		return false;
+	}
+
+	char magic[sizeof(MAGIC)] = {};
+	f.read(magic, sizeof(magic));
+
+	return (f.gcount() == sizeof(magic)) && (std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0);
+}
+
+/// <summary>
+/// Write compiled tokenizer file
+/// Throws std::runtime_error on failure
+/// </summary>
+/// <param name="path"></param>
+/// <param name="content"></param>
+void TokenizerBinaryFile::Write(const std::string& path, const Content& content)
+{
+	if ((content.vocab == nullptr) || (content.merges == nullptr))
+	{
+		throw std::runtime_error("Compiled tokenizer - missing vocab or merges");
+	}
+
+	std::ofstream f(path, std::ios::binary | std::ios::trunc);
+	if (!f)
+	{
+		throw std::runtime_error("Failed to create compiled tokenizer: " + path);
+	}
+
+	Header h = {};
+	std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = VERSION;
+	h.firstSyntheticId = content.firstSyntheticId;
+
+	uint64_t pos = sizeof(Header);
+
+	std::vector<char> zeros(std::max(ALIGNMENT, sizeof(Header)), 0);
+	f.write(zeros.data(), sizeof(Header));
+
+	auto writeSection = [&](Section& s, const void* ptr, size_t bytes) {
+		uint64_t aligned = (pos + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		f.write(zeros.data(), static_cast<std::streamsize>(aligned - pos));
+
+		s.offset = aligned;
+		s.size = bytes;
+		if (bytes > 0)
+		{
+			f.write(static_cast<const char*>(ptr), static_cast<std::streamsize>(bytes));
+		}
+		pos = aligned + bytes;
+	};
+
+	auto vocabTable = content.vocab->GetTable();
+	auto vocabSpans = content.vocab->GetSpans();
+	auto vocabBlob = content.vocab->GetBlob();
+	auto mergeTable = content.merges->GetTable();
+
+	writeSection(h.config, content.configJson.data(), content.configJson.size());
+	writeSection(h.vocabTable, vocabTable.data(), vocabTable.size_bytes());
+	writeSection(h.vocabSpans, vocabSpans.data(), vocabSpans.size_bytes());
+	writeSection(h.vocabBlob, vocabBlob.data(), vocabBlob.size_bytes());
+	writeSection(h.mergeTable, mergeTable.data(), mergeTable.size_bytes());
+	writeSection(h.syntheticIds, content.syntheticIds.data(), content.syntheticIds.size() * sizeof(SyntheticId));
+
+	f.seekp(0);
+	f.write(reinterpret_cast<const char*>(&h), sizeof(Header));
+
+	if (!f)
+	{
+		throw std::runtime_error("Failed to write compiled tokenizer: " + path);
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef TOKENIZER_BINARY_FILE_H
+#define TOKENIZER_BINARY_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <memory>
+
+#include "./Tokenizers.h"
+#include "./TokenVocab.h"
+#include "./BpeMergeTable.h"
+
+/// <summary>
+/// Compiled tokenizer file.
+/// Contains flat vocab (hash table, token spans and blob),
+/// BPE merge table over token ids and the rest of tokenizer.json
+/// (special tokens, normalizer, pre-tokenizer, post-processor)
+/// as small JSON section.
+///
+/// File is memory-mapped, all tables are used directly from the mapping
+/// Layout: Header, then sections aligned to 64 bytes
+/// </summary>
+class TokenizerBinaryFile
+{
+public:
+	struct SyntheticId
+	{
+		StringUtf8Hash hash;
+		TokenId id;
+		uint32_t reserved;
+	};
+
+	struct Content
+	{
+		std::string configJson;
+		const TokenVocab* vocab = nullptr;
+		const BpeMergeTable* merges = nullptr;
+		std::vector<SyntheticId> syntheticIds;
+		TokenId firstSyntheticId = 0;
+	};
+
+	explicit TokenizerBinaryFile(const std::string& path);
+	~TokenizerBinaryFile();
+
+	std::string_view GetConfigJson() const;
+
+	std::span<const TokenVocab::Entry> GetVocabTable() const;
+	std::span<const TokenVocab::TokenSpan> GetVocabSpans() const;
+	std::span<const char8_t> GetVocabBlob() const;
+
+	std::span<const BpeMergeTable::Entry> GetMergeTable() const;
+	std::span<const SyntheticId> GetSyntheticIds() const;
+	TokenId GetFirstSyntheticId() const;
+
+	static bool IsBinaryFile(const std::string& path);
+	static void Write(const std::string& path, const Content& content);
+
+protected:
+	static constexpr char MAGIC[8] = { 'T', 'O', 'K', 'B', 'P', 'E', 'B', 'N' };
+	static constexpr uint32_t VERSION = 1;
+	static constexpr size_t ALIGNMENT = 64;
+
+	struct Section
+	{
+		uint64_t offset;
+		uint64_t size; //in bytes
+	};
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		int32_t firstSyntheticId;
+
+		Section config;
+		Section vocabTable;
+		Section vocabSpans;
+		Section vocabBlob;
+		Section mergeTable;
+		Section syntheticIds;
+	};
+
+	struct Mapping;
+
+	std::shared_ptr<Mapping> mapping;
+	const uint8_t* data;
+	size_t size;
+	Header header;
+
+	template <typename T>
+	std::span<const T> GetSection(const Section& s) const;
+};
+
+#endif
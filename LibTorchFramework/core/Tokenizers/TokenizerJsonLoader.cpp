@@ -1,6 +1,9 @@
 #include "./TokenizerJsonLoader.h"
 
 #include <stdexcept>
+#include <cstring>
+
+#include "./TokenizerBinaryFile.h"
 
 #include <Utils/cJSON.h>
 #include <Utils/Strings/StringUtils.h>
@@ -32,19 +35,29 @@ const std::vector<TokenizerJsonLoader::AddedToken>& TokenizerJsonLoader::AddedTo
 	return this->addedTokens;
 }
 
-const TokenHashMap& TokenizerJsonLoader::GetVocab() const
+const TokenVocab& TokenizerJsonLoader::GetVocab() const
 {
-	return this->vocabData;
+	return this->vocab;
 }
 
-const ReverseTokenMap& TokenizerJsonLoader::GetVocabReversed() const
+const std::vector<TokenizerJsonLoader::MergeInfo>& TokenizerJsonLoader::GetMerges() const
 {
-	return this->vocabDataReverse;
+	return this->merges;
 }
 
-const std::vector<TokenizerJsonLoader::MergeInfo>& TokenizerJsonLoader::GetMerges() const
+const std::string& TokenizerJsonLoader::GetConfigJson() const
 {
-	return this->merges;
+	return this->configJson;
+}
+
+std::shared_ptr<TokenizerBinaryFile> TokenizerJsonLoader::GetBinaryFile() const
+{
+	return this->binary;
+}
+
+bool TokenizerJsonLoader::IsCompiled() const
+{
+	return this->binary != nullptr;
 }
 
 const std::vector<std::shared_ptr<TokenizerJsonLoader::IType>>& TokenizerJsonLoader::GetPreTokenizers() const
@@ -80,26 +93,37 @@ std::vector<char> TokenizerJsonLoader::LoadFile()
 }
 
 
+/// <summary>
+/// Load tokenizer.json or compiled tokenizer
+/// (see TokenizerBinaryFile), file type is detected from its content
+/// </summary>
 void TokenizerJsonLoader::Load()
 {
-	std::vector<char> jsonData = this->LoadFile();
+	this->addedTokens.clear();
+	this->vocab.Clear();
+	this->merges.clear();
+	this->configJson.clear();
+	this->binary = nullptr;
 
-	if (cJSON* json = cJSON_ParseWithLength(jsonData.data(), jsonData.size()))
+	if (TokenizerBinaryFile::IsBinaryFile(this->jsonPath))
 	{
-		auto addedTokens = cJSON_GetObjectItemCaseSensitive(json, "added_tokens");
-		this->LoadAddedTokens(addedTokens);
-
-		auto normalizer = cJSON_GetObjectItemCaseSensitive(json, "normalizer");
-		this->LoadNormalizer(normalizer);
+		this->LoadCompiled();
+	}
+	else
+	{
+		this->LoadJson();
+	}
+}
 
-		auto preTokenizer = cJSON_GetObjectItemCaseSensitive(json, "pre_tokenizer");
-		this->LoadPreTokenizer(preTokenizer);
+void TokenizerJsonLoader::LoadJson()
+{
+	std::vector<char> jsonData = this->LoadFile();
 
-		auto postProcessor = cJSON_GetObjectItemCaseSensitive(json, "post_processor");
-		this->LoadPostProcessor(postProcessor);
+	if (cJSON* json = cJSON_ParseWithLength(jsonData.data(), jsonData.size()))
+	{
+		this->LoadConfig(json);
 
 		auto model = cJSON_GetObjectItemCaseSensitive(json, "model");
-		this->LoadModelInfo(model);
 
 		auto vocab = cJSON_GetObjectItemCaseSensitive(model, "vocab");
 		this->LoadModelVocab(vocab);
@@ -107,6 +131,15 @@ void TokenizerJsonLoader::Load()
 		auto merges = cJSON_GetObjectItemCaseSensitive(model, "merges");
 		this->LoadModelMerges(merges);
 
+		//keep the rest for compiled file
+		cJSON_DeleteItemFromObjectCaseSensitive(model, "vocab");
+		cJSON_DeleteItemFromObjectCaseSensitive(model, "merges");
+		if (char* cfg = cJSON_PrintUnformatted(json))
+		{
+			this->configJson = cfg;
+			cJSON_free(cfg);
+		}
+
 		cJSON_Delete(json);
 	}
 	else 
@@ -117,6 +150,52 @@ void TokenizerJsonLoader::Load()
 	
 }
 
+/// <summary>
+/// Load compiled file - only small config JSON is parsed,
+/// vocab is used directly from memory-mapped file.
+/// Merges are not loaded, merge table is in the file as well
+/// </summary>
+void TokenizerJsonLoader::LoadCompiled()
+{
+	this->binary = std::make_shared<TokenizerBinaryFile>(this->jsonPath);
+
+	this->configJson = this->binary->GetConfigJson();
+
+	if (cJSON* json = cJSON_ParseWithLength(this->configJson.data(), this->configJson.size()))
+	{
+		this->LoadConfig(json);
+		cJSON_Delete(json);
+	}
+	else
+	{
+		throw std::runtime_error("Compiled tokenizer has invalid config: " + this->jsonPath);
+	}
+
+	this->vocab.Attach(this->binary->GetVocabTable(), this->binary->GetVocabSpans(), this->binary->GetVocabBlob());
+}
+
+/// <summary>
+/// Load everything except of vocab and merges
+/// </summary>
+/// <param name="json"></param>
+void TokenizerJsonLoader::LoadConfig(cJSON* json)
+{
+	auto addedTokens = cJSON_GetObjectItemCaseSensitive(json, "added_tokens");
+	this->LoadAddedTokens(addedTokens);
+
+	auto normalizer = cJSON_GetObjectItemCaseSensitive(json, "normalizer");
+	this->LoadNormalizer(normalizer);
+
+	auto preTokenizer = cJSON_GetObjectItemCaseSensitive(json, "pre_tokenizer");
+	this->LoadPreTokenizer(preTokenizer);
+
+	auto postProcessor = cJSON_GetObjectItemCaseSensitive(json, "post_processor");
+	this->LoadPostProcessor(postProcessor);
+
+	auto model = cJSON_GetObjectItemCaseSensitive(json, "model");
+	this->LoadModelInfo(model);
+}
+
 //=============================================================================
 // Load added tokens
 //=============================================================================
@@ -457,21 +536,20 @@ void TokenizerJsonLoader::LoadModelInfo(cJSON* json)
 /// <param name="json"></param>
 void TokenizerJsonLoader::LoadModelVocab(cJSON* json)
 {
+	this->vocab.Reserve(static_cast<size_t>(cJSON_GetArraySize(json)));
+
 	cJSON* item = nullptr;
 	cJSON_ArrayForEach(item, json)
 	{				
-		StringUtf8 str = (char8_t*)item->string;
+		std::u8string_view str = (char8_t*)item->string;
 
 		uint64_t tokenHash = Token::CalcHash(str);
 		
-		auto it = this->vocabData.try_emplace(tokenHash, item->valueint);
-		if (it.second == false)
+		if (this->vocab.TryAdd(tokenHash, item->valueint, str) == false)
 		{
 			//Collision - should not happen
 			throw std::runtime_error("Hash collision - tokenizer broken");
 		}
-		
-		this->vocabDataReverse.try_emplace(item->valueint, std::move(str));
 	}
 }
 
@@ -3,6 +3,8 @@
 
 struct cJSON;
 
+class TokenizerBinaryFile;
+
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -10,6 +12,7 @@ struct cJSON;
 #include <memory>
 
 #include "./Tokenizers.h"
+#include "./TokenVocab.h"
 
 class TokenizerJsonLoader 
 {
@@ -160,10 +163,13 @@ public:
 	std::shared_ptr<IType> GetNormalizer() const;
 
 	const std::vector<AddedToken>& AddedTokens() const;
-	const TokenHashMap& GetVocab() const;
-	const ReverseTokenMap& GetVocabReversed() const;
+	const TokenVocab& GetVocab() const;
 	const std::vector<MergeInfo>& GetMerges() const;
 
+	const std::string& GetConfigJson() const;
+	std::shared_ptr<TokenizerBinaryFile> GetBinaryFile() const;
+	bool IsCompiled() const;
+
 	const std::vector<std::shared_ptr<IType>>& GetPreTokenizers() const;
 	const std::vector<std::shared_ptr<IType>>& GetPostProcessors() const;
 
@@ -205,10 +211,15 @@ protected:
 	ModelInfo mi;
 
 	std::vector<AddedToken> addedTokens;
-	TokenHashMap vocabData;
-	ReverseTokenMap vocabDataReverse;
+	TokenVocab vocab;
 	std::vector<MergeInfo> merges;
 
+	//tokenizer.json without vocab and merges
+	std::string configJson;
+
+	//set if loaded from compiled file, vocab is attached to it
+	std::shared_ptr<TokenizerBinaryFile> binary;
+
 	std::shared_ptr<IType> normalizer;
 
 	std::vector<std::shared_ptr<IType>> preTokenizers;
@@ -218,6 +229,10 @@ protected:
 
 	std::vector<char> LoadFile();
 
+	void LoadJson();
+	void LoadCompiled();
+	void LoadConfig(cJSON* json);
+
 	void LoadAddedTokens(cJSON* json);
 
 	void LoadNormalizer(cJSON* json);
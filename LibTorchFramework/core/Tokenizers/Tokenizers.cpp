@@ -0,0 +1,110 @@
+#include "./Tokenizers.h"
+
+#include "../../Utils/ThreadPool.h"
+
+//=============================================================
+// FlatBatch
+//=============================================================
+
+size_t Tokenizer::FlatBatch::GetCount() const
+{
+	return (offsets.empty()) ? 0 : offsets.size() - 1;
+}
+
+std::span<const TokenId> Tokenizer::FlatBatch::Get(size_t i) const
+{
+	return std::span<const TokenId>(ids.data() + offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+//=============================================================
+// Batch encode / decode
+//=============================================================
+
+std::vector<std::vector<TokenId>> Tokenizer::EncodeBatch(std::span<const StringUtf8> strs, ThreadPool* pool) const
+{
+	if (pool == nullptr)
+	{
+		pool = &ThreadPool::GetDefault();
+	}
+
+	std::vector<std::vector<TokenId>> res(strs.size());
+
+	pool->ParallelFor(strs.size(), BATCH_GRAIN_SIZE, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			res[i] = this->Encode(strs[i]);
+		}
+	});
+
+	return res;
+}
+
+/// <summary>
+/// Encode strings to single ids buffer.
+/// Each chunk of strings is encoded to its own buffer,
+/// chunks are then copied to result at their prefix-sum offsets
+/// </summary>
+/// <param name="strs"></param>
+/// <param name="pool">if nullptr, default pool is used</param>
+/// <returns></returns>
+Tokenizer::FlatBatch Tokenizer::EncodeBatchFlat(std::span<const StringUtf8> strs, ThreadPool* pool) const
+{
+	if (pool == nullptr)
+	{
+		pool = &ThreadPool::GetDefault();
+	}
+
+	const size_t chunksCount = (strs.size() + BATCH_GRAIN_SIZE - 1) / BATCH_GRAIN_SIZE;
+
+	std::vector<std::vector<TokenId>> chunkIds(chunksCount);
+
+	FlatBatch res;
+	res.offsets.assign(strs.size() + 1, 0);
+
+	//offsets[i + 1] temporarily holds length of string i
+	pool->ParallelFor(strs.size(), BATCH_GRAIN_SIZE, [&](size_t begin, size_t end) {
+		auto& buf = chunkIds[begin / BATCH_GRAIN_SIZE];
+		for (size_t i = begin; i < end; i++)
+		{
+			auto ids = this->Encode(strs[i]);
+			res.offsets[i + 1] = ids.size();
+			buf.insert(buf.end(), ids.begin(), ids.end());
+		}
+	});
+
+	for (size_t i = 0; i < strs.size(); i++)
+	{
+		res.offsets[i + 1] += res.offsets[i];
+	}
+
+	res.ids.resize(res.offsets.back());
+
+	pool->ParallelFor(chunksCount, 1, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; c++)
+		{
+			const auto& buf = chunkIds[c];
+			std::copy(buf.begin(), buf.end(), res.ids.begin() + res.offsets[c * BATCH_GRAIN_SIZE]);
+		}
+	});
+
+	return res;
+}
+
+std::vector<StringUtf8> Tokenizer::DecodeBatch(std::span<const std::vector<TokenId>> ids, ThreadPool* pool) const
+{
+	if (pool == nullptr)
+	{
+		pool = &ThreadPool::GetDefault();
+	}
+
+	std::vector<StringUtf8> res(ids.size());
+
+	pool->ParallelFor(ids.size(), BATCH_GRAIN_SIZE, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			res[i] = this->Decode(ids[i]);
+		}
+	});
+
+	return res;
+}
@@ -7,6 +7,7 @@
 #include <memory>
 #include <vector>
 #include <utility>
+#include <span>
 
 #include <Utils/3rdParty/xxhash.hpp>
 
@@ -34,14 +35,41 @@ using TokenHashMap = std::unordered_map<StringUtf8Hash, TokenId>;
 
 //=============================================================
 
+class ThreadPool;
+
+/// <summary>
+/// Encode and Decode must be thread-safe,
+/// batch methods run them in parallel
+/// </summary>
 class Tokenizer 
 {
 public:
+	/// <summary>
+	/// Ids of all strings in single buffer,
+	/// ids of string i are [offsets[i], offsets[i + 1])
+	/// </summary>
+	struct FlatBatch
+	{
+		std::vector<TokenId> ids;
+		std::vector<size_t> offsets;
+
+		size_t GetCount() const;
+		std::span<const TokenId> Get(size_t i) const;
+	};
+
 	Tokenizer() = default;
-	~Tokenizer() = default;
+	virtual ~Tokenizer() = default;
+
+	virtual std::vector<TokenId> Encode(const StringUtf8& str) const = 0;
+	virtual StringUtf8 Decode(const std::vector<TokenId>& ids) const = 0;
+
+	std::vector<std::vector<TokenId>> EncodeBatch(std::span<const StringUtf8> strs, ThreadPool* pool = nullptr) const;
+	FlatBatch EncodeBatchFlat(std::span<const StringUtf8> strs, ThreadPool* pool = nullptr) const;
+
+	std::vector<StringUtf8> DecodeBatch(std::span<const std::vector<TokenId>> ids, ThreadPool* pool = nullptr) const;
 
-	virtual std::vector<TokenId> Encode(const StringUtf8& str) = 0;
-	virtual StringUtf8 Decode(const std::vector<TokenId>& ids) = 0;
+protected:
+	static constexpr size_t BATCH_GRAIN_SIZE = 16;
 };
 
 //=============================================================
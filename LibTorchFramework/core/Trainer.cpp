@@ -1,5 +1,7 @@
 #include "./Trainer.h"
 
+#include <filesystem>
+
 #include "../InputProcessing/DataLoaderData.h"
 
 #include "./Structures.h"
@@ -12,6 +14,9 @@
 #include "./Metrics/MetricsDefault.h"
 
 #include "./Snapshot/SnapshotSaver.h"
+#include "./Snapshot/AsyncSnapshotSaver.h"
+#include "./Snapshot/PretrainedManager.h"
+#include "./Snapshot/TrainingState.h"
 
 #include "./Modules/gradscaler.hpp"
 
@@ -21,20 +26,164 @@ Trainer::Trainer(const Settings& sets, std::shared_ptr<AbstractModel> model) :
 	Runner(RunMode::TRAIN, sets, model),
     cudaGraph(nullptr),
     scaler(nullptr),
-    bestMetrics(nullptr)
+    bestMetrics(nullptr),
+    snapshotSaver(nullptr),
+    stateSaver(nullptr),
+    trainingState(std::make_shared<TrainingState>()),
+    resumedState(nullptr),
+    resumePending(false),
+    lastStateSaveCount(0)
 {
     if (sets.perf.enableAutoCast)
     {
         scaler = std::make_shared<torch::amp::GradScaler>();        
     }
 
+    if (sets.perf.useAsyncSnapshots)
+    {
+        snapshotSaver = std::make_shared<AsyncSnapshotSaver>(this->model.get(), sets.perf.asyncSnapshotsInFlight);
+
+        //own staging buffers - training state has different tensors than snapshot
+        if (this->IsTrainingStateEnabled())
+        {
+            stateSaver = std::make_shared<AsyncSnapshotSaver>(this->model.get(), 1);
+        }
+    }
+    else
+    {
+        snapshotSaver = std::make_shared<SnapshotSaver>(this->model.get());
+    }
+
+    if ((sets.pretrainedManager) && (sets.pretrainedManager->IsDeltaSnapshotEnabled()))
+    {
+        snapshotSaver->EnableDeltaMode(true, sets.pretrainedManager->GetDeltaBasePath());
+    }
+
     //cudaGraph = std::make_shared<CudaGraphHelper>(this, 1, true, true);
 }
 
 Trainer::~Trainer()
 {
+    //async saver finishes all pending writes before it is released
+    snapshotSaver = nullptr;
+    stateSaver = nullptr;
+}
+
+//============================================================
+// Training state (resume)
+//============================================================
+
+/// <summary>
+/// Training state is opt-in via sets.trainingStateInterval
+/// (saving it every epoch is expensive for large models)
+/// </summary>
+/// <returns></returns>
+bool Trainer::IsTrainingStateEnabled() const
+{
+    return (sets.pretrainedManager != nullptr) && (sets.trainingStateInterval.has_value());
+}
+
+/// <summary>
+/// Load training state of the model (if exist) and restore weights,
+/// optimizer, scaler and RNG from it.
+/// Returned state contains epoch and data shuffle seed,
+/// that must be used to build data loaders.
+/// Batches processed before interruption are skipped in the resumed epoch
+/// </summary>
+/// <returns>nullptr if there is nothing to resume</returns>
+std::shared_ptr<const TrainingState> Trainer::ResumeTrainingState()
+{
+    if (this->IsTrainingStateEnabled() == false)
+    {
+        return nullptr;
+    }
+
+    auto path = sets.pretrainedManager->GetTrainingStatePath(this->model.get());
+    if (std::filesystem::exists(path) == false)
+    {
+        MY_LOG_INFO("No training state in %s - training starts from the beginning", path.c_str());
+        return nullptr;
+    }
+
+    if (trainingState->Load(path) == false)
+    {
+        MY_LOG_WARNING("Training state %s is not resumed - training starts from the beginning", path.c_str());
+        return nullptr;
+    }
+
+    if (trainingState->GetEpochId() >= sets.epochCount)
+    {
+        MY_LOG_WARNING("Training state %s is from finished training (epoch %d / %d) - not resumed, "
+            "training starts from the beginning", path.c_str(), trainingState->GetEpochId(), sets.epochCount);
+
+        trainingState->ReleaseTensors();
+        trainingState->SetEpoch(0, 0);
+        return nullptr;
+    }
+
+    //optimizer state is created on the device of parameters
+    model->to(sets.device);
+
+    trainingState->Restore(this->model.get(), this->scaler.get());
+    trainingState->ReleaseTensors();
+
+    resumePending = true;
+
+    MY_LOG_INFO("Resuming training from epoch %d / %d (state: %s)", 
+        trainingState->GetEpochId(), sets.epochCount, path.c_str());
+
+    return trainingState;
+}
+
+void Trainer::SetDataShuffleSeed(std::optional<int> seed)
+{
+    trainingState->SetShuffleSeed(seed);
 }
 
+/// <summary>
+/// Id of batch within epoch, independent on order in which
+/// batches arrive from workers (sequential sampler - batch
+/// contains consecutive data indices).
+/// Bucketed batches (sets.maxBatchTokens) have fixed content and each
+/// sample is in exactly one batch, so the first data index is used
+/// (id is not smaller than batches count, TrainingState flags grow to it).
+/// Stream batches have no indices, order of batch within epoch is used
+/// </summary>
+/// <param name="dataIndices">data indices of batch samples</param>
+/// <returns></returns>
+size_t Trainer::GetBatchId(const std::vector<int64_t>& dataIndices) const
+{
+    if (dataIndices[0] == DataLoaderData::STREAM_INDEX)
+    {
+        return batchIndex;
+    }
+    if (sets.maxBatchTokens.has_value())
+    {
+        return size_t(dataIndices[0]);
+    }
+    return size_t(dataIndices[0]) / std::max<size_t>(sets.batchSize, 1);
+}
+
+void Trainer::SaveTrainingState()
+{
+    auto path = sets.pretrainedManager->GetTrainingStatePath(this->model.get());
+
+    trainingState->Capture(this->model.get(), this->scaler.get());
+    if (stateSaver)
+    {
+        trainingState->Save(path, *stateSaver);
+    }
+    else
+    {
+        trainingState->Save(path);
+    }
+    trainingState->ReleaseTensors();
+
+    lastStateSaveCount = trainingState->GetProcessedBatchesCount();
+}
+
+//============================================================
+
 void Trainer::CheckLoss(at::Tensor loss)
 {
     //TORCH_CHECK(scaler != nullptr, "enableAutoCast is true but scaler is null");
@@ -184,6 +333,71 @@ void Trainer::OnEpochStart()
     model->train();
     
     torch::autograd::GradMode::set_enabled(true);
+
+    if (this->IsTrainingStateEnabled())
+    {
+        bool resumeEpoch = resumePending &&
+            (trainingState->GetEpochId() == activeEpochId) &&
+            (trainingState->GetBatchesCount() == dataLoaderBatchesCount);
+
+        if (resumeEpoch == false)
+        {
+            if ((resumePending) && (trainingState->GetEpochId() == activeEpochId))
+            {
+                MY_LOG_WARNING("Training state has %zu batches in epoch, data loader %zu - epoch %d starts from the beginning",
+                    trainingState->GetBatchesCount(), dataLoaderBatchesCount, activeEpochId);
+            }
+            trainingState->SetEpoch(activeEpochId, dataLoaderBatchesCount);
+        }
+        else
+        {
+            MY_LOG_INFO("Resuming epoch %d - skipping %zu processed batches", 
+                activeEpochId, trainingState->GetProcessedBatchesCount());
+        }
+
+        resumePending = false;
+        lastStateSaveCount = trainingState->GetProcessedBatchesCount();
+
+        //copy - trainingState is updated during epoch, copy is read by prefetcher
+        resumedState = nullptr;
+        if (trainingState->GetProcessedBatchesCount() > 0)
+        {
+            resumedState = std::make_shared<const TrainingState>(*trainingState);
+        }
+    }
+}
+
+bool Trainer::SkipBatch(const std::vector<int64_t>& dataIndices)
+{
+    if ((this->IsTrainingStateEnabled() == false) || (trainingState->GetProcessedBatchesCount() == 0))
+    {
+        return false;
+    }
+
+    if (trainingState->IsBatchProcessed(this->GetBatchId(dataIndices)) == false)
+    {
+        return false;
+    }
+
+    this->pBar->NextStep();
+    return true;
+}
+
+/// <summary>
+/// Batches processed before interruption are known at the start of epoch,
+/// so they are not moved to device by prefetcher.
+/// Stream batches are identified by order, they are always moved
+/// </summary>
+/// <param name="dataIndices"></param>
+/// <returns></returns>
+bool Trainer::IsBatchSkipped(const std::vector<int64_t>& dataIndices) const
+{
+    if ((resumedState == nullptr) || (dataIndices[0] == DataLoaderData::STREAM_INDEX))
+    {
+        return false;
+    }
+
+    return resumedState->IsBatchProcessed(this->GetBatchId(dataIndices));
 }
 
 void Trainer::ProcessBatch(DataLoaderData& batch)
@@ -215,6 +429,19 @@ void Trainer::ProcessBatch(DataLoaderData& batch)
     {
         this->RunStep(batch, optimizer);
     }
+
+    if (this->IsTrainingStateEnabled())
+    {
+        trainingState->MarkBatchProcessed(this->GetBatchId(batch.GetDataIndices()));
+
+        //state is saved only after optimizer step, when there are no accumulated gradients
+        if ((optimizer != nullptr) && 
+            (sets.trainingStateInterval.has_value()) && (*sets.trainingStateInterval > 0) &&
+            (trainingState->GetProcessedBatchesCount() >= lastStateSaveCount + *sets.trainingStateInterval))
+        {
+            this->SaveTrainingState();
+        }
+    }
 }
 
 void Trainer::OnEpochEnd()
@@ -223,9 +450,25 @@ void Trainer::OnEpochEnd()
 
     if ((this->metrics) && (this->metrics->IsBetterThan(this->bestMetrics)))
     {
-        SnapshotSaver saver(this->model.get());
-        saver.Save(sets.pretrainedManager);
-
-        this->bestMetrics = this->metrics;
+        if ((snapshotSaver->Save(sets.pretrainedManager) == false) && (sets.pretrainedManager != nullptr))
+        {
+            //keep previous best, snapshot is saved again with next better metrics
+            MY_LOG_ERROR("Best model snapshot was not saved");
+        }
+        else
+        {
+            this->bestMetrics = this->metrics;
+            if (sets.pretrainedManager)
+            {
+                sets.pretrainedManager->DeleteOldTrainingFiles();
+            }
+        }
     }    
+
+    if (this->IsTrainingStateEnabled())
+    {
+        //epoch is finished, resumed training continues with the next one
+        trainingState->SetEpoch(activeEpochId + 1, 0);
+        this->SaveTrainingState();
+    }
 }
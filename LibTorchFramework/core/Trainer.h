@@ -7,6 +7,9 @@ class AbstractModel;
 struct DataLoaderData;
 
 class CudaGraphHelper;
+class SnapshotSaver;
+class AsyncSnapshotSaver;
+class TrainingState;
 
 namespace torch {
 	namespace amp {
@@ -24,6 +27,9 @@ public:
 
 	Trainer(const Settings& sets, std::shared_ptr<AbstractModel> model);
 	virtual ~Trainer();    
+
+	std::shared_ptr<const TrainingState> ResumeTrainingState();
+	void SetDataShuffleSeed(std::optional<int> seed);
 	
 	friend class CudaGraphHelper;
 
@@ -35,6 +41,18 @@ protected:
 
 	std::shared_ptr<MetricsDefault> bestMetrics;
 
+	std::shared_ptr<SnapshotSaver> snapshotSaver;
+	std::shared_ptr<AsyncSnapshotSaver> stateSaver;
+
+	std::shared_ptr<TrainingState> trainingState;
+	std::shared_ptr<const TrainingState> resumedState; //processed batches at the start of resumed epoch
+	bool resumePending;
+	size_t lastStateSaveCount;
+
+	bool IsTrainingStateEnabled() const;
+	size_t GetBatchId(const std::vector<int64_t>& dataIndices) const;
+	void SaveTrainingState();
+
 	void CheckLoss(at::Tensor loss);
 
 	void RunTrainStepsFull(at::Tensor loss, std::shared_ptr<torch::optim::Optimizer> optimizer);
@@ -48,6 +66,8 @@ protected:
 	void ProgressLoss(float loss);
 
 	virtual void OnEpochStart() override;
+	virtual bool SkipBatch(const std::vector<int64_t>& dataIndices) override;
+	virtual bool IsBatchSkipped(const std::vector<int64_t>& dataIndices) const override;
 	virtual void ProcessBatch(DataLoaderData& batch) override;
 	virtual void OnEpochEnd() override;
 };